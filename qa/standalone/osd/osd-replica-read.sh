@@ -0,0 +1,154 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7235" # git grep '\<7235\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+# the sum of an osd perf counter over osd.0 and osd.1
+function osd_counter() {
+    local counter=$1
+    local sum=0
+    for osd in 0 1 ; do
+        local v=$(ceph tell osd.$osd perf dump osd | jq ".osd.$counter")
+        sum=$((sum + v))
+    done
+    echo $sum
+}
+
+# write obj, then right away read it back with balanced reads from
+# many threads, so that some of them go to the replica while the write
+# is not known to be committed there yet; prints the longest read in ms
+function write_and_balanced_reads() {
+    local poolname=$1
+    local obj=$2
+    python3 - $poolname $obj <<'EOF'
+import sys
+import threading
+import time
+import rados
+
+pool, obj = sys.argv[1], sys.argv[2]
+data = b'replica read %f' % time.time()
+cluster = rados.Rados(conffile='')
+cluster.conf_parse_env('CEPH_ARGS')
+cluster.connect()
+ioctx = cluster.open_ioctx(pool)
+ioctx.write_full(obj, data)
+
+failed = []
+latencies = []
+def read():
+    start = time.monotonic()
+    try:
+        with rados.ReadOpCtx() as op:
+            op.cmpext(data, 0)
+            ioctx.operate_read_op(op, obj,
+                                  rados.LIBRADOS_OPERATION_BALANCE_READS)
+    except rados.Error as e:
+        failed.append(e)
+    latencies.append(time.monotonic() - start)
+
+threads = [threading.Thread(target=read) for _ in range(16)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+ioctx.close()
+cluster.shutdown()
+if failed:
+    print(failed, file=sys.stderr)
+    sys.exit(1)
+print(int(max(latencies) * 1000))
+EOF
+}
+
+function setup_cluster() {
+    local dir=$1
+    local poolname=$2
+
+    run_mon $dir a --osd_pool_default_size=2 || return 1
+    run_mgr $dir x || return 1
+    run_osd $dir 0 || return 1
+    run_osd $dir 1 || return 1
+    create_pool $poolname 1 1 || return 1
+    # the primary only advances pg_committed_to on the replica 3 seconds
+    # after the last write
+    ceph osd pool set $poolname pct_update_delay 3 || return 1
+    wait_for_clean || return 1
+}
+
+function TEST_replica_read_wait_for_commit() {
+    local dir=$1
+    local poolname=test
+
+    setup_cluster $dir $poolname || return 1
+    ceph tell 'osd.*' config set osd_replica_read_wait_for_commit true || return 1
+
+    local waited=$(osd_counter replica_read_wait_commit)
+    local served=$(osd_counter replica_read_served)
+    local conflict=$(osd_counter replica_read_redirect_conflict)
+    local longest
+    longest=$(write_and_balanced_reads $poolname obj1) || return 1
+    waited=$(($(osd_counter replica_read_wait_commit) - waited))
+    served=$(($(osd_counter replica_read_served) - served))
+    conflict=$(($(osd_counter replica_read_redirect_conflict) - conflict))
+    echo "waited=$waited served=$served conflict=$conflict longest=${longest}ms"
+
+    # the reads reaching the replica were held there rather than bounced,
+    # and served by it once pg_committed_to reached the write
+    test $waited -gt 0 || return 1
+    test $conflict = 0 || return 1
+    test $served -ge $waited || return 1
+    test $longest -ge 1000 || return 1
+}
+
+function TEST_replica_read_bounce() {
+    local dir=$1
+    local poolname=test
+
+    setup_cluster $dir $poolname || return 1
+    ceph tell 'osd.*' config set osd_replica_read_wait_for_commit false || return 1
+
+    local waited=$(osd_counter replica_read_wait_commit)
+    local conflict=$(osd_counter replica_read_redirect_conflict)
+    write_and_balanced_reads $poolname obj1 || return 1
+    waited=$(($(osd_counter replica_read_wait_commit) - waited))
+    conflict=$(($(osd_counter replica_read_redirect_conflict) - conflict))
+    echo "waited=$waited conflict=$conflict"
+
+    # the reads reaching the replica are bounced to the primary
+    test $waited = 0 || return 1
+    test $conflict -gt 0 || return 1
+}
+
+main osd-replica-read "$@"
+
+# Local Variables:
+# compile-command: "make -j4 && ../qa/run-standalone.sh osd-replica-read.sh"
+# End:
@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7236" # git grep '\<7236\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+# the sum of a counter over the osd-shard-<n> sets of an osd
+function shard_counter() {
+    local osd=$1
+    local counter=$2
+    ceph tell osd.$osd perf dump | \
+        jq "[to_entries[] | select(.key | startswith(\"osd-shard-\")) | .value.$counter] | add"
+}
+
+# ceph_test_rados checks that the writes to each object complete in
+# order and that the reads return what was last written
+function rados_model() {
+    local poolname=$1
+    timeout 600 ceph_test_rados --pool $poolname --max-ops 3000 --objects 20 \
+        --max-in-flight 16 --size 400000 --min-stride-size 40000 \
+        --max-stride-size 80000 --max-seconds 240 \
+        --op read 100 --op write 100 --op append 50 --op delete 10 \
+        --op setattr 20 --op rmattr 10
+}
+
+function TEST_work_stealing() {
+    local dir=$1
+
+    run_mon $dir a --osd_pool_default_size=1 || return 1
+    run_mgr $dir x || return 1
+    # a thread per shard, so that a busy shard has no thread to spare and
+    # the idle shards steal from it
+    run_osd $dir 0 --osd_op_queue=wpq --osd_op_num_shards=4 \
+        --osd_op_num_threads_per_shard=1 \
+        --osd_op_queue_work_stealing=true || return 1
+    # all the ops of "hot" land on the shard of its only pg, those of
+    # "cold" on every shard, including the thieves
+    create_pool hot 1 1 || return 1
+    create_pool cold 8 8 || return 1
+    wait_for_clean || return 1
+
+    rados_model hot > $dir/hot.log 2>&1 &
+    local hot=$!
+    rados_model cold > $dir/cold.log 2>&1 &
+    local cold=$!
+    # an oncommit a thief failed to run would leave its op hanging
+    local status=0
+    wait $hot || status=1
+    wait $cold || status=1
+    if test $status != 0 ; then
+        tail -n 50 $dir/hot.log $dir/cold.log
+        return 1
+    fi
+
+    local steals=$(shard_counter 0 steals)
+    local stolen=$(shard_counter 0 stolen)
+    echo "steals=$steals stolen=$stolen"
+    test $steals -gt 0 || return 1
+    test $steals = $stolen || return 1
+}
+
+main osd-work-stealing "$@"
+
+# Local Variables:
+# compile-command: "make -j4 && ../qa/run-standalone.sh osd-work-stealing.sh"
+# End:
@@ -109,6 +109,10 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
             "Number of discard ops issued to kernel device");
   b.add_u64_counter(l_blk_kernel_discard_threads, "discard_threads",
             "Number of discard threads running");
+  b.add_u64_counter(l_blk_kernel_device_write_realign_bytes,
+            "write_realign_bytes",
+            "Bytes copied to align write buffers for direct I/O",
+            NULL, PerfCountersBuilder::PRIO_DEBUGONLY, unit_t(UNIT_BYTES));
 
   logger.reset(b.create_perf_counters());
   cct->get_perfcounters_collection()->add(logger.get());
@@ -1111,9 +1115,13 @@ int KernelDevice::write(
     return 0;
   }
 
-  if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
-      bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
-    dout(20) << __func__ << " rebuilding buffer to be aligned" << dendl;
+  if (!buffered || bl.get_num_buffers() >= IOV_MAX) {
+    ceph::buffer_instrumentation::copy_tracker copied;
+    if (bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
+      dout(20) << __func__ << " rebuilding buffer to be aligned, copied 0x"
+	       << std::hex << copied.get() << std::dec << dendl;
+      logger->inc(l_blk_kernel_device_write_realign_bytes, copied.get());
+    }
   }
   dout(40) << "data:\n";
   bl.hexdump(*_dout);
@@ -1140,9 +1148,13 @@ int KernelDevice::aio_write(
     return 0;
   }
 
-  if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
-      bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
-    dout(20) << __func__ << " rebuilding buffer to be aligned" << dendl;
+  if (!buffered || bl.get_num_buffers() >= IOV_MAX) {
+    ceph::buffer_instrumentation::copy_tracker copied;
+    if (bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
+      dout(20) << __func__ << " rebuilding buffer to be aligned, copied 0x"
+	       << std::hex << copied.get() << std::dec << dendl;
+      logger->inc(l_blk_kernel_device_write_realign_bytes, copied.get());
+    }
   }
   dout(40) << "data:\n";
   bl.hexdump(*_dout);
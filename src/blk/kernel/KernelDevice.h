@@ -34,6 +34,7 @@ enum {
   l_blk_kernel_device_first = 1000,
   l_blk_kernel_device_discard_op,
   l_blk_kernel_discard_threads,
+  l_blk_kernel_device_write_realign_bytes,
   l_blk_kernel_device_last,
 };
 
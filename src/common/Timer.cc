@@ -21,8 +21,6 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "timer(" << this << ")."
 
-using std::pair;
-
 using ceph::operator <<;
 
 template <class Mutex>
@@ -41,6 +39,7 @@ CommonSafeTimer<Mutex>::CommonSafeTimer(CephContext *cct_, Mutex &l, bool safe_c
   : cct(cct_), lock(l),
     safe_callbacks(safe_callbacks),
     thread(NULL),
+    schedule(std::chrono::milliseconds(1)),
     stopping(false)
 {
 }
@@ -84,31 +83,22 @@ void CommonSafeTimer<Mutex>::timer_thread()
   while (!stopping) {
     auto now = clock_t::now();
 
-    while (!schedule.empty()) {
-      auto p = schedule.begin();
-
-      // is the future now?
-      #if defined(_WIN32)
-      if (p->first - now > std::chrono::milliseconds(1)) {
-        // std::condition_variable::wait_for uses SleepConditionVariableSRW
-        // on Windows, which has millisecond precision. Deltas <1ms will
-        // lead to busy loops, which should be avoided. This situation is
-        // quite common since "wait_for" often returns ~1ms earlier than
-        // requested.
-        break;
-      }
-      #else // !_WIN32
-      if (p->first > now) {
-        break;
-      }
-      #endif
-
+    // is the future now?
+    #if defined(_WIN32)
+    // std::condition_variable::wait_for uses SleepConditionVariableSRW
+    // on Windows, which has millisecond precision. Deltas <1ms will
+    // lead to busy loops, which should be avoided. This situation is
+    // quite common since "wait_for" often returns ~1ms earlier than
+    // requested.
+    now += std::chrono::milliseconds(1);
+    #endif
+
+    schedule.expire(now, [&] (event_t& event) {
       ldout(cct, 20) << "timer_thread going to execute and remove the top of a schedule sized " << schedule.size() << dendl;
-      Context *callback = p->second;
+      Context *callback = event.callback;
       events.erase(callback);
-      schedule.erase(p);
       ldout(cct,10) << "timer_thread executing " << callback << dendl;
-      
+
       if (!safe_callbacks) {
 	l.unlock();
 	callback->complete(0);
@@ -116,7 +106,7 @@ void CommonSafeTimer<Mutex>::timer_thread()
       } else {
 	callback->complete(0);
       }
-    }
+    });
 
     // recheck stopping if we dropped the lock
     if (!safe_callbacks && stopping)
@@ -127,7 +117,7 @@ void CommonSafeTimer<Mutex>::timer_thread()
       cond.wait(l);
     } else {
       ldout(cct, 20) << "timer_thread going to sleep with a schedule size " << schedule.size() << dendl;
-      auto when = schedule.begin()->first;
+      auto when = *schedule.next_expiry();
       cond.wait_until(l, when);
     }
     ldout(cct,20) << "timer_thread awake" << dendl;
@@ -160,18 +150,19 @@ Context* CommonSafeTimer<Mutex>::add_event_at(CommonSafeTimer<Mutex>::clock_t::t
     delete callback;
     return nullptr;
   }
-  scheduled_map_t::value_type s_val(when, callback);
-  scheduled_map_t::iterator i = schedule.insert(s_val);
-
-  event_lookup_map_t::value_type e_val(callback, i);
-  pair < event_lookup_map_t::iterator, bool > rval(events.insert(e_val));
+  auto [e, inserted] = events.try_emplace(callback);
 
   /* If you hit this, you tried to insert the same Context* twice. */
-  ceph_assert(rval.second);
+  ceph_assert(inserted);
+
+  auto next = schedule.next_expiry();
+  e->second.when = when;
+  e->second.callback = callback;
+  schedule.arm(e->second, when);
 
   /* If the event we have just inserted comes before everything else, we need to
    * adjust our timeout. */
-  if (i == schedule.begin())
+  if (!next || when < *next)
     cond.notify_all();
   return callback;
 }
@@ -200,10 +191,10 @@ bool CommonSafeTimer<Mutex>::cancel_event(Context *callback)
     return false;
   }
 
-  ldout(cct,10) << "cancel_event " << p->second->first << " -> " << callback << dendl;
+  ldout(cct,10) << "cancel_event " << p->second.when << " -> " << callback << dendl;
   delete p->first;
 
-  schedule.erase(p->second);
+  schedule.cancel(p->second);
   events.erase(p);
   return true;
 }
@@ -216,9 +207,9 @@ void CommonSafeTimer<Mutex>::cancel_all_events()
 
   while (!events.empty()) {
     auto p = events.begin();
-    ldout(cct,10) << " cancelled " << p->second->first << " -> " << p->first << dendl;
+    ldout(cct,10) << " cancelled " << p->second.when << " -> " << p->first << dendl;
     delete p->first;
-    schedule.erase(p->second);
+    schedule.cancel(p->second);
     events.erase(p);
   }
 }
@@ -230,10 +221,8 @@ void CommonSafeTimer<Mutex>::dump(const char *caller) const
     caller = "";
   ldout(cct,10) << "dump " << caller << dendl;
 
-  for (scheduled_map_t::const_iterator s = schedule.begin();
-       s != schedule.end();
-       ++s)
-    ldout(cct,10) << " " << s->first << "->" << s->second << dendl;
+  for (const auto& [callback, event] : events)
+    ldout(cct,10) << " " << event.when << "->" << callback << dendl;
 }
 
 template class CommonSafeTimer<ceph::mutex>;
@@ -17,10 +17,12 @@
 #define CEPH_TIMER_H
 
 #include <map>
+#include <unordered_map>
 #include "include/common_fwd.h"
 #include "ceph_time.h"
 #include "ceph_mutex.h"
 #include "fair_mutex.h"
+#include "timing_wheel.h"
 #include <condition_variable>
 
 class Context;
@@ -42,10 +44,15 @@ class CommonSafeTimer
   void _shutdown();
 
   using clock_t = ceph::mono_clock;
-  using scheduled_map_t = std::multimap<clock_t::time_point, Context*>;
-  scheduled_map_t schedule;
-  using event_lookup_map_t = std::map<Context*, scheduled_map_t::iterator>;
+  struct event_t : public ceph::common::timing_wheel_hook {
+    clock_t::time_point when;
+    Context *callback = nullptr;
+  };
+  // the events are looked up by their callback, and armed on the wheel
+  // where they are
+  using event_lookup_map_t = std::unordered_map<Context*, event_t>;
   event_lookup_map_t events;
+  ceph::common::timing_wheel<event_t, clock_t> schedule;
   bool stopping;
 
   void dump(const char *caller = 0) const;
@@ -27,6 +27,7 @@
 #include "include/ceph_assert.h"
 #include "include/types.h"
 #include "include/buffer_raw.h"
+#include "common/buffer_instrumentation.h"
 #include "include/compat.h"
 #include "include/mempool.h"
 #include "armor.h"
@@ -86,6 +87,12 @@ static ceph::spinlock debug_lock;
     return buffer_missed_crc;
   }
 
+  static thread_local uint64_t thread_copied_bytes = 0;
+
+  uint64_t buffer_instrumentation::get_thread_copied_bytes() {
+    return thread_copied_bytes;
+  }
+
   /*
    * raw_combined is always placed within a single allocation along
    * with the data buffer.  the data goes at the beginning, and
@@ -1186,6 +1193,7 @@ static ceph::spinlock debug_lock;
   void buffer::list::rebuild(
     std::unique_ptr<buffer::ptr_node, buffer::ptr_node::disposer> nb)
   {
+    thread_copied_bytes += _len;
     unsigned pos = 0;
     int mempool = _buffers.front().get_mempool();
     nb->reassign_to_mempool(mempool);
@@ -1,6 +1,10 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
 // vim: ts=8 sw=2 sts=2 expandtab
 
+#pragma once
+
+#include <cstdint>
+
 #include "include/buffer.h"
 #include "include/buffer_raw.h"
 
@@ -29,4 +33,18 @@ struct instrumented_bptr : public ceph::buffer::ptr {
   }
 };
 
+// running total of the bytes copied by `ceph::buffer::list::rebuild()` on
+// the calling thread -- c_str() on a fragmented list, realignment for
+// O_DIRECT and the like.  it only ever grows; use `copy_tracker` to find
+// out how much a given code path copied.
+uint64_t get_thread_copied_bytes();
+
+class copy_tracker {
+  const uint64_t start = get_thread_copied_bytes();
+public:
+  uint64_t get() const {
+    return get_thread_copied_bytes() - start;
+  }
+};
+
 } // namespace ceph::buffer_instrumentation
@@ -0,0 +1,251 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include <boost/intrusive/list.hpp>
+
+namespace ceph::common {
+
+/**
+ * timing_wheel_hook
+ *
+ * Base of the objects armed on a timing_wheel.  The wheel doesn't own
+ * them, nor allocates anything when they are armed or cancelled.  An
+ * object must be cancelled before it is destroyed.
+ */
+class timing_wheel_hook
+  : public boost::intrusive::list_base_hook<
+      boost::intrusive::link_mode<boost::intrusive::safe_link>> {
+  template <typename T, typename Clock> friend class timing_wheel;
+
+  uint64_t tick = 0;    // expiry, in ticks of the wheel
+  uint8_t level = 0;    // where it is armed
+  uint8_t slot = 0;
+
+public:
+  bool is_armed() const {
+    return is_linked();
+  }
+};
+
+/**
+ * timing_wheel
+ *
+ * Hierarchical timing wheel: time is cut into ticks of a fixed
+ * resolution and each level has 64 slots, a slot of level n spanning 64^n
+ * ticks.  An object is armed in the lowest level whose slots cover its
+ * delay, and moves down a level each time the wheel reaches its slot, so
+ * arming, cancelling and firing it are O(1) whatever the number of armed
+ * objects, and the next expiry is found by scanning a bitmap per level.
+ *
+ * The objects never fire early, but up to a tick late, and the objects
+ * expiring within the same tick fire in the order they were armed.
+ * Delays beyond the span of the wheel (64^6 ticks) are armed in its last
+ * slot and wait there again on their turn.
+ *
+ * T must inherit from timing_wheel_hook.  The wheel isn't thread safe.
+ */
+template <typename T, typename Clock>
+class timing_wheel {
+  static constexpr unsigned SLOT_BITS = 6;
+  static constexpr unsigned SLOTS = 1u << SLOT_BITS;
+  static constexpr unsigned LEVELS = 6;
+  static constexpr uint64_t SPAN = uint64_t(1) << (SLOT_BITS * LEVELS);
+
+  using list_t = boost::intrusive::list<
+    T, boost::intrusive::constant_time_size<false>>;
+
+  const uint64_t resolution;    // in ns
+  uint64_t now_tick;            // the ticks before it are expired
+  size_t count = 0;
+  std::array<uint64_t, LEVELS> occupied = {};  // a bit per non-empty slot
+  std::array<std::array<list_t, SLOTS>, LEVELS> slots;
+
+  static uint64_t since_epoch(typename Clock::time_point t) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      t.time_since_epoch()).count();
+    return ns > 0 ? ns : 0;
+  }
+  uint64_t tick_floor(typename Clock::time_point t) const {
+    return since_epoch(t) / resolution;
+  }
+  uint64_t tick_ceil(typename Clock::time_point t) const {
+    return (since_epoch(t) + resolution - 1) / resolution;
+  }
+
+  void place(T& node) {
+    uint64_t expiry = std::max(node.tick, now_tick);
+    uint64_t delta = expiry - now_tick;
+    unsigned level = 0;
+    if (delta >= SPAN) {
+      expiry = now_tick + SPAN - 1;
+      level = LEVELS - 1;
+    } else if (delta >= SLOTS) {
+      level = (std::bit_width(delta) - 1) / SLOT_BITS;
+    }
+    const unsigned slot = (expiry >> (level * SLOT_BITS)) & (SLOTS - 1);
+    node.level = level;
+    node.slot = slot;
+    slots[level][slot].push_back(node);
+    occupied[level] |= uint64_t(1) << slot;
+  }
+
+  // moves the objects of the slots which the wheel enters at tick down
+  void cascade(uint64_t tick) {
+    for (unsigned level = LEVELS - 1; level > 0; --level) {
+      const unsigned shift = level * SLOT_BITS;
+      if (tick & ((uint64_t(1) << shift) - 1)) {
+        continue;
+      }
+      const unsigned slot = (tick >> shift) & (SLOTS - 1);
+      if (!(occupied[level] & (uint64_t(1) << slot))) {
+        continue;
+      }
+      list_t moving;
+      moving.splice(moving.end(), slots[level][slot]);
+      occupied[level] &= ~(uint64_t(1) << slot);
+      while (!moving.empty()) {
+        T& node = moving.front();
+        moving.pop_front();
+        place(node);
+      }
+    }
+  }
+
+  // the first tick from now_tick on where an object fires or moves down
+  uint64_t next_tick() const {
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    for (unsigned level = 0; level < LEVELS; ++level) {
+      if (!occupied[level]) {
+        continue;
+      }
+      const unsigned shift = level * SLOT_BITS;
+      uint64_t base = now_tick >> shift;
+      if (now_tick & ((uint64_t(1) << shift) - 1)) {
+        // the wheel entered the current slot and moved its objects down,
+        // what is there now is a turn ahead
+        ++base;
+      }
+      const unsigned offset = std::countr_zero(
+        std::rotr(occupied[level], base & (SLOTS - 1)));
+      next = std::min(next, (base + offset) << shift);
+    }
+    return next;
+  }
+
+public:
+  explicit timing_wheel(
+    typename Clock::duration res,
+    typename Clock::time_point now = Clock::now())
+    : resolution(std::max<uint64_t>(
+        1, std::chrono::duration_cast<std::chrono::nanoseconds>(res).count())),
+      now_tick(tick_floor(now)) {}
+  timing_wheel(const timing_wheel&) = delete;
+  timing_wheel& operator=(const timing_wheel&) = delete;
+  ~timing_wheel() {
+    clear();
+  }
+
+  size_t size() const {
+    return count;
+  }
+  bool empty() const {
+    return count == 0;
+  }
+
+  /// arm node to fire at when, or move it there if it is armed already
+  void arm(T& node, typename Clock::time_point when) {
+    cancel(node);
+    node.tick = tick_ceil(when);
+    place(node);
+    ++count;
+  }
+
+  /// returns false if node wasn't armed
+  bool cancel(T& node) {
+    if (!node.is_linked()) {
+      return false;
+    }
+    auto& slot = slots[node.level][node.slot];
+    slot.erase(slot.iterator_to(node));
+    --count;
+    if (slot.empty()) {
+      occupied[node.level] &= ~(uint64_t(1) << node.slot);
+    }
+    return true;
+  }
+
+  /// disarm all the nodes
+  void clear() {
+    for (unsigned level = 0; level < LEVELS; ++level) {
+      for (auto& slot : slots[level]) {
+        slot.clear();
+      }
+      occupied[level] = 0;
+    }
+    count = 0;
+  }
+
+  /**
+   * A time from which expire() may have work to do, possibly only moving
+   * objects down, or nullopt if nothing is armed.
+   */
+  std::optional<typename Clock::time_point> next_expiry() const {
+    if (!count) {
+      return std::nullopt;
+    }
+    const uint64_t tick = next_tick();
+    return typename Clock::time_point(
+      std::chrono::duration_cast<typename Clock::duration>(
+        std::chrono::nanoseconds(tick * resolution)));
+  }
+
+  /**
+   * Pass the objects expired at now to f, one at a time, in expiry order.
+   * A node is disarmed before it's passed to f, which may arm it again,
+   * destroy it, arm or cancel others.  Returns the number of objects
+   * fired.
+   */
+  template <typename F>
+  size_t expire(typename Clock::time_point now, F&& f) {
+    const uint64_t target = tick_floor(now);
+    size_t fired = 0;
+    while (count) {
+      const uint64_t tick = next_tick();
+      if (tick > target) {
+        break;
+      }
+      now_tick = tick;
+      cascade(tick);
+      const unsigned index = tick & (SLOTS - 1);
+      auto& slot = slots[0][index];
+      // anything armed from f for this tick goes to the next one, and
+      // what is armed in this slot from now on is a turn ahead, behind the
+      // nodes due now
+      now_tick = tick + 1;
+      while (!slot.empty() && slot.front().tick <= tick) {
+        T& node = slot.front();
+        slot.pop_front();
+        if (slot.empty()) {
+          occupied[0] &= ~(uint64_t(1) << index);
+        }
+        --count;
+        ++fired;
+        f(node);
+      }
+    }
+    now_tick = std::max(now_tick, target + 1);
+    return fired;
+  }
+};
+
+} // namespace ceph::common
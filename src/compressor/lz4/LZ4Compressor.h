@@ -26,7 +26,7 @@
 
 class QatAccel;
 
-class LZ4Compressor : public Compressor {
+class LZ4Compressor : public TOPNSPC::Compressor {
 #ifdef HAVE_QATZIP
   bool qat_enabled;
   static QatAccel qat_accel;
@@ -56,7 +56,7 @@ class CEPH_BUFFER_API BufferlistSource : public snappy::Source {
   }
 };
 
-class SnappyCompressor : public Compressor {
+class SnappyCompressor : public TOPNSPC::Compressor {
  public:
   SnappyCompressor(CephContext* cct) : Compressor(COMP_ALG_SNAPPY, "snappy") {
   }
@@ -33,7 +33,10 @@ Cache::Cache(
   : epm(epm),
     pinboard(create_extent_pinboard(
       crimson::common::get_conf<Option::size_t>(
-       "seastore_cachepin_size_pershard")))
+       "seastore_cachepin_size_pershard"))),
+    decompressed_blob_capacity(
+      crimson::common::get_conf<Option::size_t>(
+       "seastore_decompressed_blob_cache_size_pershard"))
 {
   register_metrics();
   segment_providers_by_device_id.resize(DEVICE_ID_MAX, nullptr);
@@ -529,6 +532,70 @@ void Cache::register_metrics()
 
   pinboard->register_metrics();
 
+  /**
+   * object data compression
+   */
+  metrics.add_group(
+    "cache",
+    {
+      sm::make_counter(
+        "compressed_raw_bytes",
+        data_compression_stats.compressed_raw_bytes,
+        sm::description("raw bytes of the object data blobs stored compressed")
+      ),
+      sm::make_counter(
+        "compressed_stored_bytes",
+        data_compression_stats.compressed_stored_bytes,
+        sm::description("bytes stored for the compressed object data blobs")
+      ),
+      sm::make_counter(
+        "compression_rejected_raw_bytes",
+        data_compression_stats.rejected_raw_bytes,
+        sm::description("raw bytes of the object data blobs which didn't "
+                        "compress well enough to be stored compressed")
+      ),
+      sm::make_gauge(
+        "compression_ratio",
+        [this] {
+          auto &s = data_compression_stats;
+          return s.compressed_raw_bytes == 0 ? 1.0 :
+            (double)s.compressed_stored_bytes / s.compressed_raw_bytes;
+        },
+        sm::description("stored to raw bytes ratio of the compressed "
+                        "object data blobs")
+      ),
+      sm::make_counter(
+        "compress_ns",
+        data_compression_stats.compress_ns,
+        sm::description("time spent compressing object data blobs")
+      ),
+      sm::make_counter(
+        "decompress_ns",
+        data_compression_stats.decompress_ns,
+        sm::description("time spent decompressing object data blobs")
+      ),
+      sm::make_counter(
+        "decompressed_blob_hits",
+        data_compression_stats.decompressed_blob_hits,
+        sm::description("reads of compressed blobs served decompressed "
+                        "from the cache")
+      ),
+      sm::make_counter(
+        "decompressed_blob_misses",
+        data_compression_stats.decompressed_blob_misses,
+        sm::description("reads of compressed blobs which had to be "
+                        "decompressed")
+      ),
+      sm::make_gauge(
+        "decompressed_blob_bytes",
+        [this] {
+          return decompressed_blob_bytes;
+        },
+        sm::description("bytes of decompressed blobs in the cache")
+      ),
+    }
+  );
+
   /**
    * tree stats
    */
@@ -897,6 +964,7 @@ void Cache::commit_retire_extent(
 {
   const auto t_src = t.get_src();
   remove_extent(ref, &t_src);
+  drop_decompressed_blob(ref->get_paddr());
 
   ref->dirty_from = JOURNAL_SEQ_NULL;
   invalidate_extent(t, *ref);
@@ -927,10 +995,57 @@ void Cache::commit_replace_extent(
     pinboard->remove(*prev);
     add_to_dirty(next, &t_src);
   }
+  if (prev->get_type() == extent_types_t::OBJECT_DATA_BLOCK) {
+    drop_decompressed_blob(prev->get_paddr());
+  }
 
   invalidate_extent(t, *prev);
 }
 
+std::optional<ceph::bufferlist> Cache::get_decompressed_blob(paddr_t paddr)
+{
+  auto iter = decompressed_blobs.find(paddr);
+  if (iter == decompressed_blobs.end()) {
+    ++data_compression_stats.decompressed_blob_misses;
+    return std::nullopt;
+  }
+  ++data_compression_stats.decompressed_blob_hits;
+  auto &blob = iter->second;
+  decompressed_blob_lru.splice(
+    decompressed_blob_lru.begin(), decompressed_blob_lru, blob.lru_pos);
+  return blob.bl;
+}
+
+void Cache::add_decompressed_blob(paddr_t paddr, const ceph::bufferlist &bl)
+{
+  assert(paddr.is_absolute());
+  if (bl.length() > decompressed_blob_capacity) {
+    return;
+  }
+  drop_decompressed_blob(paddr);
+  while (decompressed_blob_bytes + bl.length() > decompressed_blob_capacity) {
+    drop_decompressed_blob(decompressed_blob_lru.back());
+  }
+  decompressed_blob_lru.push_front(paddr);
+  decompressed_blobs.emplace(
+    paddr, decompressed_blob_t{bl, decompressed_blob_lru.begin()});
+  decompressed_blob_bytes += bl.length();
+}
+
+void Cache::drop_decompressed_blob(paddr_t paddr)
+{
+  if (decompressed_blobs.empty()) {
+    return;
+  }
+  auto iter = decompressed_blobs.find(paddr);
+  if (iter == decompressed_blobs.end()) {
+    return;
+  }
+  decompressed_blob_bytes -= iter->second.bl.length();
+  decompressed_blob_lru.erase(iter->second.lru_pos);
+  decompressed_blobs.erase(iter);
+}
+
 void Cache::invalidate_extent(
     Transaction& t,
     CachedExtent& extent)
@@ -2003,6 +2118,9 @@ Cache::close_ertr::future<> Cache::close()
   backref_extents.clear();
   backref_entryrefs_by_seq.clear();
   pinboard->clear();
+  decompressed_blobs.clear();
+  decompressed_blob_lru.clear();
+  decompressed_blob_bytes = 0;
   return close_ertr::now();
 }
 
@@ -28,6 +28,17 @@ class BtreeBackrefManager;
 
 namespace crimson::os::seastore {
 
+/// work done compressing and decompressing object data blobs
+struct data_compression_stats_t {
+  uint64_t compressed_raw_bytes = 0;    ///< raw bytes of blobs stored compressed
+  uint64_t compressed_stored_bytes = 0; ///< bytes stored for those blobs
+  uint64_t rejected_raw_bytes = 0;      ///< raw bytes of blobs left uncompressed
+  uint64_t compress_ns = 0;
+  uint64_t decompress_ns = 0;
+  uint64_t decompressed_blob_hits = 0;
+  uint64_t decompressed_blob_misses = 0;
+};
+
 class BackrefManager;
 class SegmentProvider;
 
@@ -1606,7 +1617,24 @@ public:
     booting = false;
     extents_index.clear();
   }
+
+  /**
+   * decompressed blob cache
+   *
+   * Keeps the decompressed contents of recently read compressed object
+   * data blobs, keyed by the paddr of the first extent of the blob's
+   * payload, so that partial reads of a blob don't decompress it again.
+   * An entry is dropped as soon as that extent is retired or replaced.
+   */
+  std::optional<ceph::bufferlist> get_decompressed_blob(paddr_t paddr);
+  /// paddr must be the location of a stable extent
+  void add_decompressed_blob(paddr_t paddr, const ceph::bufferlist &bl);
+
+  data_compression_stats_t& get_data_compression_stats() {
+    return data_compression_stats;
+  }
 private:
+
   void touch_extent_fully(
       CachedExtent &ext,
       const Transaction::src_t* p_src,
@@ -1824,6 +1852,18 @@ private:
   seastar::metrics::metric_group metrics;
   void register_metrics();
 
+  void drop_decompressed_blob(paddr_t paddr);
+
+  struct decompressed_blob_t {
+    ceph::bufferlist bl;
+    std::list<paddr_t>::iterator lru_pos;
+  };
+  std::map<paddr_t, decompressed_blob_t> decompressed_blobs;
+  std::list<paddr_t> decompressed_blob_lru;  ///< most recent first
+  std::size_t decompressed_blob_bytes = 0;
+  const std::size_t decompressed_blob_capacity;
+  data_compression_stats_t data_compression_stats;
+
   void apply_backref_mset(
       backref_entry_refs_t& backref_entries) {
     for (auto& entry : backref_entries) {
@@ -1,9 +1,17 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
 // vim: ts=8 sw=2 sts=2 expandtab
 
+#include <bit>
 #include <utility>
 #include <functional>
 
+#include "common/ceph_context.h"
+#include "compressor/snappy/SnappyCompressor.h"
+#ifdef HAVE_LZ4
+#include "compressor/lz4/LZ4Compressor.h"
+#endif
+#include "osd/osd_types.h"
+
 #include "crimson/common/log.h"
 
 #include "crimson/os/seastore/object_data_handler.h"
@@ -49,7 +57,7 @@ auto with_object_data(
   F &&f)
 {
   return seastar::do_with(
-    ctx.onode.get_layout().object_data.get(),
+    ctx.onode.get_object_data(),
     std::forward<F>(f),
     [ctx](auto &object_data, auto &f) {
       return std::invoke(f, object_data
@@ -69,8 +77,8 @@ auto with_objects_data(
 {
   ceph_assert(ctx.d_onode);
   return seastar::do_with(
-    ctx.onode.get_layout().object_data.get(),
-    ctx.d_onode->get_layout().object_data.get(),
+    ctx.onode.get_object_data(),
+    ctx.d_onode->get_object_data(),
     std::forward<F>(f),
     [ctx](auto &object_data, auto &d_object_data, auto &f) {
       return std::invoke(f, object_data, d_object_data
@@ -86,6 +94,80 @@ auto with_objects_data(
     });
 }
 
+CompressorRef get_data_compressor(int alg)
+{
+  // the compressor plugins are built against the classic CephContext,
+  // so crimson can't load them and links their compressors instead
+  static thread_local std::array<
+    CompressorRef, Compressor::COMP_ALG_LAST> compressors;
+  static thread_local CephContext cct;
+  if (alg <= Compressor::COMP_ALG_NONE || alg >= Compressor::COMP_ALG_LAST) {
+    return nullptr;
+  }
+  auto &compressor = compressors[alg];
+  if (!compressor) {
+    switch (alg) {
+    case Compressor::COMP_ALG_SNAPPY:
+      compressor = std::make_shared<SnappyCompressor>(&cct);
+      break;
+#ifdef HAVE_LZ4
+    case Compressor::COMP_ALG_LZ4:
+      compressor = std::make_shared<LZ4Compressor>(&cct);
+      break;
+#endif
+    default:
+      break;
+    }
+  }
+  return compressor;
+}
+
+data_compression_t data_compression_t::create(const pool_opts_t &opts)
+{
+  LOG_PREFIX(data_compression_t::create);
+  using crimson::common::get_conf;
+  data_compression_t ret;
+  std::string val = get_conf<std::string>("seastore_compression_mode");
+  opts.get(pool_opts_t::COMPRESSION_MODE, &val);
+  auto mode = Compressor::get_comp_mode_type(val);
+  if (!mode) {
+    ERROR("unrecognized compression mode: {}", val);
+    return ret;
+  }
+  // without the compressibility hints of the clients, passive
+  // compression never applies
+  if (*mode != Compressor::COMP_AGGRESSIVE &&
+      *mode != Compressor::COMP_FORCE) {
+    return ret;
+  }
+  val = get_conf<std::string>("seastore_compression_algorithm");
+  opts.get(pool_opts_t::COMPRESSION_ALGORITHM, &val);
+  auto alg = Compressor::get_comp_alg_type(val);
+  if (!alg) {
+    ERROR("unrecognized compression algorithm: {}", val);
+    return ret;
+  }
+  if (*alg == Compressor::COMP_ALG_NONE) {
+    return ret;
+  }
+  ret.compressor = get_data_compressor(*alg);
+  if (!ret.compressor) {
+    ERROR("compression algorithm {} is not available", val);
+    return ret;
+  }
+  ret.required_ratio = get_conf<double>(
+    "seastore_compression_required_ratio");
+  opts.get(pool_opts_t::COMPRESSION_REQUIRED_RATIO, &ret.required_ratio);
+  int64_t blob_size = get_conf<Option::size_t>(
+    "seastore_compression_blob_size");
+  opts.get(pool_opts_t::COMPRESSION_MAX_BLOB_SIZE, &blob_size);
+  if (blob_size > 0) {
+    ret.blob_size = std::bit_floor(
+      std::min<uint64_t>(blob_size, uint64_t(1) << 30));
+  }
+  return ret;
+}
+
 ObjectDataHandler::write_iertr::future<std::optional<LBAMapping>>
 ObjectDataHandler::prepare_data_reservation(
   context_t ctx,
@@ -110,11 +192,20 @@ ObjectDataHandler::prepare_data_reservation(
       ctx.t,
       ctx.onode.get_data_hint(),
       max_object_size
-    ).si_then([max_object_size=max_object_size, &object_data](auto pin) {
+    ).si_then([max_object_size=max_object_size, ctx, &object_data](auto pin) {
       ceph_assert(pin.get_length() == max_object_size);
       object_data.update_reserved(
 	pin.get_key(),
 	pin.get_length());
+      // onodes without the layout extension have no room for the blob order
+      if (ctx.compression && ctx.compression->enabled() &&
+	  ctx.onode.has_layout_ext()) {
+	auto blob_size = ctx.compression->blob_size;
+	if (blob_size >= 2 * ctx.tm.get_block_size() &&
+	    max_object_size % blob_size == 0) {
+	  object_data.update_blob_order(std::countr_zero(blob_size));
+	}
+      }
       return std::make_optional<LBAMapping>(std::move(pin));
     }).handle_error_interruptible(
       crimson::ct_error::enospc::assert_failure{"unexpected enospc"},
@@ -1246,6 +1337,382 @@ ObjectDataHandler::read_edge_for_clone_range(
   );
 }
 
+namespace {
+
+/// the range of pin within [blob_base, blob_base + blob_size),
+/// relative to blob_base
+std::pair<extent_len_t, extent_len_t> get_pin_range_in_blob(
+  const LBAMapping &pin,
+  laddr_t blob_base,
+  extent_len_t blob_size)
+{
+  auto blob_end = (blob_base + blob_size).checked_to_laddr();
+  auto begin = std::max(pin.get_key(), blob_base);
+  auto end = std::min(
+    (pin.get_key() + pin.get_length()).checked_to_laddr(), blob_end);
+  return {begin.get_byte_distance<extent_len_t>(blob_base),
+	  end.get_byte_distance<extent_len_t>(blob_base)};
+}
+
+}
+
+std::optional<bufferlist> ObjectDataHandler::compress_blob(
+  context_t ctx,
+  const bufferlist &raw,
+  extent_len_t data_len) const
+{
+  LOG_PREFIX(ObjectDataHandler::compress_blob);
+  assert(ctx.compression && ctx.compression->enabled());
+  auto &stats = ctx.tm.get_data_compression_stats();
+  auto block_size = ctx.tm.get_block_size();
+  bufferlist compressed;
+  std::optional<int32_t> compressor_message;
+  auto start = ceph::mono_clock::now();
+  int r = ctx.compression->compressor->compress(
+    raw, compressed, compressor_message);
+  stats.compress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    ceph::mono_clock::now() - start).count();
+  if (r < 0) {
+    ERRORT("compressing with {} failed: {}",
+	   ctx.t, ctx.compression->compressor->get_type_name(), r);
+    stats.rejected_raw_bytes += data_len;
+    return std::nullopt;
+  }
+  compressed_blob_header_t header;
+  header.alg = ctx.compression->compressor->get_type();
+  header.raw_len = raw.length();
+  header.compressed_len = compressed.length();
+  bufferlist payload;
+  encode(header, payload);
+  payload.claim_append(compressed);
+  // the payload has to leave at least one block of the blob unmapped,
+  // see the blob layout in ObjectDataHandler
+  auto payload_len = p2roundup(payload.length(), block_size);
+  if (payload_len + block_size > data_len ||
+      payload_len > data_len * ctx.compression->required_ratio) {
+    TRACET("0x{:x} bytes compressed to 0x{:x}, keep it raw",
+	   ctx.t, data_len, payload_len);
+    stats.rejected_raw_bytes += data_len;
+    return std::nullopt;
+  }
+  payload.append_zero(payload_len - payload.length());
+  stats.compressed_raw_bytes += data_len;
+  stats.compressed_stored_bytes += payload_len;
+  return payload;
+}
+
+ObjectDataHandler::read_ret ObjectDataHandler::read_compressed_blob(
+  context_t ctx,
+  extent_len_t blob_size,
+  lba_mapping_list_t::iterator begin,
+  lba_mapping_list_t::iterator end)
+{
+  LOG_PREFIX(ObjectDataHandler::read_compressed_blob);
+  auto &stats = ctx.tm.get_data_compression_stats();
+  // a stable direct extent can't change under the same paddr, the
+  // decompressed contents are dropped from the cache once it's retired
+  std::optional<paddr_t> cache_key;
+  if (!begin->is_indirect() && begin->is_data_stable()) {
+    cache_key = begin->get_val();
+    auto cached = ctx.tm.get_decompressed_blob(*cache_key);
+    if (cached) {
+      co_return std::move(*cached);
+    }
+  }
+  bufferlist payload;
+  for (auto iter = begin; iter != end; ++iter) {
+    ceph_assert(!iter->get_val().is_zero());
+    auto len = iter->get_length();
+    auto extent = co_await ctx.tm.read_pin<ObjectDataBlock>(
+      ctx.t, *iter, 0, len);
+    payload.append(extent.get_range(0, len));
+  }
+  auto p = payload.cbegin();
+  compressed_blob_header_t header;
+  try {
+    decode(header, p);
+  } catch (const ceph::buffer::error&) {
+    header.magic = 0;
+  }
+  auto compressor = get_data_compressor(header.alg);
+  if (header.magic != compressed_blob_header_t::MAGIC ||
+      header.raw_len != blob_size ||
+      header.compressed_len > p.get_remaining() ||
+      !compressor) {
+    ERRORT("bad compressed blob header at {}: magic=0x{:x}, alg={}, "
+	   "raw_len=0x{:x}, compressed_len=0x{:x}",
+	   ctx.t, begin->get_key(), header.magic, header.alg,
+	   header.raw_len, header.compressed_len);
+    co_await read_iertr::future<>(
+      crimson::ct_error::input_output_error::make());
+  }
+  bufferlist raw;
+  auto start = ceph::mono_clock::now();
+  int r = compressor->decompress(p, header.compressed_len, raw, std::nullopt);
+  stats.decompress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    ceph::mono_clock::now() - start).count();
+  if (r < 0 || raw.length() != blob_size) {
+    ERRORT("decompressing the blob at {} with {} failed: r={}, len=0x{:x}",
+	   ctx.t, begin->get_key(), compressor->get_type_name(),
+	   r, raw.length());
+    co_await read_iertr::future<>(
+      crimson::ct_error::input_output_error::make());
+  }
+  if (cache_key && !ctx.t.is_conflicted()) {
+    ctx.tm.add_decompressed_blob(*cache_key, raw);
+  }
+  co_return raw;
+}
+
+ObjectDataHandler::read_ret ObjectDataHandler::read_blob(
+  context_t ctx,
+  const object_data_t &object_data,
+  objaddr_t blob_off,
+  extent_len_t offset,
+  extent_len_t len)
+{
+  LOG_PREFIX(ObjectDataHandler::read_blob);
+  auto blob_size = object_data.get_blob_size();
+  assert(blob_size && blob_off % blob_size == 0);
+  assert(offset + len <= blob_size);
+  auto blob_base = (object_data.get_reserved_data_base() + blob_off
+    ).checked_to_laddr();
+  auto pins = co_await ctx.tm.get_pins(ctx.t, blob_base, blob_size);
+  ceph_assert(!pins.empty());
+  ceph_assert(pins.front().get_key() <= blob_base);
+  bufferlist ret;
+  if (pins.front().get_val().is_zero()) {
+    // a hole or a compressed blob
+    auto data = std::find_if(pins.begin(), pins.end(), [](auto &pin) {
+      return !pin.get_val().is_zero();
+    });
+    if (data == pins.end()) {
+      ret.append_zero(len);
+      co_return ret;
+    }
+    TRACET("compressed blob at {}", ctx.t, blob_base);
+    auto raw = co_await read_compressed_blob(
+      ctx, blob_size, data, pins.end());
+    ret.substr_of(raw, offset, len);
+    co_return ret;
+  }
+
+  // a raw blob, possibly followed by zeros
+  auto block_size = ctx.tm.get_block_size();
+  auto end = offset + len;
+  for (auto &pin : pins) {
+    auto [pin_begin, pin_end] = get_pin_range_in_blob(
+      pin, blob_base, blob_size);
+    if (pin_end <= offset || pin_begin >= end) {
+      continue;
+    }
+    auto read_begin = std::max(pin_begin, offset);
+    auto read_end = std::min(pin_end, end);
+    if (pin.get_val().is_zero()) {
+      ret.append_zero(read_end - read_begin);
+      continue;
+    }
+    // data mappings never cross the blob boundaries
+    assert(pin.get_key() >= blob_base);
+    auto aligned_begin = p2align(read_begin - pin_begin, block_size);
+    auto aligned_len = p2roundup(read_end - pin_begin, block_size)
+      - aligned_begin;
+    auto extent = co_await ctx.tm.read_pin<ObjectDataBlock>(
+      ctx.t, pin, aligned_begin, aligned_len);
+    auto aligned_bl = extent.get_range(aligned_begin, aligned_len);
+    bufferlist bl;
+    bl.substr_of(aligned_bl, read_begin - pin_begin - aligned_begin,
+		 read_end - read_begin);
+    ret.append(std::move(bl));
+  }
+  ceph_assert(ret.length() == len);
+  co_return ret;
+}
+
+ObjectDataHandler::write_ret ObjectDataHandler::punch_blob(
+  context_t ctx,
+  object_data_t &object_data,
+  objaddr_t blob_off)
+{
+  auto blob_size = object_data.get_blob_size();
+  auto data_base = object_data.get_reserved_data_base();
+  auto blob_base = (data_base + blob_off).checked_to_laddr();
+  auto pin = co_await ctx.tm.get_containing_pin(ctx.t, blob_base
+  ).handle_error_interruptible(
+    write_iertr::pass_further{},
+    crimson::ct_error::assert_all{"unexpected enoent"}
+  );
+  if (pin.get_val().is_zero() &&
+      pin.get_key() + pin.get_length() >= blob_base + blob_size) {
+    // already a hole
+    co_return;
+  }
+  if (pin.is_pending() &&
+      pin.get_key() == blob_base &&
+      pin.get_length() == blob_size) {
+    // overwrite() would zero a pending extent in place, which would
+    // turn the blob into a raw one, drop the extent instead
+    auto pos = co_await ctx.tm.remove(ctx.t, std::move(pin)
+    ).handle_error_interruptible(
+      write_iertr::pass_further{},
+      crimson::ct_error::assert_all{"unexpected enoent"}
+    );
+    co_await ctx.tm.reserve_region(
+      ctx.t, std::move(pos), blob_base, blob_size
+    ).handle_error_interruptible(
+      crimson::ct_error::enospc::assert_failure{"unexpected enospc"},
+      write_iertr::pass_further{}
+    ).discard_result();
+    co_return;
+  }
+  co_await overwrite(
+    ctx, data_base, blob_off, blob_size, std::nullopt, std::move(pin));
+}
+
+ObjectDataHandler::write_ret ObjectDataHandler::write_blob(
+  context_t ctx,
+  object_data_t &object_data,
+  objaddr_t blob_off,
+  bufferlist raw)
+{
+  LOG_PREFIX(ObjectDataHandler::write_blob);
+  auto blob_size = object_data.get_blob_size();
+  auto block_size = ctx.tm.get_block_size();
+  assert(raw.length() == blob_size);
+  // leave the trailing zero blocks unmapped
+  extent_len_t data_len = blob_size;
+  while (data_len > 0) {
+    bufferlist block;
+    block.substr_of(raw, data_len - block_size, block_size);
+    if (!block.is_zero()) {
+      break;
+    }
+    data_len -= block_size;
+  }
+  std::optional<bufferlist> payload;
+  if (data_len > 0 && ctx.compression && ctx.compression->enabled()) {
+    payload = compress_blob(ctx, raw, data_len);
+  }
+  DEBUGT("blob {}, data_len=0x{:x}, compressed_len=0x{:x}",
+	 ctx.t, blob_off, data_len, payload ? payload->length() : 0);
+  co_await punch_blob(ctx, object_data, blob_off);
+  if (data_len == 0) {
+    co_return;
+  }
+  auto data_base = object_data.get_reserved_data_base();
+  objaddr_t offset = blob_off;
+  std::optional<bufferlist> bl;
+  if (payload) {
+    offset += blob_size - payload->length();
+    bl = std::move(payload);
+  } else {
+    bl.emplace();
+    bl->substr_of(raw, 0, data_len);
+  }
+  auto pin = co_await ctx.tm.get_containing_pin(
+    ctx.t, (data_base + offset).checked_to_laddr()
+  ).handle_error_interruptible(
+    write_iertr::pass_further{},
+    crimson::ct_error::assert_all{"unexpected enoent"}
+  );
+  auto len = bl->length();
+  co_await overwrite(
+    ctx, data_base, offset, len, std::move(bl), std::move(pin));
+}
+
+ObjectDataHandler::write_ret ObjectDataHandler::blob_overwrite(
+  context_t ctx,
+  object_data_t &object_data,
+  objaddr_t offset,
+  extent_len_t len,
+  std::optional<bufferlist> bl)
+{
+  LOG_PREFIX(ObjectDataHandler::blob_overwrite);
+  DEBUGT("0x{:x}~0x{:x} zero={}", ctx.t, offset, len, !bl);
+  assert(!bl || bl->length() == len);
+  auto blob_size = object_data.get_blob_size();
+  auto end = offset + len;
+  for (auto blob_off = p2align(offset, blob_size);
+       blob_off < end;
+       blob_off += blob_size) {
+    auto begin_in_blob = std::max(offset, blob_off) - blob_off;
+    auto end_in_blob = std::min(end, blob_off + blob_size) - blob_off;
+    if (begin_in_blob == 0 && end_in_blob == blob_size) {
+      if (!bl) {
+	co_await punch_blob(ctx, object_data, blob_off);
+      } else {
+	bufferlist raw;
+	raw.substr_of(*bl, blob_off - offset, blob_size);
+	co_await write_blob(ctx, object_data, blob_off, std::move(raw));
+      }
+      continue;
+    }
+    // read-modify-write the partially overwritten blob
+    auto old_raw = co_await read_blob(
+      ctx, object_data, blob_off, 0, blob_size);
+    bufferlist raw;
+    if (begin_in_blob > 0) {
+      bufferlist head;
+      head.substr_of(old_raw, 0, begin_in_blob);
+      raw.append(std::move(head));
+    }
+    if (bl) {
+      bufferlist mid;
+      mid.substr_of(*bl, blob_off + begin_in_blob - offset,
+		    end_in_blob - begin_in_blob);
+      raw.append(std::move(mid));
+    } else {
+      raw.append_zero(end_in_blob - begin_in_blob);
+    }
+    if (end_in_blob < blob_size) {
+      bufferlist tail;
+      tail.substr_of(old_raw, end_in_blob, blob_size - end_in_blob);
+      raw.append(std::move(tail));
+    }
+    co_await write_blob(ctx, object_data, blob_off, std::move(raw));
+  }
+}
+
+ObjectDataHandler::read_ret ObjectDataHandler::blob_read(
+  context_t ctx,
+  const object_data_t &object_data,
+  objaddr_t offset,
+  extent_len_t len)
+{
+  auto blob_size = object_data.get_blob_size();
+  auto end = offset + len;
+  bufferlist ret;
+  for (auto blob_off = p2align(offset, blob_size);
+       blob_off < end;
+       blob_off += blob_size) {
+    auto begin_in_blob = std::max(offset, blob_off) - blob_off;
+    auto end_in_blob = std::min(end, blob_off + blob_size) - blob_off;
+    ret.append(co_await read_blob(
+      ctx, object_data, blob_off, begin_in_blob,
+      end_in_blob - begin_in_blob));
+  }
+  co_return ret;
+}
+
+ObjectDataHandler::truncate_ret ObjectDataHandler::blob_truncate(
+  context_t ctx,
+  object_data_t &object_data,
+  objaddr_t offset)
+{
+  auto blob_size = object_data.get_blob_size();
+  auto blob_off = p2align(offset, blob_size);
+  if (blob_off != offset) {
+    auto raw = co_await read_blob(
+      ctx, object_data, blob_off, 0, offset - blob_off);
+    raw.append_zero(blob_size - raw.length());
+    co_await write_blob(ctx, object_data, blob_off, std::move(raw));
+    blob_off += blob_size;
+  }
+  if (blob_off < object_data.get_reserved_data_len()) {
+    co_await trim_data_reservation(ctx, object_data, blob_off);
+  }
+}
+
 ObjectDataHandler::clone_ret ObjectDataHandler::clone_range(
   context_t ctx,
   extent_len_t srcoff,
@@ -1261,6 +1728,27 @@ ObjectDataHandler::clone_ret ObjectDataHandler::clone_range(
     srcoff, len);
   // doesn't support inconsistent range clone yet
   ceph_assert(srcoff == destoff);
+  auto object_data = ctx.onode.get_object_data();
+  auto d_object_data = ctx.d_onode->get_object_data();
+  if (len > 0 &&
+      (object_data.get_blob_size() ||
+       d_object_data.get_blob_size() ||
+       (d_object_data.is_null() &&
+	ctx.compression && ctx.compression->enabled()))) {
+    // blobs are only ever rewritten as a whole, so their mappings can't
+    // be shared by ranges, copy the data instead
+    DEBUGT("copying blobs", ctx.t);
+    return read(ctx, srcoff, len
+    ).si_then([this, ctx, destoff](auto bl) {
+      return seastar::do_with(
+	std::move(bl),
+	[this, ctx, destoff](auto &bl) {
+	return write(
+	  context_t{ctx.tm, ctx.t, *ctx.d_onode, nullptr, ctx.compression},
+	  destoff, bl);
+      });
+    });
+  }
   return with_objects_data(
     ctx,
     [ctx, this, srcoff, len](auto &object_data, auto &d_object_data)
@@ -1335,6 +1823,9 @@ ObjectDataHandler::zero_ret ObjectDataHandler::zero(
 	object_data,
 	p2roundup(offset + len, ctx.tm.get_block_size())
       ).si_then([this, ctx, offset, len, &object_data](auto mapping) {
+	if (object_data.get_blob_size()) {
+	  return blob_overwrite(ctx, object_data, offset, len, std::nullopt);
+	}
 	auto data_base = object_data.get_reserved_data_base();
 	if (mapping) {
 	  return overwrite(
@@ -1378,6 +1869,10 @@ ObjectDataHandler::write_ret ObjectDataHandler::write(
 	p2roundup(offset + bl.length(), ctx.tm.get_block_size())
       ).si_then([this, ctx, offset, &object_data, &bl]
 		(auto mapping) -> write_ret {
+	if (object_data.get_blob_size()) {
+	  return blob_overwrite(
+	    ctx, object_data, offset, bl.length(), bufferlist(bl));
+	}
 	auto data_base = object_data.get_reserved_data_base();
 	if (mapping) {
 	  return overwrite(
@@ -1433,10 +1928,11 @@ ObjectDataHandler::read_ret ObjectDataHandler::read(
 {
   return seastar::do_with(
     bufferlist(),
-    [ctx, obj_offset, len](auto &ret) {
+    [this, ctx, obj_offset, len](auto &ret) {
     return with_object_data(
       ctx,
-      [ctx, obj_offset, len, &ret](const auto &object_data) {
+      [this, ctx, obj_offset, len, &ret](const auto &object_data)
+      -> read_iertr::future<> {
       LOG_PREFIX(ObjectDataHandler::read);
       DEBUGT("reading {}~0x{:x}",
              ctx.t,
@@ -1447,6 +1943,12 @@ ObjectDataHandler::read_ret ObjectDataHandler::read(
       ceph_assert(!object_data.is_null());
       ceph_assert((obj_offset + len) <= object_data.get_reserved_data_len());
       ceph_assert(len > 0);
+      if (object_data.get_blob_size()) {
+	return blob_read(ctx, object_data, obj_offset, len
+	).si_then([&ret](auto bl) {
+	  ret = std::move(bl);
+	});
+      }
       laddr_offset_t l_start =
         object_data.get_reserved_data_base() + obj_offset;
       laddr_offset_t l_end = l_start + len;
@@ -1597,12 +2099,32 @@ ObjectDataHandler::fiemap_ret ObjectDataHandler::fiemap(
       ).si_then([l_start, len, &object_data, &ret](auto &&pins) {
 	ceph_assert(pins.size() >= 1);
         ceph_assert(pins.front().get_key() <= l_start);
+	auto blob_size = object_data.get_blob_size();
+	auto data_base = object_data.get_reserved_data_base();
 	for (auto &&i: pins) {
 	  if (!(i.get_val().is_zero())) {
-	    laddr_offset_t ret_left = std::max(laddr_offset_t(i.get_key(), 0), l_start);
-	    laddr_offset_t ret_right = std::min(
-	      i.get_key() + i.get_length(),
-	      l_start + len);
+	    laddr_offset_t pin_begin(i.get_key(), 0);
+	    laddr_offset_t pin_end = i.get_key() + i.get_length();
+	    if (blob_size) {
+	      // the mapped payload of a compressed blob stands for the
+	      // whole blob
+	      auto begin_off = pin_begin.get_byte_distance<extent_len_t>(
+		data_base);
+	      pin_begin = data_base + p2align(begin_off, blob_size);
+	      pin_end = data_base + p2roundup(begin_off + 1, blob_size);
+	    }
+	    laddr_offset_t ret_left = std::max(pin_begin, l_start);
+	    laddr_offset_t ret_right = std::min(pin_end, l_start + len);
+	    if (blob_size && !ret.empty()) {
+	      auto &[last_off, last_len] = *ret.rbegin();
+	      auto left_off = ret_left.get_byte_distance<uint64_t>(data_base);
+	      if (last_off + last_len >= left_off) {
+		last_len = std::max<uint64_t>(
+		  last_len,
+		  ret_right.get_byte_distance<uint64_t>(data_base) - last_off);
+		continue;
+	      }
+	    }
 	    assert(ret_right > ret_left);
 	    ret.emplace(
 	      std::make_pair(
@@ -1632,7 +2154,9 @@ ObjectDataHandler::truncate_ret ObjectDataHandler::truncate(
 	     object_data.get_reserved_data_base(),
 	     object_data.get_reserved_data_len(),
 	     offset);
-      if (offset < object_data.get_reserved_data_len()) {
+      if (object_data.get_blob_size()) {
+	return blob_truncate(ctx, object_data, offset);
+      } else if (offset < object_data.get_reserved_data_len()) {
 	return trim_data_reservation(ctx, object_data, offset);
       } else if (offset > object_data.get_reserved_data_len()) {
 	return prepare_data_reservation(
@@ -1708,6 +2232,8 @@ ObjectDataHandler::do_clone(
   auto mapping = co_await prepare_data_reservation(
     ctx, d_object_data, old_len);
   ceph_assert(mapping.has_value());
+  // the clone shares the blobs of the source
+  d_object_data.update_blob_order(object_data.get_blob_order());
   DEBUGT("new obj reserve_data_base: {}, len 0x{:x}",
     ctx.t,
     d_object_data.get_reserved_data_base(),
@@ -1730,6 +2256,17 @@ ObjectDataHandler::do_clone(
 ObjectDataHandler::clone_ret ObjectDataHandler::clone(
   context_t ctx)
 {
+  ceph_assert(ctx.d_onode);
+  if (ctx.onode.get_object_data().get_blob_order() &&
+      !ctx.d_onode->has_layout_ext()) {
+    // the destination can't record the blob order, so it can't share the
+    // blobs, copy the data instead
+    auto size = ctx.onode.get_layout().size;
+    if (size == 0) {
+      return clone_iertr::now();
+    }
+    return clone_range(ctx, 0, size, 0);
+  }
   return with_objects_data(
     ctx,
     [ctx, this](auto &object_data, auto &d_object_data) {
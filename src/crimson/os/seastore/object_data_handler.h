@@ -7,6 +7,7 @@
 #include <limits>
 
 #include "include/buffer.h"
+#include "compressor/Compressor.h"
 
 #include "test/crimson/seastore/test_block.h" // TODO
 
@@ -16,6 +17,8 @@
 #include "crimson/os/seastore/transaction.h"
 #include "crimson/os/seastore/logical_child_node.h"
 
+class pool_opts_t;
+
 namespace crimson::os::seastore {
 
 struct block_delta_t {
@@ -320,6 +323,48 @@ struct ObjectDataBlock : crimson::os::seastore::LogicalChildNode {
 };
 using ObjectDataBlockRef = TCachedExtentRef<ObjectDataBlock>;
 
+/**
+ * data_compression_t
+ *
+ * How the data written to the objects of a collection is compressed,
+ * resolved from the pool options with the seastore_compression_*
+ * options as defaults.  A null compressor disables compression.
+ */
+struct data_compression_t {
+  CompressorRef compressor;
+  extent_len_t blob_size = 0;
+  double required_ratio = 1.0;
+
+  bool enabled() const {
+    return (bool)compressor;
+  }
+
+  static data_compression_t create(const pool_opts_t &opts);
+};
+
+/// the compressor behind a compressor plugin, built into crimson
+CompressorRef get_data_compressor(int alg);
+
+/**
+ * compressed_blob_header_t
+ *
+ * Prefix of the payload of a compressed blob.
+ */
+struct compressed_blob_header_t {
+  static constexpr uint32_t MAGIC = 0x53424c42; // "SBLB"
+  uint32_t magic = MAGIC;
+  uint8_t alg = 0;
+  uint32_t raw_len = 0;
+  uint32_t compressed_len = 0;
+
+  DENC(compressed_blob_header_t, v, p) {
+    denc(v.magic, p);
+    denc(v.alg, p);
+    denc(v.raw_len, p);
+    denc(v.compressed_len, p);
+  }
+};
+
 class ObjectDataHandler {
 public:
   ObjectDataHandler(uint32_t mos) : max_object_size(mos),
@@ -331,6 +376,8 @@ public:
     Transaction &t;
     Onode &onode;
     Onode *d_onode = nullptr; // The desination node in case of clone
+    // compression of the newly written data, nullptr if disabled
+    const data_compression_t *compression = nullptr;
   };
 
   /// Writes bl to [offset, offset + bl.length())
@@ -442,6 +489,63 @@ private:
     lba_mapping_list_t &pins,
     laddr_t data_base);
 
+  /**
+   * blob layout
+   *
+   * Objects reserved with a non-zero blob_order are split into fixed-size
+   * blobs which are always rewritten as a whole.  Each blob is either
+   *  - a hole: zero mappings only,
+   *  - raw: data mapped from the start of the blob, up to the last
+   *    non-zero block, followed by zero mappings,
+   *  - compressed: a zero mapping at the start of the blob, followed by the
+   *    compressed_blob_header_t and the compressed contents, padded to
+   *    blocks and mapped at the end of the blob.
+   * No data mapping crosses a blob boundary.
+   */
+  read_ret read_blob(
+    context_t ctx,
+    const object_data_t &object_data,
+    objaddr_t blob_off,
+    extent_len_t offset,
+    extent_len_t len);
+  read_ret read_compressed_blob(
+    context_t ctx,
+    extent_len_t blob_size,
+    lba_mapping_list_t::iterator begin,
+    lba_mapping_list_t::iterator end);
+  /// Returns the padded payload of the compressed blob, if worth storing
+  std::optional<bufferlist> compress_blob(
+    context_t ctx,
+    const bufferlist &raw,
+    extent_len_t data_len) const;
+  /// Turns the blob at blob_off into a hole
+  write_ret punch_blob(
+    context_t ctx,
+    object_data_t &object_data,
+    objaddr_t blob_off);
+  /// Replaces the blob at blob_off with raw
+  write_ret write_blob(
+    context_t ctx,
+    object_data_t &object_data,
+    objaddr_t blob_off,
+    bufferlist raw);
+  /// Updates (or zeroes if !bl) [offset, offset + len) of a blob object
+  write_ret blob_overwrite(
+    context_t ctx,
+    object_data_t &object_data,
+    objaddr_t offset,
+    extent_len_t len,
+    std::optional<bufferlist> bl);
+  read_ret blob_read(
+    context_t ctx,
+    const object_data_t &object_data,
+    objaddr_t offset,
+    extent_len_t len);
+  truncate_ret blob_truncate(
+    context_t ctx,
+    object_data_t &object_data,
+    objaddr_t offset);
+
   enum op_type_t : uint8_t {
     OVERWRITE,
     ZERO,
@@ -659,6 +763,7 @@ private:
 }
 
 WRITE_CLASS_DENC_BOUNDED(crimson::os::seastore::block_delta_t)
+WRITE_CLASS_DENC_BOUNDED(crimson::os::seastore::compressed_blob_header_t)
 
 #if FMT_VERSION >= 90000
 template <> struct fmt::formatter<crimson::os::seastore::ObjectDataBlock> : fmt::ostream_formatter {};
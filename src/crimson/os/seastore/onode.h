@@ -64,6 +64,25 @@ struct onode_layout_t {
   }
 } __attribute__((packed));
 
+/**
+ * onode_layout_ext_t
+ *
+ * Fields appended to onode_layout_t, which keeps its size for the onodes
+ * written before they existed.  Those have no room for the extension and
+ * read it as version 0, with every field at its default.
+ */
+struct onode_layout_ext_t {
+  static constexpr uint8_t LATEST_VERSION = 1;
+
+  uint8_t version = LATEST_VERSION;
+  // v1: log2 of the size of the compression blobs the object data is
+  // split into, 0 if it is stored as is. See ObjectDataHandler.
+  uint8_t blob_order = 0;
+} __attribute__((packed));
+constexpr onode_layout_ext_t get_missing_layout_ext() {
+  return onode_layout_ext_t{0, 0};
+}
+
 class Transaction;
 
 /**
@@ -91,6 +110,7 @@ public:
 
   virtual bool is_alive() const = 0;
   virtual const onode_layout_t &get_layout() const = 0;
+  virtual onode_layout_ext_t get_layout_ext() const = 0;
   virtual ~Onode() = default;
 
   const hobject_t &get_hobj() const {
@@ -105,6 +125,13 @@ public:
   bool need_cow() const {
     return get_layout().need_cow;
   }
+  /// whether the onode has room for the fields of onode_layout_ext_t
+  bool has_layout_ext() const {
+    return get_layout_ext().version > 0;
+  }
+  object_data_t get_object_data() const {
+    return get_layout().object_data.get(get_layout_ext().blob_order);
+  }
   virtual void update_onode_size(Transaction&, uint32_t) = 0;
   virtual void update_omap_root(Transaction&, omap_root_t&) = 0;
   virtual void update_log_root(Transaction&, omap_root_t&) = 0;
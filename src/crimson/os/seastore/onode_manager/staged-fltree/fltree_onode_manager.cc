@@ -74,7 +74,17 @@ void FLTreeOnode::Recorder::apply_value_delta(
       break;
     case delta_op_t::CREATE_DEFAULT:
       mlayout = onode_layout_t{};
+      if (auto mext = get_mutable_layout_ext(value); mext) {
+	*mext = onode_layout_ext_t{};
+      }
       break;
+    case delta_op_t::UPDATE_LAYOUT_EXT: {
+      DEBUG("update layout ext");
+      auto mext = get_mutable_layout_ext(value);
+      ceph_assert(mext);
+      bliter.copy(sizeof(*mext), (char *)mext);
+      break;
+    }
     default:
       ceph_abort();
     }
@@ -148,6 +158,13 @@ void FLTreeOnode::Recorder::encode_update(
       onode_layout_t::MAX_SS_LENGTH);
     ceph::encode(layout.ss_size, encoded);
     break;
+  case delta_op_t::UPDATE_LAYOUT_EXT:
+    DEBUG("update layout ext");
+    ceph_assert(payload_mut.get_length() >= PAYLOAD_SIZE);
+    encoded.append(
+      payload_mut.get_read() + LAYOUT_EXT_OFFSET,
+      sizeof(onode_layout_ext_t));
+    break;
   case delta_op_t::CREATE_DEFAULT:
     DEBUG("create default layout");
     [[fallthrough]];
@@ -201,7 +218,7 @@ FLTreeOnodeManager::get_or_create_onode(
   LOG_PREFIX(FLTreeOnodeManager::get_or_create_onode);
   return tree.insert(
     trans, hoid,
-    OnodeTree::tree_value_config_t{sizeof(onode_layout_t)}
+    OnodeTree::tree_value_config_t{FLTreeOnode::PAYLOAD_SIZE}
   ).si_then([this, &trans, &hoid, FNAME](auto p)
               -> get_or_create_onode_ret {
     auto [cursor, created] = std::move(p);
@@ -24,6 +24,12 @@ struct FLTreeOnode final : Onode, Value {
                 //   see the formula in validate_tree_config
   };
 
+  // onode_layout_ext_t follows onode_layout_t in the values of the onodes
+  // created since it exists
+  static constexpr value_size_t LAYOUT_EXT_OFFSET = sizeof(onode_layout_t);
+  static constexpr value_size_t PAYLOAD_SIZE =
+    sizeof(onode_layout_t) + sizeof(onode_layout_ext_t);
+
   enum class status_t {
     ALIVE,
     DELETED
@@ -58,7 +64,8 @@ struct FLTreeOnode final : Onode, Value {
       CLEAR_SNAPSET,
       CREATE_DEFAULT,
       SET_NEED_COW,
-      UNSET_NEED_COW
+      UNSET_NEED_COW,
+      UPDATE_LAYOUT_EXT
     };
     Recorder(bufferlist &bl) : ValueDeltaRecorder(bl) {}
 
@@ -81,6 +88,23 @@ struct FLTreeOnode final : Onode, Value {
     assert(status != status_t::DELETED);
     return *read_payload<onode_layout_t>();
   }
+  onode_layout_ext_t get_layout_ext() const final {
+    assert(status != status_t::DELETED);
+    if (get_payload_size() < PAYLOAD_SIZE) {
+      return get_missing_layout_ext();
+    }
+    return *reinterpret_cast<const onode_layout_ext_t*>(
+      read_payload<char>() + LAYOUT_EXT_OFFSET);
+  }
+  /// nullptr if the value of the onode has no room for the extension
+  static onode_layout_ext_t *get_mutable_layout_ext(
+    NodeExtentMutable &payload_mut) {
+    if (payload_mut.get_length() < PAYLOAD_SIZE) {
+      return nullptr;
+    }
+    return reinterpret_cast<onode_layout_ext_t*>(
+      payload_mut.get_write() + LAYOUT_EXT_OFFSET);
+  }
 
   template <typename layout_func_t>
   void with_mutable_layout(
@@ -112,6 +136,15 @@ struct FLTreeOnode final : Onode, Value {
     std::swap(mlayout.omap_root, o_mlayout.omap_root);
     std::swap(mlayout.log_root, o_mlayout.log_root);
     std::swap(mlayout.xattr_root, o_mlayout.xattr_root);
+    // the blob order goes with the object data
+    auto mext = get_mutable_layout_ext(payload_mut);
+    auto o_mext = get_mutable_layout_ext(o_payload_mut);
+    if (mext && o_mext) {
+      std::swap(mext->blob_order, o_mext->blob_order);
+    } else {
+      ceph_assert(!mext || mext->blob_order == 0);
+      ceph_assert(!o_mext || o_mext->blob_order == 0);
+    }
     if (recorder) {
       recorder->encode_update(
 	payload_mut, Recorder::delta_op_t::UPDATE_OBJECT_DATA);
@@ -121,6 +154,10 @@ struct FLTreeOnode final : Onode, Value {
 	payload_mut, Recorder::delta_op_t::UPDATE_LOG_ROOT);
       recorder->encode_update(
 	payload_mut, Recorder::delta_op_t::UPDATE_XATTR_ROOT);
+      if (mext && o_mext) {
+	recorder->encode_update(
+	  payload_mut, Recorder::delta_op_t::UPDATE_LAYOUT_EXT);
+      }
     }
     if (o_recorder) {
       o_recorder->encode_update(
@@ -131,6 +168,10 @@ struct FLTreeOnode final : Onode, Value {
 	o_payload_mut, Recorder::delta_op_t::UPDATE_LOG_ROOT);
       o_recorder->encode_update(
 	o_payload_mut, Recorder::delta_op_t::UPDATE_XATTR_ROOT);
+      if (mext && o_mext) {
+	o_recorder->encode_update(
+	  o_payload_mut, Recorder::delta_op_t::UPDATE_LAYOUT_EXT);
+      }
     }
   }
 
@@ -141,6 +182,9 @@ struct FLTreeOnode final : Onode, Value {
 	auto &mlayout = *reinterpret_cast<onode_layout_t*>(
 	  payload_mut.get_write());
 	mlayout = onode_layout_t{};
+	if (auto mext = get_mutable_layout_ext(payload_mut); mext) {
+	  *mext = onode_layout_ext_t{};
+	}
 	if (recorder) {
 	  recorder->encode_update(
 	    payload_mut, Recorder::delta_op_t::CREATE_DEFAULT);
@@ -246,6 +290,17 @@ struct FLTreeOnode final : Onode, Value {
 	  recorder->encode_update(
 	    payload_mut, Recorder::delta_op_t::UPDATE_OBJECT_DATA);
 	}
+	auto mext = get_mutable_layout_ext(payload_mut);
+	if (!mext) {
+	  // see ObjectDataHandler::prepare_data_reservation()
+	  ceph_assert(odata.get_blob_order() == 0);
+	} else if (mext->blob_order != odata.get_blob_order()) {
+	  mext->blob_order = odata.get_blob_order();
+	  if (recorder) {
+	    recorder->encode_update(
+	      payload_mut, Recorder::delta_op_t::UPDATE_LAYOUT_EXT);
+	  }
+	}
     });
   }
 
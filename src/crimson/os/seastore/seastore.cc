@@ -132,6 +132,7 @@ SeaStore::Shard::Shard(
    max_object_size(
      get_conf<uint64_t>("seastore_default_max_object_size")),
    is_test(is_test),
+   default_compression(data_compression_t::create(pool_opts_t{})),
    throttler(
       get_conf<uint64_t>("seastore_max_concurrent_transactions"))
 {
@@ -950,8 +951,12 @@ SeaStore::Shard::set_collection_opts(CollectionRef c,
                                         const pool_opts_t& opts)
 {
   LOG_PREFIX(SeaStoreS::set_collection_opts);
-  DEBUG("cid={}, opts={} not implemented", c->get_cid(), opts);
-  //TODO
+  auto &coll = static_cast<SeastoreCollection&>(*c);
+  coll.compression = data_compression_t::create(opts);
+  DEBUG("cid={}, opts={}, compression {}",
+        c->get_cid(), opts,
+        coll.compression.enabled() ?
+          coll.compression.compressor->get_type_name() : "disabled");
   return seastar::now();
 }
 
@@ -1865,7 +1870,7 @@ SeaStore::Shard::_rename(
   auto omap_root = rename_omap_root(omap_type_t::OMAP, *onode, *d_onode);
   auto xattr_root = rename_omap_root(omap_type_t::XATTR, *onode, *d_onode);
   auto log_root = rename_omap_root(omap_type_t::LOG, *onode, *d_onode);
-  auto object_data = olayout.object_data.get();
+  auto object_data = onode->get_object_data();
   auto oi_bl = ceph::bufferlist::static_from_mem(
     &olayout.oi[0],
     (uint32_t)olayout.oi_size);
@@ -1877,12 +1882,40 @@ SeaStore::Shard::_rename(
   d_onode->update_omap_root(*ctx.transaction, omap_root);
   d_onode->update_xattr_root(*ctx.transaction, xattr_root);
   d_onode->update_log_root(*ctx.transaction, log_root);
-  d_onode->update_object_data(*ctx.transaction, object_data);
   d_onode->update_object_info(*ctx.transaction, oi_bl);
   d_onode->update_snapset(*ctx.transaction, ss_bl);
-  return onode_manager->erase_onode(
-    *ctx.transaction, onode
-  ).handle_error_interruptible(
+  auto fut = ObjectDataHandler::clone_iertr::now();
+  if (object_data.get_blob_order() && !d_onode->has_layout_ext()) {
+    // d_onode can't record the blob order, copy the data instead of
+    // handing the blobs over
+    fut = seastar::do_with(
+      ObjectDataHandler(max_object_size),
+      [this, &ctx, &onode, &d_onode, size](auto &objhandler) {
+      auto objctx = ObjectDataHandler::context_t{
+	*transaction_manager,
+	*ctx.transaction,
+	*onode,
+	d_onode.get()
+      };
+      auto copy_fut = ObjectDataHandler::clone_iertr::now();
+      if (size) {
+	copy_fut = objhandler.clone_range(objctx, 0, size, 0);
+      }
+      return copy_fut.si_then([&objhandler, objctx, &onode] {
+	if (onode->need_cow()) {
+	  return objhandler.copy_on_write(objctx);
+	}
+	return ObjectDataHandler::clone_iertr::now();
+      }).si_then([&objhandler, objctx] {
+	return objhandler.clear(objctx);
+      });
+    });
+  } else {
+    d_onode->update_object_data(*ctx.transaction, object_data);
+  }
+  return fut.si_then([this, &ctx, &onode] {
+    return onode_manager->erase_onode(*ctx.transaction, onode);
+  }).handle_error_interruptible(
     crimson::ct_error::input_output_error::pass_further(),
     crimson::ct_error::assert_all{
       "Invalid error in SeaStoreS::_rename"}
@@ -1964,6 +1997,8 @@ SeaStore::Shard::_write(
 	  *transaction_manager,
 	  *ctx.transaction,
 	  onode,
+	  nullptr,
+	  &static_cast<SeastoreCollection&>(*ctx.ch).compression
 	};
       if (onode.need_cow()) {
 	fut = objhandler.copy_on_write(objctx);
@@ -2058,7 +2093,8 @@ SeaStore::Shard::_clone_range(
 	*transaction_manager,
 	*ctx.transaction,
 	*src_onode,
-	dst_onode.get()},
+	dst_onode.get(),
+	&static_cast<SeastoreCollection&>(*ctx.ch).compression},
       srcoff,
       length,
       dstoff);
@@ -2090,6 +2126,8 @@ SeaStore::Shard::_zero(
 	*transaction_manager,
 	*ctx.transaction,
 	onode,
+	nullptr,
+	&static_cast<SeastoreCollection&>(*ctx.ch).compression
       };
     if (onode.need_cow()) {
       fut = objhandler.copy_on_write(objctx);
@@ -2150,6 +2188,8 @@ SeaStore::Shard::_truncate(
 	*transaction_manager,
 	*ctx.transaction,
 	onode,
+	nullptr,
+	&static_cast<SeastoreCollection&>(*ctx.ch).compression
       };
     if (onode.need_cow()) {
       fut = objhandler.copy_on_write(objctx);
@@ -2364,7 +2404,9 @@ SeaStore::Shard::_remove_collection(
 boost::intrusive_ptr<SeastoreCollection>
 SeaStore::Shard::_get_collection(const coll_t& cid)
 {
-  return new SeastoreCollection{cid};
+  auto c = new SeastoreCollection{cid};
+  c->compression = default_compression;
+  return c;
 }
 
 seastar::future<> SeaStore::write_meta(
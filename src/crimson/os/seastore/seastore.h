@@ -53,6 +53,8 @@ public:
     FuturizedCollection(std::forward<T>(args)...) {}
 
   seastar::shared_mutex ordering_lock;
+  /// compression of the object data written to this collection
+  data_compression_t compression;
 };
 
 /**
@@ -515,6 +517,8 @@ public:
     Device* device;
     const uint32_t max_object_size;
     bool is_test;
+    /// compression of collections without pool options
+    const data_compression_t default_compression;
 
     std::vector<Device*> secondaries;
     TransactionManagerRef transaction_manager;
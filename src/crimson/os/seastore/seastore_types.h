@@ -1779,14 +1779,19 @@ std::ostream &operator<<(std::ostream &out, const journal_tail_delta_t &delta);
 class object_data_t {
   laddr_t reserved_data_base = L_ADDR_NULL;
   extent_len_t reserved_data_len = 0;
+  // log2 of the size of the compression blobs the data is split into,
+  // 0 if the data is stored as is. See ObjectDataHandler.
+  uint8_t blob_order = 0;
 
   bool dirty = false;
 public:
   object_data_t(
     laddr_t reserved_data_base,
-    extent_len_t reserved_data_len)
+    extent_len_t reserved_data_len,
+    uint8_t blob_order = 0)
     : reserved_data_base(reserved_data_base),
-      reserved_data_len(reserved_data_len) {}
+      reserved_data_len(reserved_data_len),
+      blob_order(blob_order) {}
 
   laddr_t get_reserved_data_base() const {
     return reserved_data_base;
@@ -1796,6 +1801,14 @@ public:
     return reserved_data_len;
   }
 
+  uint8_t get_blob_order() const {
+    return blob_order;
+  }
+
+  extent_len_t get_blob_size() const {
+    return blob_order ? extent_len_t(1) << blob_order : 0;
+  }
+
   bool is_null() const {
     return reserved_data_base == L_ADDR_NULL;
   }
@@ -1818,10 +1831,16 @@ public:
     reserved_data_len = len;
   }
 
+  void update_blob_order(uint8_t order) {
+    dirty = true;
+    blob_order = order;
+  }
+
   void clear() {
     dirty = true;
     reserved_data_base = L_ADDR_NULL;
     reserved_data_len = 0;
+    blob_order = 0;
   }
 };
 constexpr object_data_t get_null_object_data() {
@@ -1837,10 +1856,12 @@ struct __attribute__((packed)) object_data_le_t {
     reserved_data_len = init_extent_len_le(nroot.get_reserved_data_len());
   }
 
-  object_data_t get() const {
+  // the blob order is stored in onode_layout_ext_t
+  object_data_t get(uint8_t blob_order = 0) const {
     return object_data_t(
       reserved_data_base,
-      reserved_data_len);
+      reserved_data_len,
+      blob_order);
   }
 };
 
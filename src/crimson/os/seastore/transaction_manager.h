@@ -944,6 +944,19 @@ public:
     return *cache;
   }
 
+  /// see Cache::get_decompressed_blob()
+  std::optional<ceph::bufferlist> get_decompressed_blob(paddr_t paddr) {
+    return cache->get_decompressed_blob(paddr);
+  }
+
+  void add_decompressed_blob(paddr_t paddr, const ceph::bufferlist &bl) {
+    cache->add_decompressed_blob(paddr, bl);
+  }
+
+  data_compression_stats_t& get_data_compression_stats() {
+    return cache->get_data_compression_stats();
+  }
+
   using remap_entry_t = LBAManager::remap_entry_t;
   using remap_mappings_iertr = base_iertr;
   using remap_mappings_ret = remap_mappings_iertr::future<
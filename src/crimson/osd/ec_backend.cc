@@ -1,18 +1,269 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
 #include "ec_backend.h"
 
+#include <seastar/util/defer.hh>
+
+#include "crimson/common/config_proxy.h"
+#include "crimson/common/coroutine.h"
+#include "crimson/common/exception.h"
+#include "crimson/common/log.h"
+#include "crimson/os/futurized_store.h"
+#include "crimson/osd/exceptions.h"
+#include "crimson/osd/pg.h"
 #include "crimson/osd/shard_services.h"
+#include "erasure-code/ErasureCodePlugin.h"
+#include "osd/PeeringState.h"
+
+SET_SUBSYS(osd);
+
+using crimson::common::local_conf;
 
 namespace crimson::osd {
 
-ECBackend::ECBackend(shard_id_t shard,
+ECBackend::ECBackend(pg_t pgid,
+                     pg_shard_t whoami,
+                     crimson::osd::PG& pg,
                      ECBackend::CollectionRef coll,
                      crimson::osd::ShardServices& shard_services,
-                     const ec_profile_t&,
-                     uint64_t,
+                     const ec_profile_t& ec_profile,
+                     const pg_pool_t& pool,
 		     DoutPrefixProvider &dpp)
-  : PGBackend{shard, coll, shard_services, dpp}
+  : PGBackend{whoami.shard, coll, shard_services, dpp},
+    pgid{pgid},
+    whoami{whoami},
+    pg(pg),
+    pool{pool},
+    ec_impl{create_ec_impl(ec_profile)},
+    sinfo{ec_impl, &this->pool, pool.stripe_width}
+{}
+
+ceph::ErasureCodeInterfaceRef
+ECBackend::create_ec_impl(const ec_profile_t& ec_profile)
 {
-  // todo
+  auto profile = ec_profile;
+  auto plugin = profile.find("plugin");
+  if (plugin == profile.end()) {
+    throw std::runtime_error("erasure code profile has no plugin");
+  }
+  // the plugins are preloaded by the OSD, so this does not touch the disk
+  ceph::ErasureCodeInterfaceRef ec_impl;
+  std::stringstream ss;
+  int r = ceph::ErasureCodePluginRegistry::instance().factory(
+    plugin->second,
+    local_conf().get_val<std::string>("erasure_code_dir"),
+    profile,
+    &ec_impl,
+    &ss);
+  if (r) {
+    throw std::runtime_error(
+      fmt::format("unable to create erasure code {}: {}",
+		  plugin->second, ss.str()));
+  }
+  return ec_impl;
+}
+
+std::optional<pg_shard_t>
+ECBackend::get_read_shard(const hobject_t& hoid, shard_id_t s) const
+{
+  for (const auto& pg_shard : pg.get_actingset()) {
+    if (pg_shard.shard != s) {
+      continue;
+    }
+    const bool missing = pg_shard == whoami ?
+      pg.is_missing_object(hoid) :
+      pg.is_missing_on_peer(pg_shard, hoid);
+    if (missing) {
+      return std::nullopt;
+    }
+    return pg_shard;
+  }
+  return std::nullopt;
+}
+
+ECBackend::interruptible_future<ECSubReadReply>
+ECBackend::do_sub_read(ECSubRead op)
+{
+  LOG_PREFIX(ECBackend::do_sub_read);
+  ECSubReadReply reply;
+  reply.from = whoami;
+  reply.tid = op.tid;
+  for (auto& [hoid, extents] : op.to_read) {
+    const ghobject_t oid{hoid, ghobject_t::NO_GEN, shard};
+    auto& buffers = reply.buffers_read[hoid];
+    for (auto& extent : extents) {
+      const uint64_t off = boost::get<0>(extent);
+      const uint64_t len = boost::get<1>(extent);
+      int r = 0;
+      auto bl = co_await interruptor::make_interruptible(
+	store->read(coll, oid, off, len, boost::get<2>(extent))
+      ).handle_error_interruptible<false>(
+	ll_read_errorator::all_same_way([&r](const std::error_code& e) {
+	  r = -e.value();
+	  return seastar::make_ready_future<ceph::bufferlist>();
+	}));
+      if (r < 0) {
+	DEBUGDPP("{} {}~{} got {}", dpp, oid, off, len, r);
+	reply.buffers_read.erase(hoid);
+	reply.errors[hoid] = r;
+	break;
+      }
+      // shards are not extended past the object's end
+      if (bl.length() < len) {
+	bl.append_zero(len - bl.length());
+      }
+      buffers.emplace_back(off, std::move(bl));
+    }
+  }
+  co_return reply;
+}
+
+seastar::future<ECSubReadReply>
+ECBackend::send_sub_read(pg_shard_t to, ECSubRead&& op)
+{
+  LOG_PREFIX(ECBackend::send_sub_read);
+  const ceph_tid_t tid = shard_services.get_tid();
+  op.from = whoami;
+  op.tid = tid;
+  auto m = crimson::make_message<MOSDECSubOpRead>();
+  m->pgid = spg_t{pgid, to.shard};
+  m->map_epoch = pg.get_osdmap_epoch();
+  m->min_epoch = pg.get_last_peering_reset();
+  m->op = std::move(op);
+  auto reply = pending_reads[tid].get_future();
+  return shard_services.send_to_osd(
+    to.osd, std::move(m), pg.get_osdmap_epoch()
+  ).then_wrapped([FNAME, this, tid, to,
+		  reply=std::move(reply)](auto&& sent) mutable {
+    if (sent.failed()) {
+      // no reply is coming, fail the read rather than wait for the
+      // next interval
+      auto e = sent.get_exception();
+      WARNDPP("sub read {} to {} not sent: {}", dpp, tid, to, e);
+      if (auto p = pending_reads.find(tid); p != pending_reads.end()) {
+	p->second.set_exception(e);
+	pending_reads.erase(p);
+      }
+    }
+    return std::move(reply);
+  });
+}
+
+ECBackend::interruptible_future<>
+ECBackend::read_shards(
+  const hobject_t& hoid,
+  const ECUtil::shard_extent_set_t& want,
+  ECUtil::shard_extent_map_t& out,
+  shard_id_set& failed)
+{
+  std::optional<ECSubRead> local_read;
+  std::vector<seastar::future<ECSubReadReply>> remote_reads;
+  std::vector<shard_id_t> remote_shards;
+  for (auto& [s, eset] : want) {
+    if (eset.empty()) {
+      continue;
+    }
+    auto from = get_read_shard(hoid, s);
+    if (!from) {
+      failed.insert(s);
+      continue;
+    }
+    ECSubRead op;
+    auto& to_read = op.to_read[hoid];
+    for (auto [off, len] : eset) {
+      to_read.emplace_back(off, len, 0);
+    }
+    if (*from == whoami) {
+      local_read = std::move(op);
+    } else {
+      remote_reads.emplace_back(send_sub_read(*from, std::move(op)));
+      remote_shards.push_back(s);
+    }
+  }
+
+  std::vector<ECSubReadReply> replies;
+  if (local_read) {
+    replies.emplace_back(co_await do_sub_read(std::move(*local_read)));
+  }
+  if (!remote_reads.empty()) {
+    auto remote_replies = co_await interruptor::make_interruptible(
+      seastar::when_all(remote_reads.begin(), remote_reads.end()));
+    for (unsigned i = 0; i < remote_replies.size(); ++i) {
+      auto& reply = remote_replies[i];
+      if (!reply.failed()) {
+	replies.emplace_back(reply.get());
+	continue;
+      }
+      // a shard which could not be asked is read as any unreadable one,
+      // unless the interval is over
+      try {
+	std::rethrow_exception(reply.get_exception());
+      } catch (const crimson::common::interruption&) {
+	throw;
+      } catch (...) {
+	failed.insert(remote_shards[i]);
+      }
+    }
+  }
+  for (auto& reply : replies) {
+    const shard_id_t s = reply.from.shard;
+    auto buffers = reply.buffers_read.find(hoid);
+    if (reply.errors.contains(hoid) || buffers == reply.buffers_read.end()) {
+      failed.insert(s);
+      continue;
+    }
+    for (auto& [off, bl] : buffers->second) {
+      out.insert_in_shard(s, off, bl);
+    }
+  }
+}
+
+ECBackend::interruptible_future<bool>
+ECBackend::read_and_decode(
+  const hobject_t& hoid,
+  const ECUtil::shard_extent_set_t& want,
+  ECUtil::shard_extent_map_t& out)
+{
+  LOG_PREFIX(ECBackend::read_and_decode);
+  shard_id_set failed;
+  co_await read_shards(hoid, want, out, failed);
+  if (failed.empty()) {
+    co_return true;
+  }
+  // read the same rows from every other shard, parity included, and
+  // rebuild the missing ones from any k of them
+  co_await read_shards(hoid, ec::extents_to_decode(sinfo, want, failed),
+		       out, failed);
+  DEBUGDPP("{} decoding shards {}", dpp, hoid, failed);
+  if (int r = ec::decode_shards(sinfo, ec_impl, want, failed, out, &dpp); r) {
+    WARNDPP("{} cannot decode from the {} of {} shards left: {}",
+	    dpp, hoid, sinfo.get_k_plus_m() - failed.size(), sinfo.get_k(), r);
+    co_return false;
+  }
+  co_return true;
+}
+
+ECBackend::interruptible_future<std::optional<ceph::bufferlist>>
+ECBackend::read_logical(const hobject_t& hoid, uint64_t off, uint64_t len)
+{
+  if (len == 0) {
+    co_return ceph::bufferlist{};
+  }
+  uint64_t ro_off = off;
+  uint64_t ro_len = len;
+  if (!sinfo.supports_partial_reads()) {
+    std::tie(ro_off, ro_len) =
+      sinfo.ro_offset_len_to_stripe_ro_offset_len(off, len);
+  }
+  ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
+  sinfo.ro_range_to_shard_extent_set(ro_off, ro_len, want);
+  want.align(EC_ALIGN_SIZE);
+  ECUtil::shard_extent_map_t sem(&sinfo);
+  if (!co_await read_and_decode(hoid, want, sem)) {
+    co_return std::nullopt;
+  }
+  co_return sem.get_ro_buffer(off, len);
 }
 
 ECBackend::ll_read_ierrorator::future<ceph::bufferlist>
@@ -21,21 +272,734 @@ ECBackend::_read(const hobject_t& hoid,
                  const uint64_t len,
                  const uint32_t flags)
 {
-  // todo
-  return seastar::make_ready_future<bufferlist>();
+  return read_logical(hoid, off, len).then_interruptible(
+    [](std::optional<ceph::bufferlist> bl)
+    -> ll_read_errorator::future<ceph::bufferlist> {
+    if (!bl) {
+      return crimson::ct_error::input_output_error::make();
+    }
+    return ll_read_errorator::make_ready_future<ceph::bufferlist>(
+      std::move(*bl));
+  });
+}
+
+ECBackend::interruptible_future<MURef<MOSDECSubOpReadReply>>
+ECBackend::handle_sub_read(Ref<MOSDECSubOpRead> m)
+{
+  LOG_PREFIX(ECBackend::handle_sub_read);
+  DEBUGDPP("{}", dpp, *m);
+  auto reply = crimson::make_message<MOSDECSubOpReadReply>();
+  reply->pgid = spg_t{pgid, m->op.from.shard};
+  reply->map_epoch = pg.get_osdmap_epoch();
+  reply->min_epoch = m->min_epoch;
+  reply->op = co_await do_sub_read(m->op);
+  co_return reply;
+}
+
+void ECBackend::handle_sub_read_reply(ECSubReadReply&& reply)
+{
+  LOG_PREFIX(ECBackend::handle_sub_read_reply);
+  auto found = pending_reads.find(reply.tid);
+  if (found == pending_reads.end()) {
+    WARNDPP("cannot find sub read {} from {}", dpp, reply.tid, reply.from);
+    return;
+  }
+  auto pr = std::move(found->second);
+  pending_reads.erase(found);
+  pr.set_value(std::move(reply));
+}
+
+ECBackend::interruptible_future<>
+ECBackend::load_object_state(const hobject_t& hoid)
+{
+  if (auto p = objects_in_flight.find(hoid); p != objects_in_flight.end()) {
+    ++p->second.pending;
+    co_return;
+  }
+  // nothing in flight, so the local object info is up to date
+  auto bl = co_await interruptor::make_interruptible(
+    store->get_attr(coll, ghobject_t{hoid, ghobject_t::NO_GEN, shard}, OI_ATTR)
+  ).handle_error_interruptible<false>(
+    crimson::os::FuturizedStore::Shard::get_attr_errorator::all_same_way(
+      [](const std::error_code&) {
+      return seastar::make_ready_future<ceph::bufferlist>();
+    }));
+  uint64_t size = 0;
+  if (bl.length()) {
+    size = object_info_t{bl}.size;
+  }
+  auto& st = objects_in_flight[hoid];
+  st.size = st.valid_end = size;
+  ++st.pending;
+}
+
+void ECBackend::release_object_states(const std::set<hobject_t>& objects)
+{
+  for (auto& hoid : objects) {
+    auto p = objects_in_flight.find(hoid);
+    if (p != objects_in_flight.end() && --p->second.pending == 0) {
+      objects_in_flight.erase(p);
+    }
+  }
+}
+
+void ECBackend::emit_shard_writes(
+  const hobject_t& hoid,
+  uint64_t object_size,
+  const ECUtil::shard_extent_map_t& sem,
+  const shard_id_set& shards,
+  shard_txns_t& shard_txns)
+{
+  for (auto& [s, t] : shard_txns) {
+    if (!shards.contains(s) || !sem.contains_shard(s)) {
+      continue;
+    }
+    const uint64_t shard_size = sinfo.object_size_to_shard_size(object_size, s);
+    for (auto& e : sem.get_extent_map(s)) {
+      const uint64_t off = e.get_off();
+      if (off >= shard_size) {
+	break;
+      }
+      const uint64_t len = std::min<uint64_t>(e.get_len(), shard_size - off);
+      ceph::bufferlist bl;
+      bl.substr_of(e.get_val(), 0, len);
+      t.write(get_shard_cid(s), ghobject_t{hoid, ghobject_t::NO_GEN, s},
+	      off, len, bl);
+    }
+  }
+}
+
+ECBackend::interruptible_future<bool>
+ECBackend::write_parity_delta(
+  const hobject_t& hoid,
+  write_plan_t& plan,
+  shard_txns_t& shard_txns)
+{
+  LOG_PREFIX(ECBackend::write_parity_delta);
+  ECUtil::shard_extent_set_t will_write(sinfo.get_k_plus_m());
+  extent_set superset;
+  for (auto [off, len] : plan.dirty) {
+    sinfo.ro_range_to_shard_extent_set_with_superset(
+      off, len, will_write, superset);
+  }
+  superset.align(EC_ALIGN_SIZE);
+  for (auto s : sinfo.get_parity_shards()) {
+    will_write[s].union_of(superset);
+  }
+  will_write.align(EC_ALIGN_SIZE);
+
+  ECUtil::shard_extent_map_t read_sem(&sinfo);
+  shard_id_set failed;
+  co_await read_shards(hoid, will_write, read_sem, failed);
+  if (!failed.empty()) {
+    DEBUGDPP("{} shards {} unreadable, rewriting the stripes",
+	     dpp, hoid, failed);
+    co_return false;
+  }
+
+  ECUtil::shard_extent_map_t to_write(&sinfo);
+  for (auto& e : plan.overlay) {
+    ceph::bufferlist bl = e.get_val();
+    sinfo.ro_range_to_shard_extent_map(e.get_off(), e.get_len(), bl, to_write);
+  }
+  read_sem.zero_pad(will_write);
+  to_write.pad_with_other(will_write, read_sem);
+  int r = to_write.encode_parity_delta(ec_impl, read_sem, &dpp);
+  ceph_assert(r == 0);
+
+  auto& st = objects_in_flight.at(hoid);
+  emit_shard_writes(hoid, st.size, to_write, will_write.get_shard_id_set(),
+		    shard_txns);
+  st.data.insert(plan.overlay);
+  co_return true;
+}
+
+ECBackend::interruptible_future<>
+ECBackend::write_stripes(
+  const hobject_t& hoid,
+  write_plan_t& plan,
+  shard_txns_t& shard_txns)
+{
+  LOG_PREFIX(ECBackend::write_stripes);
+  auto& st = objects_in_flight.at(hoid);
+  const uint64_t size = st.size;
+  const extent_set stripes = ec::stripes_to_rewrite(sinfo, plan, size);
+  if (stripes.empty()) {
+    co_return;
+  }
+
+  const extent_set need = ec::old_data_to_read(plan, st, stripes);
+  extent_map old_data;
+  if (!need.empty()) {
+    ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
+    for (auto [off, len] : need) {
+      sinfo.ro_range_to_shard_extent_set(off, len, want);
+    }
+    want.align(EC_ALIGN_SIZE);
+    ECUtil::shard_extent_map_t old_sem(&sinfo);
+    if (!co_await read_and_decode(hoid, want, old_sem)) {
+      ERRORDPP("{} cannot read {} to rewrite {}", dpp, hoid, need, stripes);
+      throw crimson::osd::error(std::errc::io_error);
+    }
+    for (auto [off, len] : need) {
+      old_data.insert(off, len, old_sem.get_ro_buffer(off, len));
+    }
+  }
+
+  const extent_map image = ec::assemble_stripes(plan, st, stripes, old_data);
+  ECUtil::shard_extent_map_t to_write(&sinfo);
+  for (auto& e : image) {
+    ceph::bufferlist bl = e.get_val();
+    sinfo.ro_range_to_shard_extent_map(e.get_off(), e.get_len(), bl, to_write);
+  }
+  to_write.insert_parity_buffers();
+  int r = to_write.encode(ec_impl, &dpp);
+  ceph_assert(r == 0);
+
+  emit_shard_writes(hoid, size, to_write, ec::shards_to_rewrite(sinfo, plan),
+		    shard_txns);
+
+  st.data.insert(image);
+  const uint64_t stripes_end = sinfo.ro_offset_to_next_stripe_ro_offset(size);
+  if (stripes_end > size) {
+    st.data.erase(size, stripes_end - size);
+  }
+}
+
+ECBackend::interruptible_future<>
+ECBackend::flush_plan(
+  const hobject_t& hoid,
+  write_plan_t& plan,
+  shard_txns_t& shard_txns)
+{
+  if (plan.truncate_to) {
+    for (auto& [s, t] : shard_txns) {
+      t.truncate(get_shard_cid(s), ghobject_t{hoid, ghobject_t::NO_GEN, s},
+		 sinfo.object_size_to_shard_size(*plan.truncate_to, s));
+    }
+  }
+  if (!plan.dirty.empty()) {
+    bool written = false;
+    if (ec::should_write_parity_delta(sinfo, plan, objects_in_flight.at(hoid))) {
+      written = co_await write_parity_delta(hoid, plan, shard_txns);
+    }
+    if (!written) {
+      co_await write_stripes(hoid, plan, shard_txns);
+    }
+  }
+  if (plan.resized) {
+    // shards which were not written still have to follow the new size
+    const uint64_t size = objects_in_flight.at(hoid).size;
+    for (auto& [s, t] : shard_txns) {
+      t.truncate(get_shard_cid(s), ghobject_t{hoid, ghobject_t::NO_GEN, s},
+		 sinfo.object_size_to_shard_size(size, s));
+    }
+  }
+  plan = write_plan_t{};
+}
+
+int ECBackend::check_transaction(ceph::os::Transaction& txn) const
+{
+  return ec::check_transaction(txn);
+}
+
+int ECBackend::replicate_op(
+  ceph::os::Transaction::iterator& i,
+  const ceph::os::Transaction::Op* op,
+  shard_txns_t& shard_txns)
+{
+  using ceph::os::Transaction;
+  const auto& oid = i.get_oid(op->oid);
+  auto for_each_shard = [&](auto&& f) {
+    for (auto& [s, t] : shard_txns) {
+      f(t, get_shard_cid(s), get_shard_oid(oid, s));
+    }
+  };
+  switch (op->op) {
+  case Transaction::OP_NOP:
+    break;
+  case Transaction::OP_CREATE:
+    for_each_shard([](auto& t, auto& cid, auto& soid) {
+      t.create(cid, soid);
+    });
+    break;
+  case Transaction::OP_TOUCH:
+    for_each_shard([](auto& t, auto& cid, auto& soid) {
+      t.touch(cid, soid);
+    });
+    break;
+  case Transaction::OP_SETATTR: {
+    std::string name = i.decode_string();
+    ceph::bufferlist bl;
+    i.decode_bl(bl);
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.setattr(cid, soid, name, bl);
+    });
+    break;
+  }
+  case Transaction::OP_SETATTRS: {
+    std::map<std::string, ceph::bufferlist> aset;
+    i.decode_attrset(aset);
+    const std::map<std::string, ceph::bufferlist, std::less<>> attrs{
+      aset.begin(), aset.end()};
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.setattrs(cid, soid, attrs);
+    });
+    break;
+  }
+  case Transaction::OP_RMATTR: {
+    std::string name = i.decode_string();
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.rmattr(cid, soid, name);
+    });
+    break;
+  }
+  case Transaction::OP_RMATTRS:
+    for_each_shard([](auto& t, auto& cid, auto& soid) {
+      t.rmattrs(cid, soid);
+    });
+    break;
+  case Transaction::OP_OMAP_CLEAR:
+    for_each_shard([](auto& t, auto& cid, auto& soid) {
+      t.omap_clear(cid, soid);
+    });
+    break;
+  case Transaction::OP_OMAP_SETKEYS: {
+    ceph::bufferlist bl;
+    i.decode_attrset_bl(&bl);
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.omap_setkeys(cid, soid, bl);
+    });
+    break;
+  }
+  case Transaction::OP_OMAP_RMKEYS: {
+    ceph::bufferlist bl;
+    i.decode_keyset_bl(&bl);
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.omap_rmkeys(cid, soid, bl);
+    });
+    break;
+  }
+  case Transaction::OP_OMAP_RMKEYRANGE: {
+    std::string first = i.decode_string();
+    std::string last = i.decode_string();
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.omap_rmkeyrange(cid, soid, first, last);
+    });
+    break;
+  }
+  case Transaction::OP_OMAP_SETHEADER: {
+    ceph::bufferlist bl;
+    i.decode_bl(bl);
+    for_each_shard([&](auto& t, auto& cid, auto& soid) {
+      t.omap_setheader(cid, soid, bl);
+    });
+    break;
+  }
+  default:
+    return -EOPNOTSUPP;
+  }
+  return 0;
+}
+
+ECBackend::interruptible_future<int>
+ECBackend::translate_transaction(
+  ceph::os::Transaction& txn,
+  shard_txns_t& shard_txns,
+  std::set<hobject_t>& objects)
+{
+  using ceph::os::Transaction;
+  std::set<hobject_t> with_data;
+  for (auto i = txn.begin(); i.have_op(); ) {
+    auto op = i.decode_op();
+    switch (op->op) {
+    case Transaction::OP_CLONE:
+      with_data.insert(i.get_oid(op->dest_oid).hobj);
+      [[fallthrough]];
+    case Transaction::OP_WRITE:
+    case Transaction::OP_ZERO:
+    case Transaction::OP_TRUNCATE:
+    case Transaction::OP_REMOVE:
+      with_data.insert(i.get_oid(op->oid).hobj);
+      break;
+    }
+  }
+  for (auto& hoid : with_data) {
+    co_await load_object_state(hoid);
+    objects.insert(hoid);
+  }
+
+  // data ops are accumulated per object and turned into shard writes
+  // when the object is cloned, or at the end of the transaction
+  std::map<hobject_t, write_plan_t> plans;
+  for (auto i = txn.begin(); i.have_op(); ) {
+    auto op = i.decode_op();
+    const auto& oid = i.get_oid(op->oid);
+    switch (op->op) {
+    case Transaction::OP_WRITE: {
+      ceph::bufferlist bl;
+      i.decode_bl(bl);
+      ec::plan_write(plans[oid.hobj], objects_in_flight.at(oid.hobj),
+		     op->off, op->len, bl);
+      break;
+    }
+    case Transaction::OP_ZERO: {
+      ceph::bufferlist bl;
+      bl.append_zero(op->len);
+      ec::plan_write(plans[oid.hobj], objects_in_flight.at(oid.hobj),
+		     op->off, op->len, bl);
+      break;
+    }
+    case Transaction::OP_TRUNCATE:
+      ec::plan_truncate(sinfo, plans[oid.hobj],
+			objects_in_flight.at(oid.hobj), op->off);
+      break;
+    case Transaction::OP_CLONE: {
+      const auto& dest = i.get_oid(op->dest_oid);
+      if (auto p = plans.find(oid.hobj); p != plans.end()) {
+	co_await flush_plan(oid.hobj, p->second, shard_txns);
+	plans.erase(p);
+      }
+      plans.erase(dest.hobj);
+      for (auto& [s, t] : shard_txns) {
+	t.clone(get_shard_cid(s), get_shard_oid(oid, s), get_shard_oid(dest, s));
+      }
+      const auto& src_state = objects_in_flight.at(oid.hobj);
+      auto& dest_state = objects_in_flight.at(dest.hobj);
+      dest_state.size = src_state.size;
+      dest_state.valid_end = src_state.valid_end;
+      dest_state.data = src_state.data;
+      break;
+    }
+    case Transaction::OP_REMOVE: {
+      plans.erase(oid.hobj);
+      auto& st = objects_in_flight.at(oid.hobj);
+      st.size = st.valid_end = 0;
+      st.data.clear();
+      for (auto& [s, t] : shard_txns) {
+	t.remove(get_shard_cid(s), get_shard_oid(oid, s));
+      }
+      break;
+    }
+    case Transaction::OP_SETALLOCHINT:
+      // every shard holds 1/k of the object
+      for (auto& [s, t] : shard_txns) {
+	t.set_alloc_hint(get_shard_cid(s), get_shard_oid(oid, s),
+			 op->expected_object_size / sinfo.get_k(),
+			 op->expected_write_size / sinfo.get_k(),
+			 op->hint);
+      }
+      break;
+    default:
+      if (int r = replicate_op(i, op, shard_txns); r < 0) {
+	co_return r;
+      }
+    }
+  }
+  for (auto& [hoid, plan] : plans) {
+    co_await flush_plan(hoid, plan, shard_txns);
+  }
+  co_return 0;
+}
+
+MURef<MOSDECSubOpWrite> ECBackend::new_sub_write_msg(
+  const pg_shard_t &pg_shard,
+  const hobject_t &hoid,
+  const ceph::os::Transaction &txn,
+  const osd_op_params_t &osd_op_p,
+  epoch_t min_epoch,
+  epoch_t map_epoch,
+  const std::vector<pg_log_entry_t> &log_entries,
+  bool send_op,
+  ceph_tid_t tid)
+{
+  ceph_assert(pg_shard != whoami);
+  auto m = crimson::make_message<MOSDECSubOpWrite>();
+  m->pgid = spg_t{pgid, pg_shard.shard};
+  m->map_epoch = map_epoch;
+  m->min_epoch = min_epoch;
+  auto& op = m->op;
+  op.from = whoami;
+  op.tid = tid;
+  op.reqid = osd_op_p.req_id;
+  op.soid = hoid;
+  op.stats = pg.get_info().stats;
+  if (send_op) {
+    op.t = txn;
+  }
+  op.at_version = osd_op_p.at_version;
+  op.trim_to = osd_op_p.pg_trim_to;
+  op.pg_committed_to = osd_op_p.pg_committed_to;
+  op.log_entries = log_entries;
+  op.backfill_or_async_recovery = !send_op;
+  return m;
 }
 
 ECBackend::rep_op_fut_t
-ECBackend::submit_transaction(const std::set<pg_shard_t> &pg_shards,
-                              const hobject_t& hoid,
-			      crimson::osd::ObjectContextRef&& new_clone,
-                              ceph::os::Transaction&& txn,
-                              osd_op_params_t&& osd_op_p,
-                              epoch_t min_epoch, epoch_t max_epoch,
-			      std::vector<pg_log_entry_t>&& log_entries)
-{
-  // todo
-  return make_ready_future<rep_op_ret_t>(seastar::now(), seastar::now());
+ECBackend::submit_transaction(
+  const std::set<pg_shard_t> &pg_shards,
+  const hobject_t& hoid,
+  crimson::osd::ObjectContextRef &&new_clone,
+  ceph::os::Transaction&& t,
+  osd_op_params_t&& opp,
+  epoch_t min_epoch, epoch_t map_epoch,
+  std::vector<pg_log_entry_t>&& logv)
+{
+  LOG_PREFIX(ECBackend::submit_transaction);
+  DEBUGDPP("object {}", dpp, hoid);
+  auto log_entries = std::move(logv);
+  auto txn = std::move(t);
+  auto osd_op_p = std::move(opp);
+  auto _new_clone = std::move(new_clone);
+
+  const ceph_tid_t tid = shard_services.get_tid();
+  auto pending_txn =
+    pending_trans.try_emplace(
+      tid,
+      pg_shards.size(),
+      osd_op_p.at_version,
+      pg.get_last_complete()).first;
+
+  // a transaction is planned against the state left by the previous ones,
+  // and its sub writes must reach the shards after theirs
+  auto prev_submitted = last_submitted;
+  seastar::promise<> submitted;
+  last_submitted = seastar::shared_future<>(submitted.get_future());
+  auto release_submitted = seastar::defer([&submitted] () noexcept {
+    submitted.set_value();
+  });
+  co_await interruptor::make_interruptible(prev_submitted.get_future());
+
+  shard_txns_t shard_txns;
+  for (auto &pg_shard : pg_shards) {
+    shard_txns[pg_shard.shard];
+  }
+  std::set<hobject_t> objects;
+  std::exception_ptr eptr;
+  int r = 0;
+  try {
+    r = co_await translate_transaction(txn, shard_txns, objects);
+  } catch (...) {
+    eptr = std::current_exception();
+  }
+  if (eptr || r < 0) {
+    release_object_states(objects);
+    pending_trans.erase(tid);
+    if (eptr) {
+      std::rethrow_exception(eptr);
+    }
+    // PG::submit_transaction checks the ops first, see check_transaction()
+    ERRORDPP("object {}: unsupported transaction op, r={}", dpp, hoid, r);
+    co_return std::make_tuple(
+      interruptor::make_interruptible(seastar::make_exception_future<>(
+	std::system_error(-r, std::generic_category()))),
+      interruptor::now());
+  }
+
+  bool is_delete = false;
+  for (auto &le : log_entries) {
+    // shards are overwritten in place, there is nothing to roll back to
+    le.mark_unrollbackable();
+    if (le.is_delete()) {
+      is_delete = true;
+    }
+  }
+
+  auto& local_txn = shard_txns[whoami.shard];
+  co_await pg.update_snap_map(log_entries, local_txn);
+
+  std::vector<pg_shard_t> to_push_clone;
+  std::vector<pg_shard_t> to_push_delete;
+  auto sends = std::make_unique<std::vector<seastar::future<>>>();
+  for (auto &pg_shard : pg_shards) {
+    if (pg_shard == whoami) {
+      continue;
+    }
+    const bool send_op = pg.should_send_op(pg_shard, hoid);
+    auto m = new_sub_write_msg(
+      pg_shard, hoid, shard_txns[pg_shard.shard], osd_op_p,
+      min_epoch, map_epoch, log_entries, send_op, tid);
+    if (!send_op && pg.is_missing_on_peer(pg_shard, hoid)) {
+      // see ReplicatedBackend::submit_transaction
+      if (_new_clone) {
+	to_push_clone.push_back(pg_shard);
+      }
+      if (is_delete) {
+	to_push_delete.push_back(pg_shard);
+      }
+    }
+    pending_txn->second.acked_peers.push_back({pg_shard, eversion_t{}});
+    sends->emplace_back(
+      shard_services.send_to_osd(
+	pg_shard.osd, std::move(m), map_epoch));
+  }
+
+  pg.log_operation(
+    std::move(log_entries),
+    osd_op_p.pg_trim_to,
+    osd_op_p.at_version,
+    osd_op_p.pg_committed_to,
+    true,
+    local_txn,
+    false);
+
+  auto all_completed = interruptor::make_interruptible(
+      shard_services.get_store().do_transaction(coll, std::move(local_txn))
+   ).then_interruptible([FNAME, this,
+			peers=pending_txn->second.weak_from_this()] {
+    if (!peers) {
+      // for now, only actingset_changed can cause peers
+      // to be nullptr
+      ERRORDPP("peers is null, this should be impossible", dpp);
+      assert(0 == "impossible");
+    }
+    if (--peers->pending == 0) {
+      pg.complete_write(peers->at_version, peers->last_complete);
+      peers->all_committed.set_value();
+      peers->all_committed = {};
+      return seastar::now();
+    }
+    // wait for all shards to ack (ECBackend::handle_sub_write_reply)
+    return peers->all_committed.get_shared_future();
+  }).then_interruptible([pending_txn, this, _new_clone, hoid,
+			objects=std::move(objects),
+			to_push_delete=std::move(to_push_delete),
+			to_push_clone=std::move(to_push_clone)] {
+    pending_trans.erase(pending_txn);
+    release_object_states(objects);
+    if (_new_clone && !to_push_clone.empty()) {
+      pg.enqueue_push_for_backfill(
+	_new_clone->obs.oi.soid,
+	_new_clone->obs.oi.version,
+	to_push_clone);
+    }
+    if (!to_push_delete.empty()) {
+      pg.enqueue_delete_for_backfill(hoid, {}, to_push_delete);
+    }
+    return seastar::now();
+  });
+
+  auto sends_complete = seastar::when_all_succeed(
+    sends->begin(), sends->end()
+  ).finally([sends=std::move(sends)] {});
+  co_return std::make_tuple(std::move(sends_complete), std::move(all_completed));
+}
+
+ECBackend::interruptible_future<ECBackend::sub_write_ret_t>
+ECBackend::handle_sub_write(Ref<MOSDECSubOpWrite> m)
+{
+  LOG_PREFIX(ECBackend::handle_sub_write);
+  DEBUGDPP("{}", dpp, *m);
+  auto& op = m->op;
+  auto txn = std::move(op.t);
+  pg.update_stats(op.stats);
+
+  co_await pg.update_snap_map(op.log_entries, txn);
+
+  pg.log_operation(std::move(op.log_entries),
+		   op.trim_to,
+		   op.at_version,
+		   op.pg_committed_to,
+		   !txn.empty(),
+		   txn,
+		   false);
+  DEBUGDPP("{} do_transaction", dpp, *m);
+
+  auto commit_fut = interruptor::make_interruptible(
+    shard_services.get_store().do_transaction(coll, std::move(txn))
+  );
+
+  const auto &lcod = pg.peering_state.get_info().last_complete;
+  pg.peering_state.update_last_complete_ondisk(lcod);
+  auto reply = crimson::make_message<MOSDECSubOpWriteReply>();
+  reply->pgid = spg_t{pgid, op.from.shard};
+  reply->map_epoch = pg.get_osdmap_epoch();
+  reply->min_epoch = m->min_epoch;
+  reply->op.from = whoami;
+  reply->op.tid = op.tid;
+  reply->op.last_complete = lcod;
+  reply->op.committed = true;
+  reply->op.applied = true;
+  co_return sub_write_ret_t(std::move(commit_fut), std::move(reply));
+}
+
+void ECBackend::handle_sub_write_reply(const ECSubWriteReply& reply)
+{
+  LOG_PREFIX(ECBackend::handle_sub_write_reply);
+  auto found = pending_trans.find(reply.tid);
+  if (found == pending_trans.end()) {
+    WARNDPP("cannot find sub write {} from {}", dpp, reply.tid, reply.from);
+    return;
+  }
+  auto& peers = found->second;
+  for (auto& peer : peers.acked_peers) {
+    if (peer.shard == reply.from) {
+      peer.last_complete_ondisk = reply.last_complete;
+      pg.update_peer_last_complete_ondisk(
+	peer.shard, peer.last_complete_ondisk);
+      if (--peers.pending == 0) {
+        pg.complete_write(peers.at_version, peers.last_complete);
+        peers.all_committed.set_value();
+        peers.all_committed = {};
+      }
+      return;
+    }
+  }
+}
+
+void ECBackend::on_actingset_changed(bool same_primary)
+{
+  crimson::common::actingset_changed e_actingset_changed{same_primary};
+  for (auto& [tid, pending_txn] : pending_trans) {
+    pending_txn.all_committed.set_exception(e_actingset_changed);
+  }
+  pending_trans.clear();
+  for (auto& [tid, pending_read] : pending_reads) {
+    pending_read.set_exception(e_actingset_changed);
+  }
+  pending_reads.clear();
+  objects_in_flight.clear();
+  last_submitted = seastar::shared_future<>(seastar::make_ready_future<>());
+}
+
+seastar::future<> ECBackend::stop()
+{
+  LOG_PREFIX(ECBackend::stop);
+  INFODPP("cid {}", dpp, coll->get_cid());
+  for (auto& [tid, pending_on] : pending_trans) {
+    pending_on.all_committed.set_exception(
+	crimson::common::system_shutdown_exception());
+  }
+  pending_trans.clear();
+  for (auto& [tid, pending_read] : pending_reads) {
+    pending_read.set_exception(
+	crimson::common::system_shutdown_exception());
+  }
+  pending_reads.clear();
+  objects_in_flight.clear();
+  return seastar::now();
+}
+
+seastar::future<>
+ECBackend::request_committed(const osd_reqid_t& reqid,
+			     const eversion_t& at_version)
+{
+  if (std::empty(pending_trans)) {
+    return seastar::now();
+  }
+  auto iter = pending_trans.begin();
+  auto& pending_txn = iter->second;
+  if (pending_txn.at_version > at_version) {
+    return seastar::now();
+  }
+  for (; iter->second.at_version < at_version; ++iter);
+  // see ReplicatedBackend::request_committed
+  assert(iter != pending_trans.end() && iter->second.at_version == at_version);
+  if (iter->second.pending) {
+    return iter->second.all_committed.get_shared_future();
+  } else {
+    return seastar::now();
+  }
 }
 
 }
@@ -5,41 +5,196 @@
 
 #include <boost/intrusive_ptr.hpp>
 #include <seastar/core/future.hh>
+#include <seastar/core/shared_future.hh>
+#include <seastar/core/weak_ptr.hh>
+#include "erasure-code/ErasureCodeInterface.h"
 #include "include/buffer_fwd.h"
+#include "messages/MOSDECSubOpRead.h"
+#include "messages/MOSDECSubOpReadReply.h"
+#include "messages/MOSDECSubOpWrite.h"
+#include "messages/MOSDECSubOpWriteReply.h"
+#include "osd/ECUtil.h"
 #include "osd/osd_types.h"
+
+#include "acked_peers.h"
+#include "ec_planner.h"
 #include "pg_backend.h"
 
 namespace crimson::osd {
+class ShardServices;
+class PG;
 
+/**
+ * ECBackend
+ *
+ * Stores each object as k data and m parity chunks, one per shard of
+ * the PG, using the pool's erasure code plugin.  The primary turns every
+ * logical transaction into per-shard transactions (reading back the old
+ * stripes it has to re-encode) and sends them as MOSDECSubOpWrite; reads
+ * are served from the data shards and decoded from any k shards when some
+ * of them are unavailable.  All encoding and decoding runs on the reactor
+ * owning the PG.
+ */
 class ECBackend : public PGBackend
 {
 public:
-  ECBackend(shard_id_t shard,
+  ECBackend(pg_t pgid, pg_shard_t whoami,
+	    crimson::osd::PG& pg,
 	    CollectionRef coll,
 	    crimson::osd::ShardServices& shard_services,
 	    const ec_profile_t& ec_profile,
-	    uint64_t stripe_width,
+	    const pg_pool_t& pool,
 	    DoutPrefixProvider &dpp);
-  seastar::future<> stop() final {
-    return seastar::now();
+  seastar::future<> stop() final;
+  void on_actingset_changed(bool same_primary) final;
+
+  unsigned get_k() const {
+    return sinfo.get_k();
   }
-  void on_actingset_changed(bool same_primary) final {}
+
+  using sub_write_ret_t = std::tuple<
+    interruptible_future<>,          // resolves upon commit
+    MURef<MOSDECSubOpWriteReply>>;   // reply message
+  interruptible_future<sub_write_ret_t> handle_sub_write(
+    Ref<MOSDECSubOpWrite> m);
+  void handle_sub_write_reply(const ECSubWriteReply& reply);
+  interruptible_future<MURef<MOSDECSubOpReadReply>> handle_sub_read(
+    Ref<MOSDECSubOpRead> m);
+  void handle_sub_read_reply(ECSubReadReply&& reply);
+
 private:
+  bool supports_sparse_reads() const final {
+    return false;
+  }
   ll_read_ierrorator::future<ceph::bufferlist>
-  _read(const hobject_t& hoid, uint64_t off, uint64_t len, uint32_t flags) override;
-  rep_op_fut_t
-  submit_transaction(const std::set<pg_shard_t> &pg_shards,
-		     const hobject_t& hoid,
-		     crimson::osd::ObjectContextRef&& new_clone,
-		     ceph::os::Transaction&& txn,
-		     osd_op_params_t&& req,
-		     epoch_t min_epoch, epoch_t max_epoch,
-		     std::vector<pg_log_entry_t>&& log_entries) final;
-  CollectionRef coll;
-  seastar::future<> request_committed(const osd_reqid_t& reqid,
-				       const eversion_t& version) final {
-    return seastar::now();
+    _read(const hobject_t& hoid, uint64_t off,
+	  uint64_t len, uint32_t flags) override;
+  int check_transaction(ceph::os::Transaction& txn) const final;
+  rep_op_fut_t submit_transaction(
+    const std::set<pg_shard_t> &pg_shards,
+    const hobject_t& hoid,
+    crimson::osd::ObjectContextRef&& new_clone,
+    ceph::os::Transaction&& txn,
+    osd_op_params_t&& osd_op_p,
+    epoch_t min_epoch, epoch_t max_epoch,
+    std::vector<pg_log_entry_t>&& log_entries) final;
+  seastar::future<> request_committed(
+    const osd_reqid_t& reqid, const eversion_t& at_version) final;
+
+  static ceph::ErasureCodeInterfaceRef create_ec_impl(
+    const ec_profile_t& ec_profile);
+
+  const pg_t pgid;
+  const pg_shard_t whoami;
+  crimson::osd::PG& pg;
+  // sinfo keeps a pointer to the pool
+  const pg_pool_t pool;
+  const ceph::ErasureCodeInterfaceRef ec_impl;
+  const ECUtil::stripe_info_t sinfo;
+
+  coll_t get_shard_cid(shard_id_t s) const {
+    return coll_t{spg_t{pgid, s}};
+  }
+  static ghobject_t get_shard_oid(const ghobject_t& oid, shard_id_t s) {
+    return ghobject_t{oid.hobj, oid.generation, s};
   }
+  /// where to read shard s of hoid from, if it is readable at all
+  std::optional<pg_shard_t> get_read_shard(
+    const hobject_t& hoid, shard_id_t s) const;
+
+  // -- reads --
+  /// serve a sub read from the local shard
+  interruptible_future<ECSubReadReply> do_sub_read(ECSubRead op);
+  seastar::future<ECSubReadReply> send_sub_read(
+    pg_shard_t to, ECSubRead&& op);
+  /// read the given shard extents, shards which fail are added to failed
+  interruptible_future<> read_shards(
+    const hobject_t& hoid,
+    const ECUtil::shard_extent_set_t& want,
+    ECUtil::shard_extent_map_t& out,
+    shard_id_set& failed);
+  /// read the given data shard extents, decoding the unreadable ones
+  interruptible_future<bool> read_and_decode(
+    const hobject_t& hoid,
+    const ECUtil::shard_extent_set_t& want,
+    ECUtil::shard_extent_map_t& out);
+  interruptible_future<std::optional<ceph::bufferlist>> read_logical(
+    const hobject_t& hoid, uint64_t off, uint64_t len);
+  using pending_reads_t = std::map<ceph_tid_t, seastar::promise<ECSubReadReply>>;
+  pending_reads_t pending_reads;
+
+  // -- writes --
+  using object_state_t = ec::object_state_t;
+  using write_plan_t = ec::write_plan_t;
+  std::map<hobject_t, object_state_t> objects_in_flight;
+  using shard_txns_t = std::map<shard_id_t, ceph::os::Transaction>;
+
+  interruptible_future<> load_object_state(const hobject_t& hoid);
+  void release_object_states(const std::set<hobject_t>& objects);
+  interruptible_future<int> translate_transaction(
+    ceph::os::Transaction& txn,
+    shard_txns_t& shard_txns,
+    std::set<hobject_t>& objects);
+  /// -EOPNOTSUPP if op is neither a data op nor one applied as is on
+  /// every shard
+  int replicate_op(
+    ceph::os::Transaction::iterator& i,
+    const ceph::os::Transaction::Op* op,
+    shard_txns_t& shard_txns);
+  interruptible_future<> flush_plan(
+    const hobject_t& hoid,
+    write_plan_t& plan,
+    shard_txns_t& shard_txns);
+  /// overwrite existing data, patching the parity with the data delta
+  interruptible_future<bool> write_parity_delta(
+    const hobject_t& hoid,
+    write_plan_t& plan,
+    shard_txns_t& shard_txns);
+  /// read-modify-write the stripes covering the plan's dirty ranges
+  interruptible_future<> write_stripes(
+    const hobject_t& hoid,
+    write_plan_t& plan,
+    shard_txns_t& shard_txns);
+  void emit_shard_writes(
+    const hobject_t& hoid,
+    uint64_t object_size,
+    const ECUtil::shard_extent_map_t& sem,
+    const shard_id_set& shards,
+    shard_txns_t& shard_txns);
+
+  MURef<MOSDECSubOpWrite> new_sub_write_msg(
+    const pg_shard_t &pg_shard,
+    const hobject_t &hoid,
+    const ceph::os::Transaction &txn,
+    const osd_op_params_t &osd_op_p,
+    epoch_t min_epoch,
+    epoch_t map_epoch,
+    const std::vector<pg_log_entry_t> &log_entries,
+    bool send_op,
+    ceph_tid_t tid);
+
+  class pending_on_t : public seastar::weakly_referencable<pending_on_t> {
+  public:
+    pending_on_t(
+      size_t pending,
+      const eversion_t& at_version,
+      const eversion_t& last_complete)
+      : pending{static_cast<unsigned>(pending)},
+	at_version(at_version),
+	last_complete(last_complete)
+    {}
+    unsigned pending;
+    // see ReplicatedBackend::pending_on_t
+    const eversion_t at_version;
+    const eversion_t last_complete;
+    crimson::osd::acked_peers_t acked_peers;
+    seastar::shared_promise<> all_committed;
+  };
+  using pending_transactions_t = std::map<ceph_tid_t, pending_on_t>;
+  pending_transactions_t pending_trans;
+  /// resolves once the previous transaction has been sent to the shards,
+  /// so sub writes leave in version order even if planning had to read
+  seastar::shared_future<> last_submitted{seastar::make_ready_future<>()};
 };
 
 }
@@ -0,0 +1,224 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "ec_planner.h"
+
+#include <cerrno>
+
+namespace crimson::osd::ec {
+
+void plan_write(
+  write_plan_t& plan,
+  object_state_t& st,
+  uint64_t off,
+  uint64_t len,
+  const ceph::bufferlist& bl)
+{
+  if (len == 0) {
+    return;
+  }
+  plan.overlay.insert(off, len, bl);
+  plan.dirty.union_insert(off, len);
+  if (off + len > st.size) {
+    st.size = off + len;
+    plan.resized = true;
+  }
+}
+
+void plan_truncate(
+  const ECUtil::stripe_info_t& sinfo,
+  write_plan_t& plan,
+  object_state_t& st,
+  uint64_t off)
+{
+  if (off < st.size) {
+    const uint64_t len = st.size - off;
+    plan.overlay.erase(off, len);
+    plan.dirty.erase(off, len);
+    st.data.erase(off, len);
+    st.valid_end = std::min(st.valid_end, off);
+    plan.truncate_to = std::min(plan.truncate_to.value_or(off), off);
+    if (off % sinfo.get_stripe_width()) {
+      // the rest of the last stripe is now zeros, its parity must follow
+      plan.dirty.union_insert(
+	off, sinfo.ro_offset_to_next_stripe_ro_offset(off) - off);
+    }
+  }
+  if (off != st.size) {
+    st.size = off;
+    plan.resized = true;
+  }
+}
+
+bool should_write_parity_delta(
+  const ECUtil::stripe_info_t& sinfo,
+  const write_plan_t& plan,
+  const object_state_t& st)
+{
+  // only pure overwrites of data which is on disk, see
+  // ECTransaction::WritePlanObj for the classic heuristic
+  if (!sinfo.supports_parity_delta_writes() ||
+      plan.truncate_to || plan.resized ||
+      st.pending > 1 || !st.data.empty() ||
+      plan.dirty.range_end() > st.valid_end) {
+    return false;
+  }
+  ECUtil::shard_extent_set_t touched(sinfo.get_k_plus_m());
+  for (auto [off, len] : plan.dirty) {
+    sinfo.ro_range_to_shard_extent_set(off, len, touched);
+  }
+  // reads n data shards and m parity shards instead of the k - n others
+  const unsigned n = touched.shard_count();
+  return n + sinfo.get_m() <= sinfo.get_k() - n;
+}
+
+extent_set stripes_to_rewrite(
+  const ECUtil::stripe_info_t& sinfo,
+  const write_plan_t& plan,
+  uint64_t size)
+{
+  extent_set stripes;
+  for (auto [off, len] : plan.dirty) {
+    auto [stripe_off, stripe_len] =
+      sinfo.ro_offset_len_to_stripe_ro_offset_len(off, len);
+    stripes.union_insert(stripe_off, stripe_len);
+  }
+  extent_set in_object;
+  in_object.insert(0, sinfo.ro_offset_to_next_stripe_ro_offset(size));
+  stripes.intersection_of(in_object);
+  return stripes;
+}
+
+extent_set old_data_to_read(
+  const write_plan_t& plan,
+  const object_state_t& st,
+  const extent_set& stripes)
+{
+  extent_set need;
+  if (st.valid_end) {
+    extent_set valid;
+    valid.insert(0, st.valid_end);
+    need.intersection_of(stripes, valid);
+    extent_set known;
+    plan.overlay.to_interval_set(known);
+    st.data.to_interval_set(known);
+    need.subtract(known);
+  }
+  return need;
+}
+
+extent_map assemble_stripes(
+  const write_plan_t& plan,
+  const object_state_t& st,
+  const extent_set& stripes,
+  const extent_map& old_data)
+{
+  extent_map image;
+  for (auto [off, len] : stripes) {
+    ceph::bufferlist zeros;
+    zeros.append_zero(len);
+    image.insert(off, len, std::move(zeros));
+  }
+  image.insert(old_data);
+  for (auto [off, len] : stripes) {
+    image.insert(st.data.intersect(off, len));
+  }
+  image.insert(plan.overlay);
+  return image;
+}
+
+shard_id_set shards_to_rewrite(
+  const ECUtil::stripe_info_t& sinfo,
+  const write_plan_t& plan)
+{
+  shard_id_set shards;
+  if (sinfo.supports_partial_writes()) {
+    ECUtil::shard_extent_set_t touched(sinfo.get_k_plus_m());
+    for (auto [off, len] : plan.dirty) {
+      sinfo.ro_range_to_shard_extent_set(off, len, touched);
+    }
+    shards = touched.get_shard_id_set();
+    shards.insert(sinfo.get_parity_shards());
+  } else {
+    for (shard_id_t s; s < sinfo.get_k_plus_m(); ++s) {
+      shards.insert(s);
+    }
+  }
+  return shards;
+}
+
+int check_transaction(ceph::os::Transaction& txn)
+{
+  using ceph::os::Transaction;
+  for (auto i = txn.begin(); i.have_op(); ) {
+    switch (i.decode_op()->op) {
+    // see ECBackend::translate_transaction() and replicate_op()
+    case Transaction::OP_WRITE:
+    case Transaction::OP_ZERO:
+    case Transaction::OP_TRUNCATE:
+    case Transaction::OP_CLONE:
+    case Transaction::OP_REMOVE:
+    case Transaction::OP_SETALLOCHINT:
+    case Transaction::OP_NOP:
+    case Transaction::OP_CREATE:
+    case Transaction::OP_TOUCH:
+    case Transaction::OP_SETATTR:
+    case Transaction::OP_SETATTRS:
+    case Transaction::OP_RMATTR:
+    case Transaction::OP_RMATTRS:
+    case Transaction::OP_OMAP_CLEAR:
+    case Transaction::OP_OMAP_SETKEYS:
+    case Transaction::OP_OMAP_RMKEYS:
+    case Transaction::OP_OMAP_RMKEYRANGE:
+    case Transaction::OP_OMAP_SETHEADER:
+      break;
+    default:
+      return -EOPNOTSUPP;
+    }
+  }
+  return 0;
+}
+
+ECUtil::shard_extent_set_t extents_to_decode(
+  const ECUtil::stripe_info_t& sinfo,
+  const ECUtil::shard_extent_set_t& want,
+  const shard_id_set& failed)
+{
+  const extent_set rows = want.get_extent_superset();
+  ECUtil::shard_extent_set_t more(sinfo.get_k_plus_m());
+  for (shard_id_t s; s < sinfo.get_k_plus_m(); ++s) {
+    if (failed.contains(s)) {
+      continue;
+    }
+    extent_set eset = rows;
+    if (want.contains(s)) {
+      eset.subtract(want.at(s));
+    }
+    if (!eset.empty()) {
+      more.emplace(s, std::move(eset));
+    }
+  }
+  return more;
+}
+
+int decode_shards(
+  const ECUtil::stripe_info_t& sinfo,
+  const ceph::ErasureCodeInterfaceRef& ec_impl,
+  const ECUtil::shard_extent_set_t& want,
+  const shard_id_set& failed,
+  ECUtil::shard_extent_map_t& out,
+  DoutPrefixProvider *dpp)
+{
+  // whatever was read from a shard before it failed is not trusted
+  for (auto s : failed) {
+    if (out.contains_shard(s)) {
+      out.erase_shard(s);
+    }
+  }
+  if (sinfo.get_k_plus_m() - failed.size() < sinfo.get_k()) {
+    return -EIO;
+  }
+  return out.decode(ec_impl, want, out.get_ro_end(), dpp);
+}
+
+}
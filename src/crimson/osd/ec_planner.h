@@ -0,0 +1,100 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <optional>
+
+#include "erasure-code/ErasureCodeInterface.h"
+#include "include/buffer_fwd.h"
+#include "os/Transaction.h"
+#include "osd/ECUtil.h"
+
+class DoutPrefixProvider;
+
+/*
+ * The planning of ECBackend, apart from its reads and its transactions.
+ * The offsets are logical, in the object, unless they are in a
+ * shard_extent_*_t.
+ */
+namespace crimson::osd::ec {
+
+/// projected state of an object with transactions in flight
+struct object_state_t {
+  uint64_t size = 0;       ///< projected logical size
+  uint64_t valid_end = 0;  ///< shard contents below this are current...
+  extent_map data;         ///< ...unless overwritten by writes in flight
+  unsigned pending = 0;    ///< in-flight transactions touching the object
+};
+
+/// data ops of one object accumulated between two flush points
+struct write_plan_t {
+  extent_map overlay;                  ///< new logical contents
+  extent_set dirty;                    ///< logical ranges to re-encode
+  std::optional<uint64_t> truncate_to; ///< lowest truncation point
+  bool resized = false;                ///< object size changed
+};
+
+// -- writes --
+void plan_write(
+  write_plan_t& plan,
+  object_state_t& st,
+  uint64_t off,
+  uint64_t len,
+  const ceph::bufferlist& bl);
+void plan_truncate(
+  const ECUtil::stripe_info_t& sinfo,
+  write_plan_t& plan,
+  object_state_t& st,
+  uint64_t off);
+/// whether patching the parity with the data delta reads less than
+/// rewriting the stripes
+bool should_write_parity_delta(
+  const ECUtil::stripe_info_t& sinfo,
+  const write_plan_t& plan,
+  const object_state_t& st);
+/// the stripes to re-encode, up to the projected end of the object
+extent_set stripes_to_rewrite(
+  const ECUtil::stripe_info_t& sinfo,
+  const write_plan_t& plan,
+  uint64_t size);
+/// the old contents of the stripes to read back, those neither overwritten
+/// by the plan nor in flight
+extent_set old_data_to_read(
+  const write_plan_t& plan,
+  const object_state_t& st,
+  const extent_set& stripes);
+/// the new contents of the stripes: zeros < old data < in flight < plan
+extent_map assemble_stripes(
+  const write_plan_t& plan,
+  const object_state_t& st,
+  const extent_set& stripes,
+  const extent_map& old_data);
+/// the shards written when re-encoding the stripes
+shard_id_set shards_to_rewrite(
+  const ECUtil::stripe_info_t& sinfo,
+  const write_plan_t& plan);
+/// 0, or -EOPNOTSUPP if txn has an op ECBackend can't turn into shard ops
+int check_transaction(ceph::os::Transaction& txn);
+
+// -- reads --
+/// the rows of want to read from the shards left, parity included, to
+/// rebuild the failed ones
+ECUtil::shard_extent_set_t extents_to_decode(
+  const ECUtil::stripe_info_t& sinfo,
+  const ECUtil::shard_extent_set_t& want,
+  const shard_id_set& failed);
+/**
+ * Rebuild the shards of want which failed from the others read into out.
+ * Returns -EIO if fewer than k shards are left, or the error of the
+ * plugin.
+ */
+int decode_shards(
+  const ECUtil::stripe_info_t& sinfo,
+  const ceph::ErasureCodeInterfaceRef& ec_impl,
+  const ECUtil::shard_extent_set_t& want,
+  const shard_id_set& failed,
+  ECUtil::shard_extent_map_t& out,
+  DoutPrefixProvider *dpp = nullptr);
+
+}
@@ -34,6 +34,7 @@
 
 #include "os/Transaction.h"
 #include "osd/ClassHandler.h"
+#include "erasure-code/ErasureCodePlugin.h"
 #include "osd/OSDCap.h"
 #include "osd/PGPeeringEvent.h"
 #include "osd/PeeringState.h"
@@ -54,6 +55,7 @@
 #include "crimson/osd/pg_backend.h"
 #include "crimson/osd/pg_meta.h"
 #include "crimson/osd/osd_operations/client_request.h"
+#include "crimson/osd/osd_operations/ec_subrequest.h"
 #include "crimson/osd/osd_operations/peering_event.h"
 #include "crimson/osd/osd_operations/pgpct_request.h"
 #include "crimson/osd/osd_operations/pg_advance_map.h"
@@ -144,6 +146,17 @@ OSD::OSD(int id, uint32_t nonce,
 	   cpp_strerror(r));
     }
   }
+  {
+    // so that ECBackend does not dlopen() plugins on the reactors
+    std::stringstream ss;
+    const int r = ceph::ErasureCodePluginRegistry::instance().preload(
+      local_conf().get_val<std::string>("osd_erasure_code_plugins"),
+      local_conf().get_val<std::string>("erasure_code_dir"),
+      &ss);
+    if (r) {
+      WARN("warning: got an error loading erasure code plugins: {}", ss.str());
+    }
+  }
   INFO("nonce is {}", nonce);
   monc->set_log_client(&log_client);
   clog->set_log_to_monitors(true);
@@ -989,6 +1002,14 @@ OSD::do_ms_dispatch(
     return handle_rep_op(conn, boost::static_pointer_cast<MOSDRepOp>(m));
   case MSG_OSD_REPOPREPLY:
     return handle_rep_op_reply(conn, boost::static_pointer_cast<MOSDRepOpReply>(m));
+  case MSG_OSD_EC_WRITE:
+    [[fallthrough]];
+  case MSG_OSD_EC_WRITE_REPLY:
+    [[fallthrough]];
+  case MSG_OSD_EC_READ:
+    [[fallthrough]];
+  case MSG_OSD_EC_READ_REPLY:
+    return handle_ec_subop(conn, boost::static_pointer_cast<MOSDFastDispatchOp>(m));
   case MSG_OSD_SCRUB2:
     return handle_scrub_command(
       conn, boost::static_pointer_cast<MOSDScrub2>(m));
@@ -1415,6 +1436,15 @@ seastar::future<> OSD::handle_rep_op_reply(
     std::move(m));
 }
 
+seastar::future<> OSD::handle_ec_subop(
+  crimson::net::ConnectionRef conn,
+  Ref<MOSDFastDispatchOp> m)
+{
+  return pg_shard_manager.start_pg_operation_active<ECSubRequest>(
+    std::move(conn),
+    std::move(m));
+}
+
 seastar::future<> OSD::handle_scrub_command(
   crimson::net::ConnectionRef conn,
   Ref<MOSDScrub2> m)
@@ -209,6 +209,8 @@ private:
                                   Ref<MOSDRepOp> m);
   seastar::future<> handle_rep_op_reply(crimson::net::ConnectionRef conn,
                                         Ref<MOSDRepOpReply> m);
+  seastar::future<> handle_ec_subop(crimson::net::ConnectionRef conn,
+                                    Ref<MOSDFastDispatchOp> m);
   seastar::future<> handle_peering_op(crimson::net::ConnectionRef conn,
                                       Ref<MOSDPeeringOp> m);
   seastar::future<> handle_pg_remove(crimson::net::ConnectionRef conn,
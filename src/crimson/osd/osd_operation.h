@@ -106,6 +106,7 @@ enum class OperationTypeCode {
   scrub_reserve_range,
   scrub_scan,
   pgpct_request,
+  ec_subrequest,
   last_op
 };
 
@@ -131,6 +132,7 @@ static constexpr const char* const OP_NAMES[] = {
   "scrub_reserve_range",
   "scrub_scan",
   "pgpct_request",
+  "ec_subrequest",
 };
 
 // prevent the addition of OperationTypeCode-s with no matching OP_NAMES entry:
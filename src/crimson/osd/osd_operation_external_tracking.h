@@ -7,6 +7,7 @@
 #include "crimson/osd/osdmap_gate.h"
 #include "crimson/osd/osd_operations/background_recovery.h"
 #include "crimson/osd/osd_operations/client_request.h"
+#include "crimson/osd/osd_operations/ec_subrequest.h"
 #include "crimson/osd/osd_operations/peering_event.h"
 #include "crimson/osd/osd_operations/pgpct_request.h"
 #include "crimson/osd/osd_operations/pg_advance_map.h"
@@ -343,6 +344,13 @@ struct EventBackendRegistry<osd::PGPCTRequest> {
   }
 };
 
+template <>
+struct EventBackendRegistry<osd::ECSubRequest> {
+  static std::tuple<> get_backends() {
+    return {/* no extenral backends */};
+  }
+};
+
 
 template <>
 struct EventBackendRegistry<osd::RecoverySubRequest> {
@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "ec_subrequest.h"
+
+#include "common/Formatter.h"
+
+#include "crimson/common/coroutine.h"
+#include "crimson/osd/ec_backend.h"
+#include "crimson/osd/osd.h"
+#include "crimson/osd/osd_connection_priv.h"
+#include "crimson/osd/osd_operation_external_tracking.h"
+#include "crimson/osd/pg.h"
+#include "messages/MOSDECSubOpRead.h"
+#include "messages/MOSDECSubOpReadReply.h"
+#include "messages/MOSDECSubOpWrite.h"
+#include "messages/MOSDECSubOpWriteReply.h"
+
+namespace {
+  seastar::logger& logger() {
+    return crimson::get_logger(ceph_subsys_osd);
+  }
+}
+
+SET_SUBSYS(osd);
+
+namespace crimson::osd {
+
+ECSubRequest::ECSubRequest(crimson::net::ConnectionRef&& conn,
+			   Ref<MOSDFastDispatchOp> &&req)
+  : RemoteOperation{std::move(conn)},
+    req{std::move(req)}
+{}
+
+void ECSubRequest::print(std::ostream& os) const
+{
+  os << "ECSubRequest("
+     << "req=" << *req
+     << ")";
+}
+
+void ECSubRequest::dump_detail(Formatter *f) const
+{
+  f->open_object_section("ECSubRequest");
+  f->dump_stream("pgid") << req->get_spg();
+  f->dump_unsigned("map_epoch", req->get_map_epoch());
+  f->dump_unsigned("min_epoch", req->get_min_epoch());
+  f->dump_int("type", req->get_type());
+  f->close_section();
+}
+
+ConnectionPipeline &ECSubRequest::get_connection_pipeline()
+{
+  return get_osd_priv(&get_connection()
+  ).replicated_request_conn_pipeline;
+}
+
+PerShardPipeline &ECSubRequest::get_pershard_pipeline(
+    ShardServices &shard_services)
+{
+  return shard_services.get_replicated_request_pipeline();
+}
+
+PGRepopPipeline &ECSubRequest::repop_pipeline(PG &pg)
+{
+  return pg.repop_pipeline;
+}
+
+ECBackend &ECSubRequest::get_backend(PG &pg)
+{
+  return static_cast<ECBackend&>(pg.get_backend());
+}
+
+ECSubRequest::interruptible_future<> ECSubRequest::do_sub_write(
+  Ref<PG> pg)
+{
+  auto m = boost::static_pointer_cast<MOSDECSubOpWrite>(req);
+  co_await this->template enter_stage<interruptor>(repop_pipeline(*pg).process);
+  co_await interruptor::make_interruptible(this->template with_blocking_event<
+    PG_OSDMapGate::OSDMapBlocker::BlockingEvent
+    >([this, pg](auto &&trigger) {
+      return pg->osdmap_gate.wait_for_map(
+	std::move(trigger), req->get_min_epoch());
+    }));
+
+  if (pg->can_discard_replica_op(*m)) {
+    co_return;
+  }
+
+  auto [commit_fut, reply] = co_await get_backend(*pg).handle_sub_write(m);
+
+  // Transitions from OrderedExclusive->OrderedConcurrent cannot block
+  this->enter_stage_sync(repop_pipeline(*pg).wait_commit);
+
+  co_await std::move(commit_fut);
+
+  co_await this->template enter_stage<interruptor>(
+    repop_pipeline(*pg).send_reply);
+
+  co_await interruptor::make_interruptible(
+    pg->shard_services.send_to_osd(
+      m->op.from.osd, std::move(reply), pg->get_osdmap_epoch())
+  );
+}
+
+ECSubRequest::interruptible_future<> ECSubRequest::do_sub_read(
+  Ref<PG> pg)
+{
+  auto m = boost::static_pointer_cast<MOSDECSubOpRead>(req);
+  // reads do not have to be ordered against the writes in the repop
+  // pipeline, the primary only reads what is committed on the shards
+  co_await interruptor::make_interruptible(this->template with_blocking_event<
+    PG_OSDMapGate::OSDMapBlocker::BlockingEvent
+    >([this, pg](auto &&trigger) {
+      return pg->osdmap_gate.wait_for_map(
+	std::move(trigger), req->get_min_epoch());
+    }));
+
+  if (pg->can_discard_replica_op(*m)) {
+    co_return;
+  }
+
+  auto reply = co_await get_backend(*pg).handle_sub_read(m);
+  co_await interruptor::make_interruptible(
+    pg->shard_services.send_to_osd(
+      m->op.from.osd, std::move(reply), pg->get_osdmap_epoch())
+  );
+}
+
+ECSubRequest::interruptible_future<> ECSubRequest::with_pg_interruptible(
+  Ref<PG> pg)
+{
+  LOG_PREFIX(ECSubRequest::with_pg_interruptible);
+  DEBUGI("{}", *this);
+  switch (req->get_type()) {
+  case MSG_OSD_EC_WRITE:
+    co_await do_sub_write(pg);
+    break;
+  case MSG_OSD_EC_READ:
+    co_await do_sub_read(pg);
+    break;
+  case MSG_OSD_EC_WRITE_REPLY:
+    if (!pg->can_discard_replica_op(*req)) {
+      auto m = boost::static_pointer_cast<MOSDECSubOpWriteReply>(req);
+      get_backend(*pg).handle_sub_write_reply(m->op);
+    }
+    break;
+  case MSG_OSD_EC_READ_REPLY:
+    if (!pg->can_discard_replica_op(*req)) {
+      auto m = boost::static_pointer_cast<MOSDECSubOpReadReply>(req);
+      get_backend(*pg).handle_sub_read_reply(std::move(m->op));
+    }
+    break;
+  default:
+    ceph_abort_msg("unexpected erasure code sub op");
+  }
+}
+
+seastar::future<> ECSubRequest::with_pg(
+  ShardServices &shard_services, Ref<PG> pg)
+{
+  LOG_PREFIX(ECSubRequest::with_pg);
+  DEBUGI("{}", *this);
+  IRef ref = this;
+  return interruptor::with_interruption([this, pg] {
+    return with_pg_interruptible(pg);
+  }, [](std::exception_ptr) {
+    return seastar::now();
+  }, pg, pg->get_osdmap_epoch()
+  ).finally([this, pg, ref=std::move(ref)]() mutable {
+    logger().debug("{}: exit", *this);
+    return handle.complete(
+    ).finally([ref=std::move(ref), pg=std::move(pg)] {});
+  });
+}
+
+}
@@ -37,6 +37,7 @@
 #include "crimson/net/Messenger.h"
 #include "crimson/os/cyanstore/cyan_store.h"
 #include "crimson/os/futurized_collection.h"
+#include "crimson/osd/ec_backend.h"
 #include "crimson/osd/exceptions.h"
 #include "crimson/osd/pg_meta.h"
 #include "crimson/osd/pg_backend.h"
@@ -92,6 +93,31 @@ public:
   }
 };
 
+// any k distinct shards are enough to rebuild an erasure coded object
+class ECRecoverablePredicate : public IsPGRecoverablePredicate {
+  unsigned k;
+public:
+  explicit ECRecoverablePredicate(unsigned k) : k(k) {}
+  bool operator()(const set<pg_shard_t> &have) const override {
+    set<shard_id_t> shards;
+    for (auto &pg_shard : have) {
+      shards.insert(pg_shard.shard);
+    }
+    return shards.size() >= k;
+  }
+};
+
+class ECReadablePredicate: public IsPGReadablePredicate {
+  pg_shard_t whoami;
+  ECRecoverablePredicate recoverable;
+public:
+  ECReadablePredicate(pg_shard_t whoami, unsigned k)
+    : whoami(whoami), recoverable(k) {}
+  bool operator()(const set<pg_shard_t> &have) const override {
+    return have.count(whoami) && recoverable(have);
+  }
+};
+
 PG::PG(
   spg_t pgid,
   pg_shard_t pg_shard,
@@ -156,9 +182,16 @@ PG::PG(
     wait_for_active_blocker(this)
 {
   scrubber.initiate();
-  peering_state.set_backend_predicates(
-    new ReadablePredicate(pg_whoami),
-    new RecoverablePredicate());
+  if (peering_state.get_pgpool().info.is_erasure()) {
+    const auto k = static_cast<ECBackend&>(*backend).get_k();
+    peering_state.set_backend_predicates(
+      new ECReadablePredicate(pg_whoami, k),
+      new ECRecoverablePredicate(k));
+  } else {
+    peering_state.set_backend_predicates(
+      new ReadablePredicate(pg_whoami),
+      new RecoverablePredicate());
+  }
   osdmap_gate.got_map(osdmap->get_epoch());
 }
 
@@ -397,6 +430,22 @@ void PG::on_activate_complete()
    * have recorded the current interval.  At that point, the PG may either become
    * ACTIVE or PEERED, depending on whether the acting set is eligible for client
    * IO.  Only unblock wait_for_active_blocker if we actually became ACTIVE */
+  if (peering_state.get_pgpool().info.is_erasure() &&
+      (peering_state.needs_recovery() || peering_state.needs_backfill())) {
+    logger().error("{}: erasure coded pg {} needs recovery or backfill,"
+		   " which is not supported, reporting it down",
+		   __func__, pgid);
+    // the recovery backend pushes whole objects, it would clobber the
+    // shards.  Report the PG down rather than active, so the cluster
+    // sees it can't serve ops; the next interval clears the state and
+    // peers again.
+    peering_state.state_clear(PG_STATE_ACTIVE);
+    peering_state.state_clear(PG_STATE_PEERED);
+    peering_state.state_set(PG_STATE_DOWN);
+    publish_stats_to_osd();
+    recovery_handler->on_activate_complete();
+    return;
+  }
   if (peering_state.is_active()) {
     wait_for_active_blocker.unblock();
   }
@@ -969,6 +1018,15 @@ PG::submit_transaction(
         interruptor::now());
   }
 
+  if (int r = backend->check_transaction(txn); r < 0) {
+    logger().error("{}: {} can't submit the transaction of {}: r={}",
+		   *this, __func__, obc->obs.oi.soid, r);
+    co_return std::make_tuple(
+        interruptor::make_interruptible(seastar::make_exception_future<>(
+          std::system_error(-r, std::generic_category()))),
+        interruptor::now());
+  }
+
   epoch_t map_epoch = get_osdmap_epoch();
   auto at_version = osd_op_p.at_version;
 
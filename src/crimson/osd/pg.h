@@ -992,6 +992,7 @@ private:
   friend class WatchTimeoutRequest;
   friend class SnapTrimEvent;
   friend class SnapTrimObjSubEvent;
+  friend class ECSubRequest;
 private:
 
   void enqueue_push_for_backfill(
@@ -1032,6 +1033,7 @@ private:
 private:
   friend class IOInterruptCondition;
   friend class ReplicatedBackend;
+  friend class ECBackend;
   struct log_update_t {
     std::set<pg_shard_t> waiting_on;
     seastar::shared_promise<> all_committed;
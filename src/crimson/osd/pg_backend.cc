@@ -61,9 +61,9 @@ PGBackend::create(pg_t pgid,
 					       coll, shard_services,
 					       dpp);
   case pg_pool_t::TYPE_ERASURE:
-    return std::make_unique<ECBackend>(pg_shard.shard, coll, shard_services,
-                                       std::move(ec_profile),
-                                       pool.stripe_width,
+    return std::make_unique<ECBackend>(pgid, pg_shard, pg,
+				       coll, shard_services,
+				       ec_profile, pool,
 				       dpp);
   default:
     throw runtime_error(seastar::format("unsupported pool type '{}'",
@@ -255,6 +255,29 @@ PGBackend::sparse_read(const ObjectState& os, OSDOp& osd_op,
   }
   logger().trace("sparse_read: {} {}~{}",
                  os.oi.soid, (uint64_t)op.extent.offset, (uint64_t)op.extent.length);
+  if (!supports_sparse_reads()) {
+    // the local object only holds a shard, report the whole range as data
+    return _read(os.oi.soid, offset, adjusted_length, op.flags
+    ).safe_then_interruptible_tuple(
+      [&delta_stats, &os, &osd_op, offset](auto&& bl) -> read_errorator::future<> {
+      if (!_read_verify_data(os.oi, bl)) {
+        return crimson::ct_error::object_corrupted::make();
+      }
+      std::map<uint64_t, uint64_t> extents;
+      if (bl.length()) {
+        extents.emplace(offset, bl.length());
+      }
+      osd_op.op.extent.length = bl.length();
+      ceph::encode(extents, osd_op.outdata);
+      encode_destructively(bl, osd_op.outdata);
+      delta_stats.num_rd++;
+      delta_stats.num_rd_kb += shift_round_up(osd_op.op.extent.length, 10);
+      return read_errorator::make_ready_future<>();
+    }, crimson::ct_error::input_output_error::handle([] {
+      return read_errorator::future<>{crimson::ct_error::object_corrupted::make()};
+    }),
+    read_errorator::pass_further{});
+  }
   return interruptor::make_interruptible(store->fiemap(coll, ghobject_t{os.oi.soid},
     offset, adjusted_length)).safe_then_interruptible(
     [&delta_stats, &os, &osd_op, this](auto&& m) {
@@ -1132,7 +1155,7 @@ PGBackend::getxattr(
   const hobject_t& soid,
   std::string_view key) const
 {
-  return store->get_attr(coll, ghobject_t{soid}, key);
+  return store->get_attr(coll, ghobject_t{soid, ghobject_t::NO_GEN, shard}, key);
 }
 
 PGBackend::get_attr_ierrorator::future<ceph::bufferlist>
@@ -1141,7 +1164,7 @@ PGBackend::getxattr(
   std::string&& key) const
 {
   return seastar::do_with(key, [this, &soid](auto &key) {
-    return store->get_attr(coll, ghobject_t{soid}, key);
+    return store->get_attr(coll, ghobject_t{soid, ghobject_t::NO_GEN, shard}, key);
   });
 }
 
@@ -1150,7 +1173,7 @@ PGBackend::get_attr_ierrorator::future<> PGBackend::get_xattrs(
   OSDOp& osd_op,
   object_stat_sum_t& delta_stats) const
 {
-  return store->get_attrs(coll, ghobject_t{os.oi.soid}).safe_then(
+  return store->get_attrs(coll, ghobject_t{os.oi.soid, ghobject_t::NO_GEN, shard}).safe_then(
     [&delta_stats, &osd_op](auto&& attrs) {
     std::vector<std::pair<std::string, bufferlist>> user_xattrs;
     ceph::bufferlist bl;
@@ -1309,7 +1332,7 @@ maybe_get_omap_vals_by_keys(
   const std::set<std::string>& keys_to_get)
 {
   if (oi.is_omap()) {
-    return store->omap_get_values(coll, ghobject_t{oi.soid}, keys_to_get);
+    return store->omap_get_values(coll, ghobject_t{oi.soid, ghobject_t::NO_GEN, shard}, keys_to_get);
   } else {
     return crimson::ct_error::enodata::make();
   }
@@ -1329,7 +1352,7 @@ maybe_do_omap_iterate(
   omap_iterate_cb_t callback)
 {
   if (oi.is_omap()) {
-    return store->omap_iterate(coll, ghobject_t{oi.soid}, start_from, callback);
+    return store->omap_iterate(coll, ghobject_t{oi.soid, ghobject_t::NO_GEN, shard}, start_from, callback);
   } else {
     return crimson::ct_error::enodata::make();
   }
@@ -1359,7 +1382,7 @@ PGBackend::omap_get_header(
 {
   if (os.oi.is_omap()) {
     return omap_get_header(
-      coll, ghobject_t{os.oi.soid}, CEPH_OSD_OP_FLAG_FADVISE_DONTNEED
+      coll, ghobject_t{os.oi.soid, ghobject_t::NO_GEN, shard}, CEPH_OSD_OP_FLAG_FADVISE_DONTNEED
     ).safe_then_interruptible(
       [&delta_stats, &osd_op] (ceph::bufferlist&& header) {
         osd_op.outdata = std::move(header);
@@ -1493,7 +1516,7 @@ PGBackend::omap_cmp(
     for (auto &i: assertions) {
       to_get.insert(i.first);
     }
-    return store->omap_get_values(coll, ghobject_t{os.oi.soid}, to_get)
+    return store->omap_get_values(coll, ghobject_t{os.oi.soid, ghobject_t::NO_GEN, shard}, to_get)
       .safe_then([=, &osd_op] (auto&& out) -> omap_cmp_iertr::future<> {
       osd_op.rval = 0;
       return  do_omap_val_cmp(out, assertions);
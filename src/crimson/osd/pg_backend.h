@@ -422,6 +422,11 @@ public:
     const hobject_t &to,
     ceph::os::Transaction& trans);
 
+  /// 0, or the error to fail a transaction with whose ops the backend
+  /// can't submit, before it is logged
+  virtual int check_transaction(ceph::os::Transaction& txn) const {
+    return 0;
+  }
   virtual rep_op_fut_t
   submit_transaction(const std::set<pg_shard_t> &pg_shards,
 		     const hobject_t& hoid,
@@ -454,6 +459,11 @@ public:
     const hobject_t &oid);
 
 private:
+  /// whether objects in the local store map 1:1 to logical objects, so
+  /// that their allocated extents can be reported as is
+  virtual bool supports_sparse_reads() const {
+    return true;
+  }
   virtual ll_read_ierrorator::future<ceph::bufferlist> _read(
     const hobject_t& hoid,
     size_t offset,
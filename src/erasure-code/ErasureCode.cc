@@ -478,6 +478,33 @@ int ErasureCode::decode(const shard_id_set &want_to_read,
   return _decode(want_to_read, chunks, decoded);
 }
 
+int ErasureCode::encode_chunks_batch(
+  const vector<shard_id_map<bufferptr>> &in,
+  vector<shard_id_map<bufferptr>> &out)
+{
+  ceph_assert(in.size() == out.size());
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (int r = encode_chunks(in[i], out[i]); r) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+int ErasureCode::decode_chunks_batch(
+  const shard_id_set &want_to_read,
+  vector<shard_id_map<bufferptr>> &in,
+  vector<shard_id_map<bufferptr>> &out)
+{
+  ceph_assert(in.size() == out.size());
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (int r = decode_chunks(want_to_read, in[i], out[i]); r) {
+      return r;
+    }
+  }
+  return 0;
+}
+
 int ErasureCode::parse(const ErasureCodeProfile &profile,
 		       ostream *ss)
 {
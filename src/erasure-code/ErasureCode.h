@@ -160,6 +160,15 @@ class ErasureCode : public ErasureCodeInterface {
   int decode_concat(const std::map<int, bufferlist> &chunks,
                     bufferlist *decoded) override;
 
+  int encode_chunks_batch(
+    const std::vector<shard_id_map<bufferptr>> &in,
+    std::vector<shard_id_map<bufferptr>> &out) override;
+
+  int decode_chunks_batch(
+    const shard_id_set &want_to_read,
+    std::vector<shard_id_map<bufferptr>> &in,
+    std::vector<shard_id_map<bufferptr>> &out) override;
+
   void encode_delta(const bufferptr &old_data,
                     const bufferptr &new_data,
                     bufferptr *delta_maybe_in_place) override {
@@ -448,6 +448,25 @@ namespace ceph {
     virtual int encode_chunks(const shard_id_map<bufferptr> &in,
                               shard_id_map<bufferptr> &out) = 0;
 
+    /**
+     * Encode a batch of slices, typically the stripes of a large write
+     * whose shard buffers are not contiguous.  This is equivalent to
+     * calling encode_chunks(in[i], out[i]) for every i, but the plugin
+     * only sets up once for the whole batch (tables, zero buffers...).
+     *
+     * The buffers of a slice follow the rules of encode_chunks and all
+     * have the same size, slices may have different sizes.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] in data shards of each slice to be encoded
+     * @param [out] out parity buffers of each slice to be written to
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_chunks_batch(
+      const std::vector<shard_id_map<bufferptr>> &in,
+      std::vector<shard_id_map<bufferptr>> &out) = 0;
+
     /**
      * Calculate the delta between the old_data and new_data buffers using xor,
      * (or plugin-specific implementation) and returns the result in the
@@ -571,6 +590,24 @@ namespace ceph {
                               shard_id_map<bufferptr> &in,
                               shard_id_map<bufferptr> &out) = 0;
 
+    /**
+     * Decode a batch of slices.  This is equivalent to calling
+     * decode_chunks(want_to_read, in[i], out[i]) for every i, but the
+     * plugin may reuse its decoding tables for all the slices missing
+     * the same shards.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] want_to_read shard indexes to be decoded
+     * @param [in] in available shards of each slice
+     * @param [out] out shards of each slice to be decoded
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int decode_chunks_batch(
+      const shard_id_set &want_to_read,
+      std::vector<shard_id_map<bufferptr>> &in,
+      std::vector<shard_id_map<bufferptr>> &out) = 0;
+
     [[deprecated]]
     virtual int decode_chunks(const std::set<int> &want_to_read,
                               const std::map<int, bufferlist> &chunks,
@@ -115,8 +115,10 @@ int ErasureCodeIsa::decode_chunks(const set<int> &want_to_read,
   return isa_decode(erasures, data, coding, blocksize);
 }
 
-int ErasureCodeIsa::encode_chunks(const shard_id_map<bufferptr> &in,
-                                       shard_id_map<bufferptr> &out)
+int ErasureCodeIsa::encode_slice(const shard_id_map<bufferptr> &in,
+                                 shard_id_map<bufferptr> &out,
+                                 char **zeros,
+                                 uint64_t *zeros_size)
 {
   char *chunks[k + m]; //TODO don't use variable length arrays
   memset(chunks, 0, sizeof(char*) * (k + m));
@@ -140,33 +142,55 @@ int ErasureCodeIsa::encode_chunks(const shard_id_map<bufferptr> &in,
     chunks[static_cast<int>(shard)] = ptr.c_str();
   }
 
-  char *zeros = nullptr;
-
   for (shard_id_t i; i < k + m; ++i) {
     if (in.contains(i) || out.contains(i)) {
       continue;
     }
 
-    if (zeros == nullptr) {
-      zeros = (char*)malloc(size);
-      memset(zeros, 0, size);
+    // the zero buffer is kept across the slices of a batch
+    if (*zeros_size < size) {
+      free(*zeros);
+      *zeros = (char*)malloc(size);
+      memset(*zeros, 0, size);
+      *zeros_size = size;
     }
 
-    chunks[static_cast<int>(i)] = zeros;
+    chunks[static_cast<int>(i)] = *zeros;
   }
 
   isa_encode(&chunks[0], &chunks[k], size);
-
-  if (zeros != nullptr) {
-    free(zeros);
-  }
-
   return 0;
 }
 
-int ErasureCodeIsa::decode_chunks(const shard_id_set &want_to_read,
-                                  shard_id_map<bufferptr> &in,
+int ErasureCodeIsa::encode_chunks(const shard_id_map<bufferptr> &in,
                                   shard_id_map<bufferptr> &out)
+{
+  char *zeros = nullptr;
+  uint64_t zeros_size = 0;
+  int r = encode_slice(in, out, &zeros, &zeros_size);
+  free(zeros);
+  return r;
+}
+
+int ErasureCodeIsa::encode_chunks_batch(
+  const vector<shard_id_map<bufferptr>> &in,
+  vector<shard_id_map<bufferptr>> &out)
+{
+  ceph_assert(in.size() == out.size());
+  char *zeros = nullptr;
+  uint64_t zeros_size = 0;
+  int r = 0;
+  for (size_t i = 0; i < in.size() && r == 0; ++i) {
+    r = encode_slice(in[i], out[i], &zeros, &zeros_size);
+  }
+  free(zeros);
+  return r;
+}
+
+int ErasureCodeIsa::decode_slice(const shard_id_set &want_to_read,
+                                 shard_id_map<bufferptr> &in,
+                                 shard_id_map<bufferptr> &out,
+                                 decode_tables_t *tables)
 {
   unsigned int size = 0;
   shard_id_set erasures_set;
@@ -232,7 +256,7 @@ int ErasureCodeIsa::decode_chunks(const shard_id_set &want_to_read,
 
   erasures[erasures_count] = -1;
   ceph_assert(erasures_count > 0);
-  int r = isa_decode(erasures, data, coding, size);
+  int r = isa_decode(erasures, data, coding, size, tables);
   for (auto & shard : to_free) {
     int i = static_cast<int>(shard);
     char **buf = i < k ? &data[i] : &coding[i - k];
@@ -242,6 +266,28 @@ int ErasureCodeIsa::decode_chunks(const shard_id_set &want_to_read,
   return r;
 }
 
+int ErasureCodeIsa::decode_chunks(const shard_id_set &want_to_read,
+                                  shard_id_map<bufferptr> &in,
+                                  shard_id_map<bufferptr> &out)
+{
+  return decode_slice(want_to_read, in, out, nullptr);
+}
+
+int ErasureCodeIsa::decode_chunks_batch(
+  const shard_id_set &want_to_read,
+  vector<shard_id_map<bufferptr>> &in,
+  vector<shard_id_map<bufferptr>> &out)
+{
+  ceph_assert(in.size() == out.size());
+  decode_tables_t tables;
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (int r = decode_slice(want_to_read, in[i], out[i], &tables); r) {
+      return r;
+    }
+  }
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 
 void
@@ -372,7 +418,8 @@ int
 ErasureCodeIsaDefault::isa_decode(int *erasures,
                                   char **data,
                                   char **coding,
-                                  int blocksize)
+                                  int blocksize,
+                                  decode_tables_t *tables)
 {
   int nerrs = 0;
   int i, r, s;
@@ -455,6 +502,15 @@ ErasureCodeIsaDefault::isa_decode(int *erasures,
     return 0;
   }
 
+  // The previous slice of a batch lost the same shards
+  if (tables && !tables->tbls.empty() &&
+      std::equal(erasures, erasures + nerrs,
+                 tables->erasures.begin(), tables->erasures.end())) {
+    ec_encode_data(blocksize, k, nerrs, tables->tbls.data(),
+                   recover_source, recover_target);
+    return 0;
+  }
+
   unsigned char d[k * (m + k)];
   unsigned char decode_tbls[k * (m + k)*32];
   unsigned char *p_tbls = decode_tbls;
@@ -539,6 +595,10 @@ ErasureCodeIsaDefault::isa_decode(int *erasures,
     ec_init_tables(k, nerrs, c, decode_tbls);
     tcache.putDecodingTableToCache(erasure_signature, p_tbls, matrixtype, k, m);
   }
+  if (tables) {
+    tables->erasures.assign(erasures, erasures + nerrs);
+    tables->tbls.assign(decode_tbls, decode_tbls + sizeof(decode_tbls));
+  }
   // Recover data sources
   ec_encode_data(blocksize,
                  k, nerrs, decode_tbls, recover_source, recover_target);
@@ -107,6 +107,8 @@ public:
                     std::map<int, ceph::buffer::list> *encoded) override;
   int encode_chunks(const shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  int encode_chunks_batch(const std::vector<shard_id_map<bufferptr>> &in,
+                          std::vector<shard_id_map<bufferptr>> &out) override;
 
   [[deprecated]]
   int decode_chunks(const std::set<int> &want_to_read,
@@ -115,6 +117,9 @@ public:
   int decode_chunks(const shard_id_set &want_to_read,
                     shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  int decode_chunks_batch(const shard_id_set &want_to_read,
+                          std::vector<shard_id_map<bufferptr>> &in,
+                          std::vector<shard_id_map<bufferptr>> &out) override;
 
   int init(ceph::ErasureCodeProfile &profile, std::ostream *ss) override;
 
@@ -126,10 +131,17 @@ public:
                           char **coding,
                           int blocksize) = 0;
 
+  /// decoding tables kept across the slices of a batch decode
+  struct decode_tables_t {
+    std::vector<int> erasures; ///< the erasures the tables decode
+    std::vector<unsigned char> tbls;
+  };
+
   virtual int isa_decode(int *erasures,
                          char **data,
                          char **coding,
-                         int blocksize) = 0;
+                         int blocksize,
+                         decode_tables_t *tables = nullptr) = 0;
 
   virtual unsigned get_alignment() const = 0;
 
@@ -138,6 +150,15 @@ public:
  private:
   virtual int parse(ceph::ErasureCodeProfile &profile,
                     std::ostream *ss) = 0;
+
+  int encode_slice(const shard_id_map<bufferptr> &in,
+                   shard_id_map<bufferptr> &out,
+                   char **zeros,
+                   uint64_t *zeros_size);
+  int decode_slice(const shard_id_set &want_to_read,
+                   shard_id_map<bufferptr> &in,
+                   shard_id_map<bufferptr> &out,
+                   decode_tables_t *tables);
 };
 
 // -----------------------------------------------------------------------------
@@ -178,7 +199,8 @@ public:
   int isa_decode(int *erasures,
                          char **data,
                          char **coding,
-                         int blocksize) override;
+                         int blocksize,
+                         decode_tables_t *tables = nullptr) override;
 
   void encode_delta(const ceph::bufferptr &old_data,
                     const ceph::bufferptr &new_data,
@@ -38,6 +38,7 @@ extern "C" {
 using std::ostream;
 using std::map;
 using std::set;
+using std::vector;
 
 using ceph::bufferlist;
 using ceph::ErasureCodeProfile;
@@ -114,8 +115,10 @@ int ErasureCodeJerasure::encode_chunks(const set<int> &want_to_encode,
   return 0;
 }
 
-int ErasureCodeJerasure::encode_chunks(const shard_id_map<bufferptr> &in,
-                                       shard_id_map<bufferptr> &out)
+int ErasureCodeJerasure::encode_slice(const shard_id_map<bufferptr> &in,
+                                      shard_id_map<bufferptr> &out,
+                                      char **zeros,
+                                      uint64_t *zeros_size)
 {
   char *chunks[k + m]; //TODO don't use variable length arrays
   memset(chunks, 0, sizeof(char*) * (k + m));
@@ -139,26 +142,50 @@ int ErasureCodeJerasure::encode_chunks(const shard_id_map<bufferptr> &in,
     chunks[static_cast<int>(shard)] = ptr.c_str();
   }
 
-  char *zeros = nullptr;
-
   for (shard_id_t i; i < k + m; ++i) {
     if (in.contains(i) || out.contains(i)) continue;
 
-    if (zeros == nullptr) {
-      zeros = (char*)malloc(size);
-      memset(zeros, 0, size);
+    // the zero buffer is kept across the slices of a batch
+    if (*zeros_size < size) {
+      free(*zeros);
+      *zeros = (char*)malloc(size);
+      memset(*zeros, 0, size);
+      *zeros_size = size;
     }
 
-    chunks[static_cast<int>(i)] = zeros;
+    chunks[static_cast<int>(i)] = *zeros;
   }
 
   jerasure_encode(&chunks[0], &chunks[k], size);
 
-  if (zeros != nullptr) free(zeros);
-
   return 0;
 }
 
+int ErasureCodeJerasure::encode_chunks(const shard_id_map<bufferptr> &in,
+                                       shard_id_map<bufferptr> &out)
+{
+  char *zeros = nullptr;
+  uint64_t zeros_size = 0;
+  int r = encode_slice(in, out, &zeros, &zeros_size);
+  free(zeros);
+  return r;
+}
+
+int ErasureCodeJerasure::encode_chunks_batch(
+  const vector<shard_id_map<bufferptr>> &in,
+  vector<shard_id_map<bufferptr>> &out)
+{
+  ceph_assert(in.size() == out.size());
+  char *zeros = nullptr;
+  uint64_t zeros_size = 0;
+  int r = 0;
+  for (size_t i = 0; i < in.size() && r == 0; ++i) {
+    r = encode_slice(in[i], out[i], &zeros, &zeros_size);
+  }
+  free(zeros);
+  return r;
+}
+
 [[deprecated]]
 int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
 				       const map<int, bufferlist> &chunks,
@@ -186,13 +213,13 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
-int ErasureCodeJerasure::decode_chunks(const shard_id_set &want_to_read,
-                                  shard_id_map<bufferptr> &in,
-                                  shard_id_map<bufferptr> &out)
+int ErasureCodeJerasure::decode_slice(const shard_id_set &want_to_read,
+                                      shard_id_map<bufferptr> &in,
+                                      shard_id_map<bufferptr> &out,
+                                      decode_scratch_t &scratch)
 {
   unsigned int size = 0;
   shard_id_set erasures_set;
-  shard_id_set to_free;
   erasures_set.insert_range(shard_id_t(0), k + m);
   int erasures[k + m + 1];
   int erasures_count = 0;
@@ -223,11 +250,18 @@ int ErasureCodeJerasure::decode_chunks(const shard_id_set &want_to_read,
     erasures_set.insert(shard);
   }
 
+  if (scratch.size < size) {
+    scratch.clear();
+    scratch.bufs.resize(k + m, nullptr);
+    scratch.size = size;
+  }
   for (int i = 0; i < k + m; i++) {
     char **buf = i < k ? &data[i] : &coding[i - k];
     if (*buf == nullptr) {
-      *buf = (char *)malloc(size);
-      to_free.insert(shard_id_t(i));
+      if (scratch.bufs[i] == nullptr) {
+        scratch.bufs[i] = (char *)malloc(scratch.size);
+      }
+      *buf = scratch.bufs[i];
       /* If we are inventing a buffer for non-erasure shard, its zeros! */
       if (i < k && !erasures_set.contains(shard_id_t(i))) {
         memset(*buf, 0, size);
@@ -241,14 +275,30 @@ int ErasureCodeJerasure::decode_chunks(const shard_id_set &want_to_read,
   erasures[erasures_count] = -1;
   ceph_assert(erasures_count > 0);
 
-  int r = jerasure_decode(erasures, data, coding, size);
-  for (auto & shard : to_free) {
-    int i = static_cast<int>(shard);
-    char **buf = i < k ? &data[i] : &coding[i - k];
-    free(*buf);
-    *buf = nullptr;
+  return jerasure_decode(erasures, data, coding, size);
+}
+
+int ErasureCodeJerasure::decode_chunks(const shard_id_set &want_to_read,
+                                  shard_id_map<bufferptr> &in,
+                                  shard_id_map<bufferptr> &out)
+{
+  decode_scratch_t scratch;
+  return decode_slice(want_to_read, in, out, scratch);
+}
+
+int ErasureCodeJerasure::decode_chunks_batch(
+  const shard_id_set &want_to_read,
+  vector<shard_id_map<bufferptr>> &in,
+  vector<shard_id_map<bufferptr>> &out)
+{
+  ceph_assert(in.size() == out.size());
+  decode_scratch_t scratch;
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (int r = decode_slice(want_to_read, in[i], out[i], scratch); r) {
+      return r;
+    }
   }
-  return r;
+  return 0;
 }
 
 void ErasureCodeJerasure::encode_delta(const bufferptr &old_data,
@@ -82,6 +82,8 @@ public:
         std::map<int, ceph::buffer::list> *encoded) override;
   int encode_chunks(const shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  int encode_chunks_batch(const std::vector<shard_id_map<bufferptr>> &in,
+                          std::vector<shard_id_map<bufferptr>> &out) override;
 
   [[deprecated]]
   int decode_chunks(const std::set<int> &want_to_read,
@@ -90,6 +92,9 @@ public:
   int decode_chunks(const shard_id_set &want_to_read,
                     shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  int decode_chunks_batch(const shard_id_set &want_to_read,
+                          std::vector<shard_id_map<bufferptr>> &in,
+                          std::vector<shard_id_map<bufferptr>> &out) override;
 
   void encode_delta(const ceph::bufferptr &old_data,
                     const ceph::bufferptr &new_data,
@@ -122,6 +127,34 @@ public:
 
   void do_scheduled_ops(char **ptrs, int **operations, int packetsize, int s, int d);
 
+private:
+  /// buffers standing in for the shards missing from a decode, kept
+  /// across the slices of a batch
+  struct decode_scratch_t {
+    std::vector<char*> bufs;
+    unsigned int size = 0;
+
+    void clear() {
+      for (auto buf : bufs) {
+        free(buf);
+      }
+      bufs.clear();
+      size = 0;
+    }
+    ~decode_scratch_t() {
+      clear();
+    }
+  };
+
+  int encode_slice(const shard_id_map<bufferptr> &in,
+                   shard_id_map<bufferptr> &out,
+                   char **zeros,
+                   uint64_t *zeros_size);
+  int decode_slice(const shard_id_set &want_to_read,
+                   shard_id_map<bufferptr> &in,
+                   shard_id_map<bufferptr> &out,
+                   decode_scratch_t &scratch);
+
 protected:
   virtual int parse(ceph::ErasureCodeProfile &profile, std::ostream *ss);
 };
@@ -1002,6 +1002,76 @@ int ErasureCodeLrc::encode_chunks(const shard_id_map<bufferptr> &in,
   return 0;
 }
 
+void ErasureCodeLrc::encode_delta(const bufferptr &old_data,
+                                  const bufferptr &new_data,
+                                  bufferptr *delta_maybe_in_place)
+{
+  // all the layers are linear codes, the delta of a chunk is the same
+  // whichever layer it is fed to
+  layers.front().erasure_code->encode_delta(old_data, new_data,
+                                            delta_maybe_in_place);
+}
+
+void ErasureCodeLrc::apply_delta(const shard_id_map<bufferptr> &in,
+                                 shard_id_map<bufferptr> &out)
+{
+  ceph_assert(!in.empty());
+  const unsigned blocksize = in.begin()->second.length();
+
+  // The coding chunks of a layer may be data chunks of the layers that
+  // follow (e.g. the global parity is protected by the local layers), so
+  // the deltas are propagated through the layers in the order they are
+  // encoded.  A layer sees the deltas of its data chunks and computes the
+  // deltas of its coding chunks, starting from zeroed buffers.
+  shard_id_map<bufferptr> deltas(get_chunk_count());
+  const vector<shard_id_t> &mapping = get_chunk_mapping();
+  for (unsigned int i = 0; i < get_data_chunk_count(); ++i) {
+    shard_id_t shard = i < mapping.size() ? mapping[i] : shard_id_t(i);
+    if (in.contains(shard)) {
+      ceph_assert(in.at(shard).length() == blocksize);
+      deltas[shard] = in.at(shard);
+    }
+  }
+  shard_id_set coded;
+  for (const Layer &layer : layers) {
+    shard_id_map<bufferptr> layer_in(get_chunk_count());
+    shard_id_t j;
+    for (const auto& c : layer.data) {
+      if (deltas.contains(shard_id_t(c))) {
+        layer_in[j] = deltas[shard_id_t(c)];
+      }
+      ++j;
+    }
+    if (layer_in.empty()) {
+      // a chunk coded again by a later layer takes that layer's value,
+      // which is unchanged
+      for (const auto& c : layer.coding) {
+        deltas.erase(shard_id_t(c));
+        coded.erase(shard_id_t(c));
+      }
+      continue;
+    }
+    shard_id_map<bufferptr> layer_out(get_chunk_count());
+    for (const auto& c : layer.coding) {
+      bufferptr delta(buffer::create_aligned(blocksize, SIMD_ALIGN));
+      delta.zero();
+      layer_out[j] = delta;
+      deltas[shard_id_t(c)] = delta;
+      coded.insert(shard_id_t(c));
+      ++j;
+    }
+    layer.erasure_code->apply_delta(layer_in, layer_out);
+  }
+
+  for (auto&& [shard, parity] : out) {
+    if (!coded.contains(shard)) {
+      continue;
+    }
+    ceph_assert(parity.length() == blocksize);
+    encode_delta(parity, deltas[shard], &parity);
+  }
+}
+
 IGNORE_DEPRECATED
 [[deprecated]]
 int ErasureCodeLrc::decode_chunks(const set<int> &want_to_read,
@@ -106,9 +106,24 @@ public:
 			     std::ostream *ss) const override;
 
   uint64_t get_supported_optimizations() const override {
-    return FLAG_EC_PLUGIN_PARTIAL_READ_OPTIMIZATION |
+    uint64_t flags = FLAG_EC_PLUGIN_PARTIAL_READ_OPTIMIZATION |
       FLAG_EC_PLUGIN_PARTIAL_WRITE_OPTIMIZATION |
       FLAG_EC_PLUGIN_ZERO_INPUT_ZERO_OUTPUT_OPTIMIZATION;
+    // parity deltas are applied layer by layer, so every layer must
+    // support them
+    bool parity_delta = !layers.empty();
+    for (const auto &layer : layers) {
+      if (!layer.erasure_code ||
+	  !(layer.erasure_code->get_supported_optimizations() &
+	    FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
+	parity_delta = false;
+	break;
+      }
+    }
+    if (parity_delta) {
+      flags |= FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION;
+    }
+    return flags;
   }
 
   unsigned int get_chunk_count() const override {
@@ -135,6 +150,11 @@ public:
   int decode_chunks(const shard_id_set &want_to_read,
                     shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  void encode_delta(const bufferptr &old_data,
+                    const bufferptr &new_data,
+                    bufferptr *delta_maybe_in_place) override;
+  void apply_delta(const shard_id_map<bufferptr> &in,
+                   shard_id_map<bufferptr> &out) override;
 
   int init(ceph::ErasureCodeProfile &profile, std::ostream *ss) override;
 
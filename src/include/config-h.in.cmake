@@ -90,6 +90,9 @@
 /* Defined if you have liburing */
 #cmakedefine HAVE_LIBURING
 
+/* Defined if the io_uring messenger stack is built */
+#cmakedefine HAVE_URING_MESSENGER
+
 /* Defind if you have POSIX AIO */
 #cmakedefine HAVE_POSIXAIO
 
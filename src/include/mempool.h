@@ -175,6 +175,7 @@ namespace mempool {
   f(osd)			      \
   f(osd_mapbl)			      \
   f(osd_pglog)			      \
+  f(osd_pglog_index)		      \
   f(osdmap)			      \
   f(osdmap_mapping)		      \
   f(pgmap)			      \
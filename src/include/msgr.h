@@ -52,9 +52,14 @@
 
 DEFINE_MSGR2_FEATURE(0, 1, REVISION_1)   // msgr2.1
 DEFINE_MSGR2_FEATURE(1, 1, COMPRESSION)  // on-wire compression
+DEFINE_MSGR2_FEATURE(2, 1, KTLS)         // secure mode in kernel TLS
+DEFINE_MSGR2_FEATURE(3, 1, MULTISTREAM)  // sessions over several streams
 
 /*
- * Features supported.  Should be everything above.
+ * Features supported.  Should be everything above but KTLS, which
+ * depends on the socket, and MULTISTREAM, which depends on the
+ * configuration; they are only advertised by the connections that can
+ * use them.
  */
 #define CEPH_MSGR2_SUPPORTED_FEATURES \
 	(CEPH_MSGR2_FEATURE_REVISION_1 | \
@@ -1896,36 +1896,45 @@ int RocksDBStore::get(
     const std::set<string> &keys,
     std::map<string, bufferlist> *out)
 {
-  rocksdb::PinnableSlice value;
+  if (keys.empty()) {
+    return 0;
+  }
   utime_t start = ceph_clock_now();
-  if (cf_handles.count(prefix) > 0) {
-    for (auto& key : keys) {
-      auto cf_handle = get_cf_handle(prefix, key);
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    cf_handle,
-			    rocksdb::Slice(key),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value.data(), value.size());
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
-      value.Reset();
-    }
-  } else {
-    for (auto& key : keys) {
-      string k = combine_strings(prefix, key);
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    default_cf,
-			    rocksdb::Slice(k),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value.data(), value.size());
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
-      value.Reset();
-    }
+  // one MultiGet lets rocksdb batch the memtable/block cache probes and
+  // read the sst blocks it misses in parallel
+  size_t n = keys.size();
+  std::vector<rocksdb::ColumnFamilyHandle*> cfs(n);
+  std::vector<rocksdb::Slice> slices(n);
+  std::vector<string> combined;
+  bool sharded = cf_handles.count(prefix) > 0;
+  if (!sharded) {
+    combined.reserve(n);
+  }
+  size_t i = 0;
+  for (auto& key : keys) {
+    if (sharded) {
+      cfs[i] = get_cf_handle(prefix, key);
+      slices[i] = rocksdb::Slice(key);
+    } else {
+      cfs[i] = default_cf;
+      combined.push_back(combine_strings(prefix, key));
+      slices[i] = rocksdb::Slice(combined.back());
+    }
+    ++i;
+  }
+  std::vector<rocksdb::PinnableSlice> values(n);
+  std::vector<rocksdb::Status> statuses(n);
+  db->MultiGet(rocksdb::ReadOptions(), n, cfs.data(), slices.data(),
+	       values.data(), statuses.data());
+  i = 0;
+  for (auto& key : keys) {
+    auto& status = statuses[i];
+    if (status.ok()) {
+      (*out)[key].append(values[i].data(), values[i].size());
+    } else if (status.IsIOError()) {
+      ceph_abort_msg(status.getState());
+    }
+    ++i;
   }
   utime_t lat = ceph_clock_now() - start;
   logger->tinc(l_rocksdb_get_latency, lat);
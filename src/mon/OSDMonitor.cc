@@ -797,6 +797,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     dout(7) << __func__ << " loading latest full map e" << latest_full << dendl;
     osdmap = OSDMap();
     osdmap.decode(latest_bl);
+    mapping.note_full_map();
   }
 
   bufferlist bl;
@@ -837,6 +838,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     OSDMap::Incremental inc(inc_bl);
     err = osdmap.apply_incremental(inc);
     ceph_assert(err == 0);
+    mapping.note_incremental(inc);
 
     if (!t)
       t.reset(new MonitorDBStore::Transaction);
@@ -884,6 +886,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 
 	osdmap = OSDMap();
 	osdmap.decode(orig_full_bl);
+	mapping.note_full_map();
 
 	dout(20) << __func__ << " canonical full osdmap:\n";
 	JSONFormatter jf(true);
@@ -8145,10 +8148,17 @@ int OSDMonitor::prepare_new_pool(string& name,
   }
 
   if (crimson) {
-    /* crimson-osd requires that the pool be replicated and that pg_num/pgp_num
-     * be static.  User must also have specified set-allow-crimson */
+    /* crimson-osd requires that pg_num/pgp_num be static, and that the pool
+     * be replicated unless its experimental erasure coding is enabled.  User
+     * must also have specified set-allow-crimson */
     const auto *suffix = " (--crimson specified or osd_pool_default_crimson set)";
-    if (pg_autoscale_mode != "off") {
+    if (pool_type == pg_pool_t::TYPE_ERASURE &&
+	!g_ceph_context->check_experimental_feature_enabled("crimson-ec")) {
+      *ss << "crimson-osd can't recover or backfill erasure coded pools yet, "
+	  << "add 'crimson-ec' to the experimental features config to create "
+	  << "one anyway" << suffix;
+      return -EINVAL;
+    } else if (pg_autoscale_mode != "off") {
       *ss << "crimson-osd does not support changing pg_num or pgp_num, "
 	  << "pg_autoscale_mode must be set to 'off'" << suffix;
       return -EINVAL;
@@ -242,7 +242,7 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
 
   recv_end = recv_start = 0;
   /* nothing left in the prefetch buffer */
-  if (left > (uint64_t)recv_max_prefetch) {
+  if (left > (uint64_t)recv_max_prefetch || recv_exact) {
     /* this was a large read, we don't prefetch for these */
     do {
       r = read_bulk(p+state_offset, left);
@@ -388,6 +388,12 @@ void AsyncConnection::process() {
 
   ldout(async_msgr->cct, 20) << __func__ << dendl;
 
+  if (cs) {
+    // e.g. a MSG_ZEROCOPY completion would wake us up over and over while
+    // the protocol waits for something else than the socket
+    cs.drain_error_queue();
+  }
+
   switch (state) {
     case STATE_NONE: {
       ldout(async_msgr->cct, 20) << __func__ << " enter none state" << dendl;
@@ -812,6 +818,13 @@ void AsyncConnection::tick(uint64_t id)
                                 << dendl;
       protocol->fault();
       labeled_logger->inc(l_msgr_connection_idle_timeouts);
+    } else if (protocol->has_stalled_streams(now, inactive_timeout_us)) {
+      ldout(async_msgr->cct, 1) << __func__ << " a stream of the session made"
+                                << " no progress in more than "
+                                << inactive_timeout_us << " us, fault."
+                                << dendl;
+      protocol->fault();
+      labeled_logger->inc(l_msgr_connection_idle_timeouts);
     } else {
       last_tick_id = center->create_time_event(inactive_timeout_us, tick_handler);
     }
@@ -375,6 +375,8 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
     transport_type = "rdma";
   else if (type.find("dpdk") != std::string::npos)
     transport_type = "dpdk";
+  else if (type.find("uring") != std::string::npos)
+    transport_type = "uring";
 
   auto single = &cct->lookup_or_create_singleton_object<StackSingleton>(
     "AsyncMessenger::NetworkStack::" + transport_type, true, cct);
@@ -835,7 +837,8 @@ void AsyncMessenger::add_accept(Worker *w, ConnectedSocket cli_socket,
 }
 
 AsyncConnectionRef AsyncMessenger::create_connect(
-  const entity_addrvec_t& addrs, int type, bool anon)
+  const entity_addrvec_t& addrs, int type, bool anon,
+  const std::function<void(AsyncConnection*)>& prepare)
 {
   ceph_assert(ceph_mutex_is_locked(lock));
 
@@ -860,6 +863,9 @@ AsyncConnectionRef AsyncMessenger::create_connect(
   auto conn = ceph::make_ref<AsyncConnection>(cct, this, &dispatch_queue, w,
 						target.is_msgr2(), false);
   conn->anon = anon;
+  if (prepare) {
+    prepare(conn.get());
+  }
   conn->connect(addrs, type, target);
   if (anon) {
     anon_conns.insert(conn);
@@ -1142,6 +1148,14 @@ int AsyncMessenger::accept_conn(const AsyncConnectionRef& conn)
   return 0;
 }
 
+void AsyncMessenger::accept_stream(const AsyncConnectionRef& conn)
+{
+  std::lock_guard l{lock};
+  ldout(cct, 10) << __func__ << " " << conn << " " << *conn->peer_addrs << dendl;
+  anon_conns.insert(conn);
+  accepting_conns.erase(conn);
+}
+
 
 bool AsyncMessenger::learned_addr(const entity_addr_t &peer_addr_for_me)
 {
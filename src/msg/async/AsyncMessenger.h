@@ -18,6 +18,7 @@
 #ifndef CEPH_ASYNCMESSENGER_H
 #define CEPH_ASYNCMESSENGER_H
 
+#include <functional>
 #include <map>
 #include <optional>
 #include <unordered_map>
@@ -224,11 +225,14 @@ private:
    * @param addrs The address(es) of the entity to connect to.
    * @param type The peer type of the entity at the address.
    *
+   * @param prepare Sets up the connection before it starts connecting.
+   *
    * @return a pointer to the newly-created connection. Caller does not own a
    * reference; take one if you need it.
    */
-  AsyncConnectionRef create_connect(const entity_addrvec_t& addrs, int type,
-				    bool anon);
+  AsyncConnectionRef create_connect(
+    const entity_addrvec_t& addrs, int type, bool anon,
+    const std::function<void(AsyncConnection*)>& prepare = {});
 
 
   void _finish_bind(const entity_addrvec_t& bind_addrs,
@@ -382,6 +386,19 @@ public:
   }
 
   int accept_conn(const AsyncConnectionRef& conn);
+  /**
+   * Connect an anonymous stream of a session, prepare() tells it which
+   * session to join.  The streams are not looked up by address, their
+   * session keeps a reference to them.
+   */
+  AsyncConnectionRef create_stream(
+    const entity_addrvec_t& addrs, int type,
+    const std::function<void(AsyncConnection*)>& prepare) {
+    std::lock_guard l{lock};
+    return create_connect(addrs, type, true, prepare);
+  }
+  /// an accepted connection joined an existing session as a stream of it
+  void accept_stream(const AsyncConnectionRef& conn);
   bool learned_addr(const entity_addr_t &peer_addr_for_me);
   void add_accept(Worker *w, ConnectedSocket cli_socket,
 		  const entity_addr_t &listen_addr,
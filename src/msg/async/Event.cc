@@ -24,6 +24,10 @@
 #include "dpdk/EventDPDK.h"
 #endif
 
+#ifdef HAVE_URING_MESSENGER
+#include "EventUring.h"
+#endif
+
 #ifdef HAVE_EPOLL
 #include "EventEpoll.h"
 #else
@@ -116,7 +120,7 @@ EventCenter::Poller::~Poller()
 std::ostream& EventCenter::_event_prefix(std::ostream *_dout)
 {
   return *_dout << "Event(" << this << " nevent=" << nevent
-                << " time_id=" << time_event_next_id << ").";
+                << " time_events=" << time_events.size() << ").";
 }
 
 int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
@@ -130,6 +134,10 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
   if (type == "dpdk") {
 #ifdef HAVE_DPDK
     driver = new DPDKDriver(cct);
+#endif
+  } else if (type == "uring") {
+#ifdef HAVE_URING_MESSENGER
+    driver = new UringDriver(cct);
 #endif
   } else {
 #ifdef HAVE_EPOLL
@@ -215,6 +223,8 @@ EventCenter::~EventCenter()
   }
   time_events.clear();
   //assert(time_events.empty());
+  time_event_pool.clear();
+  free_time_events.clear();
 
   if (notify_receive_fd >= 0)
     compat_closesocket(notify_receive_fd);
@@ -334,16 +344,24 @@ void EventCenter::delete_file_event(int fd, int mask)
 uint64_t EventCenter::create_time_event(uint64_t microseconds, EventCallbackRef ctxt)
 {
   ceph_assert(in_thread());
-  uint64_t id = time_event_next_id++;
+  uint32_t index;
+  if (free_time_events.empty()) {
+    index = time_event_pool.size();
+    time_event_pool.emplace_back();
+  } else {
+    index = free_time_events.back();
+    free_time_events.pop_back();
+  }
+  TimeEvent &event = time_event_pool[index];
+  // the generation starts at 1 so that no id is 0, and is bumped on each
+  // reuse so that the id of a fired or deleted event isn't found again
+  uint64_t id = ((event.id >> 32) + 1) << 32 | index;
 
   ldout(cct, 30) << __func__ << " id=" << id << " trigger after " << microseconds << "us"<< dendl;
-  EventCenter::TimeEvent event;
   clock_type::time_point expire = clock_type::now() + std::chrono::microseconds(microseconds);
   event.id = id;
   event.time_cb = ctxt;
-  std::multimap<clock_type::time_point, TimeEvent>::value_type s_val(expire, event);
-  auto it = time_events.insert(std::move(s_val));
-  event_map[id] = it;
+  time_events.arm(event, expire);
 
   return id;
 }
@@ -352,17 +370,17 @@ void EventCenter::delete_time_event(uint64_t id)
 {
   ceph_assert(in_thread());
   ldout(cct, 30) << __func__ << " id=" << id << dendl;
-  if (id >= time_event_next_id || id == 0)
+  uint32_t index = id & 0xffffffff;
+  if (id == 0 || index >= time_event_pool.size())
     return ;
 
-  auto it = event_map.find(id);
-  if (it == event_map.end()) {
+  TimeEvent &event = time_event_pool[index];
+  if (event.id != id || !time_events.cancel(event)) {
     ldout(cct, 10) << __func__ << " id=" << id << " not found" << dendl;
     return ;
   }
-
-  time_events.erase(it->second);
-  event_map.erase(it);
+  event.time_cb = NULL;
+  free_time_events.push_back(index);
 }
 
 void EventCenter::wakeup()
@@ -394,28 +412,19 @@ void EventCenter::wakeup()
 
 int EventCenter::process_time_events()
 {
-  int processed = 0;
   clock_type::time_point now = clock_type::now();
   using ceph::operator <<;
   ldout(cct, 30) << __func__ << " cur time is " << now << dendl;
 
-  while (!time_events.empty()) {
-    auto it = time_events.begin();
-    if (now >= it->first) {
-      TimeEvent &e = it->second;
-      EventCallbackRef cb = e.time_cb;
-      uint64_t id = e.id;
-      time_events.erase(it);
-      event_map.erase(id);
-      ldout(cct, 30) << __func__ << " process time event: id=" << id << dendl;
-      processed++;
-      cb->do_request(id);
-    } else {
-      break;
-    }
-  }
-
-  return processed;
+  return time_events.expire(now, [this] (TimeEvent &e) {
+    EventCallbackRef cb = e.time_cb;
+    uint64_t id = e.id;
+    // the callback may create time events, let it reuse this entry
+    e.time_cb = NULL;
+    free_time_events.push_back(id & 0xffffffff);
+    ldout(cct, 30) << "process_time_events process time event: id=" << id << dendl;
+    cb->do_request(id);
+  });
 }
 
 int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *working_dur)
@@ -426,10 +435,12 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   auto now = clock_type::now();
   clock_type::time_point end_time = now + std::chrono::microseconds(timeout_microseconds);
 
-  auto it = time_events.begin();
-  if (it != time_events.end() && end_time >= it->first) {
+  // may be a bit earlier than the first event, when the wheel only has to
+  // move events closer to their expiry
+  auto next = time_events.next_expiry();
+  if (next && end_time >= *next) {
     trigger_time = true;
-    end_time = it->first;
+    end_time = *next;
 
     if (end_time > now) {
       timeout_microseconds = std::chrono::duration_cast<std::chrono::microseconds>(end_time - now).count();
@@ -48,6 +48,7 @@
 
 #include "common/ceph_time.h"
 #include "common/dout.h"
+#include "common/timing_wheel.h"
 #include "net_handler.h"
 
 #define EVENT_NONE 0
@@ -108,7 +109,9 @@ class EventCenter {
     FileEvent(): mask(0), read_cb(NULL), write_cb(NULL) {}
   };
 
-  struct TimeEvent {
+  // pooled, the id of an event is the generation of its entry in the
+  // upper half and the index of the entry in the lower half
+  struct TimeEvent : public ceph::common::timing_wheel_hook {
     uint64_t id;
     EventCallbackRef time_cb;
 
@@ -163,13 +166,13 @@ class EventCenter {
   std::deque<EventCallbackRef> external_events;
   std::vector<FileEvent> file_events;
   EventDriver *driver;
-  std::multimap<clock_type::time_point, TimeEvent> time_events;
+  std::deque<TimeEvent> time_event_pool;
+  std::vector<uint32_t> free_time_events;
+  ceph::common::timing_wheel<TimeEvent, clock_type> time_events;
   // Keeps track of all of the pollers currently defined.  We don't
   // use an intrusive list here because it isn't reentrant: we need
   // to add/remove elements while the center is traversing the list.
   std::vector<Poller*> pollers;
-  std::map<uint64_t, std::multimap<clock_type::time_point, TimeEvent>::iterator> event_map;
-  uint64_t time_event_next_id;
   int notify_receive_fd;
   int notify_send_fd;
   ceph::NetHandler net;
@@ -187,7 +190,7 @@ class EventCenter {
   explicit EventCenter(CephContext *c):
     cct(c), nevent(0),
     external_num_events(0),
-    driver(NULL), time_event_next_id(1),
+    driver(NULL), time_events(std::chrono::microseconds(100)),
     notify_receive_fd(-1), notify_send_fd(-1), net(c),
     notify_handler(NULL), center_id(0) { }
   ~EventCenter();
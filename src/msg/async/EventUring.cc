@@ -0,0 +1,594 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <bit>
+
+#include "common/errno.h"
+#include "include/page.h"
+#include "EventUring.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "UringDriver."
+
+namespace {
+
+// the kind of operation a completion belongs to is in the low bits of
+// its user_data, the rest is the Socket, or the fd and generation of a
+// poll
+enum : uint64_t {
+  OP_IGNORE = 0,   // removals and cancellations
+  OP_POLL = 1,
+  OP_RECV = 2,
+  OP_SEND = 3,
+  OP_MASK = 3,
+};
+
+constexpr unsigned BUF_GROUP = 0;
+constexpr unsigned MAX_BUFFERS = 1u << 15;
+
+uint64_t poll_data(int fd, uint32_t gen)
+{
+  return (uint64_t(gen) << 32) | (uint64_t(fd) << 2) | OP_POLL;
+}
+
+uint64_t socket_data(UringDriver::Socket *s, uint64_t op)
+{
+  return reinterpret_cast<uint64_t>(s) | op;
+}
+
+}
+
+UringDriver::~UringDriver()
+{
+  if (buf_ring) {
+    io_uring_free_buf_ring(&ring, buf_ring, buf_count, BUF_GROUP);
+  }
+  if (ring_inited) {
+    io_uring_queue_exit(&ring);
+  }
+  for (auto s : sockets) {
+    delete s;
+  }
+  free(buf_base);
+}
+
+int UringDriver::init(EventCenter *c, int nevent)
+{
+  unsigned depth = cct->_conf.get_val<uint64_t>("ms_async_uring_queue_depth");
+  struct io_uring_params params = {};
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+  params.cq_entries = depth * 4;
+  int r = io_uring_queue_init_params(depth, &ring, &params);
+  if (r == -EINVAL) {
+    // kernels older than 5.19 don't know about COOP_TASKRUN
+    params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = depth * 4;
+    r = io_uring_queue_init_params(depth, &ring, &params);
+  }
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to init io_uring: "
+               << cpp_strerror(r) << dendl;
+    return r;
+  }
+  ring_inited = true;
+
+  buf_count = std::bit_floor(std::clamp<unsigned>(
+    cct->_conf.get_val<uint64_t>("ms_async_uring_recv_buffers"),
+    1, MAX_BUFFERS));
+  buf_size = cct->_conf.get_val<Option::size_t>("ms_async_uring_recv_buffer_size");
+  if (posix_memalign(reinterpret_cast<void**>(&buf_base), CEPH_PAGE_SIZE,
+                     size_t(buf_count) * buf_size)) {
+    buf_base = nullptr;
+    lderr(cct) << __func__ << " unable to allocate the receive buffers" << dendl;
+    return -ENOMEM;
+  }
+  buf_ring = io_uring_setup_buf_ring(&ring, buf_count, BUF_GROUP, 0, &r);
+  if (!buf_ring) {
+    lderr(cct) << __func__ << " unable to register the receive buffers: "
+               << cpp_strerror(r) << ", io_uring needs Linux 6.0 or later"
+               << dendl;
+    return r;
+  }
+  for (unsigned i = 0; i < buf_count; ++i) {
+    io_uring_buf_ring_add(buf_ring, buf_base + size_t(i) * buf_size, buf_size,
+                          i, io_uring_buf_ring_mask(buf_count), i);
+  }
+  io_uring_buf_ring_advance(buf_ring, buf_count);
+  buf_free = buf_count;
+  socket_max_buffers = std::min<unsigned>(
+    buf_count,
+    cct->_conf.get_val<uint64_t>("ms_async_uring_recv_buffers_per_socket"));
+  socket_max_send = cct->_conf.get_val<Option::size_t>(
+    "ms_async_uring_send_queue_bytes");
+
+  fds.resize(nevent);
+  ldout(cct, 10) << __func__ << " queue depth " << depth << " with "
+                 << buf_count << " receive buffers of " << buf_size
+                 << " bytes" << dendl;
+  return 0;
+}
+
+struct io_uring_sqe *UringDriver::get_sqe()
+{
+  auto sqe = io_uring_get_sqe(&ring);
+  while (!sqe) {
+    // the submission queue is full, hand it over to the kernel already
+    int r = io_uring_submit(&ring);
+    if (r < 0 && r != -EBUSY && r != -EAGAIN && r != -EINTR) {
+      lderr(cct) << __func__ << " io_uring_submit failed: "
+                 << cpp_strerror(r) << dendl;
+      ceph_abort();
+    }
+    sqe = io_uring_get_sqe(&ring);
+  }
+  return sqe;
+}
+
+void UringDriver::update_poll(int fd)
+{
+  auto &st = get_fd_state(fd);
+  int mask = st.owned ? (st.mask & ~EVENT_READABLE) : st.mask;
+  if (st.polled) {
+    auto sqe = get_sqe();
+    io_uring_prep_poll_remove(sqe, poll_data(fd, st.gen));
+    io_uring_sqe_set_data64(sqe, OP_IGNORE);
+    st.polled = false;
+  }
+  ++st.gen;
+  if (mask != EVENT_NONE) {
+    unsigned events = 0;
+    if (mask & EVENT_READABLE)
+      events |= POLLIN;
+    if (mask & EVENT_WRITABLE)
+      events |= POLLOUT;
+    auto sqe = get_sqe();
+    io_uring_prep_poll_multishot(sqe, fd, events);
+    io_uring_sqe_set_data64(sqe, poll_data(fd, st.gen));
+    st.polled = true;
+  }
+}
+
+int UringDriver::add_event(int fd, int cur_mask, int add_mask)
+{
+  ldout(cct, 20) << __func__ << " add event fd=" << fd << " cur_mask=" << cur_mask
+                 << " add_mask=" << add_mask << dendl;
+  auto &st = get_fd_state(fd);
+  st.mask = cur_mask | add_mask;
+  update_poll(fd);
+  return 0;
+}
+
+int UringDriver::del_event(int fd, int cur_mask, int del_mask)
+{
+  ldout(cct, 20) << __func__ << " del event fd=" << fd << " cur_mask=" << cur_mask
+                 << " del_mask=" << del_mask << dendl;
+  auto &st = get_fd_state(fd);
+  st.mask = cur_mask & ~del_mask;
+  update_poll(fd);
+  return 0;
+}
+
+int UringDriver::resize_events(int newsize)
+{
+  return 0;
+}
+
+int UringDriver::event_wait(std::vector<FiredFileEvent> &fired_events,
+                            struct timeval *tvp)
+{
+  ++wait_seq;
+  struct io_uring_cqe *cqe = nullptr;
+  int r;
+  if (tvp && tvp->tv_sec == 0 && tvp->tv_usec == 0) {
+    r = io_uring_submit(&ring);
+  } else {
+    struct __kernel_timespec ts;
+    if (tvp) {
+      ts.tv_sec = tvp->tv_sec;
+      ts.tv_nsec = tvp->tv_usec * 1000;
+    }
+    r = io_uring_submit_and_wait_timeout(&ring, &cqe, 1, tvp ? &ts : nullptr,
+                                         nullptr);
+  }
+  if (r < 0 && r != -ETIME && r != -EINTR && r != -EBUSY && r != -EAGAIN) {
+    lderr(cct) << __func__ << " io_uring_enter failed: "
+               << cpp_strerror(r) << dendl;
+  }
+
+  unsigned head;
+  unsigned count = 0;
+  io_uring_for_each_cqe(&ring, head, cqe) {
+    ++count;
+    uint64_t data = io_uring_cqe_get_data64(cqe);
+    auto s = reinterpret_cast<Socket*>(data & ~OP_MASK);
+    switch (data & OP_MASK) {
+    case OP_POLL:
+      handle_poll(cqe, fired_events);
+      break;
+    case OP_RECV:
+      handle_recv(s, cqe, fired_events);
+      break;
+    case OP_SEND:
+      handle_send(s, cqe, fired_events);
+      break;
+    default:
+      break;
+    }
+  }
+  io_uring_cq_advance(&ring, count);
+  return fired_events.size();
+}
+
+void UringDriver::handle_poll(struct io_uring_cqe *cqe,
+                              std::vector<FiredFileEvent> &fired_events)
+{
+  uint64_t data = io_uring_cqe_get_data64(cqe);
+  int fd = (data & 0xffffffff) >> 2;
+  auto &st = get_fd_state(fd);
+  if (uint32_t(data >> 32) != st.gen) {
+    // the fd was polled for other events since
+    return;
+  }
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (!more) {
+    st.polled = false;
+  }
+  if (cqe->res < 0) {
+    ldout(cct, 1) << __func__ << " poll of fd=" << fd << " failed: "
+                  << cpp_strerror(cqe->res) << dendl;
+    // let the owner find out about it, don't poll again until it asks to
+    fired_events.push_back({fd, EVENT_READABLE | EVENT_WRITABLE});
+    return;
+  }
+  int mask = 0;
+  if (cqe->res & POLLIN) mask |= EVENT_READABLE;
+  if (cqe->res & POLLOUT) mask |= EVENT_WRITABLE;
+  if (cqe->res & (POLLERR | POLLHUP)) mask |= EVENT_READABLE | EVENT_WRITABLE;
+  if (mask) {
+    fired_events.push_back({fd, mask});
+  }
+  if (!more) {
+    // the kernel may end a multishot poll, e.g. on a CQ overflow
+    update_poll(fd);
+  }
+}
+
+void UringDriver::fire(Socket *s, std::vector<FiredFileEvent> &fired_events)
+{
+  if (s->notified != wait_seq) {
+    s->notified = wait_seq;
+    fired_events.push_back({s->fd, EVENT_READABLE});
+  }
+}
+
+void UringDriver::maybe_free(Socket *s)
+{
+  if (s->closed && !s->recv_armed && !s->send_inflight) {
+    // the queued submissions refer to the fd by its number, which may be
+    // reused as soon as it is closed
+    io_uring_submit(&ring);
+    ::close(s->fd);
+    sockets.erase(s);
+    delete s;
+  }
+}
+
+UringDriver::Socket *UringDriver::attach(int fd)
+{
+  ldout(cct, 20) << __func__ << " fd=" << fd << dendl;
+  auto s = new Socket(fd);
+  sockets.insert(s);
+  auto &st = get_fd_state(fd);
+  st.owned = true;
+  update_poll(fd);
+  return s;
+}
+
+void UringDriver::arm_recv(Socket *s)
+{
+  auto sqe = get_sqe();
+  io_uring_prep_recv_multishot(sqe, s->fd, nullptr, 0, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUF_GROUP;
+  io_uring_sqe_set_data64(sqe, socket_data(s, OP_RECV));
+  s->recv_armed = true;
+}
+
+void UringDriver::pause_recv(Socket *s)
+{
+  ldout(cct, 20) << __func__ << " fd=" << s->fd << " holding "
+                 << s->received.size() << " buffers, " << buf_free
+                 << " free" << dendl;
+  s->recv_paused = true;
+  if (s->recv_armed) {
+    auto sqe = get_sqe();
+    io_uring_prep_cancel64(sqe, socket_data(s, OP_RECV), 0);
+    io_uring_sqe_set_data64(sqe, OP_IGNORE);
+  }
+  // let the owner know when there is more to read directly
+  get_fd_state(s->fd).owned = false;
+  update_poll(s->fd);
+}
+
+void UringDriver::resume_recv(Socket *s)
+{
+  ldout(cct, 20) << __func__ << " fd=" << s->fd << dendl;
+  s->recv_paused = false;
+  get_fd_state(s->fd).owned = true;
+  update_poll(s->fd);
+  arm_recv(s);
+}
+
+void UringDriver::recycle_buffer(uint16_t bid)
+{
+  io_uring_buf_ring_add(buf_ring, buf_base + size_t(bid) * buf_size, buf_size,
+                        bid, io_uring_buf_ring_mask(buf_count), 0);
+  io_uring_buf_ring_advance(buf_ring, 1);
+  ++buf_free;
+}
+
+void UringDriver::handle_recv(Socket *s, struct io_uring_cqe *cqe,
+                              std::vector<FiredFileEvent> &fired_events)
+{
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (!more) {
+    s->recv_armed = false;
+  }
+  if (cqe->res > 0) {
+    uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    --buf_free;
+    if (s->closed) {
+      recycle_buffer(bid);
+    } else {
+      s->received.push_back({bid, 0, uint32_t(cqe->res)});
+      fire(s, fired_events);
+      if (s->recv_paused) {
+        // received before the cancellation took effect
+      } else if (s->received.size() >= socket_max_buffers) {
+        pause_recv(s);
+      } else if (!more) {
+        arm_recv(s);
+      }
+    }
+  } else if (!s->closed) {
+    if (cqe->res == 0) {
+      s->eof = true;
+      fire(s, fired_events);
+    } else if (cqe->res == -ENOBUFS) {
+      // all the buffers are queued on sockets, read this one directly
+      // meanwhile
+      ldout(cct, 20) << __func__ << " fd=" << s->fd << " out of buffers" << dendl;
+      pause_recv(s);
+      fire(s, fired_events);
+    } else if (cqe->res == -ECANCELED && s->recv_paused) {
+      // what is left is read directly from now on
+      fire(s, fired_events);
+    } else {
+      s->error = cqe->res;
+      fire(s, fired_events);
+    }
+  }
+  maybe_free(s);
+}
+
+ssize_t UringDriver::read(Socket *s, char *buf, size_t len)
+{
+  size_t copied = 0;
+  while (copied < len && !s->received.empty()) {
+    auto &r = s->received.front();
+    size_t n = std::min<size_t>(len - copied, r.len);
+    memcpy(buf + copied, buf_base + size_t(r.bid) * buf_size + r.off, n);
+    copied += n;
+    r.off += n;
+    r.len -= n;
+    if (r.len == 0) {
+      uint16_t bid = r.bid;
+      s->received.pop_front();
+      recycle_buffer(bid);
+    }
+  }
+  if (copied) {
+    return copied;
+  }
+  if (s->error) {
+    return s->error;
+  }
+  if (s->eof) {
+    return 0;
+  }
+  if (s->recv_paused) {
+    if (s->recv_armed) {
+      // the recv is being cancelled, it may still deliver data
+      return -EAGAIN;
+    }
+    ssize_t r = ::read(s->fd, buf, len);
+    if (r >= 0) {
+      return r;
+    }
+    r = -errno;
+    if (r != -EAGAIN) {
+      return r;
+    }
+    // drained, the ring can take over again if it has buffers to spare
+    if (buf_free > 0) {
+      resume_recv(s);
+    }
+    return -EAGAIN;
+  }
+  if (!s->recv_armed) {
+    arm_recv(s);
+  }
+  return -EAGAIN;
+}
+
+void UringDriver::submit_send(Socket *s)
+{
+  if (s->sending.length() == 0) {
+    if (s->pending.get_num_buffers() <= IOV_MAX) {
+      s->sending.swap(s->pending);
+    } else {
+      unsigned len = 0;
+      unsigned n = 0;
+      for (auto &p : s->pending.buffers()) {
+        if (n++ == IOV_MAX)
+          break;
+        len += p.length();
+      }
+      s->pending.splice(0, len, &s->sending);
+    }
+  }
+  s->iov.clear();
+  for (auto &p : s->sending.buffers()) {
+    s->iov.push_back({const_cast<char*>(p.c_str()), p.length()});
+  }
+  s->msg = {};
+  s->msg.msg_iov = s->iov.data();
+  s->msg.msg_iovlen = s->iov.size();
+  auto sqe = get_sqe();
+  io_uring_prep_sendmsg(sqe, s->fd, &s->msg, MSG_NOSIGNAL);
+  io_uring_sqe_set_data64(sqe, socket_data(s, OP_SEND));
+  s->send_inflight = true;
+}
+
+// sends what the socket takes right away, returns how much or the error
+ssize_t UringDriver::send_now(Socket *s, ceph::buffer::list &bl)
+{
+  size_t sent = 0;
+  auto pb = std::cbegin(bl.buffers());
+  uint64_t left_pbrs = bl.get_num_buffers();
+  while (left_pbrs) {
+    struct iovec iov[IOV_MAX];
+    uint64_t n = std::min<uint64_t>(left_pbrs, IOV_MAX);
+    left_pbrs -= n;
+    size_t len = 0;
+    for (auto v = iov; v != iov + n; ++v, ++pb) {
+      v->iov_base = const_cast<char*>(pb->c_str());
+      v->iov_len = pb->length();
+      len += pb->length();
+    }
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    ssize_t r = ::sendmsg(s->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (r < 0) {
+      r = -errno;
+      if (r == -EINTR) {
+        // start over from the first buffer not sent
+        pb = std::cbegin(bl.buffers());
+        left_pbrs = bl.get_num_buffers();
+        continue;
+      }
+      if (r != -EAGAIN) {
+        return r;
+      }
+      break;
+    }
+    sent += r;
+    if (size_t(r) < len) {
+      break;
+    }
+  }
+  bl.splice(0, sent);
+  return sent;
+}
+
+ssize_t UringDriver::send(Socket *s, ceph::buffer::list &bl)
+{
+  if (s->error) {
+    return s->error;
+  }
+  ssize_t sent = 0;
+  if (!s->send_inflight && s->pending.length() == 0) {
+    // nothing to wait for, the socket probably takes it all
+    sent = send_now(s, bl);
+    if (sent < 0) {
+      s->error = sent;
+      return sent;
+    }
+  }
+  // the ring sends the rest once the socket has room for it
+  uint64_t queued = s->sending.length() + s->pending.length();
+  if (bl.length() && queued < socket_max_send) {
+    uint64_t n = std::min<uint64_t>(bl.length(), socket_max_send - queued);
+    ceph::buffer::list rest;
+    bl.splice(n, bl.length() - n, &rest);
+    s->pending.claim_append(bl);
+    bl.swap(rest);
+    sent += n;
+    if (!s->send_inflight) {
+      submit_send(s);
+    }
+  }
+  if (bl.length()) {
+    s->send_blocked = true;
+  }
+  return sent;
+}
+
+void UringDriver::handle_send(Socket *s, struct io_uring_cqe *cqe,
+                              std::vector<FiredFileEvent> &fired_events)
+{
+  s->send_inflight = false;
+  if (cqe->res < 0) {
+    if (!s->closed && !s->error) {
+      s->error = cqe->res;
+      fire(s, fired_events);
+    }
+    s->sending.clear();
+    s->pending.clear();
+  } else if (unsigned(cqe->res) < s->sending.length()) {
+    s->sending.splice(0, cqe->res);
+    submit_send(s);
+  } else {
+    s->sending.clear();
+    if (s->pending.length()) {
+      submit_send(s);
+    }
+  }
+  if (s->send_blocked && !s->closed && !s->send_inflight) {
+    // there is room in the queue again
+    s->send_blocked = false;
+    fired_events.push_back({s->fd, EVENT_WRITABLE});
+  }
+  maybe_free(s);
+}
+
+void UringDriver::close(Socket *s)
+{
+  ldout(cct, 20) << __func__ << " fd=" << s->fd
+                 << (s->send_inflight ? ", sending the queued data" : "")
+                 << dendl;
+  s->closed = true;
+  get_fd_state(s->fd).owned = false;
+  if (s->recv_armed) {
+    auto sqe = get_sqe();
+    io_uring_prep_cancel64(sqe, socket_data(s, OP_RECV), 0);
+    io_uring_sqe_set_data64(sqe, OP_IGNORE);
+  }
+  for (auto &r : s->received) {
+    recycle_buffer(r.bid);
+  }
+  s->received.clear();
+  // the data queued was reported as sent, so it goes out before the fd
+  // is closed, by maybe_free() once nothing is in flight anymore
+  maybe_free(s);
+}
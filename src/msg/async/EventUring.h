@@ -0,0 +1,150 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENTURING_H
+#define CEPH_MSG_EVENTURING_H
+
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <set>
+#include <vector>
+
+#include "liburing.h"
+
+#include "include/buffer.h"
+#include "Event.h"
+
+/*
+ * UringDriver waits for the file events with multishot polls on an
+ * io_uring, and besides offers a completion based data path to the
+ * sockets of the UringStack: their input is received by a multishot recv
+ * into the buffers provided to the ring, and their output is sent
+ * asynchronously when it can't be sent right away.  Once a socket takes
+ * this data path the driver stops polling it for input and fires its
+ * READABLE events itself when data, EOF or an error arrives.
+ *
+ * A socket holds at most ms_async_uring_recv_buffers_per_socket of the
+ * provided buffers.  When it reaches that, or when the ring runs out of
+ * buffers, receiving into the ring pauses for it: it is polled and read
+ * directly, like by the posix stack, until it is drained, so that a
+ * connection which stops reading can't starve the others.  Likewise at
+ * most ms_async_uring_send_queue_bytes are queued per socket, beyond that
+ * send() leaves the data to the caller and fires WRITABLE once the queue
+ * drains.
+ *
+ * All the submissions are queued and only handed to the kernel by
+ * event_wait(), along with the wait for completions, so each pass of the
+ * event loop costs a single io_uring_enter(2) however many sockets it
+ * reads from and writes to.  Everything but construction must be called
+ * from the thread of the owning EventCenter.
+ */
+class UringDriver : public EventDriver {
+ public:
+  /// the state of a socket using the data path of the ring
+  struct Socket {
+    struct received_t {
+      uint16_t bid;     ///< index of the provided buffer
+      uint32_t off;
+      uint32_t len;
+    };
+
+    int fd;
+    bool closed = false;          ///< by the owner, fd open until sent
+    bool recv_armed = false;
+    bool recv_paused = false;     ///< read directly, not by the ring
+    bool send_inflight = false;
+    bool send_blocked = false;    ///< data was left to the caller
+    bool eof = false;
+    int error = 0;
+    uint64_t notified = 0;        ///< last event_wait() it was fired in
+    std::deque<received_t> received;
+    ceph::buffer::list pending;   ///< queued behind the send in flight
+    ceph::buffer::list sending;   ///< the send in flight
+    std::vector<struct iovec> iov;
+    struct msghdr msg = {};
+
+    explicit Socket(int fd) : fd(fd) {}
+  };
+
+ private:
+  struct fd_state_t {
+    int mask = EVENT_NONE;
+    uint32_t gen = 0;     ///< tells the completions of an older poll apart
+    bool polled = false;
+    bool owned = false;   ///< a Socket receives for it
+  };
+
+  CephContext *cct;
+  struct io_uring ring;
+  bool ring_inited = false;
+  std::vector<fd_state_t> fds;
+  std::set<Socket*> sockets;
+  uint64_t wait_seq = 0;
+
+  struct io_uring_buf_ring *buf_ring = nullptr;
+  char *buf_base = nullptr;
+  unsigned buf_count = 0;
+  unsigned buf_size = 0;
+  unsigned buf_free = 0;          ///< buffers the kernel can receive into
+  unsigned socket_max_buffers = 0;
+  uint64_t socket_max_send = 0;
+
+  fd_state_t &get_fd_state(int fd) {
+    if (fd >= static_cast<int>(fds.size())) {
+      fds.resize(fd + 1);
+    }
+    return fds[fd];
+  }
+  struct io_uring_sqe *get_sqe();
+  void update_poll(int fd);
+  void arm_recv(Socket *s);
+  void pause_recv(Socket *s);
+  void resume_recv(Socket *s);
+  ssize_t send_now(Socket *s, ceph::buffer::list &bl);
+  void submit_send(Socket *s);
+  void recycle_buffer(uint16_t bid);
+  void fire(Socket *s, std::vector<FiredFileEvent> &fired_events);
+  void maybe_free(Socket *s);
+
+  void handle_poll(struct io_uring_cqe *cqe,
+                   std::vector<FiredFileEvent> &fired_events);
+  void handle_recv(Socket *s, struct io_uring_cqe *cqe,
+                   std::vector<FiredFileEvent> &fired_events);
+  void handle_send(Socket *s, struct io_uring_cqe *cqe,
+                   std::vector<FiredFileEvent> &fired_events);
+
+ public:
+  explicit UringDriver(CephContext *c) : cct(c) {}
+  ~UringDriver() override;
+
+  int init(EventCenter *c, int nevent) override;
+  int add_event(int fd, int cur_mask, int add_mask) override;
+  int del_event(int fd, int cur_mask, int del_mask) override;
+  int resize_events(int newsize) override;
+  int event_wait(std::vector<FiredFileEvent> &fired_events,
+                 struct timeval *tp) override;
+
+  /// move the data path of a connected socket to the ring
+  Socket *attach(int fd);
+  /// copy out the received data, -EAGAIN if there is none yet
+  ssize_t read(Socket *s, char *buf, size_t len);
+  /// send or queue what it can of bl and remove it from there, returns
+  /// its length or the error of the socket
+  ssize_t send(Socket *s, ceph::buffer::list &bl);
+  /// stop receiving, the fd is closed once the data queued is sent
+  void close(Socket *s);
+};
+
+#endif
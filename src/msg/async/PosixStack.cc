@@ -20,8 +20,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -38,16 +42,155 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define HAVE_MSG_ZEROCOPY 1
+#endif
+
+// The buffers of the MSG_ZEROCOPY sends of a socket, held until the
+// kernel notifies on the error queue of the socket that it is done with
+// them.
+class PosixZerocopySends {
+  PerfCounters *logger;
+  int fd;
+  // the kernel numbers the MSG_ZEROCOPY sends of each socket
+  uint32_t next_id = 0;
+  struct send_t {
+    uint32_t first_id;
+    uint32_t last_id;
+    uint32_t pending;          // ids of the range not completed yet
+    ceph::buffer::list data;   // holds the raw buffers the kernel reads from
+    bool copied = false;
+  };
+  std::deque<send_t> sends;
+
+  bool complete(uint32_t lo, uint32_t hi, bool copied) {
+    for (auto &zs : sends) {
+      // the ids wrap around, compare them relative to the first one
+      int64_t n = zs.last_id - zs.first_id;
+      int64_t from = std::max<int64_t>(int32_t(lo - zs.first_id), 0);
+      int64_t to = std::min<int64_t>(int32_t(hi - zs.first_id), n);
+      if (from <= to) {
+	zs.pending -= to - from + 1;
+	zs.copied |= copied;
+      }
+    }
+    while (!sends.empty() && sends.front().pending == 0) {
+      auto &zs = sends.front();
+      if (zs.copied && logger) {
+	logger->inc(l_msgr_send_zerocopy_copied_bytes, zs.data.length());
+      }
+      sends.pop_front();
+    }
+    return copied;
+  }
+
+ public:
+  PosixZerocopySends(PerfCounters *logger, int fd)
+    : logger(logger), fd(fd) {}
+
+  int get_fd() const {
+    return fd;
+  }
+  bool empty() const {
+    return sends.empty();
+  }
+  size_t length() const {
+    size_t len = 0;
+    for (auto &zs : sends) {
+      len += zs.data.length();
+    }
+    return len;
+  }
+
+  /// hold the data sent by the last calls MSG_ZEROCOPY sendmsg() calls
+  void add(unsigned calls, ceph::buffer::list &&data) {
+    sends.push_back({next_id, next_id + calls - 1, calls, std::move(data)});
+    next_id += calls;
+  }
+
+  /// release the data of the completed sends, returns true if the kernel
+  /// copied some of them
+  bool reap() {
+    bool copied = false;
+#ifdef HAVE_MSG_ZEROCOPY
+    while (!sends.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+		   CMSG_SPACE(sizeof(struct sockaddr_in6))];
+      struct msghdr msg = {};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+	break;
+      }
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	      (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+	  continue;
+	}
+	auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	copied |= complete(serr->ee_info, serr->ee_data,
+			   serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+      }
+    }
+#endif
+    return copied;
+  }
+};
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
+  CephContext *cct;
+  PosixWorker *worker;
   ceph::NetHandler &handler;
+  PerfCounters *logger;
   int _fd;
   entity_addr_t sa;
   bool connected;
 
+#ifdef HAVE_MSG_ZEROCOPY
+  // sends of at least this many bytes use MSG_ZEROCOPY, 0 if disabled
+  uint64_t zerocopy_threshold = 0;
+  std::unique_ptr<PosixZerocopySends> zerocopy;
+
+  void enable_zerocopy(uint64_t threshold) {
+    int one = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+      ldout(cct, 1) << __func__ << " unable to set SO_ZEROCOPY on fd=" << _fd
+		    << ": " << cpp_strerror(errno) << dendl;
+      return;
+    }
+    zerocopy_threshold = threshold;
+    zerocopy = std::make_unique<PosixZerocopySends>(logger, _fd);
+  }
+
+  void reap_zerocopy() {
+    if (zerocopy && zerocopy->reap() && zerocopy_threshold) {
+      // the kernel falls back to copying e.g. over loopback, pinning the
+      // data on top of that is only overhead
+      ldout(cct, 10) << __func__ << " fd=" << _fd << " data got copied,"
+		     << " disabling MSG_ZEROCOPY" << dendl;
+      zerocopy_threshold = 0;
+    }
+  }
+#endif
+
  public:
-  explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
-				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(CephContext *c, PosixWorker *w,
+				    ceph::NetHandler &h,
+				    PerfCounters *logger,
+				    const entity_addr_t &sa,
+				    int f, bool connected,
+				    uint64_t zerocopy_threshold = 0)
+      : cct(c), worker(w), handler(h), logger(logger), _fd(f), sa(sa),
+	connected(connected) {
+#ifdef HAVE_MSG_ZEROCOPY
+    if (zerocopy_threshold) {
+      enable_zerocopy(zerocopy_threshold);
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -64,6 +207,12 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     }
   }
 
+  void drain_error_queue() override {
+#ifdef HAVE_MSG_ZEROCOPY
+    reap_zerocopy();
+#endif
+  }
+
   ssize_t read(char *buf, size_t len) override {
     #ifdef _WIN32
     ssize_t r = ::recv(_fd, buf, len, 0);
@@ -78,13 +227,15 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   // return the sent length
   // < 0 means error occurred
   #ifndef _WIN32
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // "calls" counts the sendmsg() calls which sent anything
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    int flags, unsigned *calls)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0) | flags);
       if (r < 0) {
         int err = ceph_sock_errno();
         if (err == EINTR) {
@@ -96,6 +247,7 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
       }
 
       sent += r;
+      ++*calls;
       if (len == sent) break;
 
       while (r > 0) {
@@ -115,6 +267,14 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(ceph::buffer::list &bl, bool more) override {
+    int flags = 0;
+#ifdef HAVE_MSG_ZEROCOPY
+    reap_zerocopy();
+    if (zerocopy_threshold && bl.length() >= zerocopy_threshold) {
+      flags = MSG_ZEROCOPY;
+    }
+#endif
+    unsigned calls = 0;
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
@@ -134,9 +294,12 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
-      if (r < 0)
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more, flags,
+			     &calls);
+      if (r < 0) {
+	// the data sent so far is dropped along with the connection
         return r;
+      }
 
       // "r" is the remaining length
       sent_bytes += r;
@@ -151,7 +314,17 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
+      }
+#ifdef HAVE_MSG_ZEROCOPY
+      if (flags & MSG_ZEROCOPY) {
+	// the kernel reads the sent data until it notifies the completion
+	zerocopy->add(calls, std::move(swapped));
+      }
+#endif
+      if (logger) {
+	logger->inc(flags ? l_msgr_send_zerocopy_bytes : l_msgr_send_copied_bytes,
+		    sent_bytes);
       }
     }
 
@@ -205,11 +378,40 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+#ifdef HAVE_MSG_ZEROCOPY
+    if (zerocopy) {
+      zerocopy->reap();
+      if (!zerocopy->empty()) {
+	// the kernel may still be sending from the buffers of these sends,
+	// the worker closes the socket once it read their completions
+	worker->linger_zerocopy(std::move(zerocopy));
+	return;
+      }
+    }
+#endif
     compat_closesocket(_fd);
   }
   void set_priority(int sd, int prio, int domain) override {
     handler.set_priority(sd, prio, domain);
   }
+  int attach_ktls() override {
+    return handler.attach_ktls(_fd);
+  }
+  int enable_ktls(const uint8_t *key, const uint8_t *rx_iv,
+                  const uint8_t *tx_iv) override {
+    int r = handler.set_ktls_cipher(_fd, true, key, tx_iv);
+    if (r == 0) {
+      r = handler.set_ktls_cipher(_fd, false, key, rx_iv);
+    }
+#ifdef HAVE_MSG_ZEROCOPY
+    if (r == 0) {
+      // the TLS sendmsg() refuses MSG_ZEROCOPY, the sends already pinned
+      // are still reaped by read()
+      zerocopy_threshold = 0;
+    }
+#endif
+    return r;
+  }
   int fd() const override {
     return _fd;
   }
@@ -263,8 +465,9 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
-  *sock = ConnectedSocket(std::move(csi));
+  ceph_assert(w);
+  *sock = ConnectedSocket(
+    static_cast<PosixWorker*>(w)->create_connected_socket(*out, sd, true));
   return 0;
 }
 
@@ -272,6 +475,89 @@ void PosixWorker::initialize()
 {
 }
 
+std::unique_ptr<ConnectedSocketImpl> PosixWorker::create_connected_socket(
+  const entity_addr_t &sa, int fd, bool connected)
+{
+  uint64_t zerocopy_threshold = 0;
+  if (cct->_conf.get_val<bool>("ms_tcp_zerocopy")) {
+    zerocopy_threshold = std::max<uint64_t>(
+      cct->_conf.get_val<Option::size_t>("ms_tcp_zerocopy_threshold"), 1);
+  }
+  return std::make_unique<PosixConnectedSocketImpl>(
+    cct, this, net, perf_logger, sa, fd, connected, zerocopy_threshold);
+}
+
+class PosixWorker::C_reap_zerocopy : public EventCallback {
+  PosixWorker *worker;
+
+ public:
+  explicit C_reap_zerocopy(PosixWorker *w) : worker(w) {}
+  void do_request(uint64_t id) override {
+    worker->reap_zerocopy_id = 0;
+    worker->reap_lingering_zerocopy();
+  }
+};
+
+PosixWorker::PosixWorker(CephContext *c, unsigned i)
+  : Worker(c, i), net(c),
+    reap_zerocopy_handler(new C_reap_zerocopy(this))
+{
+}
+
+PosixWorker::~PosixWorker()
+{
+  for (auto &zs : lingering_zerocopy) {
+    ldout(cct, 1) << __func__ << " closing fd=" << zs->get_fd() << " with "
+		  << zs->length() << " bytes of MSG_ZEROCOPY sends pending"
+		  << dendl;
+    compat_closesocket(zs->get_fd());
+  }
+}
+
+void PosixWorker::linger_zerocopy(std::unique_ptr<PosixZerocopySends> zs)
+{
+  // a socket may be closed from the thread of another worker, e.g. once
+  // its connection was reused
+  center.submit_to(
+    center.get_id(),
+    [this, zs = std::move(zs)]() mutable {
+      ldout(cct, 10) << "linger_zerocopy fd=" << zs->get_fd() << " waits for "
+		     << zs->length() << " bytes of MSG_ZEROCOPY sends" << dendl;
+      lingering_zerocopy.push_back(std::move(zs));
+      if (!reap_zerocopy_id) {
+	reap_zerocopy_interval = std::chrono::milliseconds(1);
+	reap_zerocopy_id = center.create_time_event(
+	  std::chrono::microseconds(reap_zerocopy_interval).count(),
+	  reap_zerocopy_handler.get());
+      }
+    },
+    true);
+}
+
+void PosixWorker::reap_lingering_zerocopy()
+{
+  for (auto p = lingering_zerocopy.begin(); p != lingering_zerocopy.end();) {
+    auto &zs = *p;
+    zs->reap();
+    if (zs->empty()) {
+      ldout(cct, 10) << __func__ << " closing fd=" << zs->get_fd() << dendl;
+      compat_closesocket(zs->get_fd());
+      p = lingering_zerocopy.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  if (!lingering_zerocopy.empty()) {
+    // the data to a peer gone waits for the retransmissions to time out,
+    // back off up to a second
+    reap_zerocopy_interval = std::min<std::chrono::milliseconds>(
+      reap_zerocopy_interval * 2, std::chrono::seconds(1));
+    reap_zerocopy_id = center.create_time_event(
+      std::chrono::microseconds(reap_zerocopy_interval).count(),
+      reap_zerocopy_handler.get());
+  }
+}
+
 int PosixWorker::listen(entity_addr_t &sa,
 			unsigned addr_slot,
 			const SocketOptions &opt,
@@ -331,8 +617,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
   }
 
   net.set_priority(sd, opts.priority, addr.get_family());
-  *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+  *socket = ConnectedSocket(create_connected_socket(addr, sd, !opts.nonblock));
   return 0;
 }
 
@@ -18,6 +18,9 @@
 #ifndef CEPH_MSG_ASYNC_POSIXSTACK_H
 #define CEPH_MSG_ASYNC_POSIXSTACK_H
 
+#include <chrono>
+#include <list>
+#include <memory>
 #include <thread>
 
 #include "msg/msg_types.h"
@@ -25,17 +28,36 @@
 
 #include "Stack.h"
 
+class PosixZerocopySends;
+
 class PosixWorker : public Worker {
-  ceph::NetHandler net;
+  class C_reap_zerocopy;
+
+  // the sockets closed with MSG_ZEROCOPY sends in flight, which are only
+  // closed once the kernel completed them
+  std::list<std::unique_ptr<PosixZerocopySends>> lingering_zerocopy;
+  std::unique_ptr<EventCallback> reap_zerocopy_handler;
+  uint64_t reap_zerocopy_id = 0;
+  std::chrono::milliseconds reap_zerocopy_interval{1};
+
   void initialize() override;
+  void reap_lingering_zerocopy();
+ protected:
+  ceph::NetHandler net;
  public:
-  PosixWorker(CephContext *c, unsigned i)
-      : Worker(c, i), net(c) {}
+  PosixWorker(CephContext *c, unsigned i);
+  ~PosixWorker() override;
   int listen(entity_addr_t &sa,
 	     unsigned addr_slot,
 	     const SocketOptions &opt,
 	     ServerSocket *socks) override;
   int connect(const entity_addr_t &addr, const SocketOptions &opts, ConnectedSocket *socket) override;
+  /// wrap a socket accepted or connected for this worker
+  virtual std::unique_ptr<ConnectedSocketImpl> create_connected_socket(
+    const entity_addr_t &sa, int fd, bool connected);
+  /// close the socket of zs once the kernel is done with its sends, may be
+  /// called from any thread
+  void linger_zerocopy(std::unique_ptr<PosixZerocopySends> zs);
 };
 
 class PosixNetworkStack : public NetworkStack {
@@ -131,6 +131,12 @@ public:
   virtual void read_event() = 0;
   virtual void write_event() = 0;
   virtual bool is_queued() = 0;
+  // true -> a connection carrying part of our session stopped making
+  // progress, checked on each tick as they have none of their own
+  virtual bool has_stalled_streams(ceph::coarse_mono_clock::time_point now,
+                                   uint64_t timeout_us) {
+    return false;
+  }
 
   virtual void dump(Formatter *f) = 0;
 
@@ -17,6 +17,11 @@
 #define dout_subsys ceph_subsys_ms
 #undef dout_prefix
 #define dout_prefix _conn_prefix(_dout)
+
+// set once the kernel refused a TLS cipher, so that the next connections
+// stay with the secure mode frames
+static std::atomic<bool> ktls_unusable{false};
+
 std::ostream &ProtocolV2::_conn_prefix(std::ostream *_dout) {
   return *_dout << "--2- " << messenger->get_myaddrs() << " >> "
                 << *connection->peer_addrs << " conn(" << connection << " "
@@ -151,6 +156,8 @@ void ProtocolV2::discard_out_queue() {
 void ProtocolV2::reset_session() {
   ldout(cct, 1) << __func__ << dendl;
 
+  detach_streams();
+
   std::lock_guard<std::mutex> l(connection->write_lock);
   if (connection->delay_state) {
     connection->delay_state->discard();
@@ -181,10 +188,16 @@ void ProtocolV2::stop() {
 
   if (connection->delay_state) connection->delay_state->flush();
 
+  detach_streams();
+  if (stream_primary) {
+    leave_session();
+  }
+
   std::lock_guard<std::mutex> l(connection->write_lock);
 
   reset_recv_state();
   discard_out_queue();
+  stream_out.clear();
 
   connection->_stop();
 
@@ -242,10 +255,45 @@ void ProtocolV2::reset_security() {
   auth_meta.reset(new AuthConnectionMeta);
   session_stream_handlers.rx.reset(nullptr);
   session_stream_handlers.tx.reset(nullptr);
+  session_ktls = false;
+  ktls_offered = false;
+  connection->recv_exact = false;
   pre_auth.rxbuf.clear();
   pre_auth.txbuf.clear();
 }
 
+// Hands the secure mode over to the kernel if both ends offered kernel
+// TLS.  It's called by each end once it's done with the plain stream:
+// after receiving AUTH_DONE for the client, after sending it for the
+// server.  Returns false if the connection can't go on.
+bool ProtocolV2::maybe_enable_ktls(bool crossed)
+{
+  connection->recv_exact = false;
+  if (!ktls_offered ||
+      !HAVE_MSGR2_FEATURE(peer_supported_features, KTLS) ||
+      !auth_meta->is_mode_secure()) {
+    return true;
+  }
+  if (connection->recv_start != connection->recv_end) {
+    lderr(cct) << __func__ << " read ahead of the switch to kernel TLS"
+               << dendl;
+    return false;
+  }
+  auto keys = ceph::crypto::onwire::session_keys_t::get(*auth_meta, crossed);
+  int r = connection->cs.enable_ktls(keys.key.data(), keys.rx_nonce.data(),
+                                     keys.tx_nonce.data());
+  if (r < 0) {
+    if (!ktls_unusable.exchange(true)) {
+      lderr(cct) << __func__ << " unable to enable kernel TLS: "
+                 << cpp_strerror(r) << ", not offering it anymore" << dendl;
+    }
+    return false;
+  }
+  ldout(cct, 10) << __func__ << " kernel TLS enabled" << dendl;
+  session_ktls = true;
+  return true;
+}
+
 // it's expected the `write_lock` is held while calling this method.
 void ProtocolV2::reset_recv_state() {
   ldout(cct, 5) << __func__ << dendl;
@@ -335,6 +383,16 @@ CtPtr ProtocolV2::_fault() {
     return nullptr;
   }
 
+  if (stream_primary) {
+    // a stream has no session of its own to reconnect, its primary
+    // resets the streams and resends what they lost
+    ldout(cct, 1) << __func__ << " stream " << stream_index
+                  << " failed, closing" << dendl;
+    stop();
+    return nullptr;
+  }
+  detach_streams();
+
   connection->write_lock.lock();
 
   can_write = false;
@@ -572,7 +630,7 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
   } else {
     const auto sent_bytes = total_send_size - connection->outgoing_bl.length();
     connection->logger->inc(l_msgr_send_bytes, sent_bytes);
-    if (session_stream_handlers.tx) {
+    if (session_stream_handlers.tx || session_ktls) {
       connection->logger->inc(l_msgr_send_encrypted_bytes, sent_bytes);
     }
     ldout(cct, 10) << __func__ << " sending " << m
@@ -642,8 +700,312 @@ void ProtocolV2::reset_compression() {
   session_compression_handlers.tx.reset(nullptr);
 }
 
+bool ProtocolV2::can_stripe() const {
+  return !stream_primary && streams_offered &&
+         HAVE_MSGR2_FEATURE(peer_supported_features, MULTISTREAM) &&
+         !connection->policy.lossy &&
+         messenger->get_mytype() == CEPH_ENTITY_TYPE_OSD &&
+         connection->get_peer_type() == CEPH_ENTITY_TYPE_OSD;
+}
+
+// Called by the client once its session is established.  The streams are
+// created from the event loop, as the messenger lock comes before ours.
+void ProtocolV2::open_streams() {
+  if (!can_stripe()) {
+    return;
+  }
+  const auto count = cct->_conf.get_val<uint64_t>("ms_osd_peer_streams");
+  ldout(cct, 10) << __func__ << " opening " << count - 1 << " more streams"
+                 << dendl;
+  connection->center->submit_to(
+    connection->center->get_id(),
+    [msgr = messenger, primary = AsyncConnectionRef(connection),
+     addrs = *connection->peer_addrs, type = connection->get_peer_type(),
+     client_cookie = client_cookie, server_cookie = server_cookie, count] {
+      for (uint32_t i = 1; i < count; ++i) {
+        msgr->create_stream(addrs, type, [&](AsyncConnection *stream) {
+          auto proto = static_cast<ProtocolV2*>(stream->protocol.get());
+          proto->stream_primary = primary;
+          proto->stream_client_cookie = client_cookie;
+          proto->stream_server_cookie = server_cookie;
+          proto->stream_index = i;
+        });
+      }
+    }, /* always_async = */true);
+}
+
+bool ProtocolV2::join_stream(AsyncConnection *stream, uint64_t client_cookie,
+                             uint64_t server_cookie) {
+  const auto max_streams =
+    cct->_conf.get_val<uint64_t>("ms_osd_peer_streams") - 1;
+  std::lock_guard l(streams_lock);
+  if (!streams_open ||
+      client_cookie != this->client_cookie ||
+      server_cookie != this->server_cookie ||
+      streams.size() >= max_streams) {
+    return false;
+  }
+  streams.emplace_back(stream);
+  return true;
+}
+
+// Must hold connection->lock.  The messages parked by the streams are
+// dropped, the peer resends them as they were not acked yet.
+void ProtocolV2::detach_streams() {
+  std::vector<AsyncConnectionRef> detached;
+  {
+    std::lock_guard l(streams_lock);
+    streams_open = false;
+    detached.swap(streams);
+    for (auto& [seq, parked] : stream_reorder) {
+      auto& [m, from] = parked;
+      from->stream_parked--;
+      connection->dispatch_queue->dispatch_throttle_release(
+        m->get_dispatch_throttle_size());
+      m->put();
+    }
+    stream_reorder.clear();
+    stream_reorder_len = 0;
+  }
+  if (detached.empty()) {
+    return;
+  }
+  ldout(cct, 1) << __func__ << " closing " << detached.size() << " streams"
+                << dendl;
+  for (auto& stream : detached) {
+    stream->stop(false);
+  }
+}
+
+// Hands a message over to the next stream, round robin, unless it is
+// too small to be worth it.  Its sequence number is taken from the
+// session, it stays on the sent list of the session until acked.
+bool ProtocolV2::write_to_stream(Message *m) {
+  if (m->get_data().length() < stream_min_size) {
+    return false;
+  }
+  std::lock_guard l(streams_lock);
+  if (streams.empty()) {
+    return false;
+  }
+  auto& stream = streams[next_stream++ % streams.size()];
+  auto proto = static_cast<ProtocolV2*>(stream->protocol.get());
+  std::lock_guard wl(stream->write_lock);
+  if (proto->state == CLOSED) {
+    // it's about to be reported, keep the message to ourselves meanwhile
+    return false;
+  }
+
+  m->set_seq(++out_seq);
+  ceph_msg_header &header = m->get_header();
+  ceph_msg_footer &footer = m->get_footer();
+  // the acks are sent by the primary only
+  ceph_msg_header2 header2{header.seq,        header.tid,
+                           header.type,       header.priority,
+                           header.version,
+                           ceph_le32(0),      header.data_off,
+                           ceph_le64(0),
+                           footer.flags,      header.compat_version,
+                           header.reserved};
+  proto->stream_out.push_back(
+    stream_frame_t{header2, m->get_payload(), m->get_middle(), m->get_data()});
+  stream->center->dispatch_event_external(stream->write_handler);
+
+  ldout(cct, 2) << __func__ << " sending message m=" << m
+                << " seq=" << m->get_seq() << " on stream "
+                << proto->stream_index << " " << *m << dendl;
+  m->trace.event("async writing message to stream");
+  m->put();
+  return true;
+}
+
+// The write_event() of a stream: it sends the messages given by its
+// primary, the frames are assembled here so that each stream does its
+// share of the checksums, encryption and compression.
+void ProtocolV2::write_stream_event() {
+  std::deque<stream_frame_t> frames;
+  {
+    std::lock_guard l(connection->write_lock);
+    if (!can_write) {
+      return;
+    }
+    frames.swap(stream_out);
+  }
+
+  ssize_t r = 0;
+  auto start = ceph::mono_clock::now();
+  for (auto& f : frames) {
+    auto message = MessageFrame::Encode(f.header, f.front, f.middle, f.data);
+    if (!append_frame(message)) {
+      r = -EILSEQ;
+      break;
+    }
+  }
+  if (r == 0 && connection->is_queued()) {
+    const auto total_send_size = connection->outgoing_bl.length();
+    r = connection->_try_send();
+    if (r >= 0) {
+      const auto sent_bytes = total_send_size - connection->outgoing_bl.length();
+      connection->logger->inc(l_msgr_send_bytes, sent_bytes);
+      if (session_stream_handlers.tx || session_ktls) {
+        connection->logger->inc(l_msgr_send_encrypted_bytes, sent_bytes);
+      }
+    }
+  }
+  connection->logger->tinc(l_msgr_running_send_time,
+                           ceph::mono_clock::now() - start);
+  if (r < 0) {
+    ldout(cct, 1) << __func__ << " send msg failed" << dendl;
+    connection->lock.lock();
+    fault();
+    connection->lock.unlock();
+  }
+}
+
+// Called without any lock, by the primary or one of its streams, with a
+// message it received.  Whoever finds the next message in sequence
+// dispatches it and the ones parked behind it.
+void ProtocolV2::deliver_in_order(Message *m, ProtocolV2 *from) {
+  std::unique_lock l(streams_lock);
+  if (from != this &&
+      std::none_of(streams.begin(), streams.end(),
+                   [from](const auto& s) { return s->protocol.get() == from; })) {
+    ldout(cct, 10) << __func__ << " " << *m << " from a closed stream, "
+                   << "discarding" << dendl;
+    l.unlock();
+    connection->dispatch_queue->dispatch_throttle_release(
+      m->get_dispatch_throttle_size());
+    m->put();
+    return;
+  }
+  if (m->get_seq() <= in_seq ||
+      !stream_reorder.emplace(m->get_seq(), std::make_pair(m, from)).second) {
+    ldout(cct, 0) << __func__ << " got old message " << m->get_seq()
+                  << " <= " << in_seq << " " << m << " " << *m
+                  << ", discarding" << dendl;
+    l.unlock();
+    connection->dispatch_queue->dispatch_throttle_release(
+      m->get_dispatch_throttle_size());
+    m->put();
+    return;
+  }
+  from->stream_parked++;
+  stream_reorder_len = stream_reorder.size();
+  if (stream_delivering) {
+    return;
+  }
+
+  stream_delivering = true;
+  bool delivered = false;
+  while (!stream_reorder.empty() &&
+         stream_reorder.begin()->first == in_seq + 1) {
+    auto p = stream_reorder.begin();
+    auto [next, origin] = p->second;
+    stream_reorder.erase(p);
+    stream_reorder_len = stream_reorder.size();
+    origin->stream_parked--;
+    in_seq = next->get_seq();
+    if (!connection->policy.lossy) {
+      ack_left++;
+    }
+    delivered = true;
+    l.unlock();
+    dispatch_in_order(next);
+    l.lock();
+  }
+  stream_delivering = false;
+  l.unlock();
+
+  if (delivered && !connection->policy.lossy) {
+    std::lock_guard wl(connection->write_lock);
+    if (can_write) {
+      connection->center->dispatch_event_external(connection->write_handler);
+    }
+  }
+}
+
+void ProtocolV2::dispatch_in_order(Message *m) {
+  ldout(cct, 5) << __func__ << " m=" << m << " seq=" << m->get_seq()
+                << " " << *m << dendl;
+  if (connection->is_blackhole()) {
+    ldout(cct, 10) << __func__ << " blackhole " << *m << dendl;
+    m->put();
+    return;
+  }
+  messenger->ms_fast_preprocess(m);
+  if (messenger->ms_can_fast_dispatch(m)) {
+    connection->dispatch_queue->fast_dispatch(m);
+  } else {
+    connection->dispatch_queue->enqueue(m, m->get_priority(),
+                                        connection->conn_id);
+  }
+}
+
+// A stream went away along with the messages it was given: start over
+// with the whole session, unless it's no longer ours.
+void ProtocolV2::handle_stream_fault(const AsyncConnectionRef& stream) {
+  std::unique_lock l(connection->lock);
+  if (!connection->center->in_thread()) {
+    // the connection moved to another worker meanwhile
+    auto center = connection->center;
+    l.unlock();
+    center->submit_to(
+      center->get_id(),
+      [primary = AsyncConnectionRef(connection), stream] {
+        static_cast<ProtocolV2*>(primary->protocol.get())->
+          handle_stream_fault(stream);
+      }, /* always_async = */true);
+    return;
+  }
+  bool attached;
+  {
+    std::lock_guard sl(streams_lock);
+    attached = std::find(streams.begin(), streams.end(), stream) !=
+               streams.end();
+  }
+  if (attached) {
+    ldout(cct, 1) << __func__ << " lost stream " << stream << dendl;
+    _fault();
+  }
+}
+
+// Must hold connection->lock.  Called by a stream which stops, its
+// primary is told from its own thread.
+void ProtocolV2::leave_session() {
+  auto primary = std::move(stream_primary);
+  primary->center->submit_to(
+    primary->center->get_id(),
+    [primary, stream = AsyncConnectionRef(connection)] {
+      static_cast<ProtocolV2*>(primary->protocol.get())->
+        handle_stream_fault(stream);
+    }, /* always_async = */true);
+}
+
+// The messages parked for dispatch hold on to their throttle budget.  If
+// the message they wait for is yet to be read by a stream which has none
+// parked, that stream may take the budget beyond the limits instead of
+// waiting, which is at most a message per stream.
+bool ProtocolV2::overcommit_throttle(Throttle &throttle, int64_t count) {
+  ProtocolV2 *session = this;
+  if (stream_primary) {
+    session = static_cast<ProtocolV2*>(stream_primary->protocol.get());
+  }
+  if (session->stream_reorder_len == 0 || stream_parked > 0) {
+    return false;
+  }
+  ldout(cct, 10) << __func__ << " taking " << count << " from "
+                 << throttle.get_current() << "/" << throttle.get_max()
+                 << ", the session waits for a message of ours" << dendl;
+  throttle.take(count);
+  return true;
+}
+
 void ProtocolV2::write_event() {
   ldout(cct, 10) << __func__ << dendl;
+  if (stream_primary) {
+    write_stream_event();
+    return;
+  }
   ssize_t r = 0;
 
   connection->write_lock.lock();
@@ -695,7 +1057,11 @@ void ProtocolV2::write_event() {
 				 out_entry.m->queue_start);
       }
 
-      r = write_message(out_entry.m, more);
+      if (write_to_stream(out_entry.m)) {
+        r = 0;
+      } else {
+        r = write_message(out_entry.m, more);
+      }
 
       connection->write_lock.lock();
       if (r == 0) {
@@ -771,6 +1137,55 @@ bool ProtocolV2::is_queued() {
   return !out_queue.empty() || connection->is_queued();
 }
 
+// Called by the tick of the primary with connection->lock held.  A stream
+// may idle as long as the session does, but not while it has something
+// to send, nor while the session waits for messages it parked and none
+// of the streams reads anything.
+bool ProtocolV2::has_stalled_streams(ceph::coarse_mono_clock::time_point now,
+                                     uint64_t timeout_us) {
+  std::vector<AsyncConnectionRef> attached;
+  {
+    std::lock_guard l(streams_lock);
+    attached = streams;
+  }
+  if (attached.empty()) {
+    return false;
+  }
+  const bool waiting = stream_reorder_len > 0;
+  bool receiving = false;
+  for (auto& stream : attached) {
+    ceph::coarse_mono_clock::time_point last_active;
+    {
+      std::lock_guard l(stream->lock);
+      last_active = stream->last_active;
+    }
+    bool sending;
+    {
+      std::lock_guard wl(stream->write_lock);
+      auto proto = static_cast<ProtocolV2*>(stream->protocol.get());
+      sending = !proto->stream_out.empty() || stream->is_queued();
+    }
+    const auto idle_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - last_active).count();
+    if (idle_us <= 0 || (uint64_t)idle_us <= timeout_us) {
+      receiving = true;
+      continue;
+    }
+    if (sending) {
+      ldout(cct, 1) << __func__ << " stream " << stream << " sent nothing for "
+                    << idle_us << " us" << dendl;
+      return true;
+    }
+  }
+  if (waiting && !receiving) {
+    ldout(cct, 1) << __func__ << " " << stream_reorder_len
+                  << " messages parked and no stream read anything for more"
+                  << " than " << timeout_us << " us" << dendl;
+    return true;
+  }
+  return false;
+}
+
 void ProtocolV2::dump(Formatter *f) {
   f->open_object_section("v2");
   f->dump_string("state", get_state_name(state));
@@ -780,6 +1195,13 @@ void ProtocolV2::dump(Formatter *f) {
   f->dump_bool("rev1", HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1));
   f->dump_unsigned("connect_seq", connect_seq);
   f->dump_unsigned("peer_global_seq", peer_global_seq);
+  if (stream_primary) {
+    f->dump_unsigned("stream_index", stream_index);
+  } else {
+    std::lock_guard l(streams_lock);
+    f->dump_unsigned("streams", streams.size());
+    f->dump_unsigned("streams_parked_messages", stream_reorder.size());
+  }
 
   f->open_object_section("crypto");
   f->dump_string(
@@ -790,6 +1212,7 @@ void ProtocolV2::dump(Formatter *f) {
       "tx", session_stream_handlers.tx
                 ? session_stream_handlers.tx->cipher_name()
                 : "PLAIN");
+  f->dump_bool("ktls", session_ktls);
   f->close_section();  // crypto
 
   f->open_object_section("compression");
@@ -887,9 +1310,23 @@ CtPtr ProtocolV2::_banner_exchange(CtRef callback) {
   ldout(cct, 20) << __func__ << dendl;
   bannerExchangeCallback = &callback;
 
+  uint64_t supported_features = CEPH_MSGR2_SUPPORTED_FEATURES;
+  // the ULP doesn't touch the stream until it is given the keys, so it can
+  // be attached before we know whether the session is going to use it
+  ktls_offered = cct->_conf.get_val<bool>("ms_secure_mode_ktls") &&
+                 !ktls_unusable &&
+                 connection->cs.attach_ktls() == 0;
+  if (ktls_offered) {
+    supported_features |= CEPH_MSGR2_FEATURE_KTLS;
+  }
+  streams_offered = cct->_conf.get_val<uint64_t>("ms_osd_peer_streams") > 1;
+  if (streams_offered) {
+    supported_features |= CEPH_MSGR2_FEATURE_MULTISTREAM;
+  }
+
   ceph::bufferlist banner_payload;
   using ceph::encode;
-  encode((uint64_t)CEPH_MSGR2_SUPPORTED_FEATURES, banner_payload, 0);
+  encode(supported_features, banner_payload, 0);
   encode((uint64_t)CEPH_MSGR2_REQUIRED_FEATURES, banner_payload, 0);
 
   ceph::bufferlist bl;
@@ -1008,6 +1445,12 @@ CtPtr ProtocolV2::_handle_peer_banner_payload(rx_buffer_t &&buffer, int r) {
   tx_frame_asm.set_is_rev1(is_rev1);
   rx_frame_asm.set_is_rev1(is_rev1);
 
+  if (ktls_offered && HAVE_MSGR2_FEATURE(peer_supported_features, KTLS)) {
+    // the stream may switch to kernel TLS right after AUTH_DONE, so what
+    // follows it must not be read ahead
+    connection->recv_exact = true;
+  }
+
   if (state == BANNER_CONNECTING) {
     state = HELLO_CONNECTING;
   }
@@ -1204,6 +1647,8 @@ CtPtr ProtocolV2::handle_read_frame_dispatch() {
     case Tag::WAIT:
     case Tag::COMPRESSION_REQUEST:
     case Tag::COMPRESSION_DONE:
+    case Tag::STREAM_ATTACH:
+    case Tag::STREAM_ATTACH_OK:
       return handle_frame_payload();
     case Tag::MESSAGE:
       return handle_message();
@@ -1322,6 +1767,10 @@ CtPtr ProtocolV2::handle_frame_payload() {
       return handle_compression_request(payload);
     case Tag::COMPRESSION_DONE:
       return handle_compression_done(payload);
+    case Tag::STREAM_ATTACH:
+      return handle_stream_attach(payload);
+    case Tag::STREAM_ATTACH_OK:
+      return handle_stream_attach_ok(payload);
     default:
       ceph_abort();
   }
@@ -1338,13 +1787,25 @@ CtPtr ProtocolV2::ready() {
   if (connection->last_tick_id) {
     connection->center->delete_time_event(connection->last_tick_id);
   }
-  connection->last_tick_id = connection->center->create_time_event(
-      connection->inactive_timeout_us, connection->tick_handler);
+  if (stream_primary) {
+    // the tick of the primary watches over its streams
+    connection->last_tick_id = 0;
+  } else {
+    connection->last_tick_id = connection->center->create_time_event(
+        connection->inactive_timeout_us, connection->tick_handler);
+
+    const bool stripe = can_stripe();
+    stream_min_size = stripe ?
+      cct->_conf.get_val<Option::size_t>("ms_osd_peer_stream_min_size") :
+      std::numeric_limits<uint64_t>::max();
+    std::lock_guard l(streams_lock);
+    streams_open = stripe;
+  }
 
   {
     std::lock_guard<std::mutex> l(connection->write_lock);
     can_write = true;
-    if (!out_queue.empty()) {
+    if (!out_queue.empty() || !stream_out.empty()) {
       connection->center->dispatch_event_external(connection->write_handler);
     }
   }
@@ -1440,7 +1901,7 @@ CtPtr ProtocolV2::handle_message() {
       msg_frame.front(),
       msg_frame.middle(),
       msg_frame.data(),
-      connection);
+      stream_primary ? stream_primary.get() : connection);
   if (!message) {
     ldout(cct, 1) << __func__ << " decode message failed " << dendl;
     return _fault();
@@ -1461,6 +1922,36 @@ CtPtr ProtocolV2::handle_message() {
   message->set_throttle_stamp(throttle_stamp);
   message->set_recv_complete_stamp(ceph_clock_now());
 
+  if (stream_primary || streams_open) {
+    // the session is striped, its primary puts the messages of all the
+    // streams back in order
+    state = READY;
+    connection->logger->inc(l_msgr_recv_messages);
+    connection->logger->inc(l_msgr_recv_bytes,
+                            rx_frame_asm.get_frame_onwire_len());
+    if (session_stream_handlers.rx) {
+      connection->logger->inc(l_msgr_recv_encrypted_bytes,
+                              rx_frame_asm.get_frame_onwire_len());
+    }
+    ldout(cct, 5) << __func__ << " received message m=" << message
+                  << " seq=" << message->get_seq()
+                  << " from=" << message->get_source() << " type=" << header.type
+                  << " " << *message << dendl;
+    AsyncConnectionRef primary = stream_primary ? stream_primary : connection;
+    connection->lock.unlock();
+    static_cast<ProtocolV2*>(primary->protocol.get())->deliver_in_order(
+      message, this);
+    connection->recv_start_time = ceph::mono_clock::now();
+    connection->lock.lock();
+    if (state != READY) {
+      return nullptr;
+    }
+    if (!stream_primary) {
+      handle_message_ack(current_header.ack_seq);
+    }
+    return CONTINUE(read_frame);
+  }
+
   // check received seq#.  if it is old, drop the message.
   // note that incoming messages may skip ahead.  this is convenient for the
   // client side queueing because messages can't be renumbered, but the (kernel)
@@ -1585,7 +2076,8 @@ CtPtr ProtocolV2::throttle_message() {
                    << connection->policy.throttler_messages->get_current()
                    << "/" << connection->policy.throttler_messages->get_max()
                    << dendl;
-    if (!connection->policy.throttler_messages->get_or_fail()) {
+    if (!connection->policy.throttler_messages->get_or_fail() &&
+        !overcommit_throttle(*connection->policy.throttler_messages, 1)) {
       ldout(cct, 1) << __func__ << " wants 1 message from policy throttle "
                      << connection->policy.throttler_messages->get_current()
                      << "/" << connection->policy.throttler_messages->get_max()
@@ -1615,7 +2107,9 @@ CtPtr ProtocolV2::throttle_bytes() {
                      << " bytes from policy throttler "
                      << connection->policy.throttler_bytes->get_current() << "/"
                      << connection->policy.throttler_bytes->get_max() << dendl;
-      if (!connection->policy.throttler_bytes->get_or_fail(cur_msg_size)) {
+      if (!connection->policy.throttler_bytes->get_or_fail(cur_msg_size) &&
+          !overcommit_throttle(*connection->policy.throttler_bytes,
+                               cur_msg_size)) {
         ldout(cct, 1) << __func__ << " wants " << cur_msg_size
                        << " bytes from policy throttler "
                        << connection->policy.throttler_bytes->get_current()
@@ -1644,7 +2138,9 @@ CtPtr ProtocolV2::throttle_dispatch_queue() {
   const size_t cur_msg_size = get_current_msg_size();
   if (cur_msg_size) {
     if (!connection->dispatch_queue->dispatch_throttler.get_or_fail(
-            cur_msg_size)) {
+            cur_msg_size) &&
+        !overcommit_throttle(connection->dispatch_queue->dispatch_throttler,
+                             cur_msg_size)) {
       ldout(cct, 1)
           << __func__ << " wants " << cur_msg_size
           << " bytes from dispatch throttle "
@@ -1884,9 +2380,14 @@ CtPtr ProtocolV2::handle_auth_done(ceph::bufferlist &payload)
     return _fault();
   }
   auth_meta->con_mode = auth_done.con_mode();
-  bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
-  session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
-      cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/false);
+  if (!maybe_enable_ktls(/*crossed=*/false)) {
+    return _fault();
+  }
+  if (!session_ktls) {
+    bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
+    session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+        cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/false);
+  }
 
   state = AUTH_CONNECTING_SIGN;
 
@@ -1924,7 +2425,11 @@ CtPtr ProtocolV2::finish_server_auth() {
 }
 
 CtPtr ProtocolV2::start_session_connect() {
-  if (!server_cookie) {
+  if (stream_primary) {
+    ldout(cct, 20) << __func__ << " joining a session" << dendl;
+    state = SESSION_CONNECTING;
+    return send_stream_attach();
+  } else if (!server_cookie) {
     ldout(cct, 20) << __func__ << " starting a new session" << dendl;
     ceph_assert(connect_seq == 0);
     state = SESSION_CONNECTING;
@@ -2127,6 +2632,7 @@ CtPtr ProtocolV2::handle_reconnect_ok(ceph::bufferlist &payload)
   connection->dispatch_queue->queue_connect(connection);
   messenger->ms_deliver_handle_fast_connect(connection);
 
+  open_streams();
   return ready();
 }
 
@@ -2182,6 +2688,7 @@ CtPtr ProtocolV2::handle_server_ident(ceph::bufferlist &payload)
   connection->dispatch_queue->queue_connect(connection);
   messenger->ms_deliver_handle_fast_connect(connection);
 
+  open_streams();
   return ready();
 }
 
@@ -2219,6 +2726,48 @@ CtPtr ProtocolV2::handle_compression_done(ceph::bufferlist &payload) {
   return start_session_connect();
 }
 
+CtPtr ProtocolV2::send_stream_attach() {
+  auto attach = StreamAttachFrame::Encode(messenger->get_myaddrs(),
+                                          stream_client_cookie,
+                                          stream_server_cookie,
+                                          stream_index);
+
+  ldout(cct, 5) << __func__ << " joining session client_cookie=" << std::hex
+                << stream_client_cookie << " server_cookie="
+                << stream_server_cookie << std::dec << " as stream "
+                << stream_index << dendl;
+
+  return WRITE(attach, "stream attach", read_frame);
+}
+
+CtPtr ProtocolV2::handle_stream_attach_ok(ceph::bufferlist &payload)
+{
+  ldout(cct, 20) << __func__
+		 << " payload.length()=" << payload.length() << dendl;
+
+  if (state != SESSION_CONNECTING || !stream_primary) {
+    lderr(cct) << __func__ << " not in stream connect state!" << dendl;
+    return _fault();
+  }
+
+  auto attach_ok = StreamAttachOkFrame::Decode(payload);
+  auto primary = static_cast<ProtocolV2*>(stream_primary->protocol.get());
+  if (attach_ok.index() != stream_index ||
+      !primary->join_stream(connection, stream_client_cookie,
+                            stream_server_cookie)) {
+    ldout(cct, 1) << __func__ << " session moved on, dropping stream "
+                  << stream_index << dendl;
+    return _fault();
+  }
+
+  peer_name = primary->peer_name;
+  connection->set_features(stream_primary->get_features());
+  backoff = utime_t();
+  ldout(cct, 10) << __func__ << " joined as stream " << stream_index << dendl;
+
+  return ready();
+}
+
 /* Server Protocol Methods */
 
 CtPtr ProtocolV2::start_server_banner_exchange() {
@@ -2328,9 +2877,14 @@ CtPtr ProtocolV2::finish_auth()
   ceph_assert(auth_meta);
   // TODO: having a possibility to check whether we're server or client could
   // allow reusing finish_auth().
-  bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
-  session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
-      cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/true);
+  if (!maybe_enable_ktls(/*crossed=*/true)) {
+    return _fault();
+  }
+  if (!session_ktls) {
+    bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
+    session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+        cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/true);
+  }
 
   const auto sig = auth_meta->session_key.empty() ? sha256_digest_t() :
     auth_meta->session_key.hmac_sha256(cct, pre_auth.rxbuf);
@@ -2826,6 +3380,7 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
   // this happens in the event center's thread as there should be
   // no user outside its boundaries (simlarly to e.g. outgoing_bl).
   auto temp_stream_handlers = std::move(session_stream_handlers);
+  bool temp_ktls = session_ktls;
   auto temp_compression_handlers = std::move(session_compression_handlers);
   exproto->auth_meta = auth_meta;
   exproto->comp_meta = comp_meta;
@@ -2861,11 +3416,13 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
         tx_is_rev1=tx_frame_asm.get_is_rev1(),
         rx_is_rev1=rx_frame_asm.get_is_rev1(),
         temp_stream_handlers=std::move(temp_stream_handlers),
+        temp_ktls,
         temp_compression_handlers=std::move(temp_compression_handlers)
       ](ConnectedSocket &cs) mutable {
         // we need to delete time event in original thread
         {
           std::lock_guard<std::mutex> l(existing->lock);
+          exproto->detach_streams();
           existing->write_lock.lock();
           exproto->requeue_sent();
           // XXX: do we really need the locking for `outgoing_bl`? There is
@@ -2876,6 +3433,7 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
           existing->outgoing_bl.clear();
           existing->open_write = false;
           exproto->session_stream_handlers = std::move(temp_stream_handlers);
+          exproto->session_ktls = temp_ktls;
           exproto->session_compression_handlers = std::move(temp_compression_handlers);
           if (!reconnecting) {
             exproto->tx_frame_asm.set_is_rev1(tx_is_rev1);
@@ -3112,3 +3670,76 @@ CtPtr ProtocolV2::finish_compression() {
   state = SESSION_ACCEPTING;
   return CONTINUE(read_frame);
 }
+
+CtPtr ProtocolV2::handle_stream_attach(ceph::bufferlist &payload)
+{
+  ldout(cct, 20) << __func__
+		 << " payload.length()=" << payload.length() << dendl;
+
+  if (state != SESSION_ACCEPTING) {
+    lderr(cct) << __func__ << " not in session accept state!" << dendl;
+    return _fault();
+  }
+
+  auto attach = StreamAttachFrame::Decode(payload);
+
+  ldout(cct, 5) << __func__ << " received stream attach:"
+                << " addrs=" << attach.addrs()
+                << " client_cookie=" << std::hex << attach.client_cookie()
+                << " server_cookie=" << attach.server_cookie() << std::dec
+                << " index=" << attach.index() << dendl;
+
+  if (attach.addrs().empty() ||
+      attach.addrs().front() == entity_addr_t()) {
+    ldout(cct, 5) << __func__ << " oops, attach.addrs() is empty" << dendl;
+    return _fault();  // a v2 peer should never do this
+  }
+  if (!streams_offered ||
+      !HAVE_MSGR2_FEATURE(peer_supported_features, MULTISTREAM)) {
+    ldout(cct, 1) << __func__ << " streams were not negotiated" << dendl;
+    return _fault();
+  }
+
+  connection->set_peer_addrs(attach.addrs());
+  connection->target_addr = connection->_infer_target_addr(attach.addrs());
+
+  connection->lock.unlock();
+  AsyncConnectionRef existing = messenger->lookup_conn(*connection->peer_addrs);
+  ProtocolV2 *exproto = nullptr;
+  if (existing && existing->protocol->proto_type == 2 &&
+      existing->get_peer_type() == connection->get_peer_type() &&
+      existing->get_peer_global_id() == connection->get_peer_global_id()) {
+    exproto = static_cast<ProtocolV2*>(existing->protocol.get());
+  }
+  const bool joined = exproto &&
+    exproto->join_stream(connection, attach.client_cookie(),
+                         attach.server_cookie());
+  if (joined) {
+    messenger->accept_stream(connection);
+  }
+  connection->lock.lock();
+
+  if (!joined) {
+    ldout(cct, 1) << __func__ << " no session to join" << dendl;
+    return _fault();
+  }
+  stream_primary = existing;
+  stream_client_cookie = attach.client_cookie();
+  stream_server_cookie = attach.server_cookie();
+  stream_index = attach.index();
+  if (state != SESSION_ACCEPTING) {
+    ldout(cct, 1) << __func__ << " state changed while joining the session"
+                  << dendl;
+    if (state == CLOSED) {
+      leave_session();
+      return nullptr;
+    }
+    return _fault();
+  }
+
+  peer_name = exproto->peer_name;
+  connection->set_features(existing->get_features());
+
+  auto attach_ok = StreamAttachOkFrame::Encode(stream_index);
+  return WRITE(attach_ok, "stream attach ok", server_ready);
+}
@@ -4,6 +4,8 @@
 #ifndef _MSG_ASYNC_PROTOCOL_V2_
 #define _MSG_ASYNC_PROTOCOL_V2_
 
+#include <limits>
+
 #include "Protocol.h"
 #include "AsyncConnection.h"
 #include "crypto_onwire.h"
@@ -75,11 +77,15 @@ private:
   // TODO: move into auth_meta?
   ceph::crypto::onwire::rxtx_t session_stream_handlers;
   ceph::compression::onwire::rxtx_t session_compression_handlers;
+  // the kernel encrypts the secure mode stream instead of the handlers
+  bool session_ktls = false;
   
 private:
   entity_name_t peer_name;
   State state;
   uint64_t peer_supported_features;  // CEPH_MSGR2_FEATURE_*
+  bool ktls_offered = false;  // we advertised CEPH_MSGR2_FEATURE_KTLS
+  bool streams_offered = false;  // we advertised CEPH_MSGR2_FEATURE_MULTISTREAM
 
   uint64_t client_cookie;
   uint64_t server_cookie;
@@ -128,6 +134,43 @@ private:
   bool keepalive;
   bool write_in_progress = false;
 
+  /*
+   * A session between two OSDs may be striped over several streams.  The
+   * connection which established it, the primary, owns the session and
+   * its sequence numbers; the streams which joined it afterwards only
+   * carry the larger messages of the primary, in turn, and hand what they
+   * receive back to the primary, which dispatches the messages in
+   * sequence order.  Losing any stream faults the whole session, the
+   * lossless resend on reconnect takes care of the messages in flight.
+   *
+   * Lock order: primary write_lock, streams_lock, stream write_lock.  A
+   * stream may take streams_lock of its primary under its own lock, but
+   * never the other way around.
+   */
+  struct stream_frame_t {
+    ceph_msg_header2 header;
+    ceph::bufferlist front;
+    ceph::bufferlist middle;
+    ceph::bufferlist data;
+  };
+  // of a stream
+  AsyncConnectionRef stream_primary;
+  uint64_t stream_client_cookie = 0;
+  uint64_t stream_server_cookie = 0;
+  uint32_t stream_index = 0;
+  std::deque<stream_frame_t> stream_out;  // protected by write_lock
+  // messages received by us and waiting for earlier ones in the primary
+  std::atomic<unsigned> stream_parked{0};
+  // of a primary
+  std::mutex streams_lock;
+  bool streams_open = false;  // also protected by connection->lock
+  std::vector<AsyncConnectionRef> streams;
+  unsigned next_stream = 0;
+  std::map<uint64_t, std::pair<Message*, ProtocolV2*>> stream_reorder;
+  std::atomic<size_t> stream_reorder_len{0};
+  bool stream_delivering = false;
+  uint64_t stream_min_size = std::numeric_limits<uint64_t>::max();
+
   CompConnectionMeta comp_meta;
   std::ostream& _conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *pcontinuation);
@@ -150,6 +193,7 @@ private:
   uint64_t discard_requeued_up_to(uint64_t out_seq, uint64_t seq);
   void reset_recv_state();
   void reset_security();
+  bool maybe_enable_ktls(bool crossed);
   void reset_throttle();
   Ct<ProtocolV2> *_fault();
   void discard_out_queue();
@@ -160,6 +204,19 @@ private:
   void handle_message_ack(uint64_t seq);
   void reset_compression();
 
+  bool can_stripe() const;
+  void open_streams();
+  bool join_stream(AsyncConnection *stream, uint64_t client_cookie,
+                   uint64_t server_cookie);
+  void detach_streams();
+  bool write_to_stream(Message *m);
+  void write_stream_event();
+  void deliver_in_order(Message *m, ProtocolV2 *from);
+  void dispatch_in_order(Message *m);
+  void handle_stream_fault(const AsyncConnectionRef& stream);
+  void leave_session();
+  bool overcommit_throttle(Throttle &throttle, int64_t count);
+
   CONTINUATION_DECL(ProtocolV2, _wait_for_peer_banner);
   READ_BPTR_HANDLER_CONTINUATION_DECL(ProtocolV2, _handle_peer_banner);
   READ_BPTR_HANDLER_CONTINUATION_DECL(ProtocolV2, _handle_peer_banner_payload);
@@ -223,6 +280,8 @@ public:
   virtual void read_event() override;
   virtual void write_event() override;
   virtual bool is_queued() override;
+  virtual bool has_stalled_streams(ceph::coarse_mono_clock::time_point now,
+                                   uint64_t timeout_us) override;
 
   virtual void dump(Formatter *f) override;
 
@@ -254,6 +313,8 @@ private:
   Ct<ProtocolV2> *handle_server_ident(ceph::bufferlist &payload);
   Ct<ProtocolV2> *send_compression_request();
   Ct<ProtocolV2> *handle_compression_done(ceph::bufferlist &payload);
+  Ct<ProtocolV2> *send_stream_attach();
+  Ct<ProtocolV2> *handle_stream_attach_ok(ceph::bufferlist &payload);
 
 
   // Server Protocol
@@ -277,6 +338,7 @@ private:
   Ct<ProtocolV2> *send_reconnect_ok();
   Ct<ProtocolV2> *server_ready();
   Ct<ProtocolV2> *handle_compression_request(ceph::bufferlist &payload);
+  Ct<ProtocolV2> *handle_stream_attach(ceph::bufferlist &payload);
 
   size_t get_current_msg_size() const;
 };
@@ -26,6 +26,9 @@
 #ifdef HAVE_DPDK
 #include "dpdk/DPDKStack.h"
 #endif
+#ifdef HAVE_URING_MESSENGER
+#include "UringStack.h"
+#endif
 
 #include "common/dout.h"
 #include "include/ceph_assert.h"
@@ -75,6 +78,10 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c,
   else if (t == "dpdk")
     stack.reset(new DPDKStack(c));
 #endif
+#ifdef HAVE_URING_MESSENGER
+  else if (t == "uring")
+    stack.reset(new UringNetworkStack(c));
+#endif
 
   if (stack == nullptr) {
     lderr(c) << __func__ << " ms_async_transport_type " << t <<
@@ -47,6 +47,14 @@ class ConnectedSocketImpl {
   virtual void close() = 0;
   virtual int fd() const = 0;
   virtual void set_priority(int sd, int prio, int domain) = 0;
+  virtual void drain_error_queue() {}
+  virtual int attach_ktls() {
+    return -EOPNOTSUPP;
+  }
+  virtual int enable_ktls(const uint8_t *key, const uint8_t *rx_iv,
+                          const uint8_t *tx_iv) {
+    return -EOPNOTSUPP;
+  }
 };
 
 class ConnectedSocket;
@@ -142,6 +150,32 @@ class ConnectedSocket {
     _csi->set_priority(sd, prio, domain);
   }
 
+  /// Consume what the kernel queued on the error queue of the socket.
+  ///
+  /// Its EPOLLERR is level triggered and can't be masked, so it has to be
+  /// called on every event of the socket, whether the connection reads
+  /// from it or not.
+  void drain_error_queue() {
+    _csi->drain_error_queue();
+  }
+
+  /// Prepare the socket for kernel TLS.
+  ///
+  /// The stream passes through unchanged until enable_ktls(), returns
+  /// -EOPNOTSUPP if the stack or the kernel doesn't offer it.
+  int attach_ktls() {
+    return _csi->attach_ktls();
+  }
+  /// Encrypt and decrypt the stream in the kernel from now on.
+  ///
+  /// The records are TLS 1.3 AES-128-GCM ones, keyed by the 16 bytes
+  /// key, and the 12 bytes rx_iv and tx_iv.  Nothing may have been read
+  /// ahead of the received records.
+  int enable_ktls(const uint8_t *key, const uint8_t *rx_iv,
+                  const uint8_t *tx_iv) {
+    return _csi->enable_ktls(key, rx_iv, tx_iv);
+  }
+
   explicit operator bool() const {
     return _csi.get();
   }
@@ -225,6 +259,10 @@ enum {
   l_msgr_recv_encrypted_bytes,
   l_msgr_send_encrypted_bytes,
 
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_copied_bytes,
+  l_msgr_send_copied_bytes,
+
   l_msgr_last,
 };
 
@@ -283,6 +321,10 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_encrypted_bytes, "msgr_recv_encrypted_bytes", "Network received encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_encrypted_bytes, "msgr_send_encrypted_bytes", "Network sent encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
 
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent with MSG_ZEROCOPY", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_zerocopy_copied_bytes, "msgr_send_zerocopy_copied_bytes", "Network bytes sent with MSG_ZEROCOPY which the kernel copied", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_copied_bytes, "msgr_send_copied_bytes", "Network bytes sent by copying them", NULL, 0, unit_t(UNIT_BYTES));
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
 
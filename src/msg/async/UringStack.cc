@@ -0,0 +1,120 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "UringStack.h"
+#include "EventUring.h"
+
+#include "common/dout.h"
+#include "include/sock_compat.h"
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix *_dout << "UringStack "
+
+class UringConnectedSocketImpl final : public ConnectedSocketImpl {
+  ceph::NetHandler &handler;
+  EventCenter *center;
+  UringDriver *driver;
+  int _fd;
+  entity_addr_t sa;
+  bool connected;
+  // set once the socket is used from the thread of the center
+  UringDriver::Socket *sock = nullptr;
+
+  void attach() {
+    ceph_assert(center->in_thread());
+    sock = driver->attach(_fd);
+  }
+
+ public:
+  UringConnectedSocketImpl(ceph::NetHandler &h, EventCenter *c,
+                           const entity_addr_t &sa, int f, bool connected)
+    : handler(h), center(c),
+      driver(static_cast<UringDriver*>(c->get_driver())),
+      _fd(f), sa(sa), connected(connected) {}
+
+  int is_connected() override {
+    if (connected)
+      return 1;
+
+    int r = handler.reconnect(sa, _fd);
+    if (r == 0) {
+      connected = true;
+      return 1;
+    } else if (r < 0) {
+      return r;
+    } else {
+      return 0;
+    }
+  }
+
+  ssize_t read(char *buf, size_t len) override {
+    if (!sock) {
+      // read directly until the socket is drained, receiving from the ring
+      // only starts from there so that the data stays in order
+      ssize_t r = ::read(_fd, buf, len);
+      if (r >= 0) {
+        return r;
+      }
+      r = -ceph_sock_errno();
+      if (r != -EAGAIN) {
+        return r;
+      }
+      attach();
+    }
+    return driver->read(sock, buf, len);
+  }
+
+  ssize_t send(ceph::buffer::list &bl, bool more) override {
+    if (!sock) {
+      attach();
+    }
+    return driver->send(sock, bl);
+  }
+
+  void shutdown() override {
+    ::shutdown(_fd, SHUT_RDWR);
+  }
+
+  void close() override {
+    if (!sock) {
+      compat_closesocket(_fd);
+    } else if (center->in_thread()) {
+      driver->close(sock);
+    } else {
+      // the driver is only to be used from the thread of the center
+      center->submit_to(
+        center->get_id(),
+        [driver=driver, sock=sock] { driver->close(sock); },
+        true);
+    }
+  }
+
+  void set_priority(int sd, int prio, int domain) override {
+    handler.set_priority(sd, prio, domain);
+  }
+
+  int fd() const override {
+    return _fd;
+  }
+};
+
+std::unique_ptr<ConnectedSocketImpl> UringWorker::create_connected_socket(
+  const entity_addr_t &sa, int fd, bool connected)
+{
+  return std::make_unique<UringConnectedSocketImpl>(
+    net, &center, sa, fd, connected);
+}
@@ -0,0 +1,42 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_URINGSTACK_H
+#define CEPH_MSG_ASYNC_URINGSTACK_H
+
+#include "PosixStack.h"
+
+/*
+ * UringWorker sets up the sockets like the PosixWorker does, but their
+ * data path goes through the io_uring of its UringDriver instead of a
+ * read(2) or sendmsg(2) call each.
+ */
+class UringWorker : public PosixWorker {
+ public:
+  UringWorker(CephContext *c, unsigned i)
+      : PosixWorker(c, i) {}
+  std::unique_ptr<ConnectedSocketImpl> create_connected_socket(
+    const entity_addr_t &sa, int fd, bool connected) override;
+};
+
+class UringNetworkStack : public PosixNetworkStack {
+  Worker* create_worker(CephContext *c, unsigned worker_id) override {
+    return new UringWorker(c, worker_id);
+  }
+
+ public:
+  explicit UringNetworkStack(CephContext *c)
+      : PosixNetworkStack(c) {}
+};
+
+#endif //CEPH_MSG_ASYNC_URINGSTACK_H
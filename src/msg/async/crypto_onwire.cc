@@ -5,6 +5,7 @@
 #include "common/debug.h"
 #include "common/ceph_crypto.h"
 #include "include/buffer.h"
+#include "include/compat.h"
 #include "include/types.h"
 
 #include <openssl/evp.h>
@@ -276,6 +277,34 @@ void AES128GCM_OnWireRxHandler::authenticated_decrypt_update_final(
   }
 }
 
+// the connection secret of the secure mode is the key followed by the
+// initial rx and tx nonces
+static void parse_connection_secret(
+  const AuthConnectionMeta& auth_meta,
+  key_t& key,
+  nonce_t& rx_nonce,
+  nonce_t& tx_nonce)
+{
+  ceph_assert_always(auth_meta.connection_secret.length() >= \
+    sizeof(key_t) + 2 * sizeof(nonce_t));
+  const char* secbuf = auth_meta.connection_secret.c_str();
+
+  {
+    ::memcpy(key.data(), secbuf, sizeof(key));
+    secbuf += sizeof(key);
+  }
+
+  {
+    ::memcpy(&rx_nonce, secbuf, sizeof(rx_nonce));
+    secbuf += sizeof(rx_nonce);
+  }
+
+  {
+    ::memcpy(&tx_nonce, secbuf, sizeof(tx_nonce));
+    secbuf += sizeof(tx_nonce);
+  }
+}
+
 ceph::crypto::onwire::rxtx_t ceph::crypto::onwire::rxtx_t::create_handler_pair(
   CephContext* cct,
   const AuthConnectionMeta& auth_meta,
@@ -283,27 +312,10 @@ ceph::crypto::onwire::rxtx_t ceph::crypto::onwire::rxtx_t::create_handler_pair(
   bool crossed)
 {
   if (auth_meta.is_mode_secure()) {
-    ceph_assert_always(auth_meta.connection_secret.length() >= \
-      sizeof(key_t) + 2 * sizeof(nonce_t));
-    const char* secbuf = auth_meta.connection_secret.c_str();
-
     key_t key;
-    {
-      ::memcpy(key.data(), secbuf, sizeof(key));
-      secbuf += sizeof(key);
-    }
-
     nonce_t rx_nonce;
-    {
-      ::memcpy(&rx_nonce, secbuf, sizeof(rx_nonce));
-      secbuf += sizeof(rx_nonce);
-    }
-
     nonce_t tx_nonce;
-    {
-      ::memcpy(&tx_nonce, secbuf, sizeof(tx_nonce));
-      secbuf += sizeof(tx_nonce);
-    }
+    parse_connection_secret(auth_meta, key, rx_nonce, tx_nonce);
 
     return {
       std::make_unique<AES128GCM_OnWireRxHandler>(
@@ -316,4 +328,32 @@ ceph::crypto::onwire::rxtx_t ceph::crypto::onwire::rxtx_t::create_handler_pair(
   }
 }
 
+session_keys_t::~session_keys_t()
+{
+  ceph_memzero_s(this, sizeof(*this), sizeof(*this));
+}
+
+session_keys_t session_keys_t::get(
+  const AuthConnectionMeta& auth_meta,
+  bool crossed)
+{
+  ceph_assert_always(auth_meta.is_mode_secure());
+  static_assert(sizeof(session_keys_t::key) == sizeof(key_t));
+  static_assert(sizeof(session_keys_t::rx_nonce) == sizeof(nonce_t));
+
+  key_t key;
+  nonce_t rx_nonce;
+  nonce_t tx_nonce;
+  parse_connection_secret(auth_meta, key, rx_nonce, tx_nonce);
+
+  session_keys_t keys;
+  keys.key = key;
+  ::memcpy(keys.rx_nonce.data(), crossed ? &tx_nonce : &rx_nonce,
+	   sizeof(keys.rx_nonce));
+  ::memcpy(keys.tx_nonce.data(), crossed ? &rx_nonce : &tx_nonce,
+	   sizeof(keys.tx_nonce));
+  ceph_memzero_s(&key, sizeof(key), sizeof(key));
+  return keys;
+}
+
 } // namespace ceph::crypto::onwire
@@ -17,6 +17,7 @@
 #ifndef CEPH_CRYPTO_ONWIRE_H
 #define CEPH_CRYPTO_ONWIRE_H
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <stdexcept>
@@ -131,6 +132,20 @@ struct rxtx_t {
     bool crossed);
 };
 
+// The key and the nonces of a secure mode session, for the kernel to
+// encrypt the stream (kTLS) in place of the handlers above.
+struct session_keys_t {
+  std::array<std::uint8_t, 16> key;
+  std::array<std::uint8_t, 12> rx_nonce;
+  std::array<std::uint8_t, 12> tx_nonce;
+
+  ~session_keys_t();
+
+  static session_keys_t get(
+    const class AuthConnectionMeta& auth_meta,
+    bool crossed);
+};
+
 } // namespace ceph::crypto::onwire
 
 #endif // CEPH_CRYPTO_ONWIRE_H
@@ -64,7 +64,9 @@ enum class Tag : __u8 {
   KEEPALIVE2_ACK,
   ACK,
   COMPRESSION_REQUEST,
-  COMPRESSION_DONE
+  COMPRESSION_DONE,
+  STREAM_ATTACH,
+  STREAM_ATTACH_OK
 };
 
 struct segment_t {
@@ -901,6 +903,37 @@ protected:
   using ControlFrame::ControlFrame;
 };
 
+struct StreamAttachFrame
+    : public ControlFrame<StreamAttachFrame,
+                          entity_addrvec_t,  // my addresses
+                          uint64_t,  // client cookie
+                          uint64_t,  // server cookie
+                          uint32_t> { // stream index
+  static const Tag tag = Tag::STREAM_ATTACH;
+  using ControlFrame::Encode;
+  using ControlFrame::Decode;
+
+  inline entity_addrvec_t &addrs() { return get_val<0>(); }
+  inline uint64_t &client_cookie() { return get_val<1>(); }
+  inline uint64_t &server_cookie() { return get_val<2>(); }
+  inline uint32_t &index() { return get_val<3>(); }
+
+protected:
+  using ControlFrame::ControlFrame;
+};
+
+struct StreamAttachOkFrame : public ControlFrame<StreamAttachOkFrame,
+                                                 uint32_t> { // stream index
+  static const Tag tag = Tag::STREAM_ATTACH_OK;
+  using ControlFrame::Encode;
+  using ControlFrame::Decode;
+
+  inline uint32_t &index() { return get_val<0>(); }
+
+protected:
+  using ControlFrame::ControlFrame;
+};
+
 } // namespace ceph::msgr::v2
 
 #endif // _MSG_ASYNC_FRAMES_V2_
@@ -21,6 +21,12 @@
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#ifdef __linux__
+#include <linux/tls.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
 
 #include "net_handler.h"
 #include "common/debug.h"
@@ -169,6 +175,55 @@ void NetHandler::set_priority(int sd, int prio, int domain)
 #endif	// SO_PRIORITY
 }
 
+int NetHandler::attach_ktls(int sd)
+{
+#if defined(__linux__) && defined(TCP_ULP)
+  if (::setsockopt(sd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+    int r = ceph_sock_errno();
+    ldout(cct, 1) << __func__ << " couldn't attach kernel TLS: "
+		  << cpp_strerror(r) << dendl;
+    return -r;
+  }
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+int NetHandler::set_ktls_cipher(int sd, bool tx, const uint8_t *key,
+				const uint8_t *iv)
+{
+#if defined(__linux__) && defined(TLS_1_3_VERSION)
+  struct tls12_crypto_info_aes_gcm_128 info = {};
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+  static_assert(TLS_CIPHER_AES_GCM_128_KEY_SIZE == 16);
+  static_assert(TLS_CIPHER_AES_GCM_128_SALT_SIZE +
+		TLS_CIPHER_AES_GCM_128_IV_SIZE == 12);
+  // the 12 bytes nonce of a record is salt | iv, xor'ed with its sequence
+  // number by TLS 1.3
+  memcpy(info.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+  memcpy(info.salt, iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+  memcpy(info.iv, iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+	 TLS_CIPHER_AES_GCM_128_IV_SIZE);
+  int r = ::setsockopt(sd, SOL_TLS, tx ? TLS_TX : TLS_RX, &info, sizeof(info));
+  if (r < 0) {
+    r = ceph_sock_errno();
+  }
+  // don't leave the key around
+  ceph_memzero_s(&info, sizeof(info), sizeof(info));
+  if (r) {
+    ldout(cct, 1) << __func__ << " couldn't set the kernel TLS "
+		  << (tx ? "tx" : "rx") << " cipher: " << cpp_strerror(r)
+		  << dendl;
+    return -r;
+  }
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
 int NetHandler::generic_connect(const entity_addr_t& addr, const entity_addr_t &bind_addr, bool nonblock)
 {
   int ret;
@@ -41,6 +41,17 @@ namespace ceph {
     int reconnect(const entity_addr_t &addr, int sd);
     int nonblock_connect(const entity_addr_t &addr, const entity_addr_t& bind_addr);
     void set_priority(int sd, int priority, int domain);
+    /// attach the kernel TLS protocol, the stream is unchanged until a
+    /// cipher is set
+    int attach_ktls(int sd);
+    /**
+     * Have the kernel protect one direction of the stream with TLS 1.3
+     * AES-128-GCM records from now on.
+     *
+     * @param key    16 bytes
+     * @param iv     12 bytes, the record sequence number starts from 0
+     */
+    int set_ktls_cipher(int sd, bool tx, const uint8_t *key, const uint8_t *iv);
   };
 }
 
@@ -5,6 +5,7 @@
 #include "Compression.h"
 #include "common/pretty_binary.h"
 #include "common/debug.h"
+#include "common/errno.h"
 #include <asm-generic/errno-base.h>
 #include <vector>
 #include <limits>
@@ -15,6 +16,7 @@
 using ceph::bufferlist;
 using ceph::Formatter;
 using ceph::common::cmd_getval;
+using ceph::common::cmd_getval_or;
 
 BlueStore::SocketHook::SocketHook(BlueStore& store)
   : store(store)
@@ -49,6 +51,18 @@ BlueStore::SocketHook::SocketHook(BlueStore& store)
       this,
       "print compression stats, per collection");
     ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore cache shards",
+      this,
+      "print per shard cache hit rates and ghost list curves");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore online fsck "
+      "name=action,type=CephChoices,strings=start|stop|status "
+      "name=deep,type=CephBool,req=false",
+      this,
+      "start, stop or report the background fsck of the mounted store");
+    ceph_assert(r == 0);
   }
 }
 
@@ -177,6 +191,49 @@ int BlueStore::SocketHook::call(
     }
     f->close_section();
     return 0;
+  } else if (command == "bluestore cache shards") {
+    f->open_object_section("cache_shards");
+    f->dump_float("meta_ratio",
+      store.mempool_thread.meta_cache->get_cache_ratio());
+    f->dump_float("data_ratio",
+      store.mempool_thread.data_cache->get_cache_ratio());
+    f->open_array_section("onode");
+    for (auto i : store.onode_cache_shards) {
+      f->open_object_section("shard");
+      i->dump_demand(f);
+      f->close_section();
+    }
+    f->close_section();
+    f->open_array_section("buffer");
+    for (auto i : store.buffer_cache_shards) {
+      f->open_object_section("shard");
+      f->dump_unsigned("bytes", i->_get_bytes());
+      i->dump_demand(f);
+      f->close_section();
+    }
+    f->close_section();
+    f->close_section();
+    return 0;
+  } else if (command == "bluestore online fsck") {
+    std::string action;
+    cmd_getval(cmdmap, "action", action);
+    if (action == "start") {
+      bool deep = cmd_getval_or<bool>(cmdmap, "deep", false);
+      r = store.online_fsck_start(deep);
+      if (r == -EBUSY) {
+        ss << "online fsck is already running" << std::endl;
+        return r;
+      } else if (r < 0) {
+        ss << "failed to start online fsck: " << cpp_strerror(r) << std::endl;
+        return r;
+      }
+    } else if (action == "stop") {
+      store.online_fsck_stop();
+    }
+    f->open_object_section("online_fsck");
+    store.online_fsck_dump(f);
+    f->close_section();
+    return 0;
   } else {
     ss << "Invalid command" << std::endl;
     r = -ENOSYS;
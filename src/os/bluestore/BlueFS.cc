@@ -9,6 +9,7 @@
 #include "BlueFS.h"
 
 #include "common/Clock.h" // for ceph_clock_now()
+#include "common/Thread.h"
 #include "common/debug.h"
 #include "common/errno.h"
 #include "common/JSONFormatter.h"
@@ -221,6 +222,7 @@ BlueFS::BlueFS(CephContext* cct)
 BlueFS::~BlueFS()
 {
   delete asok_hook;
+  _stop_bdev_flushers();
   for (auto p : ioc) {
     if (p)
       p->aio_wait();
@@ -462,6 +464,31 @@ void BlueFS::_init_logger()
                 "Average allocation latency for primary/shared device",
                 "bsal",
                 PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_avg(l_bluefs_log_sync_group_size, "log_sync_group_size",
+                "Average number of fsyncs served by one metadata log sync");
+  b.add_u64_counter(l_bluefs_log_sync_coalesced, "log_sync_coalesced",
+                    "Fsyncs that got their metadata synced by another thread");
+
+  PerfHistogramCommon::axis_config_d group_size_config{
+    "Group size",
+    PerfHistogramCommon::SCALE_LINEAR,
+    0,                                 ///< Start at 0
+    1,                                 ///< Quantization unit is 1
+    32,                                ///< Groups up to >30 fsyncs
+  };
+  PerfHistogramCommon::axis_config_d group_lat_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,                                 ///< Start at 0
+    8,                                 ///< Quantization unit is 8usec
+    16,                                ///< Ranges into the 100s of mS
+  };
+  b.add_u64_counter_histogram(
+    l_bluefs_log_sync_group_hist, "log_sync_group_histogram",
+    group_size_config, group_lat_config,
+    "Histogram of metadata log sync group size vs. sync latency");
+  b.add_u64_counter(l_bluefs_flush_bdev_parallel, "flush_bdev_parallel",
+                    "Device flushes issued to several devices in parallel");
 
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
@@ -789,6 +816,7 @@ int BlueFS::mkfs(uuid_d osd_uuid, const bluefs_layout_t& layout)
   _flush_bdev();
 
   // clean up
+  _stop_bdev_flushers();
   super = bluefs_super_t();
   _close_writer(log.writer);
   log.writer = NULL;
@@ -1204,6 +1232,7 @@ void BlueFS::umount(bool avoid_compact)
   if (cct->_conf->bluefs_check_volume_selector_on_umount) {
     _check_vselector_LNF();
   }
+  _stop_bdev_flushers();
   _close_writer(log.writer);
   log.writer = NULL;
   log.t.clear();
@@ -3761,6 +3790,60 @@ int BlueFS::_flush_and_sync_log_LD(uint64_t want_seq)
   return 0;
 }
 
+bool BlueFS::_is_log_seq_stable_D(uint64_t seq)
+{
+  std::lock_guard dl(dirty.lock);
+  return seq <= dirty.seq_stable;
+}
+
+// Group commit for fsync.  While one thread (the leader) is syncing the
+// metadata log, others wanting it synced wait instead of queueing up on
+// log.lock.  Once it's done, whoever is still not stable elects a new
+// leader whose single log write + device flush covers all of them.
+int BlueFS::_flush_and_sync_log_group_LD(uint64_t want_seq)
+{
+  ceph_assert(want_seq);
+  std::unique_lock l(log_sync.lock);
+  if (_is_log_seq_stable_D(want_seq)) {
+    return 0;
+  }
+  uint64_t gen = log_sync.gen;
+  ++log_sync.waiting;
+  while (log_sync.in_progress) {
+    log_sync.cond.wait(l);
+  }
+  if (_is_log_seq_stable_D(want_seq)) {
+    if (gen == log_sync.gen) {
+      // synced by a leader that started before we joined
+      --log_sync.waiting;
+    }
+    logger->inc(l_bluefs_log_sync_coalesced);
+    return 0;
+  }
+  // everyone waiting has a seq no newer than the one we are about to sync
+  uint64_t group_size = log_sync.waiting;
+  log_sync.waiting = 0;
+  ++log_sync.gen;
+  log_sync.in_progress = true;
+  l.unlock();
+
+  dout(20) << __func__ << " want_seq " << want_seq
+	   << " leading a group of " << group_size << dendl;
+  auto t0 = mono_clock::now();
+  int r = _flush_and_sync_log_LD(want_seq);
+  auto lat = mono_clock::now() - t0;
+
+  l.lock();
+  log_sync.in_progress = false;
+  log_sync.cond.notify_all();
+  l.unlock();
+
+  logger->inc(l_bluefs_log_sync_group_size, group_size);
+  logger->hinc(l_bluefs_log_sync_group_hist, group_size,
+	       std::chrono::duration_cast<std::chrono::microseconds>(lat).count());
+  return r;
+}
+
 // Flushes log and immediately adjusts log_writer pos.
 int BlueFS::_flush_and_sync_log_jump_D(uint64_t jump_to)
 {
@@ -4324,7 +4407,11 @@ int BlueFS::_fsync(FileWriter *h, bool force_dirty)/*_F_D_LD_LNF_NF*/
     }
   }
   if (old_dirty_seq) {
-    _flush_and_sync_log_LD(old_dirty_seq);
+    if (cct->_conf->bluefs_group_commit) {
+      _flush_and_sync_log_group_LD(old_dirty_seq);
+    } else {
+      _flush_and_sync_log_LD(old_dirty_seq);
+    }
   }
   _maybe_compact_log_LNF_NF_LD_D();
   logger->tinc_with_max(l_bluefs_fsync_lat, mono_clock::now() - t0);
@@ -4358,6 +4445,11 @@ void BlueFS::_flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs)
 {
   // NOTE: this is safe to call without a lock.
   dout(20) << __func__ << dendl;
+  if (cct->_conf->bluefs_group_commit &&
+      std::count(dirty_bdevs.begin(), dirty_bdevs.end(), true) > 1) {
+    _flush_bdev_parallel(dirty_bdevs);
+    return;
+  }
   for (unsigned i = 0; i < MAX_BDEV; i++) {
     if (dirty_bdevs[i])
       bdev[i]->flush();
@@ -4368,12 +4460,85 @@ void BlueFS::_flush_bdev()
 {
   // NOTE: this is safe to call without a lock.
   dout(20) << __func__ << dendl;
+  std::array<bool, MAX_BDEV> devs;
   for (unsigned i = 0; i < MAX_BDEV; i++) {
     // alloc space from BDEV_SLOW is unexpected.
     // So most cases we don't alloc from BDEV_SLOW and so avoiding flush not-used device.
-    if (bdev[i] && (i != BDEV_SLOW || _get_used(i))) {
-      bdev[i]->flush();
+    devs[i] = bdev[i] && (i != BDEV_SLOW || _get_used(i));
+  }
+  _flush_bdev(devs);
+}
+
+// Flush each device from its own thread, so that syncing the slow device
+// overlaps with syncing the fast ones rather than adding up.  The first
+// device is flushed by the caller, the others by their flusher threads.
+void BlueFS::_flush_bdev_parallel(const std::array<bool, MAX_BDEV>& devs)
+{
+  std::array<uint64_t, MAX_BDEV> seqs = {};
+  int inline_dev = -1;
+  for (unsigned i = 0; i < MAX_BDEV; i++) {
+    if (!devs[i]) {
+      continue;
+    }
+    if (inline_dev < 0) {
+      inline_dev = i;
+      continue;
+    }
+    auto& f = bdev_flushers[i];
+    std::lock_guard l(f.lock);
+    if (!f.thread.joinable()) {
+      f.thread = make_named_thread(
+        "bluefs_flush", &BlueFS::_bdev_flusher_entry, this, i);
+    }
+    seqs[i] = ++f.requested;
+    f.cond.notify_all();
+  }
+  if (inline_dev >= 0) {
+    bdev[inline_dev]->flush();
+  }
+  for (unsigned i = 0; i < MAX_BDEV; i++) {
+    if (!seqs[i]) {
+      continue;
+    }
+    auto& f = bdev_flushers[i];
+    std::unique_lock l(f.lock);
+    f.cond.wait(l, [&] { return f.done >= seqs[i]; });
+  }
+  logger->inc(l_bluefs_flush_bdev_parallel);
+}
+
+void BlueFS::_bdev_flusher_entry(unsigned id)
+{
+  auto& f = bdev_flushers[id];
+  std::unique_lock l(f.lock);
+  while (f.done < f.requested || !f.stop) {
+    if (f.done == f.requested) {
+      f.cond.wait(l);
+      continue;
+    }
+    // one flush covers everything requested before it starts
+    uint64_t seq = f.requested;
+    l.unlock();
+    bdev[id]->flush();
+    l.lock();
+    f.done = seq;
+    f.cond.notify_all();
+  }
+}
+
+void BlueFS::_stop_bdev_flushers()
+{
+  for (auto& f : bdev_flushers) {
+    {
+      std::lock_guard l(f.lock);
+      if (!f.thread.joinable()) {
+        continue;
+      }
+      f.stop = true;
+      f.cond.notify_all();
     }
+    f.thread.join();
+    f.stop = false;
   }
 }
 
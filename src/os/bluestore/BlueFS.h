@@ -7,6 +7,7 @@
 #include <atomic>
 #include <mutex>
 #include <limits>
+#include <thread>
 #include <uuid/uuid.h>
 
 #include "bluefs_types.h"
@@ -88,6 +89,10 @@ enum {
   l_bluefs_wal_alloc_lat,
   l_bluefs_db_alloc_lat,
   l_bluefs_slow_alloc_lat,
+  l_bluefs_log_sync_group_size,
+  l_bluefs_log_sync_coalesced,
+  l_bluefs_log_sync_group_hist,
+  l_bluefs_flush_bdev_parallel,
   l_bluefs_last,
 };
 
@@ -588,6 +593,27 @@ private:
     // 2) we usually not remove extents from files. And when we do, we force log-syncing.
   } dirty;
 
+  // group commit of metadata log syncs requested by fsync
+  struct {
+    ceph::mutex lock = ceph::make_mutex("BlueFS::log_sync.lock");
+    ceph::condition_variable cond;
+    bool in_progress = false; ///< a group leader is syncing the log
+    uint64_t gen = 0;         ///< bumped whenever a leader takes over waiters
+    uint64_t waiting = 0;     ///< syncs requested since the last leader started
+  } log_sync;
+
+  // a thread per device flushing it when a group commit spans several
+  // devices, started on the first such flush
+  struct bdev_flusher_t {
+    ceph::mutex lock = ceph::make_mutex("BlueFS::bdev_flusher.lock");
+    ceph::condition_variable cond;
+    std::thread thread;
+    bool stop = false;
+    uint64_t requested = 0;   ///< flushes asked for so far
+    uint64_t done = 0;        ///< the last of them covered by a flush
+  };
+  std::array<bdev_flusher_t, MAX_BDEV> bdev_flushers;
+
   ceph::condition_variable log_cond;                             ///< used for state control between log flush / log compaction
   std::atomic<bool> log_is_compacting{false};                    ///< signals that bluefs log is already ongoing compaction
   std::atomic<bool> log_forbidden_to_expand{false};              ///< used to signal that async compaction is in state
@@ -683,6 +709,8 @@ private:
   void _flush_and_sync_log_core();
   int _flush_and_sync_log_jump_D(uint64_t jump_to);
   int _flush_and_sync_log_LD(uint64_t want_seq = 0);
+  int _flush_and_sync_log_group_LD(uint64_t want_seq);
+  bool _is_log_seq_stable_D(uint64_t seq);
 
   uint64_t _estimate_transaction_size(bluefs_transaction_t* t);
   uint64_t _make_initial_transaction(uint64_t start_seq,
@@ -718,6 +746,9 @@ private:
   void _flush_bdev(FileWriter *h, bool check_mutex_locked = true);
   void _flush_bdev();  // this is safe to call without a lock
   void _flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs);  // this is safe to call without a lock
+  void _flush_bdev_parallel(const std::array<bool, MAX_BDEV>& devs);
+  void _bdev_flusher_entry(unsigned id);
+  void _stop_bdev_flushers();
 
   int64_t _read_envmode(
     FileReader *h,   ///< [in] read from here
@@ -46,8 +46,10 @@
 #include "common/JSONFormatter.h"
 #include "common/safe_io.h"
 #include "common/PriorityCache.h"
+#include "common/buffer_instrumentation.h"
 #include "common/url_escape.h"
 #include "Allocator.h"
+#include "ShardedAllocator.h"
 #include "FreelistManager.h"
 #include "BlueFS.h"
 #include "BlueRocksEnv.h"
@@ -1081,6 +1083,86 @@ int64_t BlueStore::GarbageCollector::estimate(
   return expected_for_release - expected_allocations;
 }
 
+// CacheGhost
+void BlueStore::CacheGhost::add(uint64_t key, uint64_t weight)
+{
+  stamp += weight;
+  auto p = index.find(key);
+  if (p != index.end()) {
+    size -= p->second.weight;
+    lru.erase(p->second.pos);
+    index.erase(p);
+  }
+  lru.push_front(key);
+  index.emplace(key, entry_t{weight, stamp, lru.begin()});
+  size += weight;
+  set_capacity(capacity);
+}
+
+bool BlueStore::CacheGhost::take(uint64_t key, uint64_t *depth)
+{
+  auto p = index.find(key);
+  if (p == index.end()) {
+    return false;
+  }
+  *depth = std::min(*depth, stamp - p->second.stamp);
+  size -= p->second.weight;
+  lru.erase(p->second.pos);
+  index.erase(p);
+  return true;
+}
+
+void BlueStore::CacheGhost::note_hit(uint64_t depth)
+{
+  unsigned b = capacity ? std::min<uint64_t>(depth * BUCKETS / capacity,
+                                             BUCKETS - 1) : 0;
+  ++bucket_hits[b];
+  ++hits;
+}
+
+void BlueStore::CacheGhost::set_capacity(uint64_t c)
+{
+  capacity = c;
+  while (size > capacity && !lru.empty()) {
+    auto p = index.find(lru.back());
+    ceph_assert(p != index.end());
+    size -= p->second.weight;
+    index.erase(p);
+    lru.pop_back();
+  }
+}
+
+// CacheShard
+void BlueStore::CacheShard::dump_demand(ceph::Formatter *f)
+{
+  std::lock_guard l(lock);
+  uint64_t h = hits;
+  uint64_t m = misses;
+  f->dump_unsigned("max", max);
+  f->dump_unsigned("num", num);
+  f->dump_unsigned("hits", h);
+  f->dump_unsigned("misses", m);
+  f->dump_float("hit_ratio", h + m ? (double)h / (h + m) : 0);
+  f->dump_float("share", share);
+  f->dump_float("gain", gain);
+  f->open_object_section("ghost");
+  f->dump_unsigned("capacity", ghost.capacity);
+  f->dump_unsigned("size", ghost.size);
+  f->dump_unsigned("hits", ghost.hits);
+  // hit ratio the shard would have seen with that much extra space
+  f->open_array_section("curve");
+  uint64_t cum = 0;
+  for (unsigned i = 0; i < CacheGhost::BUCKETS; ++i) {
+    cum += ghost.bucket_hits[i];
+    f->open_object_section("point");
+    f->dump_unsigned("extra", ghost.capacity * (i + 1) / CacheGhost::BUCKETS);
+    f->dump_float("hit_ratio", h + m ? (double)(h + cum) / (h + m) : 0);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
 // LruOnodeCacheShard
 struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
   typedef boost::intrusive::list<
@@ -1090,15 +1172,23 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       boost::intrusive::list_member_hook<>,
       &BlueStore::Onode::lru_item> > list_t;
 
+  /// max onodes looked at per trim when packing the cold ones
+  static constexpr unsigned PACK_BATCH = 32;
+
   list_t lru;
+  list_t packed_lru;  ///< unpinned onodes colder than lru, all packed
 
   explicit LruOnodeCacheShard(CephContext *cct) : BlueStore::OnodeCacheShard(cct) {}
 
+  list_t& _lru_of(BlueStore::Onode* o) {
+    return o->packed ? packed_lru : lru;
+  }
+
   void _add(BlueStore::Onode* o, int level) override
   {
     o->set_cached();
     if (o->pin_nref == 1) {
-      (level > 0) ? lru.push_front(*o) : lru.push_back(*o);
+      (level > 0) ? _lru_of(o).push_front(*o) : _lru_of(o).push_back(*o);
       o->cache_age_bin = age_bins.front();
       *(o->cache_age_bin) += 1;
     }
@@ -1111,7 +1201,8 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     o->clear_cached();
     if (o->lru_item.is_linked()) {
       *(o->cache_age_bin) -= 1;
-      lru.erase(lru.iterator_to(*o));
+      auto& l = _lru_of(o);
+      l.erase(l.iterator_to(*o));
     }
     ceph_assert(num);
     --num;
@@ -1131,7 +1222,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     if (o->is_cached() && o->pin_nref == 1) {
       if(!o->lru_item.is_linked()) {
         if (o->exists) {
-	  lru.push_front(*o);
+	  _lru_of(o).push_front(*o);
 	  o->cache_age_bin = age_bins.front();
 	  *(o->cache_age_bin) += 1;
 	  dout(20) << __func__ << " " << this << " " << o->oid << " unpinned"
@@ -1147,8 +1238,9 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
         }
       } else if (o->exists) {
         // move onode within LRU
-        lru.erase(lru.iterator_to(*o));
-        lru.push_front(*o);
+        auto& l = _lru_of(o);
+        l.erase(l.iterator_to(*o));
+        l.push_front(*o);
         if (o->cache_age_bin != age_bins.front()) {
           *(o->cache_age_bin) -= 1;
           o->cache_age_bin = age_bins.front();
@@ -1161,32 +1253,75 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     ocs->lock.unlock();
   }
 
-  void _trim_to(uint64_t new_size) override
+  void _unpack(BlueStore::Onode* o) override
   {
-    if (new_size >= lru.size()) {
-      return; // don't even try
-    } 
-    uint64_t n = num - new_size; // note: we might get empty LRU
-                                 // before n == 0 due to pinned
-                                 // entries. And hence being unable
-                                 // to reach new_size target.
-    while (n-- > 0 && lru.size() > 0) {
-      BlueStore::Onode *o = &lru.back();
-      lru.pop_back();
-
-      dout(20) << __func__ << "  rm " << o->oid << " "
-               << o->nref << " " << o->cached << dendl;
+    ceph_assert(o->packed);
+    bool linked = o->lru_item.is_linked();
+    if (linked) {
+      packed_lru.erase(packed_lru.iterator_to(*o));
+    }
+    o->unpack();
+    if (linked) {
+      lru.push_front(*o);
+    }
+    logger->inc(l_bluestore_onode_unpacks);
+    dout(20) << __func__ << " " << this << " " << o->oid << dendl;
+  }
 
-      *(o->cache_age_bin) -= 1;
-      if (o->pin_nref > 1) {
-        dout(20) << __func__ << " " << this << " " << " " << " " << o->oid << dendl;
-      } else {
-	ceph_assert(num);
-        --num;
-        o->clear_cached();
-        o->c->onode_space._remove(o->oid);
+  void _trim_to(uint64_t new_size) override
+  {
+    if (new_size < lru.size() + packed_lru.size()) {
+      uint64_t n = num - new_size; // note: we might get empty LRU
+                                   // before n == 0 due to pinned
+                                   // entries. And hence being unable
+                                   // to reach new_size target.
+      while (n-- > 0 && lru.size() + packed_lru.size() > 0) {
+        // packed onodes are the coldest ones
+        auto& l = packed_lru.empty() ? lru : packed_lru;
+        BlueStore::Onode *o = &l.back();
+        l.pop_back();
+
+        dout(20) << __func__ << "  rm " << o->oid << " "
+                 << o->nref << " " << o->cached << dendl;
+
+        *(o->cache_age_bin) -= 1;
+        if (o->pin_nref > 1) {
+          dout(20) << __func__ << " " << this << " " << " " << " " << o->oid << dendl;
+        } else {
+	  ceph_assert(num);
+          --num;
+          o->clear_cached();
+          if (ghost.enabled()) {
+            ghost.add(std::hash<ghobject_t>{}(o->oid), 1);
+          }
+          o->c->onode_space._remove(o->oid);
+        }
       }
     }
+    _pack_cold();
+  }
+  /// pack onodes off the tail of lru until just 1 - pack_ratio of the
+  /// unpinned ones remain unpacked
+  void _pack_cold()
+  {
+    if (pack_ratio <= 0) {
+      return;
+    }
+    uint64_t hot_max = (lru.size() + packed_lru.size()) * (1.0 - pack_ratio);
+    unsigned budget = PACK_BATCH;
+    auto p = lru.end();
+    while (lru.size() > hot_max && p != lru.begin() && budget-- > 0) {
+      --p;
+      BlueStore::Onode *o = &*p;
+      if (o->pin_nref > 1 || !o->pack()) {
+        continue;
+      }
+      p = lru.erase(p);
+      packed_lru.push_front(*o);
+      logger->inc(l_bluestore_onode_packs);
+      dout(20) << __func__ << " " << this << " " << o->oid << " packed"
+               << dendl;
+    }
   }
   void _move_pinned(OnodeCacheShard *to, BlueStore::Onode *o) override
   {
@@ -1197,11 +1332,13 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     ceph_assert(o->nref > 1);
     to->_add(o, 0);
   }
-  void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) override
+  void add_stats(uint64_t *onodes, uint64_t *pinned_onodes,
+                 uint64_t *packed_onodes) override
   {
     std::lock_guard l(lock);
     *onodes += num;
-    *pinned_onodes += num - lru.size();
+    *pinned_onodes += num - lru.size() - packed_lru.size();
+    *packed_onodes += packed_lru.size();
   }
 #ifdef DEBUG_CACHE
   void _audit(const char *when) override
@@ -1293,6 +1430,7 @@ struct LruBufferCacheShard : public BlueStore::BufferCacheShard {
       dout(20) << __func__ << " rm " << *b << dendl;
       ceph_assert(*(b->cache_age_bin) >= b->length);
       *(b->cache_age_bin) -= b->length;
+      _ghost_evict(b);
       b->space->_rm_buffer(this, b);
     }
     num = lru.size();
@@ -1395,15 +1533,32 @@ public:
       case BUFFER_WARM_IN:
         // stay in warm_in.  move to front, even though 2Q doesn't actually
         // do this.
-        dout(20) << __func__ << " move to front of warm " << *b << dendl;
-        warm_in.push_front(*b);
+        if (level > 0) {
+          dout(20) << __func__ << " move to front of warm " << *b << dendl;
+          warm_in.push_front(*b);
+        } else {
+          dout(20) << __func__ << " move to back of warm " << *b << dendl;
+          warm_in.push_back(*b);
+        }
         break;
       case BUFFER_WARM_OUT:
+        if (level <= 0) {
+          // a cold read is no sign of reuse, don't promote it to hot
+          dout(20) << __func__ << " move to back of warm " << *b << dendl;
+          b->cache_private = BUFFER_WARM_IN;
+          warm_in.push_back(*b);
+          break;
+        }
         b->cache_private = BUFFER_HOT;
         // move to hot.  fall-thru
       case BUFFER_HOT:
-        dout(20) << __func__ << " move to front of hot " << *b << dendl;
-        hot.push_front(*b);
+        if (level > 0) {
+          dout(20) << __func__ << " move to front of hot " << *b << dendl;
+          hot.push_front(*b);
+        } else {
+          dout(20) << __func__ << " move to back of hot " << *b << dendl;
+          hot.push_back(*b);
+        }
         break;
       default:
         ceph_abort_msg("bad cache_private");
@@ -1557,6 +1712,7 @@ public:
         *(b->cache_age_bin) -= b->length;
 	to_evict_bytes -= b->length;
         evicted += b->length;
+        _ghost_evict(b);
         b->state = BlueStore::Buffer::STATE_EMPTY;
         b->data.clear();
         warm_in.erase(warm_in.iterator_to(*b));
@@ -1587,6 +1743,7 @@ public:
         // adjust evict size before buffer goes invalid
         to_evict_bytes -= b->length;
         evicted += b->length;
+        _ghost_evict(b);
         b->space->_rm_buffer(this, b);
       }
 
@@ -1668,6 +1825,289 @@ public:
 #endif
 };
 
+// ArcBufferCacheShard
+//
+// Adaptive Replacement Cache, after Megiddo & Modha.  Buffers seen once
+// live in t1, buffers seen again in t2; evicted buffers stay behind as
+// empty buffers in b1/b2 so that asking for their data again tells us
+// which of t1/t2 deserved more room.  Sizes are in bytes.
+
+struct ArcBufferCacheShard : public BlueStore::BufferCacheShard {
+  typedef boost::intrusive::list<
+    BlueStore::Buffer,
+    boost::intrusive::member_hook<
+      BlueStore::Buffer,
+      boost::intrusive::list_member_hook<>,
+      &BlueStore::Buffer::lru_item> > list_t;
+  list_t t1;  ///< "T1" buffers accessed once recently
+  list_t b1;  ///< "B1" empty buffers evicted from t1
+  list_t t2;  ///< "T2" buffers accessed more than once
+  list_t b2;  ///< "B2" empty buffers evicted from t2
+
+  enum {
+    BUFFER_NEW = 0,
+    BUFFER_T1,
+    BUFFER_B1,
+    BUFFER_T2,
+    BUFFER_B2,
+    BUFFER_TYPE_MAX
+  };
+
+  uint64_t list_bytes[BUFFER_TYPE_MAX] = {0}; ///< bytes per list, incl. ghosts
+  uint64_t target_t1 = 0;                     ///< "p", adaptive size of t1
+
+public:
+  explicit ArcBufferCacheShard(BlueStore* store) : BufferCacheShard(store) {}
+
+  list_t& _get_list(uint16_t which) {
+    switch (which) {
+    case BUFFER_T1:
+      return t1;
+    case BUFFER_B1:
+      return b1;
+    case BUFFER_T2:
+      return t2;
+    case BUFFER_B2:
+      return b2;
+    default:
+      ceph_abort_msg("bad cache_private");
+    }
+  }
+
+  void _adapt(uint16_t ghost, uint64_t length)
+  {
+    uint64_t c = max;
+    if (ghost == BUFFER_B1) {
+      uint64_t d = std::max<uint64_t>(
+        1, list_bytes[BUFFER_B2] / std::max<uint64_t>(1, list_bytes[BUFFER_B1]));
+      target_t1 = std::min(c, target_t1 + d * length);
+    } else {
+      uint64_t d = std::max<uint64_t>(
+        1, list_bytes[BUFFER_B1] / std::max<uint64_t>(1, list_bytes[BUFFER_B2]));
+      target_t1 = target_t1 > d * length ? target_t1 - d * length : 0;
+    }
+    dout(20) << __func__ << " ghost hit in " << (ghost == BUFFER_B1 ? "b1" : "b2")
+             << " target_t1 " << target_t1 << dendl;
+  }
+
+  void _add(BlueStore::Buffer *b, int level, BlueStore::Buffer *near) override
+  {
+    dout(20) << __func__ << " level " << level << " near " << near
+             << " on " << *b
+             << " which has cache_private " << b->cache_private << dendl;
+    ceph_assert(b->is_clean() || b->is_empty());
+    if (near) {
+      b->cache_private = near->cache_private;
+    }
+    if (near && !near->is_writing()) {
+      auto& l = _get_list(b->cache_private);
+      l.insert(l.iterator_to(*near), *b);
+    } else if (level <= 0) {
+      // cold hint (e.g. scrub or recovery): first in line for eviction,
+      // without promoting or adapting on whatever was cached here before
+      ceph_assert(!b->is_empty());
+      b->cache_private = BUFFER_T1;
+      t1.push_back(*b);
+    } else {
+      switch (b->cache_private) {
+      case BUFFER_NEW:
+        b->cache_private = BUFFER_T1;
+        t1.push_front(*b);
+        break;
+      case BUFFER_B1:
+      case BUFFER_B2:
+        _adapt(b->cache_private, b->length);
+        // fall-thru
+      case BUFFER_T1:
+      case BUFFER_T2:
+        dout(20) << __func__ << " move to front of t2 " << *b << dendl;
+        b->cache_private = BUFFER_T2;
+        t2.push_front(*b);
+        break;
+      default:
+        ceph_abort_msg("bad cache_private");
+      }
+    }
+    b->cache_age_bin = age_bins.front();
+    list_bytes[b->cache_private] += b->length;
+    if (!b->is_empty()) {
+      buffer_bytes += b->length;
+      *(b->cache_age_bin) += b->length;
+    }
+    num = t1.size() + t2.size();
+  }
+
+  void _rm(BlueStore::Buffer *b) override
+  {
+    dout(20) << __func__ << " " << *b << dendl;
+    ceph_assert(list_bytes[b->cache_private] >= b->length);
+    list_bytes[b->cache_private] -= b->length;
+    if (!b->is_empty()) {
+      ceph_assert(buffer_bytes >= b->length);
+      buffer_bytes -= b->length;
+      ceph_assert(*(b->cache_age_bin) >= b->length);
+      *(b->cache_age_bin) -= b->length;
+    }
+    auto& l = _get_list(b->cache_private);
+    l.erase(l.iterator_to(*b));
+    num = t1.size() + t2.size();
+  }
+
+  void _move(BlueStore::BufferCacheShard *srcc, BlueStore::Buffer *b) override
+  {
+    ArcBufferCacheShard *src = static_cast<ArcBufferCacheShard*>(srcc);
+    src->_rm(b);
+
+    // preserve which list we're on (even if we can't preserve the order!)
+    ceph_assert(b->is_empty() ==
+                (b->cache_private == BUFFER_B1 ||
+                 b->cache_private == BUFFER_B2));
+    _get_list(b->cache_private).push_back(*b);
+    list_bytes[b->cache_private] += b->length;
+    if (!b->is_empty()) {
+      buffer_bytes += b->length;
+      *(b->cache_age_bin) += b->length;
+    }
+    num = t1.size() + t2.size();
+  }
+
+  void _adjust_size(BlueStore::Buffer *b, int64_t delta) override
+  {
+    dout(20) << __func__ << " delta " << delta << " on " << *b << dendl;
+    ceph_assert((int64_t)list_bytes[b->cache_private] + delta >= 0);
+    list_bytes[b->cache_private] += delta;
+    if (!b->is_empty()) {
+      ceph_assert((int64_t)buffer_bytes + delta >= 0);
+      buffer_bytes += delta;
+      ceph_assert(*(b->cache_age_bin) + delta >= 0);
+      *(b->cache_age_bin) += delta;
+    }
+  }
+
+  void _touch(BlueStore::Buffer *b) override {
+    switch (b->cache_private) {
+    case BUFFER_T1:
+      if (b->cache_age_bin == age_bins.front()) {
+        // still the same burst of accesses (e.g. a buffer consumed by
+        // several small sequential reads), don't count it as reuse
+        break;
+      }
+      t1.erase(t1.iterator_to(*b));
+      list_bytes[BUFFER_T1] -= b->length;
+      b->cache_private = BUFFER_T2;
+      list_bytes[BUFFER_T2] += b->length;
+      t2.push_front(*b);
+      break;
+    case BUFFER_T2:
+      t2.erase(t2.iterator_to(*b));
+      t2.push_front(*b);
+      break;
+    default:
+      ceph_abort_msg("only cached buffers can be touched");
+    }
+    *(b->cache_age_bin) -= b->length;
+    b->cache_age_bin = age_bins.front();
+    *(b->cache_age_bin) += b->length;
+    num = t1.size() + t2.size();
+    _audit("_touch_buffer end");
+  }
+
+  void _trim_to(uint64_t max) override
+  {
+    uint64_t evicted = 0;
+    while (buffer_bytes > max) {
+      bool from_t1 = !t1.empty() &&
+        (list_bytes[BUFFER_T1] > target_t1 || t2.empty());
+      if (!from_t1 && t2.empty()) {
+        break;
+      }
+      auto& l = from_t1 ? t1 : t2;
+      BlueStore::Buffer *b = &*l.rbegin();
+      ceph_assert(b->is_clean());
+      dout(20) << __func__ << (from_t1 ? " t1" : " t2") << " -> ghost "
+               << *b << dendl;
+      _ghost_evict(b);
+      ceph_assert(buffer_bytes >= b->length);
+      buffer_bytes -= b->length;
+      ceph_assert(*(b->cache_age_bin) >= b->length);
+      *(b->cache_age_bin) -= b->length;
+      evicted += b->length;
+      l.erase(l.iterator_to(*b));
+      list_bytes[b->cache_private] -= b->length;
+      b->state = BlueStore::Buffer::STATE_EMPTY;
+      b->data.clear();
+      b->cache_private = from_t1 ? BUFFER_B1 : BUFFER_B2;
+      list_bytes[b->cache_private] += b->length;
+      (from_t1 ? b1 : b2).push_front(*b);
+    }
+    if (evicted > 0) {
+      dout(20) << __func__ << " evicted " << byte_u_t(evicted)
+               << " target_t1 " << target_t1 << dendl;
+    }
+
+    // ghosts cover at most as much as the cache itself: |t1|+|b1| <= c
+    // and |t1|+|t2|+|b1|+|b2| <= 2c
+    while (!b1.empty() &&
+           list_bytes[BUFFER_T1] + list_bytes[BUFFER_B1] > max) {
+      BlueStore::Buffer *b = &*b1.rbegin();
+      ceph_assert(b->is_empty());
+      dout(20) << __func__ << " b1 rm " << *b << dendl;
+      b->space->_rm_buffer(this, b);
+    }
+    while (!b2.empty() &&
+           list_bytes[BUFFER_T1] + list_bytes[BUFFER_B1] +
+           list_bytes[BUFFER_T2] + list_bytes[BUFFER_B2] > 2 * max) {
+      BlueStore::Buffer *b = &*b2.rbegin();
+      ceph_assert(b->is_empty());
+      dout(20) << __func__ << " b2 rm " << *b << dendl;
+      b->space->_rm_buffer(this, b);
+    }
+    num = t1.size() + t2.size();
+  }
+
+  void add_stats(uint64_t *extents,
+                 uint64_t *blobs,
+                 uint64_t *buffers,
+                 uint64_t *bytes) override {
+    std::lock_guard l(lock);
+    *extents += num_extents;
+    *blobs += num_blobs;
+    *buffers += num;
+    *bytes += buffer_bytes;
+  }
+
+#ifdef DEBUG_CACHE
+  void _audit(const char *when) override
+  {
+    dout(10) << __func__ << " " << when << " start" << dendl;
+    uint64_t s = 0;
+    for (auto which : {BUFFER_T1, BUFFER_B1, BUFFER_T2, BUFFER_B2}) {
+      uint64_t ls = 0;
+      for (auto& b : _get_list(which)) {
+        ceph_assert(b.cache_private == which);
+        ceph_assert(b.is_empty() == (which == BUFFER_B1 || which == BUFFER_B2));
+        ls += b.length;
+      }
+      if (ls != list_bytes[which]) {
+        derr << __func__ << " list " << which << " bytes " << list_bytes[which]
+             << " != actual " << ls << dendl;
+        ceph_assert(ls == list_bytes[which]);
+      }
+      if (which == BUFFER_T1 || which == BUFFER_T2) {
+        s += ls;
+      }
+    }
+    if (s != buffer_bytes) {
+      derr << __func__ << " buffer_bytes " << buffer_bytes << " actual " << s
+           << dendl;
+      ceph_assert(s == buffer_bytes);
+    }
+    dout(20) << __func__ << " " << when << " buffer_bytes " << buffer_bytes
+             << " ok" << dendl;
+  }
+#endif
+};
+
 // BuferCacheShard
 
 BlueStore::BufferCacheShard *BlueStore::BufferCacheShard::create(
@@ -1680,12 +2120,38 @@ BlueStore::BufferCacheShard *BlueStore::BufferCacheShard::create(
     c = new LruBufferCacheShard(store);
   else if (type == "2q")
     c = new TwoQBufferCacheShard(store);
+  else if (type == "arc")
+    c = new ArcBufferCacheShard(store);
   else
     ceph_abort_msg("unrecognized cache type");
   c->logger = logger;
   return c;
 }
 
+uint64_t BlueStore::BufferCacheShard::_ghost_key(
+  const ghobject_t& oid, uint64_t chunk)
+{
+  size_t key = std::hash<ghobject_t>{}(oid);
+  boost::hash_combine(key, chunk);
+  return key;
+}
+
+void BlueStore::BufferCacheShard::_ghost_evict(Buffer *b)
+{
+  if (!ghost.enabled()) {
+    return;
+  }
+  const ghobject_t& oid = b->space->onode.oid;
+  uint64_t pos = b->offset;
+  uint64_t end = b->offset + b->length;
+  while (pos < end) {
+    uint64_t chunk = pos >> GHOST_CHUNK_ORDER;
+    uint64_t next = std::min(end, (chunk + 1) << GHOST_CHUNK_ORDER);
+    ghost.add(_ghost_key(oid, chunk), next - pos);
+    pos = next;
+  }
+}
+
 // Buffer
 std::atomic<uint64_t> BlueStore::Buffer::total = 0;
 
@@ -1913,11 +2379,35 @@ void BlueStore::BufferSpace::read(
         }
       }
     }
+    if (res_intervals.size() < want_bytes && cache->ghost.enabled()) {
+      // would a bigger shard have saved us this trip to the disk?
+      interval_set<uint32_t> missing;
+      missing.insert(end - want_bytes, want_bytes);
+      missing.subtract(res_intervals);
+      bool ghost_hit = false;
+      uint64_t depth = std::numeric_limits<uint64_t>::max();
+      for (auto p = missing.begin(); p != missing.end(); ++p) {
+        uint64_t first = p.get_start() >> BufferCacheShard::GHOST_CHUNK_ORDER;
+        uint64_t last = (p.get_end() - 1) >> BufferCacheShard::GHOST_CHUNK_ORDER;
+        for (uint64_t chunk = first; chunk <= last; ++chunk) {
+          ghost_hit |= cache->ghost.take(
+            BufferCacheShard::_ghost_key(onode.oid, chunk), &depth);
+        }
+      }
+      if (ghost_hit) {
+        cache->ghost.note_hit(depth);
+      }
+    }
   }
 
   uint64_t hit_bytes = res_intervals.size();
   ceph_assert(hit_bytes <= want_bytes);
   uint64_t miss_bytes = want_bytes - hit_bytes;
+  if (miss_bytes) {
+    ++cache->misses;
+  } else {
+    ++cache->hits;
+  }
   cache->logger->inc(l_bluestore_buffer_hit_bytes, hit_bytes);
   cache->logger->inc(l_bluestore_buffer_miss_bytes, miss_bytes);
 }
@@ -2063,6 +2553,9 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
     ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
 			  << " raced, returning existing " << p.first->second
 			  << dendl;
+    if (p.first->second->packed) {
+      cache->_unpack(p.first->second.get());
+    }
     return p.first->second;
   }
   ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
@@ -2088,6 +2581,12 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
       cache->logger->inc(l_bluestore_onode_misses);
+      ++cache->misses;
+      uint64_t depth = std::numeric_limits<uint64_t>::max();
+      if (cache->ghost.enabled() &&
+          cache->ghost.take(std::hash<ghobject_t>{}(oid), &depth)) {
+        cache->ghost.note_hit(depth);
+      }
     } else {
       ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
                             << " " << p->second->nref
@@ -2096,8 +2595,12 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
       // This will pin onode and implicitly touch the cache when Onode
       // eventually will become unpinned
       o = p->second;
+      if (o->packed) {
+        cache->_unpack(o.get());
+      }
 
       cache->logger->inc(l_bluestore_onode_hits);
+      ++cache->hits;
     }
   }
 
@@ -4367,15 +4870,7 @@ void BlueStore::ExtentMap::maybe_load_shard(
           }
         }
       );
-      p->extents = decode_some(v);
-      p->loaded = true;
-      uint32_t shard_end =
-        (size_t)start + 1 < shards.size() ? (p + 1)->shard_info->offset : OBJECT_MAX_SIZE;
-      dout(20) << __func__ << " open shard for range 0x"
-               << std::hex << p->shard_info->offset << "~" << shard_end << std::dec
-	       << " (" << v.length() << " bytes)" << dendl;
-      ceph_assert(p->dirty == false);
-      ceph_assert(v.length() == p->shard_info->bytes);
+      _load_shard(start, v);
       onode->c->store->logger->inc(l_bluestore_onode_shard_misses);
     } else {
       onode->c->store->logger->inc(l_bluestore_onode_shard_hits);
@@ -4384,12 +4879,72 @@ void BlueStore::ExtentMap::maybe_load_shard(
   }
 }
 
+void BlueStore::ExtentMap::_load_shard(int idx, bufferlist& v)
+{
+  auto p = &shards[idx];
+  p->extents = decode_some(v);
+  p->loaded = true;
+  uint32_t shard_end =
+    (size_t)idx + 1 < shards.size() ? (p + 1)->shard_info->offset : OBJECT_MAX_SIZE;
+  dout(20) << __func__ << " open shard for range 0x"
+	   << std::hex << p->shard_info->offset << "~" << shard_end << std::dec
+	   << " (" << v.length() << " bytes)" << dendl;
+  ceph_assert(p->dirty == false);
+  ceph_assert(v.length() == p->shard_info->bytes);
+}
+
+void BlueStore::ExtentMap::get_unloaded_shard_keys(
+  uint32_t offset,
+  uint32_t length,
+  std::set<string>* keys)
+{
+  if (shards.empty()) {
+    return;
+  }
+  int last = seek_shard(offset + length);
+  string key;
+  for (int i = seek_shard(offset); i <= last; ++i) {
+    if (!shards[i].loaded) {
+      get_extent_shard_key(onode->key, shards[i].shard_info->offset, &key);
+      keys->insert(key);
+    }
+  }
+}
+
+unsigned BlueStore::ExtentMap::load_shards(
+  uint32_t offset,
+  uint32_t length,
+  std::map<string, bufferlist>& values)
+{
+  if (shards.empty()) {
+    return 0;
+  }
+  unsigned loaded = 0;
+  int last = seek_shard(offset + length);
+  string key;
+  for (int i = seek_shard(offset); i <= last; ++i) {
+    if (shards[i].loaded) {
+      continue;
+    }
+    get_extent_shard_key(onode->key, shards[i].shard_info->offset, &key);
+    auto v = values.find(key);
+    if (v != values.end()) {
+      _load_shard(i, v->second);
+      ++loaded;
+    }
+  }
+  return loaded;
+}
+
 void BlueStore::ExtentMap::dirty_range(
   uint32_t offset,
   uint32_t length)
 {
   dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
 	   << std::dec << dendl;
+  if (auto ra = onode->readahead.load(); ra) {
+    ++ra->gen;
+  }
   if (shards.empty()) {
     dout(20) << __func__ << " mark inline shard dirty" << dendl;
     inline_bl.clear();
@@ -4917,6 +5472,54 @@ void BlueStore::Onode::put()
   }
 }
 
+bool BlueStore::Onode::pack()
+{
+  ceph_assert(!packed);
+  if (!exists || flushing_count.load() || extent_map.needs_reshard()) {
+    return false;
+  }
+  auto& em = extent_map;
+  if (em.shards.empty()) {
+    // empty inline_bl means the map is dirty, unless there is no map at all
+    if (em.inline_bl.length() == 0 && !em.extent_map.empty()) {
+      return false;
+    }
+    em.extent_map.clear_and_dispose(ExtentMap::DeleteDisposer());
+  } else {
+    for (auto& s : em.shards) {
+      if (s.dirty) {
+        return false;
+      }
+    }
+    // unload the shards, they are faulted in from the kv store on demand;
+    // spanning blobs stay in memory
+    for (size_t i = 0; i < em.shards.size(); ++i) {
+      auto& s = em.shards[i];
+      if (!s.loaded) {
+        continue;
+      }
+      uint32_t end = i + 1 < em.shards.size() ?
+        em.shards[i + 1].shard_info->offset : OBJECT_MAX_SIZE;
+      auto p = em.seek_lextent(s.shard_info->offset);
+      while (p != em.extent_map.end() && p->logical_offset < end) {
+        em.rm(p++);
+      }
+      s.loaded = false;
+    }
+  }
+  packed = true;
+  return true;
+}
+
+void BlueStore::Onode::unpack()
+{
+  ceph_assert(packed);
+  if (extent_map.shards.empty() && extent_map.inline_bl.length()) {
+    extent_map.decode_some(extent_map.inline_bl);
+  }
+  packed = false;
+}
+
 void BlueStore::Onode::decode_raw(
   BlueStore::Onode* on,
   const bufferlist& v,
@@ -5259,16 +5862,23 @@ void BlueStore::Collection::load_shared_blob(SharedBlobRef sb)
 			  << pretty_binary_string(key) << dendl;
       ceph_abort_msg("uh oh, missing shared_blob");
     }
-
-    sb->loaded = true;
-    sb->persistent = new bluestore_shared_blob_t(sbid);
-    auto p = v.cbegin();
-    decode(*(sb->persistent), p);
-    ldout(store->cct, 10) << __func__ << " sbid 0x" << std::hex << sbid
-			  << std::dec << " loaded shared_blob " << *sb << dendl;
+    load_shared_blob(sb, v);
   }
 }
 
+void BlueStore::Collection::load_shared_blob(SharedBlobRef sb,
+					     const bufferlist& v)
+{
+  ceph_assert(!sb->is_loaded());
+  auto sbid = sb->get_sbid();
+  sb->loaded = true;
+  sb->persistent = new bluestore_shared_blob_t(sbid);
+  auto p = v.cbegin();
+  decode(*(sb->persistent), p);
+  ldout(store->cct, 10) << __func__ << " sbid 0x" << std::hex << sbid
+			<< std::dec << " loaded shared_blob " << *sb << dendl;
+}
+
 void BlueStore::Collection::make_blob_shared(uint64_t sbid, BlobRef b)
 {
   ldout(store->cct, 10) << __func__ << " " << *b << dendl;
@@ -5354,6 +5964,55 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   return onode_space.add_onode(oid, o);
 }
 
+unsigned BlueStore::Collection::get_onodes(
+  const vector<ghobject_t>& oids,
+  const vector<bool>& create,
+  vector<OnodeRef>* out)
+{
+  ceph_assert(ceph_mutex_is_wlocked(lock));
+  ceph_assert(oids.size() == create.size());
+  out->resize(oids.size());
+
+  spg_t pgid;
+  bool is_pg = cid.is_pg(&pgid);
+  vector<string> keys(oids.size());
+  std::set<string> missing;
+  for (size_t i = 0; i < oids.size(); ++i) {
+    if (is_pg && !oids[i].match(cnode.bits, pgid.ps())) {
+      // let get_onode() complain
+      continue;
+    }
+    (*out)[i] = onode_space.lookup(oids[i]);
+    if (!(*out)[i]) {
+      get_object_key(store->cct, oids[i], &keys[i]);
+      missing.insert(keys[i]);
+    }
+  }
+  if (missing.empty()) {
+    return 0;
+  }
+
+  std::map<string, bufferlist> values;
+  store->db->get(PREFIX_OBJ, missing, &values);
+  ldout(store->cct, 20) << __func__ << " read " << values.size() << "/"
+			<< missing.size() << " onodes" << dendl;
+  for (size_t i = 0; i < oids.size(); ++i) {
+    if (keys[i].empty()) {
+      continue;
+    }
+    auto v = values.find(keys[i]);
+    if (v == values.end() && !create[i]) {
+      continue;
+    }
+    OnodeRef o(Onode::create_decode(
+      this, oids[i], keys[i],
+      v != values.end() ? v->second : bufferlist(),
+      true, store->segment_size != 0));
+    (*out)[i] = onode_space.add_onode(oids[i], o);
+  }
+  return missing.size();
+}
+
 void BlueStore::Collection::split_cache(
   Collection *dest)
 {
@@ -5551,8 +6210,11 @@ void *BlueStore::MempoolThread::entry()
       if (binned_kv_onode_cache != nullptr) {
         binned_kv_onode_cache->set_cache_ratio(store->cache_kv_onode_ratio);
       }
-      meta_cache->set_cache_ratio(store->cache_meta_ratio);
-      data_cache->set_cache_ratio(store->cache_data_ratio);
+      double meta_ratio = store->cache_meta_ratio;
+      double data_ratio = store->cache_data_ratio;
+      _balance_shards(&meta_ratio, &data_ratio);
+      meta_cache->set_cache_ratio(meta_ratio);
+      data_cache->set_cache_ratio(data_ratio);
 
       // Log events at 5 instead of 20 when balance happens.
       interval_stats_trim = true;
@@ -5616,6 +6278,66 @@ void *BlueStore::MempoolThread::entry()
   return NULL;
 }
 
+template <typename Shards>
+static double balance_cache_shards(
+  Shards& shards,
+  double ghost_ratio,
+  double balance_ratio,
+  double unit_bytes)
+{
+  // a shard's gain is how many of its misses an extra byte would have
+  // turned into hits over the last interval
+  double total_gain = 0;
+  for (auto i : shards) {
+    uint64_t capacity = ghost_ratio * i->max;
+    std::lock_guard l(i->lock);
+    i->ghost.set_capacity(capacity);
+    uint64_t hits = i->ghost.hits - i->last_ghost_hits;
+    i->last_ghost_hits = i->ghost.hits;
+    double g = capacity ? hits / (capacity * unit_bytes) : 0;
+    i->gain = (i->gain + g) / 2;
+    total_gain += i->gain;
+  }
+  double n = shards.size();
+  for (auto i : shards) {
+    if (total_gain > 0) {
+      i->share = (1 - balance_ratio) / n + balance_ratio * i->gain / total_gain;
+    } else {
+      i->share = 1 / n;
+    }
+  }
+  return total_gain / n;
+}
+
+void BlueStore::MempoolThread::_balance_shards(
+  double *meta_ratio,
+  double *data_ratio)
+{
+  auto& conf = store->cct->_conf;
+  double ghost_ratio = conf.get_val<double>("bluestore_cache_ghost_ratio");
+  double balance_ratio =
+    conf.get_val<double>("bluestore_cache_shard_balance_ratio");
+
+  double meta_gain = balance_cache_shards(
+    store->onode_cache_shards, ghost_ratio, balance_ratio,
+    meta_cache->get_bytes_per_onode());
+  double data_gain = balance_cache_shards(
+    store->buffer_cache_shards, ghost_ratio, balance_ratio, 1.0);
+
+  // shift memory between onodes and buffers the same way; the kv cache
+  // keeps its ratio since we can't see what rocksdb evicts
+  if (meta_gain + data_gain > 0) {
+    double r = *meta_ratio + *data_ratio;
+    *meta_ratio = (1 - balance_ratio) * *meta_ratio +
+      balance_ratio * r * meta_gain / (meta_gain + data_gain);
+    *data_ratio = r - *meta_ratio;
+  }
+  dout(20) << __func__ << " meta_gain " << meta_gain
+           << " data_gain " << data_gain
+           << " meta_ratio " << *meta_ratio
+           << " data_ratio " << *data_ratio << dendl;
+}
+
 void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
 {
   size_t onode_shards = store->onode_cache_shards.size();
@@ -5667,17 +6389,21 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
                    << " data_used: " << data_used << dendl;
   }
 
-  uint64_t max_shard_onodes = static_cast<uint64_t>(
-      (meta_alloc / (double) onode_shards) / meta_cache->get_bytes_per_onode());
-  uint64_t max_shard_buffer = static_cast<uint64_t>(data_alloc / buffer_shards);
-
-  dout(30) << __func__ << " max_shard_onodes: " << max_shard_onodes
-                 << " max_shard_buffer: " << max_shard_buffer << dendl;
-
+  // shards share their type's budget as set by _balance_shards(), evenly
+  // until the first balance
+  double meta_onodes = meta_alloc / meta_cache->get_bytes_per_onode();
   for (auto i : store->onode_cache_shards) {
+    double share = i->share > 0 ? i->share.load() : 1.0 / onode_shards;
+    uint64_t max_shard_onodes = static_cast<uint64_t>(meta_onodes * share);
+    dout(30) << __func__ << " onode shard " << i
+             << " max_shard_onodes: " << max_shard_onodes << dendl;
     i->set_max(max_shard_onodes);
   }
   for (auto i : store->buffer_cache_shards) {
+    double share = i->share > 0 ? i->share.load() : 1.0 / buffer_shards;
+    uint64_t max_shard_buffer = static_cast<uint64_t>(data_alloc * share);
+    dout(30) << __func__ << " buffer shard " << i
+             << " max_shard_buffer: " << max_shard_buffer << dendl;
     i->set_max(max_shard_buffer);
   }
 }
@@ -5753,7 +6479,8 @@ BlueStore::BlueStore(CephContext *cct,
     kv_finalize_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(std::countr_zero(_min_alloc_size)),
-    mempool_thread(this)
+    mempool_thread(this),
+    online_fsck_thread(this)
 {
   _init_logger();
   cct->_conf.add_observer(this);
@@ -5827,6 +6554,11 @@ std::vector<std::string> BlueStore::get_tracked_keys() const noexcept
     "bluestore_warn_on_no_per_pool_omap"s,
     "bluestore_warn_on_no_per_pg_omap"s,
     "bluestore_max_defer_interval"s,
+    "bluestore_prefetch_max_bytes"s,
+    "bluestore_prefetch_min_bytes"s,
+    "bluestore_prefetch_trigger_requests"s,
+    "bluestore_txc_prefetch"s,
+    "bluestore_onode_pack_ratio"s,
     "bluestore_onode_segment_size"s,
     "bluestore_allocator_lookup_policy"s,
     "bluestore_volume_selection_reserved_factor"s,
@@ -5896,6 +6628,17 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
       _set_max_defer_interval();
     }
   }
+  if (changed.count("bluestore_prefetch_max_bytes") ||
+      changed.count("bluestore_prefetch_min_bytes") ||
+      changed.count("bluestore_prefetch_trigger_requests")) {
+    _set_prefetch_params();
+  }
+  if (changed.count("bluestore_txc_prefetch")) {
+    _set_txc_prefetch();
+  }
+  if (changed.count("bluestore_onode_pack_ratio")) {
+    _set_onode_pack_ratio();
+  }
   if (changed.count("osd_memory_target") ||
       changed.count("osd_memory_base") ||
       changed.count("osd_memory_cache_min") ||
@@ -6013,6 +6756,22 @@ void BlueStore::_set_throttle_params()
   dout(10) << __func__ << " throttle_cost_per_io " << throttle_cost_per_io
 	   << dendl;
 }
+
+void BlueStore::_set_prefetch_params()
+{
+  prefetch_max_bytes =
+    cct->_conf.get_val<Option::size_t>("bluestore_prefetch_max_bytes");
+  prefetch_min_bytes = std::min<uint64_t>(
+    cct->_conf.get_val<Option::size_t>("bluestore_prefetch_min_bytes"),
+    prefetch_max_bytes);
+  prefetch_trigger_requests =
+    cct->_conf.get_val<uint64_t>("bluestore_prefetch_trigger_requests");
+  dout(10) << __func__ << " prefetch_max_bytes " << prefetch_max_bytes
+	   << " prefetch_min_bytes " << prefetch_min_bytes
+	   << " prefetch_trigger_requests " << prefetch_trigger_requests
+	   << dendl;
+}
+
 void BlueStore::_set_blob_size()
 {
   if (cct->_conf->bluestore_max_blob_size) {
@@ -6397,6 +7156,11 @@ void BlueStore::_init_logger()
 		    NULL,
 		    PerfCountersBuilder::PRIO_DEBUGONLY,
 		    unit_t(UNIT_BYTES));
+  b.add_u64_avg(l_bluestore_write_copied_bytes, "write_copied_bytes",
+		"Average payload bytes copied while preparing a transaction",
+		NULL,
+		PerfCountersBuilder::PRIO_DEBUGONLY,
+		unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluestore_write_penalty_read_ops, "write_penalty_read_ops",
 		    "Sum for write penalty read ops");
   b.add_u64_counter(l_bluestore_write_new, "write_new",
@@ -6475,6 +7239,15 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_onode_shard_misses,
 		    "onode_shard_misses",
 		    "Count of onode shard cache lookups misses");
+  b.add_u64(l_bluestore_packed_onodes, "onodes_packed",
+            "Number of cached onodes without a decoded extent map");
+  b.add_u64_counter(l_bluestore_onode_packs, "onode_packs",
+                    "Count of cold onodes packed");
+  b.add_u64_counter(l_bluestore_onode_unpacks, "onode_unpacks",
+                    "Count of packed onodes decoded on lookup");
+  b.add_u64(l_bluestore_onode_avg_bytes, "onode_avg_bytes",
+            "Average metadata cache bytes per cached onode",
+            nullptr, 0, unit_t(UNIT_BYTES));
   b.add_u64(l_bluestore_extents, "onode_extents",
 	    "Number of extents in cache");
   b.add_u64(l_bluestore_blobs, "onode_blobs",
@@ -6504,6 +7277,49 @@ void BlueStore::_init_logger()
 	    unit_t(UNIT_BYTES));
   //****************************************
 
+  // read prefetch stats
+  //****************************************
+  b.add_u64_counter(l_bluestore_prefetch_bytes, "prefetch_bytes",
+	    "Sum for bytes requested by sequential read prefetch",
+	    NULL,
+	    PerfCountersBuilder::PRIO_DEBUGONLY,
+	    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_prefetch_hit_bytes, "prefetch_hit_bytes",
+	    "Sum for bytes of reads served from prefetched ranges",
+	    NULL,
+	    PerfCountersBuilder::PRIO_DEBUGONLY,
+	    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_prefetch_waste_bytes, "prefetch_waste_bytes",
+	    "Sum for prefetched bytes never read before the stream ended",
+	    NULL,
+	    PerfCountersBuilder::PRIO_DEBUGONLY,
+	    unit_t(UNIT_BYTES));
+  //****************************************
+
+  // transaction metadata prefetch stats
+  //****************************************
+  b.add_u64_counter(l_bluestore_txc_prefetch_onodes, "txc_prefetch_onodes",
+		    "Onodes read in a batch ahead of their transaction");
+  b.add_u64_counter(l_bluestore_txc_prefetch_shards, "txc_prefetch_shards",
+		    "Extent map shards read in a batch ahead of their transaction");
+  b.add_u64_counter(l_bluestore_txc_prefetch_shared_blobs,
+		    "txc_prefetch_shared_blobs",
+		    "Shared blobs read in a batch ahead of their transaction");
+  b.add_u64_counter(l_bluestore_txc_prefetch_collapsed,
+		    "txc_prefetch_collapsed",
+		    "Point lookups saved by batching transaction metadata reads");
+  //****************************************
+
+  // online fsck stats
+  //****************************************
+  b.add_u64_counter(l_bluestore_online_fsck_objects, "online_fsck_objects",
+		    "Objects checked by online fsck");
+  b.add_u64_counter(l_bluestore_online_fsck_errors, "online_fsck_errors",
+		    "Errors found by online fsck");
+  b.add_u64_counter(l_bluestore_online_fsck_passes, "online_fsck_passes",
+		    "Online fsck passes completed");
+  //****************************************
+
   // internal stats
   //****************************************
   b.add_u64_counter(l_bluestore_onode_reshard, "onode_reshard",
@@ -7167,6 +7983,8 @@ int BlueStore::_open_bdev(bool create)
   block_size_order = std::countr_zero(block_size);
   ceph_assert(block_size == 1u << block_size_order);
   _set_max_defer_interval();
+  _set_prefetch_params();
+  _set_txc_prefetch();
   // and set cache_size based on device type
   r = _set_cache_sizes();
   if (r < 0) {
@@ -7332,12 +8150,23 @@ int BlueStore::_create_alloc()
   uint64_t alloc_size = min_alloc_size;
 
   std::string allocator_type = cct->_conf->bluestore_allocator;
+  uint64_t alloc_shards =
+    cct->_conf.get_val<uint64_t>("bluestore_allocator_shards");
 
-  alloc = Allocator::create(
-    cct, allocator_type,
-    bdev->get_size(),
-    alloc_size,
-    "block");
+  if (alloc_shards > 1) {
+    alloc = ShardedAllocator::create(
+      cct, allocator_type,
+      bdev->get_size(),
+      alloc_size,
+      alloc_shards,
+      "block");
+  } else {
+    alloc = Allocator::create(
+      cct, allocator_type,
+      bdev->get_size(),
+      alloc_size,
+      "block");
+  }
   if (!alloc) {
     lderr(cct) << __func__ << " failed to create " << allocator_type << " allocator"
 	       << dendl;
@@ -9248,6 +10077,15 @@ void BlueStore::set_cache_shards(unsigned num)
         BufferCacheShard::create(this, cct->_conf->bluestore_cache_type,
                                  logger);
   }
+  _set_onode_pack_ratio();
+}
+
+void BlueStore::_set_onode_pack_ratio()
+{
+  double ratio = cct->_conf.get_val<double>("bluestore_onode_pack_ratio");
+  for (auto i : onode_cache_shards) {
+    i->set_pack_ratio(ratio);
+  }
 }
 
 //---------------------------------------------
@@ -9350,6 +10188,7 @@ int BlueStore::umount_readonly()
 {
   ceph_assert(_kv_only || mounted);
   _osr_drain_all();
+  _prefetch_drain();
 
   mounted = false;
 
@@ -9483,6 +10322,9 @@ int BlueStore::_mount()
   }
 
   mounted = true;
+  if (cct->_conf.get_val<double>("bluestore_online_fsck_interval") > 0) {
+    online_fsck_start(false);
+  }
   return 0;
 }
 
@@ -9490,7 +10332,9 @@ int BlueStore::umount()
 {
   dout(5) << __func__ << dendl;
   ceph_assert(_kv_only || mounted);
+  online_fsck_stop();
   _osr_drain_all();
+  _prefetch_drain();
 
   mounted = false;
 
@@ -11742,18 +12586,515 @@ out_scan:
 	  << (errors + warnings - (int)repaired) << " remaining in "
 	  << duration << " seconds" << dendl;
 
-  // In non-repair mode we should return error count only as
-  // it indicates if store status is OK.
-  // In repair mode both errors and warnings are taken into account
-  // since repaired counter relates to them both.
-  return repair ? errors + warnings - (int)repaired : errors;
+  // In non-repair mode we should return error count only as
+  // it indicates if store status is OK.
+  // In repair mode both errors and warnings are taken into account
+  // since repaired counter relates to them both.
+  return repair ? errors + warnings - (int)repaired : errors;
+}
+
+int BlueStore::get_shared_blob(const string& key,
+			        bufferlist& bl)
+{
+  return db->get(PREFIX_SHARED_BLOB, key, &bl);
+};
+
+// ---------------
+// online fsck
+
+void BlueStore::OnlineFsckThread::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(in_pass, bl);
+  encode(cid, bl);
+  encode(next, bl);
+  encode(passes, bl);
+  encode(objects, bl);
+  encode(errors, bl);
+  encode(last_pass_errors, bl);
+  ENCODE_FINISH(bl);
+}
+
+void BlueStore::OnlineFsckThread::decode(bufferlist::const_iterator& p)
+{
+  DECODE_START(1, p);
+  decode(in_pass, p);
+  decode(cid, p);
+  decode(next, p);
+  decode(passes, p);
+  decode(objects, p);
+  decode(errors, p);
+  decode(last_pass_errors, p);
+  DECODE_FINISH(p);
+}
+
+int BlueStore::online_fsck_start(bool deep)
+{
+  auto& t = online_fsck_thread;
+  std::unique_lock l(t.lock);
+  if (!mounted) {
+    return -EAGAIN;
+  }
+  if (t.running) {
+    return -EBUSY;
+  }
+  if (t.is_started()) {
+    // the previous on-demand pass is over
+    l.unlock();
+    t.join();
+    l.lock();
+  }
+  bufferlist bl;
+  if (db->get(PREFIX_SUPER, "online_fsck", &bl) >= 0 && bl.length()) {
+    try {
+      auto p = bl.cbegin();
+      t.decode(p);
+    } catch (ceph::buffer::error& e) {
+      derr << __func__ << " failed to decode checkpoint, starting over"
+	   << dendl;
+      t.in_pass = false;
+    }
+  }
+  dout(1) << __func__ << (deep ? " deep" : "")
+	  << (t.in_pass ? " resuming at " : " new pass")
+	  << (t.in_pass ? stringify(t.cid) + " " + stringify(t.next) : "")
+	  << dendl;
+  t.stop = false;
+  t.deep = deep;
+  t.running = true;
+  t.create("bstore_fsck");
+  return 0;
+}
+
+void BlueStore::online_fsck_stop()
+{
+  auto& t = online_fsck_thread;
+  {
+    std::lock_guard l(t.lock);
+    t.stop = true;
+    t.cond.notify_all();
+  }
+  if (t.is_started()) {
+    t.join();
+  }
+}
+
+void BlueStore::online_fsck_dump(Formatter *f)
+{
+  auto& t = online_fsck_thread;
+  std::lock_guard l(t.lock);
+  f->dump_bool("running", t.running);
+  f->dump_bool("deep", t.deep);
+  f->dump_bool("in_pass", t.in_pass);
+  if (t.in_pass) {
+    f->dump_stream("collection") << t.cid;
+    f->dump_stream("next") << t.next;
+  }
+  f->dump_unsigned("passes", t.passes);
+  f->dump_unsigned("objects", t.objects);
+  f->dump_unsigned("errors", t.errors);
+  f->dump_unsigned("last_pass_errors", t.last_pass_errors);
+}
+
+bool BlueStore::online_fsck_wait(uint64_t objects, ceph::timespan timeout)
+{
+  auto& t = online_fsck_thread;
+  std::unique_lock l(t.lock);
+  auto passes = t.passes;
+  return t.cond.wait_for(l, timeout, [&] {
+    return !t.running || t.passes > passes ||
+      (objects && t.in_pass && t.objects >= objects);
+  });
+}
+
+void BlueStore::_online_fsck_save()
+{
+  bufferlist bl;
+  online_fsck_thread.encode(bl);
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->set(PREFIX_SUPER, "online_fsck", bl);
+  db->submit_transaction(t);
+}
+
+void BlueStore::_online_fsck_thread()
+{
+  auto& t = online_fsck_thread;
+  std::unique_lock l(t.lock);
+  auto num_workers = cct->_conf.get_val<uint64_t>(
+    "bluestore_online_fsck_threads") - 1;
+  t.workers_stop = false;
+  for (uint64_t i = 0; i < num_workers; ++i) {
+    t.workers.push_back(
+      make_named_thread("bstore_fsck_wk", &BlueStore::_online_fsck_worker,
+			this));
+  }
+  while (!t.stop) {
+    if (!t.in_pass) {
+      // coll_t() (meta) sorts before any other collection
+      t.in_pass = true;
+      t.cid = coll_t();
+      t.next = ghobject_t();
+      t.objects = 0;
+      t.errors = 0;
+    }
+
+    // collections are visited in coll_t order, resuming at t.cid
+    CollectionRef c;
+    {
+      bool done = t.next == ghobject_t::get_max();
+      std::shared_lock cl(coll_lock);
+      for (auto& [cid, coll] : coll_map) {
+	if (cid < t.cid || (done && cid == t.cid)) {
+	  continue;
+	}
+	if (!c || cid < c->cid) {
+	  c = coll;
+	}
+      }
+    }
+    if (!c) {
+      dout(1) << __func__ << " pass " << t.passes << " done, "
+	      << t.objects << " objects, " << t.errors << " errors" << dendl;
+      t.in_pass = false;
+      t.last_pass_errors = t.errors;
+      ++t.passes;
+      logger->inc(l_bluestore_online_fsck_passes);
+      _online_fsck_save();
+      t.cond.notify_all();
+      auto interval = cct->_conf.get_val<double>(
+	"bluestore_online_fsck_interval");
+      if (interval <= 0) {
+	break;
+      }
+      t.cond.wait_for(l, ceph::make_timespan(interval));
+      continue;
+    }
+    if (c->cid != t.cid) {
+      t.cid = c->cid;
+      t.next = ghobject_t();
+    }
+
+    ghobject_t pos = t.next;
+    bool deep = t.deep;
+    uint64_t errors = 0;
+    l.unlock();
+    int r = _online_fsck_batch(c, &pos, deep, &errors);
+    l.lock();
+    if (r < 0) {
+      derr << __func__ << " failed to check " << c->cid << ": "
+	   << cpp_strerror(r) << dendl;
+      pos = ghobject_t::get_max();
+    } else {
+      t.objects += r;
+      t.errors += errors;
+    }
+    t.next = pos;
+    _online_fsck_save();
+    t.cond.notify_all();
+
+    auto sleep = cct->_conf.get_val<double>("bluestore_online_fsck_sleep");
+    if (sleep > 0 && !t.stop) {
+      t.cond.wait_for(l, ceph::make_timespan(sleep));
+    }
+  }
+  t.workers_stop = true;
+  t.workers_cond.notify_all();
+  l.unlock();
+  for (auto& w : t.workers) {
+    w.join();
+  }
+  l.lock();
+  t.workers.clear();
+  t.running = false;
+  t.cond.notify_all();
+  dout(1) << __func__ << " stopped" << dendl;
+}
+
+void BlueStore::_online_fsck_worker()
+{
+  auto& t = online_fsck_thread;
+  std::unique_lock l(t.lock);
+  uint64_t seq = t.batch_seq;
+  while (true) {
+    t.workers_cond.wait(l, [&] {
+      return t.workers_stop || (t.batch_work && t.batch_seq != seq);
+    });
+    if (t.workers_stop) {
+      break;
+    }
+    seq = t.batch_seq;
+    auto work = t.batch_work;
+    ++t.workers_busy;
+    l.unlock();
+    work();
+    l.lock();
+    if (--t.workers_busy == 0) {
+      t.workers_cond.notify_all();
+    }
+  }
+}
+
+int BlueStore::_online_fsck_batch(
+  CollectionRef& c,
+  ghobject_t *pos,
+  bool deep,
+  uint64_t *errors)
+{
+  auto batch = cct->_conf.get_val<uint64_t>("bluestore_online_fsck_batch");
+  std::vector<ghobject_t> ls;
+  std::vector<online_fsck_blob_t> blobs;
+  ghobject_t next;
+  {
+    std::shared_lock l(c->lock);
+    if (!c->exists) {
+      *pos = ghobject_t::get_max();
+      return 0;
+    }
+    int r = _collection_list(c.get(), *pos, ghobject_t::get_max(), batch,
+			     false, &ls, &next);
+    if (r < 0) {
+      return r;
+    }
+    for (auto& oid : ls) {
+      // don't let the scan evict the working set nor pin the extent map
+      // shards it reads: use the cached onodes whose shards are all
+      // loaded as they are, and a private copy of the others
+      OnodeRef o = c->onode_space.lookup(oid);
+      if (!o || std::any_of(o->extent_map.shards.begin(),
+			    o->extent_map.shards.end(),
+			    [](auto& s) { return !s.loaded; })) {
+	o = _online_fsck_load(c, oid);
+	if (!o) {
+	  continue;
+	}
+      }
+      _online_fsck_snapshot(o, &blobs);
+    }
+  }
+  dout(20) << __func__ << " " << c->cid << " " << ls.size() << " objects, "
+	   << blobs.size() << " blobs, next " << next << dendl;
+
+  // verify outside of the collection lock, along with the workers
+  std::mutex suspects_lock;
+  std::set<ghobject_t> suspects;
+  std::atomic<size_t> idx = 0;
+  auto worker = [&] {
+    size_t i;
+    while ((i = idx++) < blobs.size()) {
+      std::ostringstream ss;
+      if (_online_fsck_verify(blobs[i], deep, ss) != 0) {
+	dout(10) << __func__ << " suspect " << blobs[i].oid << ": "
+		 << ss.str() << dendl;
+	std::lock_guard l(suspects_lock);
+	suspects.insert(blobs[i].oid);
+      }
+    }
+  };
+  auto& t = online_fsck_thread;
+  if (blobs.size() > 1) {
+    std::lock_guard l(t.lock);
+    t.batch_work = worker;
+    ++t.batch_seq;
+    t.workers_cond.notify_all();
+  }
+  worker();
+  {
+    std::unique_lock l(t.lock);
+    t.batch_work = nullptr;
+    t.workers_cond.wait(l, [&] { return t.workers_busy == 0; });
+  }
+
+  // in-flight transactions may have left data and shared blobs behind
+  // what was copied; recheck suspects once those of the collection are
+  // on disk, deferred writes included: flush() only waits for the kv
+  // submit, and those are applied to the device later
+  if (!suspects.empty()) {
+    deferred_try_submit();
+    _osr_drain(c->osr.get());
+    for (auto& oid : suspects) {
+      *errors += _online_fsck_confirm(c, oid, deep);
+    }
+  }
+  logger->inc(l_bluestore_online_fsck_objects, ls.size());
+  *pos = next;
+  return ls.size();
+}
+
+BlueStore::OnodeRef BlueStore::_online_fsck_load(
+  CollectionRef& c,
+  const ghobject_t& oid)
+{
+  string key;
+  get_object_key(cct, oid, &key);
+  bufferlist v;
+  int r = db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
+  if (r < 0 || v.length() == 0) {
+    return OnodeRef();
+  }
+  return OnodeRef(Onode::create_decode(c, oid, key, v, false,
+				       segment_size != 0));
+}
+
+void BlueStore::_online_fsck_snapshot(
+  OnodeRef& o,
+  std::vector<online_fsck_blob_t>* blobs)
+{
+  o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+  std::map<Blob*, size_t> seen;
+  for (auto& e : o->extent_map.extent_map) {
+    auto [p, inserted] = seen.emplace(e.blob.get(), blobs->size());
+    if (inserted) {
+      auto& b = blobs->emplace_back();
+      b.oid = o->oid;
+      b.blob = e.blob->get_blob();
+      if (b.blob.is_shared()) {
+	b.sbid = e.blob->get_sbid();
+      }
+    }
+    auto& b = (*blobs)[p->second];
+    if (e.blob_offset + e.length > b.blob.get_logical_length()) {
+      std::ostringstream ss;
+      ss << "extent " << e << " beyond blob " << b.blob;
+      b.error = ss.str();
+    } else if (!b.blob.is_compressed() &&
+	       !b.blob.is_allocated(e.blob_offset, e.length)) {
+      std::ostringstream ss;
+      ss << "extent " << e << " references unallocated space of blob "
+	 << b.blob;
+      b.error = ss.str();
+    } else {
+      b.used.union_insert(e.blob_offset, e.length);
+    }
+  }
+}
+
+int BlueStore::_online_fsck_verify(
+  const online_fsck_blob_t& b,
+  bool deep,
+  std::ostream& err)
+{
+  if (!b.error.empty()) {
+    err << b.error;
+    return 1;
+  }
+  for (auto& p : b.blob.get_extents()) {
+    if (p.is_valid() && p.end() > bdev->get_size()) {
+      err << "pextent " << p << " beyond device end";
+      return 1;
+    }
+  }
+  if (b.sbid) {
+    string key;
+    get_shared_blob_key(b.sbid, &key);
+    bufferlist bl;
+    if (db->get(PREFIX_SHARED_BLOB, key, &bl) < 0) {
+      err << "shared blob 0x" << std::hex << b.sbid << std::dec << " missing";
+      return 1;
+    }
+    bluestore_shared_blob_t sb(b.sbid);
+    try {
+      auto p = bl.cbegin();
+      decode(sb, p);
+    } catch (ceph::buffer::error& e) {
+      err << "shared blob 0x" << std::hex << b.sbid << std::dec
+	  << " undecodable";
+      return 1;
+    }
+    for (auto& p : b.blob.get_extents()) {
+      if (p.is_valid() && !sb.ref_map.contains(p.offset, p.length)) {
+	err << "pextent " << p << " not referenced by " << sb;
+	return 1;
+      }
+    }
+  }
+  if (!deep || !b.blob.has_csum()) {
+    return 0;
+  }
+
+  // checksums cover the on-disk data, verify the referenced chunks
+  interval_set<uint32_t> ranges;
+  uint32_t limit = b.blob.get_csum_count() * b.blob.get_csum_chunk_size();
+  if (b.blob.is_compressed()) {
+    ranges.insert(0, std::min(limit, b.blob.get_ondisk_length()));
+  } else {
+    uint32_t align = std::max<uint32_t>(b.blob.get_csum_chunk_size(),
+					bdev->get_block_size());
+    for (auto p = b.used.begin(); p != b.used.end(); ++p) {
+      uint32_t start = p2align(p.get_start(), align);
+      uint32_t end = std::min(p2roundup(p.get_end(), align), limit);
+      if (start < end) {
+	ranges.union_insert(start, end - start);
+      }
+    }
+  }
+  for (auto p = ranges.begin(); p != ranges.end(); ++p) {
+    bufferlist bl;
+    IOContext ioc(cct, NULL, true);
+    int r = b.blob.map(
+      p.get_start(), p.get_len(),
+      [&](const bluestore_pextent_t& pe, uint64_t offset, uint64_t length) {
+	if (!pe.is_valid()) {
+	  return -ERANGE;
+	}
+	bufferlist t;
+	int r = bdev->read(offset, length, &t, &ioc, false);
+	if (r < 0) {
+	  return r;
+	}
+	bl.claim_append(t);
+	return 0;
+      });
+    if (r < 0) {
+      err << "failed to read 0x" << std::hex << p.get_start() << "~"
+	  << p.get_len() << std::dec << " of " << b.blob << ": "
+	  << cpp_strerror(r);
+      return 1;
+    }
+    int bad;
+    uint64_t bad_csum;
+    if (b.blob.verify_csum(p.get_start(), bl, &bad, &bad_csum) < 0) {
+      err << "bad checksum at blob offset 0x" << std::hex << bad
+	  << ", got 0x" << bad_csum << std::dec << " in " << b.blob;
+      return 1;
+    }
+  }
+  return 0;
 }
 
-int BlueStore::get_shared_blob(const string& key,
-			        bufferlist& bl)
+int BlueStore::_online_fsck_confirm(
+  CollectionRef& c,
+  const ghobject_t& oid,
+  bool deep)
 {
-  return db->get(PREFIX_SHARED_BLOB, key, &bl);
-};
+  std::vector<online_fsck_blob_t> blobs;
+  {
+    std::shared_lock l(c->lock);
+    if (!c->exists) {
+      return 0;
+    }
+    OnodeRef o = c->onode_space.lookup(oid);
+    if (o && (!o->exists || o->flushing_count)) {
+      // gone or rewritten meanwhile, the next pass will tell
+      return 0;
+    }
+    // what is not in flight is on disk now
+    o = _online_fsck_load(c, oid);
+    if (!o) {
+      return 0;
+    }
+    _online_fsck_snapshot(o, &blobs);
+  }
+  for (auto& b : blobs) {
+    std::ostringstream ss;
+    if (_online_fsck_verify(b, deep, ss) != 0) {
+      derr << "online fsck error: " << c->cid << " " << oid << ": "
+	   << ss.str() << dendl;
+      logger->inc(l_bluestore_online_fsck_errors);
+      return 1;
+    }
+  }
+  return 0;
+}
 
 /// methods to inject various errors fsck can repair
 void BlueStore::inject_broken_shared_blob_key(const string& key,
@@ -12330,8 +13671,8 @@ BlueStore::CollectionRef BlueStore::_get_collection_by_oid(const ghobject_t& oid
 void BlueStore::_queue_reap_collection(CollectionRef& c)
 {
   dout(10) << __func__ << " " << c << " " << c->cid << dendl;
-  // _reap_collections and this in the same thread,
-  // so no need a lock.
+  // with several kv lanes, txcs finish on more than one finalize thread
+  std::lock_guard l(reap_lock);
   removed_collections.push_back(c);
 }
 
@@ -12340,8 +13681,7 @@ void BlueStore::_reap_collections()
 
   list<CollectionRef> removed_colls;
   {
-    // _queue_reap_collection and this in the same thread.
-    // So no need a lock.
+    std::lock_guard l(reap_lock);
     if (!removed_collections.empty())
       removed_colls.swap(removed_collections);
     else
@@ -12371,6 +13711,7 @@ void BlueStore::_reap_collections()
   if (removed_colls.empty()) {
     dout(10) << __func__ << " all reaped" << dendl;
   } else {
+    std::lock_guard l(reap_lock);
     removed_collections.splice(removed_collections.begin(), removed_colls);
   }
 }
@@ -12379,12 +13720,13 @@ void BlueStore::refresh_perf_counters()
 {
   uint64_t num_onodes = 0;
   uint64_t num_pinned_onodes = 0;
+  uint64_t num_packed_onodes = 0;
   uint64_t num_extents = 0;
   uint64_t num_blobs = 0;
   uint64_t num_buffers = 0;
   uint64_t num_buffer_bytes = 0;
   for (auto c : onode_cache_shards) {
-    c->add_stats(&num_onodes, &num_pinned_onodes);
+    c->add_stats(&num_onodes, &num_pinned_onodes, &num_packed_onodes);
   }
   for (auto c : buffer_cache_shards) {
     c->add_stats(&num_extents, &num_blobs,
@@ -12392,6 +13734,9 @@ void BlueStore::refresh_perf_counters()
   }
   logger->set(l_bluestore_onodes, num_onodes);
   logger->set(l_bluestore_pinned_onodes, num_pinned_onodes);
+  logger->set(l_bluestore_packed_onodes, num_packed_onodes);
+  logger->set(l_bluestore_onode_avg_bytes,
+              mempool_thread.meta_cache->get_bytes_per_onode());
   logger->set(l_bluestore_extents, num_extents);
   logger->set(l_bluestore_blobs, num_blobs);
   logger->set(l_bluestore_buffers, num_buffers);
@@ -12593,7 +13938,7 @@ int BlueStore::read(
     if (offset == length && offset == 0)
       length = o->onode.size;
 
-    r = _do_read(c, o, offset, length, bl, op_flags);
+    r = _do_read(c, o, offset, length, bl, op_flags, 0, true);
     if (r == -EIO) {
       logger->inc(l_bluestore_read_eio);
     }
@@ -12794,6 +14139,7 @@ int BlueStore::_generate_read_result_bl(
   vector<bufferlist>& compressed_blob_bls,
   blobs2read_t& blobs2read,
   bool buffered,
+  int cache_level,
   bool* csum_error,
   bufferlist& bl)
 {
@@ -12822,7 +14168,8 @@ int BlueStore::_generate_read_result_bl(
       if (buffered) {
         bufferlist region_buffer;
         region_buffer.substr_of(raw_bl, blob_offset, length);
-        o->bc.did_read(o->c->cache, offset, std::move(region_buffer));
+        o->bc.did_read(o->c->cache, offset, std::move(region_buffer),
+                       cache_level);
       }
       for (auto& req : r2r) {
         for (auto& r : req.regs) {
@@ -12844,7 +14191,8 @@ int BlueStore::_generate_read_result_bl(
             bufferlist region_buffer;
             region_buffer.substr_of(req.bl, r.front, r.length);
             // need offset before padding
-            o->bc.did_read(o->c->cache, r.logical_offset, std::move(region_buffer));
+            o->bc.did_read(o->c->cache, r.logical_offset,
+                           std::move(region_buffer), cache_level);
           }
           ready_regions[r.logical_offset].substr_of(req.bl, r.front, r.length);
         }
@@ -12884,6 +14232,164 @@ int BlueStore::_generate_read_result_bl(
   return 0;
 }
 
+BlueStore::ReadPrefetch* BlueStore::_prefetch_prepare(
+  Collection* c,
+  OnodeRef& o,
+  uint64_t offset,
+  uint64_t length,
+  uint32_t op_flags)
+{
+  uint64_t max_bytes = prefetch_max_bytes;
+  if (max_bytes == 0 ||
+      (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+                   CEPH_OSD_OP_FLAG_FADVISE_NOCACHE |
+                   CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE))) {
+    return nullptr;
+  }
+  auto ra = o->readahead.load();
+  if (!ra) {
+    auto n = new OnodeReadahead;
+    n->max_window = max_bytes;
+    if (o->readahead.compare_exchange_strong(ra, n)) {
+      ra = n;
+    } else {
+      delete n;
+    }
+  }
+
+  uint64_t min_bytes = prefetch_min_bytes;
+  uint64_t end = offset + length;
+  Readahead::extent_t ext;
+  {
+    std::lock_guard l(ra->lock);
+    if (offset != ra->last_end && ra->pf_end > ra->pf_start) {
+      // the stream broke off, back off the window for the next one
+      logger->inc(l_bluestore_prefetch_waste_bytes,
+                  ra->pf_end - ra->pf_start);
+      ra->max_window = std::max(min_bytes, ra->max_window / 2);
+      ra->pf_start = ra->pf_end = 0;
+    }
+    ra->last_end = end;
+    if (offset < ra->pf_end && end > ra->pf_start) {
+      logger->inc(l_bluestore_prefetch_hit_bytes,
+                  std::min(end, ra->pf_end) - std::max(offset, ra->pf_start));
+      ra->pf_start = std::min(end, ra->pf_end);
+      if (ra->pf_start == ra->pf_end) {
+        // the reader caught up with us, widen the window
+        ra->max_window = std::min(max_bytes, ra->max_window * 2);
+      }
+    }
+    ra->max_window = std::clamp(ra->max_window, min_bytes, max_bytes);
+    ra->ra.set_trigger_requests(prefetch_trigger_requests);
+    ra->ra.set_min_readahead_size(min_bytes);
+    ra->ra.set_max_readahead_size(ra->max_window);
+    ext = ra->ra.update(offset, length, o->onode.size);
+    if (ext.second == 0) {
+      return nullptr;
+    }
+    if (ext.first != ra->pf_end) {
+      ra->pf_start = ext.first;
+    }
+    ra->pf_end = ext.first + ext.second;
+  }
+
+  dout(20) << __func__ << " 0x" << std::hex << ext.first << "~" << ext.second
+           << std::dec << " after 0x" << std::hex << offset << "~" << length
+           << std::dec << dendl;
+  logger->inc(l_bluestore_prefetch_bytes, ext.second);
+  auto pf = std::make_unique<ReadPrefetch>(cct, c, o);
+  pf->gen = ra->gen;
+  pf->offset = ext.first;
+  pf->length = ext.second;
+  o->extent_map.fault_range(db, pf->offset, pf->length);
+  _read_cache(o, pf->offset, pf->length, 0, pf->ready_regions, pf->blobs2read);
+  int r = _prepare_read_ioc(pf->blobs2read, &pf->compressed_blob_bls, &pf->ioc);
+  if (r < 0 || !pf->ioc.has_pending_aios()) {
+    return nullptr;
+  }
+  return pf.release();
+}
+
+// The prefetch is not waited for: the reader goes on as soon as its own
+// aios complete, and the aio thread populates the cache with the window
+// in _prefetch_finish().
+void BlueStore::_prefetch_submit(ReadPrefetch* pf)
+{
+  {
+    std::lock_guard l(prefetch_lock);
+    ++prefetch_in_flight;
+  }
+  bdev->aio_submit(&pf->ioc);
+}
+
+void BlueStore::_prefetch_finish(ReadPrefetch* pf)
+{
+  auto fin = make_scope_guard([this] {
+    std::lock_guard l(prefetch_lock);
+    if (--prefetch_in_flight == 0) {
+      prefetch_cond.notify_all();
+    }
+  });
+  // released before the prefetch counts as finished
+  std::unique_ptr<ReadPrefetch> deleter(pf);
+  auto& o = pf->o;
+  if (pf->ioc.get_return_value() < 0 || pf->ioc.skip_cache()) {
+    dout(10) << __func__ << " dropping 0x" << std::hex << pf->offset << "~"
+             << pf->length << std::dec << dendl;
+    return;
+  }
+  // don't block the aio thread behind a writer: what it is changing is
+  // going to be written or discarded anyway
+  std::shared_lock l(pf->c->lock, std::try_to_lock);
+  if (!l.owns_lock() || !o->exists || pf->gen != o->readahead.load()->gen) {
+    dout(20) << __func__ << " 0x" << std::hex << pf->offset << "~"
+             << pf->length << std::dec << " raced with a write" << dendl;
+    return;
+  }
+  // only populate the cache; errors are left for the actual read to report
+  auto p = pf->compressed_blob_bls.begin();
+  for (auto& [bptr, r2r] : pf->blobs2read) {
+    if (bptr->get_blob().is_compressed()) {
+      ceph_assert(p != pf->compressed_blob_bls.end());
+      bufferlist& compressed_bl = *p++;
+      if (_verify_csum(o, &bptr->get_blob(), 0, compressed_bl,
+                       r2r.front().regs.front().logical_offset) < 0) {
+        return;
+      }
+      bufferlist raw_bl;
+      if (_decompress(compressed_bl, &raw_bl) < 0) {
+        return;
+      }
+      for (auto& req : r2r) {
+        for (auto& r : req.regs) {
+          bufferlist region_buffer;
+          region_buffer.substr_of(raw_bl, r.blob_xoffset, r.length);
+          o->bc.did_read(o->c->cache, r.logical_offset,
+                         std::move(region_buffer));
+        }
+      }
+    } else {
+      for (auto& req : r2r) {
+        if (_verify_csum(o, &bptr->get_blob(), req.r_off, req.bl,
+                         r2r.front().regs.front().logical_offset) < 0) {
+          return;
+        }
+        for (const auto& r : req.regs) {
+          bufferlist region_buffer;
+          region_buffer.substr_of(req.bl, r.front, r.length);
+          o->bc.did_read(o->c->cache, r.logical_offset, std::move(region_buffer));
+        }
+      }
+    }
+  }
+}
+
+void BlueStore::_prefetch_drain()
+{
+  std::unique_lock l(prefetch_lock);
+  prefetch_cond.wait(l, [this] { return prefetch_in_flight == 0; });
+}
+
 int BlueStore::_do_read(
   Collection *c,
   OnodeRef& o,
@@ -12891,7 +14397,8 @@ int BlueStore::_do_read(
   size_t length,
   bufferlist& bl,
   uint32_t op_flags,
-  uint64_t retry_count)
+  uint64_t retry_count,
+  bool prefetch)
 {
   FUNCTRACE(cct);
   int r = 0;
@@ -12909,6 +14416,7 @@ int BlueStore::_do_read(
   // generally, don't buffer anything, unless the client explicitly requests
   // it.
   bool buffered = false;
+  int cache_level = 1;
   if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_WILLNEED) {
     dout(20) << __func__ << " will do buffered read" << dendl;
     buffered = true;
@@ -12917,6 +14425,13 @@ int BlueStore::_do_read(
 			  CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0) {
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
     buffered = true;
+  } else if (cct->_conf->bluestore_default_buffered_read) {
+    // keep what the client won't reuse at the cold end of the cache:
+    // evicted first, but still able to serve a concurrent reader and
+    // never displacing the working set
+    dout(20) << __func__ << " will do cold buffered read" << dendl;
+    buffered = true;
+    cache_level = 0;
   }
 
   if (offset + length > o->onode.size) {
@@ -12956,10 +14471,19 @@ int BlueStore::_do_read(
   if (r < 0)
     return r;
 
+  // sequential stream? queue the readahead window behind our own reads
+  ReadPrefetch* pf = nullptr;
+  if (prefetch && retry_count == 0) {
+    pf = _prefetch_prepare(c, o, offset, length, op_flags);
+  }
+
   int64_t num_ios = blobs2read.size();
   if (ioc.has_pending_aios()) {
     num_ios = ioc.get_num_ios();
     bdev->aio_submit(&ioc);
+    if (pf) {
+      _prefetch_submit(pf);
+    }
     dout(20) << __func__ << " waiting for aio" << dendl;
     ioc.aio_wait();
     r = ioc.get_return_value();
@@ -12967,6 +14491,8 @@ int BlueStore::_do_read(
       ceph_assert(r == -EIO); // no other errors allowed
       return -EIO;
     }
+  } else if (pf) {
+    _prefetch_submit(pf);
   }
   log_latency_fn(__func__,
     l_bluestore_read_wait_aio_lat,
@@ -12979,7 +14505,7 @@ int BlueStore::_do_read(
   bool csum_error = false;
   r = _generate_read_result_bl(o, offset, length, ready_regions,
                               compressed_blob_bls, blobs2read,
-                              buffered && !ioc.skip_cache(),
+                              buffered && !ioc.skip_cache(), cache_level,
                               &csum_error, bl);
   if (csum_error) {
     // Handles spurious read errors caused by a kernel bug.
@@ -13249,7 +14775,7 @@ int BlueStore::readv(
       goto out;
     }
 
-    r = _do_readv(c, o, m, bl, op_flags);
+    r = _do_readv(c, o, m, bl, op_flags, 0, true);
     if (r == -EIO) {
       logger->inc(l_bluestore_read_eio);
     }
@@ -13282,7 +14808,8 @@ int BlueStore::_do_readv(
   const interval_set<uint64_t>& m,
   bufferlist& bl,
   uint32_t op_flags,
-  uint64_t retry_count)
+  uint64_t retry_count,
+  bool prefetch)
 {
   FUNCTRACE(cct);
   int r = 0;
@@ -13295,6 +14822,7 @@ int BlueStore::_do_readv(
   // generally, don't buffer anything, unless the client explicitly requests
   // it.
   bool buffered = false;
+  int cache_level = 1;
   if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_WILLNEED) {
     dout(20) << __func__ << " will do buffered read" << dendl;
     buffered = true;
@@ -13303,6 +14831,13 @@ int BlueStore::_do_readv(
                           CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0) {
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
     buffered = true;
+  } else if (cct->_conf->bluestore_default_buffered_read) {
+    // keep what the client won't reuse at the cold end of the cache:
+    // evicted first, but still able to serve a concurrent reader and
+    // never displacing the working set
+    dout(20) << __func__ << " will do cold buffered read" << dendl;
+    buffered = true;
+    cache_level = 0;
   }
   // this method must be idempotent since we may call it several times
   // before we finally read the expected result.
@@ -13334,10 +14869,20 @@ int BlueStore::_do_readv(
       return r;
   }
 
+  // sparse reads are tracked as a single stream covering the whole span
+  ReadPrefetch* pf = nullptr;
+  if (prefetch && retry_count == 0 && !m.empty()) {
+    pf = _prefetch_prepare(c, o, m.range_start(),
+                           m.range_end() - m.range_start(), op_flags);
+  }
+
   auto num_ios = m.size();
   if (ioc.has_pending_aios()) {
     num_ios = ioc.get_num_ios();
     bdev->aio_submit(&ioc);
+    if (pf) {
+      _prefetch_submit(pf);
+    }
     dout(20) << __func__ << " waiting for aio" << dendl;
     ioc.aio_wait();
     r = ioc.get_return_value();
@@ -13345,6 +14890,8 @@ int BlueStore::_do_readv(
       ceph_assert(r == -EIO); // no other errors allowed
       return -EIO;
     }
+  } else if (pf) {
+    _prefetch_submit(pf);
   }
   log_latency_fn(__func__,
     l_bluestore_read_wait_aio_lat,
@@ -13363,7 +14910,7 @@ int BlueStore::_do_readv(
                                  std::get<0>(raw_results[i]),
                                  std::get<1>(raw_results[i]),
                                  std::get<2>(raw_results[i]),
-                                 buffered, &csum_error, t);
+                                 buffered, cache_level, &csum_error, t);
     if (csum_error) {
       // Handles spurious read errors caused by a kernel bug.
       // We sometimes get all-zero pages as a result of the read under
@@ -14382,7 +15929,24 @@ void BlueStore::_txc_state_proc(TransContext *txc)
 	  _txc_apply_kv(txc, true);
 	}
       }
-      {
+      if (unsigned lane_id = _kv_lane_of(txc->osr.get()); lane_id) {
+	KVSyncLane *lane = kv_lanes[lane_id].get();
+	std::lock_guard l(lane->lock);
+	lane->queue.push_back(txc);
+	if (!lane->sync_in_progress) {
+	  lane->sync_in_progress = true;
+	  lane->cond.notify_one();
+	}
+	if (txc->get_state() != TransContext::STATE_KV_SUBMITTED) {
+	  lane->queue_unsubmitted.push_back(txc);
+	  ++txc->osr->kv_committing_serially;
+	}
+	if (txc->had_ios)
+	  lane->ios++;
+	lane->throttle_costs += txc->cost;
+	++lane->throttle_txcs;
+	lane->logger->set(l_bluestore_kv_lane_queue_depth, lane->queue.size());
+      } else {
 	std::lock_guard l(kv_lock);
 	kv_queue.push_back(txc);
 	if (!kv_sync_in_progress) {
@@ -14397,6 +15961,7 @@ void BlueStore::_txc_state_proc(TransContext *txc)
 	  kv_ios++;
 	kv_throttle_costs += txc->cost;
 	++kv_throttle_txcs;
+	kv_lanes[0]->logger->set(l_bluestore_kv_lane_queue_depth, kv_queue.size());
       }
       return;
     case TransContext::STATE_KV_SUBMITTED:
@@ -14926,14 +16491,62 @@ void BlueStore::_kv_start()
 {
   dout(10) << __func__ << dendl;
 
+  ceph_assert(kv_lanes.empty());
+  unsigned num_lanes = std::max<uint64_t>(
+    1, cct->_conf.get_val<uint64_t>("bluestore_kv_sync_lanes"));
+  for (unsigned i = 0; i < num_lanes; ++i) {
+    auto lane = std::make_unique<KVSyncLane>(this, i);
+    PerfCountersBuilder b(cct, fmt::format("bluestore-kv-lane-{}", i),
+			  l_bluestore_kv_lane_first, l_bluestore_kv_lane_last);
+    b.add_u64(l_bluestore_kv_lane_queue_depth, "queue_depth",
+	      "Transactions waiting for the lane's kv sync");
+    b.add_u64_avg(l_bluestore_kv_lane_batch_txcs, "batch_txcs",
+		  "Transactions committed per lane kv sync");
+    b.add_time_avg(l_bluestore_kv_lane_sync_lat, "sync_lat",
+		   "Average lane kv sync latency");
+    b.add_time_avg(l_bluestore_kv_lane_final_lat, "final_lat",
+		   "Average lane kv finalize latency");
+    lane->logger = b.create_perf_counters();
+    cct->get_perfcounters_collection()->add(lane->logger);
+    kv_lanes.push_back(std::move(lane));
+  }
+  dout(10) << __func__ << " " << num_lanes << " kv lanes" << dendl;
+
   finisher.start();
   kv_sync_thread.create("bstore_kv_sync");
   kv_finalize_thread.create("bstore_kv_final");
+  for (unsigned i = 1; i < kv_lanes.size(); ++i) {
+    kv_lanes[i]->sync_thread.create(fmt::format("bstore_kvs_{}", i).c_str());
+    kv_lanes[i]->finalize_thread.create(fmt::format("bstore_kvf_{}", i).c_str());
+  }
 }
 
 void BlueStore::_kv_stop()
 {
   dout(10) << __func__ << dendl;
+  // lane finalizers may still queue deferred writes and collections to
+  // reap, so stop them ahead of the primary kv threads.
+  for (unsigned i = 1; i < kv_lanes.size(); ++i) {
+    KVSyncLane *lane = kv_lanes[i].get();
+    {
+      std::unique_lock l{lane->lock};
+      while (!lane->sync_started) {
+	lane->cond.wait(l);
+      }
+      lane->stop = true;
+      lane->cond.notify_all();
+    }
+    lane->sync_thread.join();
+    {
+      std::unique_lock l{lane->finalize_lock};
+      while (!lane->finalize_started) {
+	lane->finalize_cond.wait(l);
+      }
+      lane->finalize_stop = true;
+      lane->finalize_cond.notify_all();
+    }
+    lane->finalize_thread.join();
+  }
   {
     std::unique_lock l{kv_lock};
     while (!kv_sync_started) {
@@ -14961,6 +16574,11 @@ void BlueStore::_kv_stop()
     std::lock_guard l(kv_finalize_lock);
     kv_finalize_stop = false;
   }
+  for (auto& lane : kv_lanes) {
+    cct->get_perfcounters_collection()->remove(lane->logger);
+    delete lane->logger;
+  }
+  kv_lanes.clear();
   dout(10) << __func__ << " stopping finishers" << dendl;
   finisher.wait_for_empty();
   finisher.stop();
@@ -15019,6 +16637,7 @@ void BlueStore::_kv_sync_thread()
 	       << dendl;
       kv_committing.swap(kv_queue);
       kv_submitting.swap(kv_queue_unsubmitted);
+      kv_lanes[0]->logger->set(l_bluestore_kv_lane_queue_depth, 0);
       deferred_done.swap(deferred_done_queue);
       deferred_stable.swap(deferred_stable_queue);
       aios = kv_ios;
@@ -15078,28 +16697,13 @@ void BlueStore::_kv_sync_thread()
       // we will use one final transaction to force a sync
       KeyValueDB::Transaction synct = db->get_transaction();
 
-      // increase {nid,blobid}_max?  note that this covers both the
-      // case where we are approaching the max and the case we passed
-      // it.  in either case, we increase the max in the earlier txn
-      // we submit.
       uint64_t new_nid_max = 0, new_blobid_max = 0;
-      if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
-	new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
-	bufferlist bl;
-	encode(new_nid_max, bl);
-	t->set(PREFIX_SUPER, "nid_max", bl);
-	dout(10) << __func__ << " new_nid_max " << new_nid_max << dendl;
-      }
-      if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
-	new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
-	bufferlist bl;
-	encode(new_blobid_max, bl);
-	t->set(PREFIX_SUPER, "blobid_max", bl);
-	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
+      std::unique_lock prealloc_l{kv_prealloc_lock};
+      _kv_prealloc_ids(
+	kv_submitting.empty() ? synct : kv_submitting.front()->t,
+	&new_nid_max, &new_blobid_max);
+      if (!new_nid_max && !new_blobid_max) {
+	prealloc_l.unlock();
       }
 
       for (auto txc : kv_committing) {
@@ -15154,6 +16758,7 @@ void BlueStore::_kv_sync_thread()
 
       int committing_size = kv_committing.size();
       int deferred_size = deferred_stable.size();
+      kv_lanes[0]->logger->inc(l_bluestore_kv_lane_batch_txcs, committing_size);
 
 #if defined(WITH_LTTNG)
       double sync_latency = ceph::to_seconds<double>(mono_clock::now() - sync_start);
@@ -15206,6 +16811,9 @@ void BlueStore::_kv_sync_thread()
 	blobid_max = new_blobid_max;
 	dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
       }
+      if (prealloc_l.owns_lock()) {
+	prealloc_l.unlock();
+      }
 
       {
 	auto finish = mono_clock::now();
@@ -15229,6 +16837,7 @@ void BlueStore::_kv_sync_thread()
 	  l_bluestore_kv_sync_lat,
 	  dur,
 	  cct->_conf->bluestore_log_op_age);
+	kv_lanes[0]->logger->tinc(l_bluestore_kv_lane_sync_lat, dur);
       }
 
       l.lock();
@@ -15297,10 +16906,12 @@ void BlueStore::_kv_finalize_thread()
 
       // this is as good a place as any ...
       _reap_collections();
+      auto dur = mono_clock::now() - start;
       log_latency("kv_final",
 	l_bluestore_kv_final_lat,
-	mono_clock::now() - start,
+	dur,
 	cct->_conf->bluestore_log_op_age);
+      kv_lanes[0]->logger->tinc(l_bluestore_kv_lane_final_lat, dur);
 
       l.lock();
     }
@@ -15309,6 +16920,203 @@ void BlueStore::_kv_finalize_thread()
   kv_finalize_started = false;
 }
 
+void BlueStore::_kv_prealloc_ids(
+  KeyValueDB::Transaction t,
+  uint64_t *new_nid_max,
+  uint64_t *new_blobid_max)
+{
+  ceph_assert(ceph_mutex_is_locked(kv_prealloc_lock));
+  // increase {nid,blobid}_max?  note that this covers both the
+  // case where we are approaching the max and the case we passed
+  // it.  in either case, we increase the max in the earlier txn
+  // we submit.
+  if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
+    *new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
+    bufferlist bl;
+    encode(*new_nid_max, bl);
+    t->set(PREFIX_SUPER, "nid_max", bl);
+    dout(10) << __func__ << " new_nid_max " << *new_nid_max << dendl;
+  }
+  if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
+    *new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
+    bufferlist bl;
+    encode(*new_blobid_max, bl);
+    t->set(PREFIX_SUPER, "blobid_max", bl);
+    dout(10) << __func__ << " new_blobid_max " << *new_blobid_max << dendl;
+  }
+}
+
+// Secondary kv lanes only commit txcs.  Deferred io bookkeeping stays
+// with _kv_sync_thread, which keeps the bluefs/bdev flush ordering for
+// deferred writes in one place.
+void BlueStore::_kv_lane_sync_thread(KVSyncLane *lane)
+{
+  dout(10) << __func__ << " lane " << lane->id << " start" << dendl;
+  std::unique_lock l{lane->lock};
+  ceph_assert(!lane->sync_started);
+  lane->sync_started = true;
+  lane->cond.notify_all();
+
+  while (true) {
+    if (lane->queue.empty()) {
+      if (lane->stop)
+	break;
+      dout(20) << __func__ << " lane " << lane->id << " sleep" << dendl;
+      lane->sync_in_progress = false;
+      lane->cond.wait(l);
+      dout(20) << __func__ << " lane " << lane->id << " wake" << dendl;
+      continue;
+    }
+    deque<TransContext*> committing, submitting;
+    committing.swap(lane->queue);
+    submitting.swap(lane->queue_unsubmitted);
+    uint64_t aios = lane->ios;
+    uint64_t costs = lane->throttle_costs;
+    uint64_t txcs = lane->throttle_txcs;
+    lane->ios = 0;
+    lane->throttle_costs = 0;
+    lane->throttle_txcs = 0;
+    lane->logger->set(l_bluestore_kv_lane_queue_depth, 0);
+    l.unlock();
+
+    dout(20) << __func__ << " lane " << lane->id
+	     << " committing " << committing.size()
+	     << " submitting " << submitting.size() << dendl;
+
+    auto start = mono_clock::now();
+    if (aios) {
+      // make data written by these txcs stable before their metadata
+      bdev->flush();
+    }
+    auto after_flush = mono_clock::now();
+
+    KeyValueDB::Transaction synct = db->get_transaction();
+    uint64_t new_nid_max = 0, new_blobid_max = 0;
+    std::unique_lock prealloc_l{kv_prealloc_lock};
+    _kv_prealloc_ids(
+      submitting.empty() ? synct : submitting.front()->t,
+      &new_nid_max, &new_blobid_max);
+    if (!new_nid_max && !new_blobid_max) {
+      prealloc_l.unlock();
+    }
+
+    for (auto txc : committing) {
+      throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
+      if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
+	_txc_apply_kv(txc, false);
+	--txc->osr->kv_committing_serially;
+      } else {
+	ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+      }
+      if (txc->had_ios) {
+	--txc->osr->txc_with_unstable_io;
+      }
+    }
+    throttle.release_kv_throttle(costs, txcs);
+
+    int r = db_was_opened_read_only || cct->_conf->bluestore_debug_omit_kv_commit ?
+      0 : db->submit_transaction_sync(synct);
+    ceph_assert(r == 0);
+
+    if (new_nid_max) {
+      nid_max = new_nid_max;
+      dout(10) << __func__ << " nid_max now " << nid_max << dendl;
+    }
+    if (new_blobid_max) {
+      blobid_max = new_blobid_max;
+      dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
+    }
+    if (prealloc_l.owns_lock()) {
+      prealloc_l.unlock();
+    }
+
+    lane->logger->inc(l_bluestore_kv_lane_batch_txcs, committing.size());
+    {
+      std::lock_guard m{lane->finalize_lock};
+      lane->committing_to_finalize.insert(
+	lane->committing_to_finalize.end(),
+	committing.begin(),
+	committing.end());
+      if (!lane->finalize_in_progress) {
+	lane->finalize_in_progress = true;
+	lane->finalize_cond.notify_one();
+      }
+    }
+
+    auto finish = mono_clock::now();
+    log_latency("kv_flush",
+      l_bluestore_kv_flush_lat,
+      after_flush - start,
+      cct->_conf->bluestore_log_op_age);
+    log_latency("kv_commit",
+      l_bluestore_kv_commit_lat,
+      finish - after_flush,
+      cct->_conf->bluestore_log_op_age);
+    log_latency("kv_sync",
+      l_bluestore_kv_sync_lat,
+      finish - start,
+      cct->_conf->bluestore_log_op_age);
+    lane->logger->tinc(l_bluestore_kv_lane_sync_lat, finish - start);
+
+    l.lock();
+  }
+  dout(10) << __func__ << " lane " << lane->id << " finish" << dendl;
+  lane->sync_started = false;
+}
+
+void BlueStore::_kv_lane_finalize_thread(KVSyncLane *lane)
+{
+  deque<TransContext*> kv_committed;
+  dout(10) << __func__ << " lane " << lane->id << " start" << dendl;
+  std::unique_lock l(lane->finalize_lock);
+  ceph_assert(!lane->finalize_started);
+  lane->finalize_started = true;
+  lane->finalize_cond.notify_all();
+  while (true) {
+    ceph_assert(kv_committed.empty());
+    if (lane->committing_to_finalize.empty()) {
+      if (lane->finalize_stop)
+	break;
+      dout(20) << __func__ << " lane " << lane->id << " sleep" << dendl;
+      lane->finalize_in_progress = false;
+      lane->finalize_cond.wait(l);
+      dout(20) << __func__ << " lane " << lane->id << " wake" << dendl;
+      continue;
+    }
+    kv_committed.swap(lane->committing_to_finalize);
+    l.unlock();
+    dout(20) << __func__ << " lane " << lane->id
+	     << " kv_committed " << kv_committed << dendl;
+
+    auto start = mono_clock::now();
+    while (!kv_committed.empty()) {
+      TransContext *txc = kv_committed.front();
+      ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+      _txc_state_proc(txc);
+      kv_committed.pop_front();
+    }
+
+    if (!deferred_aggressive) {
+      if (deferred_queue_size >= deferred_batch_ops.load() ||
+	  throttle.should_submit_deferred()) {
+	deferred_try_submit();
+      }
+    }
+    _reap_collections();
+
+    auto dur = mono_clock::now() - start;
+    log_latency("kv_final",
+      l_bluestore_kv_final_lat,
+      dur,
+      cct->_conf->bluestore_log_op_age);
+    lane->logger->tinc(l_bluestore_kv_lane_final_lat, dur);
+
+    l.lock();
+  }
+  dout(10) << __func__ << " lane " << lane->id << " finish" << dendl;
+  lane->finalize_started = false;
+}
+
 
 bluestore_deferred_op_t *BlueStore::_get_deferred_op(
   TransContext *txc, uint64_t len)
@@ -15678,10 +17486,14 @@ int BlueStore::queue_transactions(
   TransContext *txc = _txc_create(static_cast<Collection*>(ch.get()), osr,
 				  &on_commit, op);
 
+  // data is meant to go from the messenger to the device as is; copies made
+  // along the way (realignment, c_str() on fragmented buffers) show up here
+  ceph::buffer_instrumentation::copy_tracker copied;
   for (vector<Transaction>::iterator p = tls.begin(); p != tls.end(); ++p) {
     txc->bytes += (*p).get_num_bytes();
     _txc_add_transaction(txc, &(*p));
   }
+  logger->inc(l_bluestore_write_copied_bytes, copied.get());
   _txc_calc_cost(txc);
 
   _txc_write_nodes(txc, txc->t);
@@ -15774,6 +17586,176 @@ void BlueStore::_txc_aio_submit(TransContext *txc)
   bdev->aio_submit(&txc->ioc);
 }
 
+void BlueStore::_txc_prefetch(
+  Transaction *t,
+  vector<CollectionRef>& cvec,
+  vector<OnodeRef>& ovec)
+{
+  // Pre-scan the ops for the objects they touch, the way the op loop in
+  // _txc_add_transaction would first reference them, plus the ranges
+  // written or zeroed.  Everything that is not cached yet is then read
+  // with one multi-key lookup per collection and kind of key (onodes,
+  // extent map shards, shared blobs) instead of one point lookup each.
+  struct object_t {
+    bool seen = false;
+    bool lookup = false;
+    bool create = false;
+    uint32_t cid = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+  };
+  vector<object_t> objs(ovec.size());
+  auto note = [&](uint32_t cid, uint32_t oid, bool lookup, bool create) {
+    auto& obj = objs[oid];
+    if (!obj.seen && cid < cvec.size() && cvec[cid]) {
+      obj.seen = true;
+      obj.lookup = lookup;
+      obj.create = create;
+      obj.cid = cid;
+    }
+  };
+
+  Transaction::iterator i = t->begin();
+  while (i.have_op()) {
+    Transaction::Op *op = i.decode_op();
+    switch (op->op) {
+    case Transaction::OP_NOP:
+    case Transaction::OP_RMCOLL:
+    case Transaction::OP_MKCOLL:
+    case Transaction::OP_SPLIT_COLLECTION:
+    case Transaction::OP_SPLIT_COLLECTION2:
+    case Transaction::OP_MERGE_COLLECTION:
+    case Transaction::OP_COLL_HINT:
+    case Transaction::OP_COLL_SETATTR:
+    case Transaction::OP_COLL_RMATTR:
+    case Transaction::OP_COLL_RENAME:
+      continue;
+    case Transaction::OP_CREATE:
+      note(op->cid, op->oid, false, true);
+      break;
+    case Transaction::OP_TOUCH:
+      note(op->cid, op->oid, true, true);
+      break;
+    case Transaction::OP_WRITE:
+    case Transaction::OP_ZERO:
+      note(op->cid, op->oid, true, true);
+      if (op->len > 0 && op->off + op->len <= OBJECT_MAX_SIZE) {
+        objs[op->oid].ranges.emplace_back(op->off, op->len);
+      }
+      break;
+    case Transaction::OP_CLONE:
+    case Transaction::OP_CLONERANGE2:
+      note(op->cid, op->oid, true, false);
+      note(op->cid, op->dest_oid, true, true);
+      break;
+    default:
+      note(op->cid, op->oid, true, false);
+      break;
+    }
+  }
+
+  for (uint32_t cid = 0; cid < cvec.size(); ++cid) {
+    Collection *c = cvec[cid].get();
+    vector<uint32_t> idx;
+    vector<ghobject_t> oids;
+    vector<bool> create;
+    for (uint32_t oid = 0; oid < objs.size(); ++oid) {
+      if (objs[oid].seen && objs[oid].lookup && objs[oid].cid == cid &&
+          !ovec[oid]) {
+        idx.push_back(oid);
+        oids.push_back(i.get_oid(oid));
+        create.push_back(objs[oid].create);
+      }
+    }
+    if (idx.empty()) {
+      continue;
+    }
+
+    std::unique_lock l(c->lock);
+    vector<OnodeRef> onodes;
+    unsigned n = c->get_onodes(oids, create, &onodes);
+    if (n) {
+      logger->inc(l_bluestore_txc_prefetch_onodes, n);
+      logger->inc(l_bluestore_txc_prefetch_collapsed, n - 1);
+    }
+    for (size_t k = 0; k < idx.size(); ++k) {
+      ovec[idx[k]] = onodes[k];
+    }
+
+    // extent map shards covering the ranges about to be overwritten
+    std::set<string> keys;
+    for (auto oid : idx) {
+      auto& o = ovec[oid];
+      if (o && o->exists) {
+        for (auto& [off, len] : objs[oid].ranges) {
+          o->extent_map.get_unloaded_shard_keys(off, len, &keys);
+        }
+      }
+    }
+    if (!keys.empty()) {
+      std::map<string, bufferlist> values;
+      db->get(PREFIX_OBJ, keys, &values);
+      unsigned loaded = 0;
+      for (auto oid : idx) {
+        auto& o = ovec[oid];
+        if (o && o->exists) {
+          for (auto& [off, len] : objs[oid].ranges) {
+            loaded += o->extent_map.load_shards(off, len, values);
+          }
+        }
+      }
+      logger->inc(l_bluestore_txc_prefetch_shards, loaded);
+      if (loaded > 1) {
+        logger->inc(l_bluestore_txc_prefetch_collapsed, loaded - 1);
+      }
+    }
+
+    // shared blobs whose refs the overwrite is going to release
+    std::map<string, SharedBlobRef> sbs;
+    string key;
+    for (auto oid : idx) {
+      auto& o = ovec[oid];
+      if (!o || !o->exists) {
+        continue;
+      }
+      for (auto& [off, len] : objs[oid].ranges) {
+        for (auto ep = o->extent_map.seek_lextent(off);
+             ep != o->extent_map.extent_map.end() &&
+               ep->logical_offset < off + len;
+             ++ep) {
+          if (ep->blob->get_blob().is_shared() &&
+              !ep->blob->get_shared_blob()->is_loaded()) {
+            get_shared_blob_key(ep->blob->get_shared_blob()->get_sbid(), &key);
+            sbs.emplace(key, ep->blob->get_shared_blob());
+          }
+        }
+      }
+    }
+    if (!sbs.empty()) {
+      keys.clear();
+      for (auto& p : sbs) {
+        keys.insert(p.first);
+      }
+      std::map<string, bufferlist> values;
+      db->get(PREFIX_SHARED_BLOB, keys, &values);
+      unsigned loaded = 0;
+      for (auto& [k, sb] : sbs) {
+        auto v = values.find(k);
+        if (v != values.end() && !sb->is_loaded()) {
+          c->load_shared_blob(sb, v->second);
+          ++loaded;
+        }
+      }
+      logger->inc(l_bluestore_txc_prefetch_shared_blobs, loaded);
+      if (loaded > 1) {
+        logger->inc(l_bluestore_txc_prefetch_collapsed, loaded - 1);
+      }
+    }
+    dout(20) << __func__ << " " << c->cid << " " << idx.size()
+             << " objects, read " << n << " onodes " << sbs.size()
+             << " shared blobs" << dendl;
+  }
+}
+
 void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
 {
   Transaction::iterator i = t->begin();
@@ -15788,6 +17770,9 @@ void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
   }
   
   vector<OnodeRef> ovec(i.objects.size());
+  if (txc_prefetch) {
+    _txc_prefetch(t, cvec, ovec);
+  }
 
   for (int pos = 0; i.have_op(); ++pos) {
     Transaction::Op *op = i.decode_op();
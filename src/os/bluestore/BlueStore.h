@@ -52,6 +52,7 @@
 #include "common/Throttle.h"
 #include "common/perf_counters.h"
 #include "common/PriorityCache.h"
+#include "common/Readahead.h"
 #include "compressor/Compressor.h"
 #include "os/ObjectStore.h"
 
@@ -143,6 +144,7 @@ enum {
   l_bluestore_write_small_pre_read,
 
   l_bluestore_write_pad_bytes,
+  l_bluestore_write_copied_bytes,
   l_bluestore_write_penalty_read_ops,
   l_bluestore_write_new,
 
@@ -176,6 +178,10 @@ enum {
   l_bluestore_onode_misses,
   l_bluestore_onode_shard_hits,
   l_bluestore_onode_shard_misses,
+  l_bluestore_packed_onodes,
+  l_bluestore_onode_packs,
+  l_bluestore_onode_unpacks,
+  l_bluestore_onode_avg_bytes,
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_spanning_blobs,
@@ -189,6 +195,28 @@ enum {
   l_bluestore_buffer_miss_bytes,
   //****************************************
 
+  // read prefetch stats
+  //****************************************
+  l_bluestore_prefetch_bytes,
+  l_bluestore_prefetch_hit_bytes,
+  l_bluestore_prefetch_waste_bytes,
+  //****************************************
+
+  // transaction metadata prefetch stats
+  //****************************************
+  l_bluestore_txc_prefetch_onodes,
+  l_bluestore_txc_prefetch_shards,
+  l_bluestore_txc_prefetch_shared_blobs,
+  l_bluestore_txc_prefetch_collapsed,
+  //****************************************
+
+  // online fsck stats
+  //****************************************
+  l_bluestore_online_fsck_objects,
+  l_bluestore_online_fsck_errors,
+  l_bluestore_online_fsck_passes,
+  //****************************************
+
   // internal stats
   //****************************************
   l_bluestore_onode_reshard,
@@ -238,6 +266,16 @@ enum {
   l_bluestore_last
 };
 
+// per kv commit lane stats, see bluestore_kv_sync_lanes
+enum {
+  l_bluestore_kv_lane_first = 732700,
+  l_bluestore_kv_lane_queue_depth,
+  l_bluestore_kv_lane_batch_txcs,
+  l_bluestore_kv_lane_sync_lat,
+  l_bluestore_kv_lane_final_lat,
+  l_bluestore_kv_lane_last
+};
+
 #define META_POOL_ID ((uint64_t)-1ull)
 using bptr_c_it_t = buffer::ptr::const_iterator;
 
@@ -264,6 +302,11 @@ public:
     max_defer_interval =
 	cct->_conf.get_val<double>("bluestore_max_defer_interval");
   }
+  void _set_prefetch_params();
+  void _set_txc_prefetch() {
+    txc_prefetch = cct->_conf.get_val<bool>("bluestore_txc_prefetch");
+  }
+  void _set_onode_pack_ratio();
 
   struct TransContext;
 
@@ -497,13 +540,14 @@ public:
     void _finish_write(BufferCacheShard* cache, TransContext* txc,
                        uint32_t offset, uint32_t length);
     void did_read(BufferCacheShard* cache,
-                  uint32_t offset, ceph::buffer::list&& bl) {
+                  uint32_t offset, ceph::buffer::list&& bl,
+                  int level = 1) {
       std::lock_guard l(cache->lock);
       uint16_t cache_private = _discard(cache, offset, bl.length());
       _add_buffer(
           cache,
           new Buffer(this, Buffer::STATE_CLEAN, 0, offset, std::move(bl), 0),
-          cache_private, 1, nullptr);
+          cache_private, level, nullptr);
       cache->_trim();
     }
 
@@ -1142,6 +1186,15 @@ public:
       KeyValueDB *db,
       int begin_shard,
       int end_shard);
+    /// collect keys of the not yet loaded shards covering a range
+    void get_unloaded_shard_keys(uint32_t offset, uint32_t length,
+                                 std::set<std::string>* keys);
+    /// load the shards covering a range from values fetched in a batch;
+    /// shards with no value in the batch are left for fault_range()
+    /// return number of shards loaded
+    unsigned load_shards(uint32_t offset, uint32_t length,
+                         std::map<std::string, ceph::buffer::list>& values);
+    void _load_shard(int idx, ceph::buffer::list& v);
 
     /// ensure a range of the map is marked dirty
     void dirty_range(uint32_t offset, uint32_t length);
@@ -1321,6 +1374,19 @@ public:
   struct OnodeSpace;
   struct OnodeCacheShard;
   /// an in-memory object
+  /// sequential read detection and prefetch accounting for an onode
+  struct OnodeReadahead {
+    Readahead ra;
+    ceph::mutex lock = ceph::make_mutex("BlueStore::OnodeReadahead::lock");
+    uint64_t last_end = 0;     ///< end of the previous read
+    uint64_t pf_start = 0;     ///< prefetched range not consumed yet
+    uint64_t pf_end = 0;
+    uint64_t max_window = 0;   ///< adaptive cap on the readahead size
+    /// bumped whenever the data changes, a prefetch issued before
+    /// that must not populate the cache
+    std::atomic<uint64_t> gen = {0};
+  };
+
   struct Onode {
     MEMPOOL_CLASS_HELPERS();
 
@@ -1339,6 +1405,7 @@ public:
     bool cached;              ///< Onode is logically in the cache
                               /// (it can be pinned and hence physically out
                               /// of it at the moment though)
+    bool packed = false;      ///< decoded extent map dropped, see pack()
     uint16_t prev_spanning_cnt = 0; /// spanning blobs count
     ExtentMap extent_map;
     BufferSpace bc;             ///< buffer cache
@@ -1351,6 +1418,8 @@ public:
     ceph::mutex flush_lock = ceph::make_mutex("BlueStore::Onode::flush_lock");
     ceph::condition_variable flush_cond;   ///< wait here for uncommitted txns
     std::shared_ptr<int64_t> cache_age_bin;  ///< cache age bin
+    /// allocated on the first read eligible for prefetch
+    std::atomic<OnodeReadahead*> readahead = {nullptr};
 
     Onode(Collection *c, const ghobject_t& o,
 	  const mempool::bluestore_cache_meta::string& k)
@@ -1382,6 +1451,7 @@ public:
           c->store->logger->dec(l_bluestore_spanning_blobs, prev_spanning_cnt);
         }
       }
+      delete readahead.load();
     }
 
     static void decode_raw(
@@ -1416,6 +1486,12 @@ public:
       cached = false;
     }
 
+    /// drop the decoded extent map of a clean, unreferenced onode, keeping
+    /// only its encoded form; to be called under the onode cache lock
+    bool pack();
+    /// decode the extent map dropped by pack(); under the onode cache lock
+    void unpack();
+
     static const std::string& calc_omap_prefix(uint8_t flags);
     static void calc_omap_header(uint8_t flags, const Onode* o,
       std::string* out);
@@ -1459,6 +1535,37 @@ public:
     }
   };
 
+  /// Keys recently evicted from a cache shard.  A miss on a ghost key
+  /// would have been a hit had the shard been larger, which tells the
+  /// balancer what extra memory buys.
+  struct CacheGhost {
+    static constexpr unsigned BUCKETS = 8;
+
+    struct entry_t {
+      uint64_t weight;
+      uint64_t stamp;  ///< evicted weight at insertion, to estimate depth
+      mempool::bluestore_cache_other::list<uint64_t>::iterator pos;
+    };
+    mempool::bluestore_cache_other::list<uint64_t> lru;  ///< newest first
+    mempool::bluestore_cache_other::unordered_map<uint64_t, entry_t> index;
+
+    uint64_t capacity = 0;  ///< max weight tracked, 0 to disable
+    uint64_t size = 0;      ///< weight tracked
+    uint64_t stamp = 0;     ///< total weight ever evicted
+    uint64_t hits = 0;
+    /// hits by how far past the cache edge they landed, in capacity/BUCKETS
+    uint64_t bucket_hits[BUCKETS] = {0};
+
+    bool enabled() const {
+      return capacity > 0;
+    }
+    void add(uint64_t key, uint64_t weight);
+    /// drop key if present, lowering *depth to its distance from the edge
+    bool take(uint64_t key, uint64_t *depth);
+    void note_hit(uint64_t depth);
+    void set_capacity(uint64_t c);
+  };
+
   /// A generic Cache Shard
   struct CacheShard {
     CephContext *cct;
@@ -1472,6 +1579,14 @@ public:
     std::atomic<uint64_t> num = {0};
     boost::circular_buffer<std::shared_ptr<int64_t>> age_bins;
 
+    // demand tracking, see MempoolThread::_balance_shards()
+    std::atomic<uint64_t> hits = {0};
+    std::atomic<uint64_t> misses = {0};
+    CacheGhost ghost;                       ///< protected by lock
+    uint64_t last_ghost_hits = 0;           ///< at the previous balance
+    std::atomic<double> gain = {0};         ///< ghost hits per byte, smoothed
+    std::atomic<double> share = {0};        ///< fraction of the cache type
+
     CacheShard(CephContext* cct) : cct(cct), logger(nullptr), age_bins(1) {
       shift_bins();
     }
@@ -1531,6 +1646,8 @@ public:
       return count;
     }
 
+    void dump_demand(ceph::Formatter *f);
+
 #ifdef DEBUG_CACHE
     virtual void _audit(const char *s) = 0;
 #else
@@ -1554,7 +1671,19 @@ public:
     virtual void _move_pinned(OnodeCacheShard *to, Onode *o) = 0;
 
     virtual void maybe_unpin(Onode* o) = 0;
-    virtual void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) = 0;
+    /// unpack an onode found in the cache, it is about to be used
+    virtual void _unpack(Onode* o) = 0;
+    virtual void add_stats(uint64_t *onodes, uint64_t *pinned_onodes,
+                           uint64_t *packed_onodes) = 0;
+
+    /// fraction of the unpinned onodes to keep packed
+    void set_pack_ratio(double ratio) {
+      std::lock_guard l(lock);
+      pack_ratio = ratio;
+    }
+  protected:
+    double pack_ratio = 0;
+  public:
     bool empty() {
       return _get_num() == 0;
     }
@@ -1575,6 +1704,12 @@ public:
     }
     static BufferCacheShard *create(BlueStore* store, std::string type,
                                     PerfCounters *logger);
+
+    /// ghost entries track evicted data in chunks of this size
+    static constexpr unsigned GHOST_CHUNK_ORDER = 16;
+    static uint64_t _ghost_key(const ghobject_t& oid, uint64_t chunk);
+    void _ghost_evict(Buffer *b);
+
     virtual void _add(Buffer *b, int level, Buffer *near) = 0;
     virtual void _rm(Buffer *b) = 0;
     virtual void _move(BufferCacheShard *src, Buffer *b) = 0;
@@ -1677,6 +1812,13 @@ public:
       return onode_space.cache;
     }
     OnodeRef get_onode(const ghobject_t& oid, bool create, bool is_createop=false);
+    /// get_onode() for a number of objects at once, reading the ones that
+    /// are not cached with a single kv lookup; out[i] is left null where
+    /// get_onode(oids[i], create[i]) would have returned null.
+    /// return number of onode keys read from the kv store
+    unsigned get_onodes(const std::vector<ghobject_t>& oids,
+                        const std::vector<bool>& create,
+                        std::vector<OnodeRef>* out);
 
     // the terminology is confusing here, sorry!
     //
@@ -1691,6 +1833,7 @@ public:
     //  loaded = SharedBlob::shared_blob_t is loaded from kv store
     void open_shared_blob(uint64_t sbid, BlobRef b);
     void load_shared_blob(SharedBlobRef sb);
+    void load_shared_blob(SharedBlobRef sb, const ceph::buffer::list& v);
     void make_blob_shared(uint64_t sbid, BlobRef b);
     uint64_t make_blob_unshared(SharedBlob *sb);
 
@@ -2309,6 +2452,58 @@ public:
     }
   };
 
+  /// an independent kv commit pipeline; OpSequencers are sharded across lanes
+  struct KVSyncLane {
+    struct SyncThread : public Thread {
+      BlueStore *store;
+      KVSyncLane *lane;
+      SyncThread(BlueStore *s, KVSyncLane *l) : store(s), lane(l) {}
+      void *entry() override {
+	store->_kv_lane_sync_thread(lane);
+	return NULL;
+      }
+    };
+    struct FinalizeThread : public Thread {
+      BlueStore *store;
+      KVSyncLane *lane;
+      FinalizeThread(BlueStore *s, KVSyncLane *l) : store(s), lane(l) {}
+      void *entry() override {
+	store->_kv_lane_finalize_thread(lane);
+	return NULL;
+      }
+    };
+
+    const unsigned id;
+    PerfCounters *logger = nullptr;
+
+    // lane 0 is served by kv_sync_thread/kv_finalize_thread and the
+    // kv_queue/kv_committing_to_finalize members of BlueStore; only the
+    // logger is used for it.
+    SyncThread sync_thread;
+    ceph::mutex lock = ceph::make_mutex("BlueStore::KVSyncLane::lock");
+    ceph::condition_variable cond;
+    bool sync_started = false;
+    bool stop = false;
+    bool sync_in_progress = false;
+    std::deque<TransContext*> queue;             ///< ready, already submitted
+    std::deque<TransContext*> queue_unsubmitted; ///< ready, need submit by lane
+    uint64_t ios = 0;
+    uint64_t throttle_costs = 0;
+    uint64_t throttle_txcs = 0;
+
+    FinalizeThread finalize_thread;
+    ceph::mutex finalize_lock =
+      ceph::make_mutex("BlueStore::KVSyncLane::finalize_lock");
+    ceph::condition_variable finalize_cond;
+    bool finalize_started = false;
+    bool finalize_stop = false;
+    bool finalize_in_progress = false;
+    std::deque<TransContext*> committing_to_finalize; ///< pending finalization
+
+    KVSyncLane(BlueStore *s, unsigned id)
+      : id(id), sync_thread(s, this), finalize_thread(s, this) {}
+  };
+
   struct BigDeferredWriteContext {
     uint64_t off = 0;     // original logical offset
     uint32_t b_off = 0;   // blob relative offset
@@ -2408,9 +2603,15 @@ private:
   std::deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
 
+  /// kv commit lanes, indexed by OpSequencer id modulo size
+  std::vector<std::unique_ptr<KVSyncLane>> kv_lanes;
+  /// serializes nid_max/blobid_max updates between lanes
+  ceph::mutex kv_prealloc_lock = ceph::make_mutex("BlueStore::kv_prealloc_lock");
+
   PerfCounters *logger = nullptr;
 
-  std::list<CollectionRef> removed_collections;
+  ceph::mutex reap_lock = ceph::make_mutex("BlueStore::reap_lock");
+  std::list<CollectionRef> removed_collections; ///< protected by reap_lock
 
   ceph::shared_mutex debug_read_error_lock =
     ceph::make_shared_mutex("BlueStore::debug_read_error_lock");
@@ -2453,6 +2654,15 @@ private:
   ///< approx cost per io, in bytes
   std::atomic<uint64_t> throttle_cost_per_io = {0};
 
+  ///< upper bound of the sequential read prefetch window, 0 to disable
+  std::atomic<uint64_t> prefetch_max_bytes = {0};
+  ///< lower bound of the sequential read prefetch window
+  std::atomic<uint64_t> prefetch_min_bytes = {0};
+  ///< sequential reads required before prefetch kicks in
+  std::atomic<int> prefetch_trigger_requests = {0};
+  ///< batch the metadata lookups of a transaction before executing it
+  std::atomic<bool> txc_prefetch = {false};
+
   std::atomic<Compressor::CompressionMode> comp_mode =
     {Compressor::COMP_NONE}; ///< compression mode
   std::atomic<int> def_compressor_alg = {Compressor::COMP_ALG_NONE};
@@ -2745,11 +2955,57 @@ private:
 
   private:
     void _update_cache_settings();
+    void _balance_shards(double *meta_ratio, double *data_ratio);
     void _resize_shards(bool interval_stats);
 
     mono_clock::time_point last_fragmentation_check;
   } mempool_thread;
 
+  /// background check of a mounted store, a batch of objects at a time
+  struct OnlineFsckThread : public Thread {
+    BlueStore *store;
+    ceph::mutex lock = ceph::make_mutex("BlueStore::OnlineFsckThread::lock");
+    ceph::condition_variable cond;
+    bool running = false;
+    bool stop = false;
+    bool deep = false;
+
+    // progress, checkpointed in the db after every batch
+    bool in_pass = false;       ///< false => next batch starts a new pass
+    coll_t cid;                 ///< collection being checked
+    ghobject_t next;            ///< first object of the next batch
+    uint64_t passes = 0;        ///< completed passes
+    uint64_t objects = 0;       ///< objects checked in the current pass
+    uint64_t errors = 0;        ///< errors found in the current pass
+    uint64_t last_pass_errors = 0;
+
+    // helpers verifying the blobs of a batch along with this thread,
+    // started and stopped with it
+    std::vector<std::thread> workers;
+    ceph::condition_variable workers_cond;
+    bool workers_stop = false;
+    uint64_t batch_seq = 0;              ///< bumped for every batch
+    std::function<void()> batch_work;    ///< set while a batch is verified
+    unsigned workers_busy = 0;
+
+    explicit OnlineFsckThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_online_fsck_thread();
+      return nullptr;
+    }
+    void encode(ceph::buffer::list& bl) const;
+    void decode(ceph::buffer::list::const_iterator& p);
+  } online_fsck_thread;
+
+  /// what the online fsck verifies of a blob, copied out of an onode
+  struct online_fsck_blob_t {
+    ghobject_t oid;
+    bluestore_blob_t blob;
+    uint64_t sbid = 0;          ///< shared blob id, if shared
+    interval_set<uint32_t> used; ///< blob ranges the object references
+    std::string error;          ///< problem spotted while copying
+  };
+
 #ifdef WITH_BLKIN
   ZTracer::Endpoint trace_endpoint {"0.0.0.0", 0, "BlueStore"};
 #endif
@@ -2883,6 +3139,9 @@ private:
 			    TrackedOpRef osd_op=TrackedOpRef());
   void _txc_update_store_statfs(TransContext *txc);
   void _txc_add_transaction(TransContext *txc, Transaction *t);
+  void _txc_prefetch(Transaction *t,
+                     std::vector<CollectionRef>& cvec,
+                     std::vector<OnodeRef>& ovec);
   void _txc_calc_cost(TransContext *txc);
   void _txc_write_nodes(TransContext *txc, KeyValueDB::Transaction t);
   void _txc_state_proc(TransContext *txc);
@@ -2909,6 +3168,14 @@ private:
   void _kv_stop();
   void _kv_sync_thread();
   void _kv_finalize_thread();
+  void _kv_lane_sync_thread(KVSyncLane *lane);
+  void _kv_lane_finalize_thread(KVSyncLane *lane);
+  void _kv_prealloc_ids(KeyValueDB::Transaction t,
+			uint64_t *new_nid_max,
+			uint64_t *new_blobid_max);
+  unsigned _kv_lane_of(const OpSequencer *osr) const {
+    return kv_lanes.size() > 1 ? osr->get_sequencer_id() % kv_lanes.size() : 0;
+  }
 
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, uint64_t len);
   void _deferred_queue(TransContext *txc);
@@ -3131,6 +3398,15 @@ public:
   int quick_fix() override {
     return _fsck(FSCK_SHALLOW, true);
   }
+  /// start checking the mounted store in the background, resuming from
+  /// the last checkpoint; see bluestore_online_fsck_* options
+  int online_fsck_start(bool deep);
+  void online_fsck_stop();
+  /// wait for the online fsck to complete a pass or to stop, or, if objects
+  /// is nonzero, to have checked that many objects of the current pass;
+  /// false on timeout
+  bool online_fsck_wait(uint64_t objects, ceph::timespan timeout);
+  void online_fsck_dump(ceph::Formatter *f);
 
   void set_cache_shards(unsigned num) override;
   void dump_cache_stats(ceph::Formatter *f) override {
@@ -3287,9 +3563,46 @@ private:
     std::vector<ceph::buffer::list>& compressed_blob_bls,
     blobs2read_t& blobs2read,
     bool buffered,
+    int cache_level,
     bool* csum_error,
     ceph::buffer::list& bl);
 
+  /// readahead window read issued alongside a regular object read, it
+  /// populates the buffer cache when its aio completes
+  struct ReadPrefetch : public AioContext {
+    CollectionRef c;
+    OnodeRef o;
+    uint64_t gen = 0;          ///< OnodeReadahead::gen when issued
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    ready_regions_t ready_regions;
+    blobs2read_t blobs2read;
+    std::vector<ceph::buffer::list> compressed_blob_bls;
+    IOContext ioc;
+
+    ReadPrefetch(CephContext* cct, Collection* c, OnodeRef& o)
+      : c(c), o(o), ioc(cct, this, true) {}
+
+    void aio_finish(BlueStore *store) override {
+      store->_prefetch_finish(this);
+    }
+  };
+
+  ceph::mutex prefetch_lock = ceph::make_mutex("BlueStore::prefetch_lock");
+  ceph::condition_variable prefetch_cond;
+  unsigned prefetch_in_flight = 0;  ///< prefetches submitted, not finished
+
+  ReadPrefetch* _prefetch_prepare(
+    Collection* c,
+    OnodeRef& o,
+    uint64_t offset,
+    uint64_t length,
+    uint32_t op_flags);
+
+  void _prefetch_submit(ReadPrefetch* pf);
+  void _prefetch_finish(ReadPrefetch* pf);
+  void _prefetch_drain();
+
   int _do_read(
     Collection *c,
     OnodeRef& o,
@@ -3297,7 +3610,8 @@ private:
     size_t len,
     ceph::buffer::list& bl,
     uint32_t op_flags = 0,
-    uint64_t retry_count = 0);
+    uint64_t retry_count = 0,
+    bool prefetch = false);
 
   void _do_read_and_pad(
     Collection* c,
@@ -3312,7 +3626,8 @@ private:
     const interval_set<uint64_t>& m,
     ceph::buffer::list& bl,
     uint32_t op_flags = 0,
-    uint64_t retry_count = 0);
+    uint64_t retry_count = 0,
+    bool prefetch = false);
 
   int _fiemap(CollectionHandle &c_, const ghobject_t& oid,
 	      uint64_t offset, size_t len, interval_set<uint64_t>& destset);
@@ -4139,6 +4454,19 @@ private:
   void _fsck_check_objects(FSCKDepth depth,
     FSCK_ObjectCtx& ctx);
 
+  void _online_fsck_thread();
+  void _online_fsck_worker();
+  int _online_fsck_batch(CollectionRef& c, ghobject_t *pos, bool deep,
+    uint64_t *errors);
+  OnodeRef _online_fsck_load(CollectionRef& c, const ghobject_t& oid);
+  void _online_fsck_snapshot(OnodeRef& o,
+    std::vector<online_fsck_blob_t>* blobs);
+  int _online_fsck_verify(const online_fsck_blob_t& b, bool deep,
+    std::ostream& err);
+  int _online_fsck_confirm(CollectionRef& c, const ghobject_t& oid,
+    bool deep);
+  void _online_fsck_save();
+
 public:
   static int create_bdev_labels(CephContext *cct,
                           const std::string& path,
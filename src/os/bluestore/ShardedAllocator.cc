@@ -0,0 +1,244 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "ShardedAllocator.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef  dout_prefix
+#define dout_prefix *_dout << "ShardedAllocator(" << get_name() << ") "
+
+ShardedAllocator::ShardedAllocator(CephContext* cct,
+				   std::string_view type,
+				   int64_t device_size,
+				   int64_t block_size,
+				   size_t num_shards,
+				   std::string_view name)
+  : AllocatorBase(name, device_size, block_size),
+    cct(cct),
+    inner_type(type)
+{
+  ceph_assert(num_shards > 0);
+  uint64_t align = std::max<uint64_t>(REGION_ALIGNMENT, block_size);
+  region_size = std::max(p2roundup<uint64_t>(device_size / num_shards, align),
+			 align);
+  num_shards = std::max<uint64_t>(1, div_round_up(device_size, region_size));
+  shards.resize(num_shards);
+  for (size_t i = 0; i < num_shards; ++i) {
+    auto& s = shards[i];
+    s.start = i * region_size;
+    s.length = std::min<uint64_t>(region_size, device_size - s.start);
+    std::string shard_name;
+    if (!name.empty()) {
+      shard_name = std::string(name) + ".shard" + std::to_string(i);
+    }
+    s.alloc.reset(Allocator::create(cct, type, s.length, block_size,
+				    shard_name));
+  }
+  ldout(cct, 10) << __func__ << " " << type << " x " << shards.size()
+		 << std::hex << " region 0x" << region_size << std::dec
+		 << dendl;
+}
+
+ShardedAllocator::~ShardedAllocator()
+{
+  shutdown();
+}
+
+ShardedAllocator* ShardedAllocator::create(CephContext* cct,
+					   std::string_view type,
+					   int64_t size,
+					   int64_t block_size,
+					   size_t num_shards,
+					   std::string_view name)
+{
+  auto a = new ShardedAllocator(cct, type, size, block_size, num_shards, name);
+  for (auto& s : a->shards) {
+    if (!s.alloc) {
+      delete a;
+      return nullptr;
+    }
+  }
+  return a;
+}
+
+size_t ShardedAllocator::_get_home_shard() const
+{
+  return std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+    shards.size();
+}
+
+int64_t ShardedAllocator::_allocate_from(
+  size_t idx,
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t hint,
+  PExtentVector* extents)
+{
+  auto& s = shards[idx];
+  int64_t h = hint;
+  if (hint > 0) {
+    h = (uint64_t)hint >= s.start && (uint64_t)hint < s.start + s.length ?
+      hint - s.start : 0;
+  }
+  auto orig_size = extents->size();
+  int64_t r = s.alloc->allocate(want, unit, max_alloc_size, h, extents);
+  if (r <= 0) {
+    return 0;
+  }
+  for (auto p = extents->begin() + orig_size; p != extents->end(); ++p) {
+    p->offset += s.start;
+  }
+  return r;
+}
+
+int64_t ShardedAllocator::allocate(
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t hint,
+  PExtentVector* extents)
+{
+  ldout(cct, 10) << __func__ << std::hex
+		 << " 0x" << want
+		 << "/" << unit
+		 << "," << max_alloc_size
+		 << "," << hint
+		 << std::dec << dendl;
+  ceph_assert(want % unit == 0);
+
+  size_t home = hint > 0 && hint < device_size ?
+    _get_shard(hint) : _get_home_shard();
+  int64_t allocated =
+    _allocate_from(home, want, unit, max_alloc_size, hint, extents);
+  if ((uint64_t)allocated < want && shards.size() > 1) {
+    // home region is running low, steal from the roomiest ones
+    std::vector<std::pair<uint64_t, size_t>> donors;
+    donors.reserve(shards.size() - 1);
+    for (size_t i = 0; i < shards.size(); ++i) {
+      if (i != home) {
+	donors.emplace_back(shards[i].alloc->get_free(), i);
+      }
+    }
+    std::sort(donors.begin(), donors.end(), std::greater<>());
+    uint64_t stolen = 0;
+    for (auto& [free, idx] : donors) {
+      if ((uint64_t)allocated >= want || free < unit) {
+	break;
+      }
+      int64_t r = _allocate_from(idx, want - allocated, unit, max_alloc_size,
+				 hint, extents);
+      allocated += r;
+      stolen += r;
+    }
+    if (stolen) {
+      ++steal_count;
+      stolen_bytes += stolen;
+      ldout(cct, 20) << __func__ << " home " << home << std::hex
+		     << " stole 0x" << stolen << std::dec << dendl;
+    }
+  }
+  return allocated ? allocated : -ENOSPC;
+}
+
+void ShardedAllocator::release(const release_set_t& release_set)
+{
+  std::vector<release_set_t> per_shard(shards.size());
+  for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+    _split(p.get_start(), p.get_len(),
+      [&](size_t idx, uint64_t off, uint64_t len) {
+	per_shard[idx].insert(off, len);
+      });
+  }
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (!per_shard[i].empty()) {
+      shards[i].alloc->release(per_shard[i]);
+    }
+  }
+}
+
+void ShardedAllocator::dump()
+{
+  ldout(cct, 0) << __func__ << " " << shards.size() << " shards"
+		<< ", steals " << steal_count
+		<< ", stolen bytes " << stolen_bytes << dendl;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    auto& s = shards[i];
+    ldout(cct, 0) << __func__ << " shard " << i << std::hex
+		  << " 0x" << s.start << "~" << s.length
+		  << " free 0x" << s.alloc->get_free() << std::dec
+		  << " fragmentation " << s.alloc->get_fragmentation()
+		  << dendl;
+    s.alloc->dump();
+  }
+}
+
+void ShardedAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  for (auto& s : shards) {
+    s.alloc->foreach([&](uint64_t offset, uint64_t length) {
+      notify(s.start + offset, length);
+    });
+  }
+}
+
+void ShardedAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << std::hex
+		 << " offset 0x" << offset
+		 << " length 0x" << length
+		 << std::dec << dendl;
+  _split(offset, length, [&](size_t idx, uint64_t off, uint64_t len) {
+    shards[idx].alloc->init_add_free(off, len);
+  });
+}
+
+void ShardedAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << std::hex
+		 << " offset 0x" << offset
+		 << " length 0x" << length
+		 << std::dec << dendl;
+  _split(offset, length, [&](size_t idx, uint64_t off, uint64_t len) {
+    shards[idx].alloc->init_rm_free(off, len);
+  });
+}
+
+uint64_t ShardedAllocator::get_free()
+{
+  uint64_t free = 0;
+  for (auto& s : shards) {
+    free += s.alloc->get_free();
+  }
+  return free;
+}
+
+double ShardedAllocator::get_fragmentation()
+{
+  // weight each region by its share of the free space
+  uint64_t total = 0;
+  double f = 0;
+  for (auto& s : shards) {
+    uint64_t free = s.alloc->get_free();
+    total += free;
+    f += s.alloc->get_fragmentation() * free;
+  }
+  return total ? f / total : 0.0;
+}
+
+void ShardedAllocator::shutdown()
+{
+  for (auto& s : shards) {
+    if (s.alloc) {
+      s.alloc->shutdown();
+    }
+  }
+}
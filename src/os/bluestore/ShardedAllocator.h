@@ -0,0 +1,124 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_OS_BLUESTORE_SHARDEDALLOCATOR_H
+#define CEPH_OS_BLUESTORE_SHARDEDALLOCATOR_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Allocator.h"
+#include "AllocatorBase.h"
+
+/*
+ * Splits the device into a number of contiguous regions, each one served
+ * by its own instance of a regular allocator (and hence its own lock).
+ *
+ * Every thread has a home region picked from its id, so OSD op shard
+ * threads stay on separate locks.  When the home region can't satisfy a
+ * request the remainder is stolen from the regions having the most free
+ * space.  Release and init_{add,rm}_free requests are routed by offset.
+ *
+ * Region allocators operate on region-relative offsets; translation to
+ * device offsets happens here.
+ */
+class ShardedAllocator : public AllocatorBase {
+  struct Shard {
+    uint64_t start = 0;   ///< device offset of the region
+    uint64_t length = 0;  ///< region length
+    std::unique_ptr<Allocator> alloc;
+  };
+
+  CephContext* cct;
+  std::string inner_type;
+  uint64_t region_size = 0;
+  std::vector<Shard> shards;
+
+  std::atomic<uint64_t> steal_count = 0;  ///< requests served by other regions
+  std::atomic<uint64_t> stolen_bytes = 0;
+
+  size_t _get_shard(uint64_t offset) const {
+    return std::min<size_t>(offset / region_size, shards.size() - 1);
+  }
+  size_t _get_home_shard() const;
+
+  /// invoke fn(shard, relative offset, length) for every region covered
+  template <typename Fn>
+  void _split(uint64_t offset, uint64_t length, Fn&& fn) {
+    while (length > 0) {
+      size_t idx = _get_shard(offset);
+      auto& s = shards[idx];
+      uint64_t l = std::min(length, s.start + s.length - offset);
+      fn(idx, offset - s.start, l);
+      offset += l;
+      length -= l;
+    }
+  }
+  int64_t _allocate_from(size_t idx,
+			 uint64_t want,
+			 uint64_t unit,
+			 uint64_t max_alloc_size,
+			 int64_t hint,
+			 PExtentVector* extents);
+
+public:
+  /// regions start at multiples of this to keep any allocation unit aligned
+  static constexpr uint64_t REGION_ALIGNMENT = 1ull << 24;
+
+  ShardedAllocator(CephContext* cct,
+		   std::string_view type,
+		   int64_t device_size,
+		   int64_t block_size,
+		   size_t num_shards,
+		   std::string_view name);
+  ~ShardedAllocator() override;
+
+  static ShardedAllocator* create(CephContext* cct,
+				  std::string_view type,
+				  int64_t size,
+				  int64_t block_size,
+				  size_t num_shards,
+				  std::string_view name = "");
+
+  const char* get_type() const override {
+    return shards.front().alloc->get_type();
+  }
+  size_t get_num_shards() const {
+    return shards.size();
+  }
+  uint64_t get_steal_count() const {
+    return steal_count;
+  }
+
+  int64_t allocate(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t hint,
+    PExtentVector* extents) override;
+  using Allocator::release;
+  void release(const release_set_t& release_set) override;
+
+  void dump() override;
+  void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) override;
+
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+
+  uint64_t get_free() override;
+  double get_fragmentation() override;
+  void shutdown() override;
+};
+
+#endif
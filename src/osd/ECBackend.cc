@@ -82,9 +82,10 @@ ECBackend::ECBackend(
     read_pipeline(cct, ec_impl, this->sinfo, get_parent()->get_eclistener()),
 #endif
     rmw_pipeline(cct, ec_impl, this->sinfo, get_parent()->get_eclistener(),
-                 *this, ec_extent_cache_lru),
+                 *this, ec_extent_cache_lru, get_parent()->get_logger()),
     recovery_backend(cct, switcher->coll, ec_impl, this->sinfo, read_pipeline,
                       get_parent(), this),
+    read_flush_callback(this),
     ec_impl(ec_impl),
     sinfo(ec_impl, &(get_parent()->get_pool()), stripe_width) {
 
@@ -854,6 +855,15 @@ void ECBackend::check_recovery_sources(const OSDMapRef &osdmap) {
     });
 }
 
+bool ECBackend::schedule_rmw_read_flush(ceph::timespan delay) {
+  get_parent()->get_pg_timer().schedule_after(read_flush_callback, delay);
+  return true;
+}
+
+void ECBackend::cancel_rmw_read_flush() {
+  get_parent()->get_pg_timer().cancel(read_flush_callback);
+}
+
 void ECBackend::on_change() {
   rmw_pipeline.on_change();
   read_pipeline.on_change();
@@ -266,6 +266,33 @@ public:
   RMWPipeline rmw_pipeline;
   ECRecoveryBackend recovery_backend;
 
+  bool schedule_rmw_read_flush(ceph::timespan delay) override;
+  void cancel_rmw_read_flush() override;
+
+  /// Sends the rmw reads held back by the extent cache
+  struct read_flush_callback_t final
+    : public common::intrusive_timer::callback_t {
+    ECBackend *backend;
+
+    read_flush_callback_t(ECBackend *backend) : backend(backend) {}
+
+    void lock() override {
+      return backend->parent->pg_lock();
+    }
+    void unlock() override {
+      return backend->parent->pg_unlock();
+    }
+    void add_ref() override {
+      return backend->parent->pg_add_ref();
+    }
+    void dec_ref() override {
+      return backend->parent->pg_dec_ref();
+    }
+    void invoke() override {
+      return backend->rmw_pipeline.extent_cache.flush_reads();
+    }
+  } read_flush_callback;
+
   ceph::ErasureCodeInterfaceRef ec_impl;
 
   PGBackend::Listener *get_parent() { return parent; }
@@ -157,6 +157,12 @@ struct ECCommon {
       std::map<hobject_t, read_request_t> &&to_read,
       GenContextURef<ec_extents_t&&> &&func) = 0;
 
+  /// @see ECExtentCache::BackendReadListener::schedule_read_flush
+  virtual bool schedule_rmw_read_flush(ceph::timespan delay) {
+    return false;
+  }
+  virtual void cancel_rmw_read_flush() {}
+
   struct ReadOp;
   /**
    * Low level async read mechanism
@@ -599,6 +605,14 @@ struct ECCommon {
         });
     }
 
+    bool schedule_read_flush(ceph::timespan delay) override {
+      return ec_backend.schedule_rmw_read_flush(delay);
+    }
+
+    void cancel_read_flush() override {
+      ec_backend.cancel_rmw_read_flush();
+    }
+
     using OpRef = std::shared_ptr<Op>;
 
     std::map<ceph_tid_t, OpRef> tid_to_op_map; /// Owns Op structure
@@ -668,13 +682,14 @@ struct ECCommon {
                 const ECUtil::stripe_info_t &sinfo,
                 ECListener *parent,
                 ECCommon &ec_backend,
-                ECExtentCache::LRU &ec_extent_cache_lru)
+                ECExtentCache::LRU &ec_extent_cache_lru,
+                PerfCounters *logger = nullptr)
       : cct(cct),
         ec_impl(std::move(ec_impl)),
         sinfo(sinfo),
         parent(parent),
         ec_backend(ec_backend),
-        extent_cache(*this, ec_extent_cache_lru, sinfo, cct),
+        extent_cache(*this, ec_extent_cache_lru, sinfo, cct, logger),
         ec_pdw_write_mode(cct->_conf.get_val<uint64_t>("ec_pdw_write_mode")) {}
   };
 
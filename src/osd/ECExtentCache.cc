@@ -3,6 +3,7 @@
 
 #include "ECExtentCache.h"
 #include "ECUtil.h"
+#include "osd_perf_counters.h"
 
 #include <mutex>
 #include <ranges>
@@ -37,6 +38,8 @@ void ECExtentCache::Object::request(OpRef &op) {
   }
 
   bool read_required = false;
+  // A read which is still to be sent takes this op's reads along.
+  bool read_queued = !requesting.empty();
 
   // If this op previously invalidate cache, the cache had better be empty.
   if (op->did_invalidate_cache) {
@@ -92,21 +95,32 @@ void ECExtentCache::Object::request(OpRef &op) {
   projected_size = op->projected_size;
 
   if (read_required) {
-    send_reads();
+    if (read_queued && pg.logger) {
+      pg.logger->inc(l_osd_ec_cache_reads_coalesced);
+    }
+    if (!pg.delay_reads(*this)) {
+      send_reads();
+    }
   }
   else {
+    if (op->reads && !cache_invalidate_expected && pg.logger) {
+      pg.logger->inc(l_osd_ec_cache_reads_saved);
+    }
     op->read_done = true;
   }
 }
 
 void ECExtentCache::Object::send_reads() {
-  if (reading || requesting.empty())
+  if (reading || read_delayed || requesting.empty())
     return; // Read busy
 
   reading_ops.swap(requesting_ops);
   pg.backend_read.backend_read(oid, requesting, current_size);
   requesting.clear();
   reading = true;
+  if (pg.logger) {
+    pg.logger->inc(l_osd_ec_cache_reads);
+  }
 }
 
 void ECExtentCache::Object::read_done(shard_extent_map_t const &buffers) {
@@ -263,6 +277,40 @@ ECExtentCache::OpRef ECExtentCache::prepare(GenContextURef<OpRef&> &&ctx,
   return op;
 }
 
+/* Hold back the read of an object with no read in flight for the coalescing
+ * window. Returns true if the read is (now) held back.  A read which follows
+ * one in flight is already coalesced, as it is only sent on completion.
+ */
+bool ECExtentCache::delay_reads(Object &object) {
+  if (object.read_delayed) {
+    return true;
+  }
+  if (object.reading || read_coalesce_window == ceph::timespan::zero()) {
+    return false;
+  }
+  if (!read_flush_scheduled) {
+    if (!backend_read.schedule_read_flush(read_coalesce_window)) {
+      return false;
+    }
+    read_flush_scheduled = true;
+  }
+  object.read_delayed = true;
+  delayed_reads.emplace_back(object.oid);
+  return true;
+}
+
+void ECExtentCache::flush_reads() {
+  read_flush_scheduled = false;
+  std::list<hobject_t> to_send;
+  to_send.swap(delayed_reads);
+  for (auto &oid : to_send) {
+    if (auto it = objects.find(oid); it != objects.end()) {
+      it->second.read_delayed = false;
+      it->second.send_reads();
+    }
+  }
+}
+
 void ECExtentCache::read_done(hobject_t const &oid,
                               shard_extent_map_t const &update) {
   objects.at(oid).read_done(update);
@@ -299,10 +347,16 @@ ECExtentCache::Op::~Op() {
  * occurred.
  */
 void ECExtentCache::on_change() {
+  if (read_flush_scheduled) {
+    backend_read.cancel_read_flush();
+    read_flush_scheduled = false;
+  }
+  delayed_reads.clear();
   for (auto &&o : std::views::values(objects)) {
     o.reading_ops.clear();
     o.requesting_ops.clear();
     o.requesting.clear();
+    o.read_delayed = false;
   }
   for (auto &&op : waiting_ops) {
     op->cancel();
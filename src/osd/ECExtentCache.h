@@ -20,6 +20,10 @@
  * contain all necessary reads, so as to catch up. Early on in development, a
  * more parallel read mechanism was explored but was found to have no benefit.
  *
+ * The first read of an idle object can be held back for a short window
+ * (ec_extent_cache_read_coalesce_us), so that the reads of the writes queued
+ * meanwhile go out in the same read rather than in the one after it.
+ *
  * This cache will never re-order IO.
  *
  * The LRU
@@ -76,6 +80,7 @@
 #pragma once
 
 #include "ECUtil.h"
+#include "common/perf_counters.h"
 #include "include/Context.h"
 
 class ECExtentCache {
@@ -94,6 +99,12 @@ class ECExtentCache {
     virtual void backend_read(hobject_t oid,
                               ECUtil::shard_extent_set_t const &request,
                               uint64_t object_size) = 0;
+    /**
+     * Call ECExtentCache::flush_reads() once delay has elapsed.  Returns
+     * false if reads cannot be delayed, in which case they are sent at once.
+     */
+    virtual bool schedule_read_flush(ceph::timespan delay) { return false; }
+    virtual void cancel_read_flush() {}
     virtual ~BackendReadListener() = default;
   };
 
@@ -226,6 +237,7 @@ private:
     uint64_t projected_size = 0;
     uint64_t line_size = 0;
     bool reading = false;
+    bool read_delayed = false;
     bool cache_invalidate_expected = false;
 
     void request(OpRef &op);
@@ -306,6 +318,13 @@ private:
   void cache_maybe_ready();
   uint32_t active_ios = 0;
   CephContext *cct;
+  PerfCounters *logger;
+  const ceph::timespan read_coalesce_window;
+  // Objects with a read held back until flush_reads()
+  std::list<hobject_t> delayed_reads;
+  bool read_flush_scheduled = false;
+
+  bool delay_reads(Object &object);
 
   OpRef prepare(GenContextURef<OpRef&> &&ctx,
                 hobject_t const &oid,
@@ -326,16 +345,22 @@ private:
 
   explicit ECExtentCache(BackendReadListener &backend_read,
                          LRU &lru, const ECUtil::stripe_info_t &sinfo,
-                         CephContext *cct
+                         CephContext *cct,
+                         PerfCounters *logger = nullptr
     ) :
     backend_read(backend_read),
     lru(lru),
     sinfo(sinfo),
-    cct(cct) {}
+    cct(cct),
+    logger(logger),
+    read_coalesce_window(std::chrono::microseconds(
+      cct->_conf.get_val<uint64_t>("ec_extent_cache_read_coalesce_us"))) {}
 
   // Insert some data into the cache.
   void read_done(hobject_t const &oid, ECUtil::shard_extent_map_t const &update);
   void write_done(OpRef const &op, ECUtil::shard_extent_map_t const &update);
+  // Send the reads held back by the coalescing window.
+  void flush_reads();
   void on_change();
   void on_change2() const;
   [[nodiscard]] bool contains_object(hobject_t const &oid) const;
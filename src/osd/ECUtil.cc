@@ -484,12 +484,17 @@ slice_iterator shard_extent_map_t::begin_slice_iterator(
 
 /* Encode parity chunks, using the encode_chunks interface into the
  * erasure coding. This generates all parity using full stripe writes.
+ *
+ * The slices are handed to the plugin as a single batch, so that it sets up
+ * once for the whole write however fragmented the shard buffers are.
  */
 int shard_extent_map_t::encode(const ErasureCodeInterfaceRef &ec_impl,
     DoutPrefixProvider *dpp,
     shard_id_set *dedup_zeros) {
   shard_id_set out_set = sinfo->get_parity_shards();
   bool rebuild_req = false;
+  std::vector<shard_id_map<bufferptr>> batch_in;
+  std::vector<shard_id_map<bufferptr>> batch_out;
 
   for (auto iter = begin_slice_iterator(out_set, dpp, dedup_zeros); !iter.is_end(); ++iter) {
     if (!iter.is_page_aligned()) {
@@ -500,8 +505,14 @@ int shard_extent_map_t::encode(const ErasureCodeInterfaceRef &ec_impl,
     shard_id_map<bufferptr> &in = iter.get_in_bufferptrs();
     shard_id_map<bufferptr> &out = iter.get_out_bufferptrs();
 
-    if (int ret = ec_impl->encode_chunks(in, out)) {
-      return ret;
+    if (dedup_zeros) {
+      // Zero dedup inspects the parity of a slice as the iterator moves on.
+      if (int ret = ec_impl->encode_chunks(in, out)) {
+        return ret;
+      }
+    } else {
+      batch_in.emplace_back(in);
+      batch_out.emplace_back(out);
     }
   }
 
@@ -510,6 +521,10 @@ int shard_extent_map_t::encode(const ErasureCodeInterfaceRef &ec_impl,
     return encode(ec_impl, dpp, dedup_zeros);
   }
 
+  if (!batch_in.empty()) {
+    return ec_impl->encode_chunks_batch(batch_in, batch_out);
+  }
+
   return 0;
 }
 
@@ -525,13 +540,18 @@ int shard_extent_map_t::encode_parity_delta(
   pad_and_rebuild_to_ec_align();
   old_sem.pad_and_rebuild_to_ec_align();
 
+  // The old and new data are staged in the first two data shards, which are
+  // not necessarily shards 0 and 1 if the plugin remaps its chunks (LRC).
+  const shard_id_t old_slot = sinfo->get_shard(raw_shard_id_t(0));
+  const shard_id_t new_slot = sinfo->get_shard(raw_shard_id_t(1));
+
   for (auto data_shard : sinfo->get_data_shards()) {
     shard_extent_map_t s(sinfo);
     if (!contains_shard(data_shard)) {
       continue;
     }
-    s.extent_maps[shard_id_t(0)] = old_sem.extent_maps[data_shard];
-    s.extent_maps[shard_id_t(1)] = extent_maps[data_shard];
+    s.extent_maps[old_slot] = old_sem.extent_maps[data_shard];
+    s.extent_maps[new_slot] = extent_maps[data_shard];
     for (shard_id_t parity_shard : sinfo->get_parity_shards()) {
       if (extent_maps.contains(parity_shard)) {
         s.extent_maps[parity_shard] = extent_maps[parity_shard];
@@ -550,10 +570,10 @@ int shard_extent_map_t::encode_parity_delta(
       ceph_assert(size > 0);
       bufferptr delta = buffer::create_aligned(size, EC_ALIGN_SIZE);
 
-      if (data_shards[shard_id_t(0)].length() != 0 && data_shards[shard_id_t(1)]
-        .length() != 0) {
-        ec_impl->encode_delta(data_shards[shard_id_t(0)],
-                              data_shards[shard_id_t(1)], &delta);
+      if (data_shards[old_slot].length() != 0 &&
+          data_shards[new_slot].length() != 0) {
+        ec_impl->encode_delta(data_shards[old_slot],
+                              data_shards[new_slot], &delta);
         shard_id_map<bufferptr> in(sinfo->get_k_plus_m());
         in.emplace(data_shard, delta);
         ec_impl->apply_delta(in, parity_shards);
@@ -717,6 +737,8 @@ int shard_extent_map_t::_decode(const ErasureCodeInterfaceRef &ec_impl,
                                 const shard_id_set &need_set,
                                 DoutPrefixProvider *dpp) {
   bool rebuild_req = false;
+  std::vector<shard_id_map<bufferptr>> batch_in;
+  std::vector<shard_id_map<bufferptr>> batch_out;
 
   for (auto iter = begin_slice_iterator(need_set, dpp); !iter.is_end(); ++iter) {
     if (!iter.is_page_aligned()) {
@@ -731,9 +753,8 @@ int shard_extent_map_t::_decode(const ErasureCodeInterfaceRef &ec_impl,
       continue;
     }
 
-    if (int ret = ec_impl->decode_chunks(want_set, in, out)) {
-      return ret;
-    }
+    batch_in.emplace_back(in);
+    batch_out.emplace_back(out);
   }
 
   if (rebuild_req) {
@@ -741,6 +762,12 @@ int shard_extent_map_t::_decode(const ErasureCodeInterfaceRef &ec_impl,
     return _decode(ec_impl, want_set, need_set, dpp);
   }
 
+  if (!batch_in.empty()) {
+    if (int ret = ec_impl->decode_chunks_batch(want_set, batch_in, batch_out)) {
+      return ret;
+    }
+  }
+
   compute_ro_range();
 
   return 0;
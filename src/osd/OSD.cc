@@ -6407,6 +6407,9 @@ void OSD::tick_without_osd_lock()
   logger->set(l_osd_cached_crc, ceph::buffer::get_cached_crc());
   logger->set(l_osd_cached_crc_adjusted, ceph::buffer::get_cached_crc_adjusted());
   logger->set(l_osd_missed_crc, ceph::buffer::get_missed_crc());
+  logger->set(l_osd_pglog_bytes, mempool::osd_pglog::allocated_bytes());
+  logger->set(l_osd_pglog_index_bytes,
+	      mempool::osd_pglog_index::allocated_bytes());
 
   // refresh osd stats
   struct store_statfs_t stbuf;
@@ -11025,6 +11028,12 @@ OSDShard::OSDShard(
     shard_name(string("OSDShard.") + stringify(id)),
     sdata_wait_lock_name(shard_name + "::sdata_wait_lock"),
     sdata_wait_lock{make_mutex(sdata_wait_lock_name)},
+    logger(build_osd_shard_logger(cct, id)),
+    lockfree_ingress(cct->_conf.get_val<bool>(
+      "osd_op_queue_lockfree_ingress")),
+    max_spin(std::chrono::microseconds(cct->_conf.get_val<uint64_t>(
+      "osd_op_queue_spin_us"))),
+    spin(max_spin.count()),
     osdmap_lock{make_mutex(shard_name + "::osdmap_lock")},
     shard_lock_name(shard_name + "::shard_lock"),
     shard_lock{make_mutex(shard_lock_name)},
@@ -11035,7 +11044,61 @@ OSDShard::OSDShard(
     ec_extent_cache_lru(cct->_conf.get_val<uint64_t>(
       "ec_extent_cache_size"))
 {
-  dout(0) << "using op scheduler " << *scheduler << dendl;
+  dout(0) << "using op scheduler " << *scheduler
+	  << (lockfree_ingress ? " with lock-free ingress" : "") << dendl;
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+OSDShard::~OSDShard()
+{
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+}
+
+void OSDShard::_drain_ingress()
+{
+  ceph_assert(ceph_mutex_is_locked_by_me(shard_lock));
+  auto n = ingress.drain([this](OpSchedulerItem&& item) {
+    scheduler->enqueue(std::move(item));
+  });
+  if (n) {
+    logger->inc(l_osd_shard_ingress_batches);
+    logger->inc(l_osd_shard_ingress_items, n);
+  }
+}
+
+bool OSDShard::spin_for_work(bool with_context_queue)
+{
+  auto budget = ceph::timespan(spin.load(std::memory_order_relaxed));
+  if (budget == ceph::timespan::zero()) {
+    return false;
+  }
+  auto deadline = ceph::mono_clock::now() + budget;
+  do {
+    if (!ingress.empty() ||
+	(with_context_queue && !context_queue.empty())) {
+      // the shard is busy, spin longer next time
+      spin = std::min(budget * 2, max_spin).count();
+      logger->inc(l_osd_shard_spin_hits);
+      return true;
+    }
+  } while (ceph::mono_clock::now() < deadline);
+  // nothing came up, back off
+  spin = std::max(budget / 2, max_spin / 16).count();
+  logger->inc(l_osd_shard_spin_misses);
+  return false;
+}
+
+void OSDShard::note_dequeue(const OpSchedulerItem& item)
+{
+  if (item.get_enqueue_stamp() == ceph::mono_time{}) {
+    return;
+  }
+  auto lat = ceph::mono_clock::now() - item.get_enqueue_stamp();
+  logger->tinc(l_osd_shard_queue_lat, lat);
+  logger->hinc(l_osd_shard_queue_lat_cost_hist,
+	       std::chrono::nanoseconds(lat).count(),
+	       std::max(item.get_cost(), 0));
 }
 
 
@@ -11080,23 +11143,66 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
   // callback.
   bool is_smallest_thread_index = thread_index < osd->num_shards;
 
+  auto idle = [&] {
+    return sdata->scheduler->empty() &&
+      (!is_smallest_thread_index || sdata->context_queue.empty());
+  };
+
   // peek at spg_t
   sdata->shard_lock.lock();
-  if (sdata->scheduler->empty() &&
-      (!is_smallest_thread_index || sdata->context_queue.empty())) {
+  if (sdata->lockfree_ingress) {
+    sdata->_drain_ingress();
+    if (idle()) {
+      // the next op often follows closely, spin a little for it rather
+      // than paying for a sleep and a wake up
+      sdata->shard_lock.unlock();
+      sdata->spin_for_work(is_smallest_thread_index);
+      sdata->shard_lock.lock();
+      sdata->_drain_ingress();
+    }
+  }
+  if (idle() && work_stealing && !osd->is_stopping()) {
+    sdata->shard_lock.unlock();
+    bool stop_waiting;
+    {
+      std::lock_guard l{sdata->sdata_wait_lock};
+      stop_waiting = sdata->stop_waiting;
+    }
+    if (!stop_waiting) {
+      if (auto victim = _pick_steal_victim(sdata); victim) {
+	// run one item of the victim as if we were one of its threads,
+	// its pg slots keep the items of each pg ordered
+	dout(20) << __func__ << " shard " << sdata->shard_id
+		 << " stealing from shard " << victim->shard_id << dendl;
+	if (_process_one(victim, false, hb, sdata)) {
+	  return;
+	}
+      }
+    }
+    sdata->shard_lock.lock();
+    sdata->_drain_ingress();
+  }
+  if (idle()) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
-    if (is_smallest_thread_index && !sdata->context_queue.empty()) {
-      // we raced with a context_queue addition, don't wait
+    // ingress producers only take sdata_wait_lock if they see a parked
+    // thread, so announce it before looking for work one last time
+    ++sdata->parked_threads;
+    if ((is_smallest_thread_index && !sdata->context_queue.empty()) ||
+	!sdata->ingress.empty()) {
+      // we raced with a context_queue or ingress addition, don't wait
+      --sdata->parked_threads;
       wait_lock.unlock();
+      sdata->_drain_ingress();
     } else if (!sdata->stop_waiting) {
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->parked_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
-      if (sdata->scheduler->empty() &&
-         !(is_smallest_thread_index && !sdata->context_queue.empty())) {
+      sdata->_drain_ingress();
+      if (idle()) {
 	sdata->shard_lock.unlock();
 	return;
       }
@@ -11105,12 +11211,44 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
         timeout_interval.load(), suicide_interval.load());
     } else {
       dout(20) << __func__ << " need return immediately" << dendl;
+      --sdata->parked_threads;
       wait_lock.unlock();
       sdata->shard_lock.unlock();
       return;
     }
   }
 
+  _process_one(sdata, is_smallest_thread_index, hb, nullptr);
+}
+
+OSDShard *OSD::ShardedOpWQ::_pick_steal_victim(OSDShard *thief)
+{
+  // start from the thief's neighbour, so that the idle shards don't all
+  // go after the same victim
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    auto victim = osd->shards[(thief->shard_id + i) % osd->num_shards];
+    // only help the shards whose own threads are all busy
+    if (victim->parked_threads > 0 || !victim->shard_lock.try_lock()) {
+      continue;
+    }
+    victim->_drain_ingress();
+    if (!victim->scheduler->empty()) {
+      return victim;
+    }
+    victim->shard_lock.unlock();
+  }
+  return nullptr;
+}
+
+bool OSD::ShardedOpWQ::_process_one(
+  OSDShard *sdata,
+  bool is_smallest_thread_index,
+  heartbeat_handle_d *hb,
+  OSDShard *thief)
+{
+  // for dout_prefix
+  const uint32_t shard_index = sdata->shard_id;
+
   list<Context *> oncommits;
   if (is_smallest_thread_index) {
     sdata->context_queue.move_to(oncommits);
@@ -11125,11 +11263,11 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
           dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
           delete c;
         }
-        return;    // OSD shutdown, discard.
+        return true;    // OSD shutdown, discard.
       }
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
 
     work_item = sdata->scheduler->dequeue();
@@ -11139,12 +11277,17 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
         dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
         delete c;
       }
-      return;    // OSD shutdown, discard.
+      return true;    // OSD shutdown, discard.
     }
 
     // If the work item is scheduled in the future, wait until
     // the time returned in the dequeue response before retrying.
     if (auto when_ready = std::get_if<double>(&work_item)) {
+      if (thief) {
+	// not ours to wait for, go back to our own shard
+	sdata->shard_lock.unlock();
+	return false;
+      }
       if (is_smallest_thread_index) {
         sdata->shard_lock.unlock();
         handle_oncommits(oncommits);
@@ -11157,10 +11300,15 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
       ++sdata->waiting_threads;
-      sdata->sdata_cond.wait_until(wait_lock, future_time);
+      ++sdata->parked_threads;
+      if (sdata->ingress.empty()) {
+	sdata->sdata_cond.wait_until(wait_lock, future_time);
+      }
+      --sdata->parked_threads;
       --sdata->waiting_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
+      sdata->_drain_ingress();
       // Reapply default wq timeouts
       osd->cct->get_heartbeat_map()->reset_timeout(hb,
         timeout_interval.load(), suicide_interval.load());
@@ -11174,13 +11322,14 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
 
   // Access the stored item
   auto item = std::move(std::get<OpSchedulerItem>(work_item));
+  sdata->note_dequeue(item);
   if (osd->is_stopping()) {
     sdata->shard_lock.unlock();
     for (auto c : oncommits) {
       dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
       delete c;
     }
-    return;    // OSD shutdown, discard.
+    return true;    // OSD shutdown, discard.
   }
 
   const auto token = item.get_ordering_token();
@@ -11221,7 +11370,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     slot = q->second.get();
     --slot->num_running;
@@ -11233,7 +11382,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     if (requeue_seq != slot->requeue_seq) {
       dout(20) << __func__ << " " << token
@@ -11243,7 +11392,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     if (slot->pg != pg) {
       // this can happen if we race with pg removal.
@@ -11342,12 +11491,12 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
 	sdata->shard_lock.unlock();
 	osd->service.release_reserved_pushes(pushes_to_free);
 	handle_oncommits(oncommits);
-	return;
+	return true;
       }
     }
     sdata->shard_lock.unlock();
     handle_oncommits(oncommits);
-    return;
+    return true;
   }
   if (qi.is_peering()) {
     OSDMapRef osdmap = sdata->shard_osdmap;
@@ -11356,7 +11505,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       sdata->shard_lock.unlock();
       pg->unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
   }
   sdata->shard_lock.unlock();
@@ -11390,7 +11539,13 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
   delete f;
   *_dout << dendl;
 
+  if (thief) {
+    thief->logger->inc(l_osd_shard_steals);
+    sdata->logger->inc(l_osd_shard_stolen);
+  }
+  auto run_start = ceph::mono_clock::now();
   qi.run(osd, sdata, pg, tp_handle);
+  sdata->logger->tinc(l_osd_shard_busy, ceph::mono_clock::now() - run_start);
 
   {
 #ifdef WITH_LTTNG
@@ -11404,6 +11559,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
   }
 
   handle_oncommits(oncommits);
+  return true;
 }
 
 void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
@@ -11420,6 +11576,16 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
 
   dout(20) << fmt::format("{} {}", __func__, item) << dendl;
 
+  item.set_enqueue_stamp(ceph::mono_clock::now());
+  if (sdata->lockfree_ingress) {
+    sdata->ingress.push(std::move(item));
+    if (sdata->parked_threads > 0) {
+      std::lock_guard l{sdata->sdata_wait_lock};
+      sdata->sdata_cond.notify_one();
+    }
+    return;
+  }
+
   bool empty = true;
   {
     std::lock_guard l{sdata->shard_lock};
@@ -11478,6 +11644,7 @@ void OSD::ShardedOpWQ::stop_for_fast_shutdown()
     auto& sdata = osd->shards[shard_index];
     ceph_assert(sdata);
     std::lock_guard l(sdata->shard_lock);
+    sdata->ingress.drain([](OpSchedulerItem&&) {});
     while (!sdata->scheduler->empty()) {
       sdata->scheduler->dequeue();
     }
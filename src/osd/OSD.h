@@ -41,6 +41,7 @@
 #include "Session.h"
 
 #include "osd/scheduler/OpScheduler.h"
+#include "osd/scheduler/OpIngressQueue.h"
 
 #include <atomic>
 #include <map>
@@ -981,6 +982,23 @@ struct OSDShard {
   ceph::mutex sdata_wait_lock;
   ceph::condition_variable sdata_cond;
   int waiting_threads = 0;
+  /// threads waiting on sdata_cond, announced under sdata_wait_lock before
+  /// they check for work.  producers on the lock-free ingress read it
+  /// without the lock to tell if they have to wake anyone.
+  std::atomic<int> parked_threads = 0;
+
+  /// per shard queue counters
+  PerfCounters *logger;
+
+  /// items are queued here rather than to the scheduler under shard_lock,
+  /// if osd_op_queue_lockfree_ingress is set
+  const bool lockfree_ingress;
+  ceph::osd::scheduler::OpIngressQueue ingress;
+
+  /// how long an idle worker spins on ingress before parking, adapted
+  /// between max_spin / 16 and max_spin
+  const ceph::timespan max_spin;
+  std::atomic<ceph::timespan::rep> spin;
 
   ceph::mutex osdmap_lock;  ///< protect shard_osdmap updates vs users w/o shard_lock
   OSDMapRef shard_osdmap;
@@ -1030,6 +1048,14 @@ struct OSDShard {
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
   void _detach_pg(OSDShardPGSlot *slot);
 
+  /// move the items queued on ingress into the scheduler
+  void _drain_ingress();
+  /// wait up to the spin time for ingress (or context_queue) to get
+  /// items, without parking.  returns true if they did.
+  bool spin_for_work(bool with_context_queue);
+  /// account the dequeue of an item
+  void note_dequeue(const ceph::osd::scheduler::OpSchedulerItem& item);
+
   void update_pg_epoch(OSDShardPGSlot *slot, epoch_t epoch);
   epoch_t get_min_pg_epoch();
   void wait_min_pg_epoch(epoch_t need);
@@ -1063,6 +1089,7 @@ struct OSDShard {
     OSD *osd,
     op_queue_type_t osd_op_queue,
     unsigned osd_op_queue_cut_off);
+  ~OSDShard();
 };
 
 struct OSDBenchTest {
@@ -1730,13 +1757,26 @@ protected:
   {
     OSD *osd;
     bool m_fast_shutdown = false;
+    /// let idle shard threads run the items of busy shards
+    const bool work_stealing;
+
+    /// find a busy shard to steal from, returned with its shard_lock held
+    OSDShard *_pick_steal_victim(OSDShard *thief);
+    /// dequeue and run an item of sdata, called with sdata->shard_lock held.
+    /// returns false if a thief found only items scheduled in the future.
+    bool _process_one(OSDShard *sdata,
+		      bool is_smallest_thread_index,
+		      ceph::heartbeat_handle_d *hb,
+		      OSDShard *thief);
   public:
     ShardedOpWQ(OSD *o,
 		ceph::timespan ti,
 		ceph::timespan si,
 		ShardedThreadPool* tp)
       : ShardedThreadPool::ShardedWQ<OpSchedulerItem>(ti, si, tp),
-        osd(o) {
+        osd(o),
+	work_stealing(o->cct->_conf.get_val<bool>(
+	  "osd_op_queue_work_stealing")) {
     }
 
     void _add_slot_waiter(
@@ -1795,6 +1835,9 @@ protected:
       auto &&sdata = osd->shards[shard_index];
       ceph_assert(sdata);
       std::lock_guard l(sdata->shard_lock);
+      if (!sdata->ingress.empty()) {
+	return false;
+      }
       if (thread_index < osd->num_shards) {
 	return sdata->scheduler->empty() && sdata->context_queue.empty();
       } else {
@@ -40,6 +40,7 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
     pools.emplace(p.first, PoolMapping(p.second.get_size(),
 				       p.second.get_pg_num(),
 				       p.second.is_erasure()));
+    delta.pools.insert(p.first);
   }
   pools.erase(q, pools.end());
   ceph_assert(pools.size() == osdmap.get_pools().size());
@@ -60,6 +61,85 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+void OSDMapMapping::note_incremental(const OSDMap::Incremental& inc)
+{
+  if (delta.last && inc.epoch != delta.last + 1) {
+    delta.all = true;
+  }
+  delta.last = inc.epoch;
+  if (delta.all) {
+    return;
+  }
+  if (inc.fullmap.length() || inc.crush.length() || inc.new_max_osd >= 0) {
+    delta.all = true;
+    return;
+  }
+  for (auto& p : inc.new_pools) {
+    delta.pools.insert(p.first);
+  }
+  for (auto& [osd, state] : inc.new_state) {
+    if (state & CEPH_OSD_EXISTS) {
+      delta.crush_osds.insert(osd);
+    } else {
+      delta.osds.insert(osd);
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    delta.osds.insert(p.first);
+  }
+  for (auto& p : inc.new_weight) {
+    delta.crush_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_affinity) {
+    delta.osds.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_temp) {
+    delta.pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    delta.pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    delta.pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    delta.pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap_primary) {
+    delta.pgs.insert(p.first);
+  }
+  delta.pgs.insert(inc.old_pg_upmap.begin(), inc.old_pg_upmap.end());
+  delta.pgs.insert(inc.old_pg_upmap_items.begin(),
+		   inc.old_pg_upmap_items.end());
+  delta.pgs.insert(inc.old_pg_upmap_primary.begin(),
+		   inc.old_pg_upmap_primary.end());
+}
+
+std::unique_ptr<OSDMapMapping::MappingJob> OSDMapMapping::start_update(
+  const OSDMap& map,
+  ParallelPGMapper& mapper,
+  unsigned pgs_per_item)
+{
+  std::unique_ptr<MappingJob> job(new MappingJob(&map, this));
+  vector<pg_t> pgs;
+  bool partial = _get_delta_pgs(map, &pgs);
+  if (!partial) {
+    rule_osds.clear();
+  }
+  // whatever happens to this job, the next one starts from this map
+  delta = Delta{};
+  delta.base = delta.last = map.get_epoch();
+  if (!partial) {
+    mapper.queue(job.get(), pgs_per_item, {});
+  } else if (!pgs.empty()) {
+    mapper.queue(job.get(), pgs_per_item, pgs);
+  } else {
+    job->finish = ceph_clock_now();
+    job->complete();
+  }
+  return job;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -126,6 +206,131 @@ void OSDMapMapping::_update_range(
   }
 }
 
+void OSDMapMapping::_update_pgs(
+  const OSDMap& osdmap,
+  const vector<pg_t>& pgs)
+{
+  for (auto& pgid : pgs) {
+    _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+  }
+}
+
+const std::set<int>& OSDMapMapping::_get_rule_osds(
+  const OSDMap& osdmap,
+  int rule)
+{
+  auto [p, inserted] = rule_osds.try_emplace(rule);
+  if (inserted) {
+    std::map<int,float> weights;
+    osdmap.crush->get_rule_weight_osd_map(rule, &weights);
+    for (auto& w : weights) {
+      p->second.insert(p->second.end(), w.first);
+    }
+  }
+  return p->second;
+}
+
+bool OSDMapMapping::_get_delta_pgs(
+  const OSDMap& osdmap,
+  vector<pg_t> *pgs)
+{
+  // an aborted update leaves the mapping at a prior epoch, partially
+  // updated, and the changes since then are gone with it
+  if (delta.all ||
+      epoch == 0 ||
+      delta.base != epoch ||
+      delta.last != osdmap.get_epoch()) {
+    return false;
+  }
+
+  std::set<pg_t> todo;
+  for (auto& pgid : delta.pgs) {
+    auto p = pools.find(pgid.pool());
+    if (p != pools.end() && pgid.ps() < p->second.pg_num) {
+      todo.insert(pgid);
+    }
+  }
+  bool any_osd = !delta.osds.empty() || !delta.crush_osds.empty();
+  if (any_osd) {
+    // temps and upmaps may point to any osd
+    for (const auto& p : *osdmap.pg_temp) {
+      todo.insert(p.first);
+    }
+    for (const auto& p : *osdmap.primary_temp) {
+      todo.insert(p.first);
+    }
+    for (const auto& p : osdmap.pg_upmap) {
+      todo.insert(p.first);
+    }
+    for (const auto& p : osdmap.pg_upmap_items) {
+      todo.insert(p.first);
+    }
+    for (const auto& p : osdmap.pg_upmap_primaries) {
+      todo.insert(p.first);
+    }
+  }
+
+  vector<bool> changed(osdmap.get_max_osd(), false);
+  for (auto osd : delta.osds) {
+    if (osd >= 0 && osd < (int)changed.size()) {
+      changed[osd] = true;
+    }
+  }
+  pgs->clear();
+  for (auto& [poolid, pm] : pools) {
+    auto pi = osdmap.get_pg_pool(poolid);
+    ceph_assert(pi);
+    bool whole = delta.pools.count(poolid);
+    if (!whole && !delta.crush_osds.empty()) {
+      // crush may now choose, or stop choosing, any of the rule's osds
+      auto& osds = _get_rule_osds(osdmap, pi->get_crush_rule());
+      whole = std::any_of(
+	delta.crush_osds.begin(), delta.crush_osds.end(),
+	[&osds](int osd) { return osds.count(osd); });
+    }
+    if (whole) {
+      for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+	pgs->push_back(pg_t(ps, poolid));
+      }
+      continue;
+    }
+    auto q = todo.lower_bound(pg_t(0, poolid));
+    if (!any_osd) {
+      for (; q != todo.end() && q->pool() == (uint64_t)poolid; ++q) {
+	pgs->push_back(*q);
+      }
+      continue;
+    }
+    // Going down or up doesn't change what crush chooses, only what is
+    // left of it in the up set: the pgs mapped to an osd which went down
+    // lose it, and an osd which came up can only fill the hole it left
+    // in the up set of the pgs it is chosen for.
+    for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+      pg_t pgid(ps, poolid);
+      if (q != todo.end() && *q == pgid) {
+	pgs->push_back(pgid);
+	++q;
+	continue;
+      }
+      const int32_t *row = &pm.table[pm.row_size() * ps];
+      bool affected = (unsigned)row[3] < pm.size;
+      for (int i = 0; !affected && i < row[3]; ++i) {
+	int osd = row[4 + pm.size + i];
+	affected = osd == CRUSH_ITEM_NONE ||
+	  (osd >= 0 && osd < (int)changed.size() && changed[osd]);
+      }
+      for (int i = 0; !affected && i < row[2]; ++i) {
+	int osd = row[4 + i];
+	affected = osd >= 0 && osd < (int)changed.size() && changed[osd];
+      }
+      if (affected) {
+	pgs->push_back(pgid);
+      }
+    }
+  }
+  return true;
+}
+
 // ---------------------------
 
 void ParallelPGMapper::Job::finish_one()
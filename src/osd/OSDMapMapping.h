@@ -7,14 +7,14 @@
 
 #include <vector>
 #include <map>
+#include <set>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 #include "common/Clock.h" // for ceph_clock_now()
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -258,11 +258,28 @@ private:
   epoch_t epoch = 0;
   uint64_t num_pgs = 0;
 
+  /// what may have changed since the mapping of epoch base
+  struct Delta {
+    epoch_t base = 0;       ///< epoch the changes apply on top of
+    epoch_t last = 0;       ///< epoch of the last incremental noted
+    bool all = false;       ///< remap every pg
+    std::set<int64_t> pools;  ///< remap every pg of these pools
+    std::set<int> osds;     ///< osds whose state or primary affinity changed
+    std::set<int> crush_osds; ///< osds whose weight or existence changed
+    std::set<pg_t> pgs;     ///< pgs whose temps or upmaps changed
+  } delta;
+  /// osds each crush rule may choose, valid until the crush map changes
+  std::map<int, std::set<int>> rule_osds;
+
   void _init_mappings(const OSDMap& osdmap);
   void _update_range(
     const OSDMap& map,
     int64_t pool,
     unsigned pg_begin, unsigned pg_end);
+  void _update_pgs(const OSDMap& map, const std::vector<pg_t>& pgs);
+  /// get the pgs to remap to go from epoch to map, false if all of them
+  bool _get_delta_pgs(const OSDMap& map, std::vector<pg_t> *pgs);
+  const std::set<int>& _get_rule_osds(const OSDMap& map, int rule);
 
   void _build_rmap(const OSDMap& osdmap);
 
@@ -281,7 +298,9 @@ private:
       : Job(osdmap), mapping(m) {
       mapping->_start(*osdmap);
     }
-    void process(const std::vector<pg_t>& pgs) override {}
+    void process(const std::vector<pg_t>& pgs) override {
+      mapping->_update_pgs(*osdmap, pgs);
+    }
     void process(int64_t pool, unsigned ps_begin, unsigned ps_end) override {
       mapping->_update_range(*osdmap, pool, ps_begin, ps_end);
     }
@@ -334,14 +353,23 @@ public:
 
   void update(const OSDMap& map, pg_t pgid);
 
+  /**
+   * note the changes made by an incremental
+   *
+   * The next start_update() only remaps the pgs possibly affected by the
+   * incrementals noted since the last one, provided that the mapping is
+   * complete and they are contiguous, and remaps everything otherwise.
+   */
+  void note_incremental(const OSDMap::Incremental& inc);
+  /// the next start_update() has to remap everything
+  void note_full_map() {
+    delta.all = true;
+  }
+
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
-    unsigned pgs_per_item) {
-    std::unique_ptr<MappingJob> job(new MappingJob(&map, this));
-    mapper.queue(job.get(), pgs_per_item, {});
-    return job;
-  }
+    unsigned pgs_per_item);
 
   epoch_t get_epoch() const {
     return epoch;
@@ -97,6 +97,7 @@ public:
   epoch_t min_epoch = 0;      ///< min epoch needed to handle this msg
 
   bool hitset_inserted;
+  bool waited_for_commit = false; ///< replica read already waited for pct
   jspan_ptr osd_parent_span;
 
   template<class T>
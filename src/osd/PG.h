@@ -1037,6 +1037,9 @@ protected:
    *  - waiting_for_readable
    *    - now > readable_until
    *    - unblocks when we get fresh(er) osd_pings
+   *  - waiting_for_committed
+   *    - replica read of an object with a write newer than pg_committed_to
+   *    - unblocks when pg_committed_to reaches that write
    *  - waiting_for_scrub
    *    - starts and stops blocking for varying intervals during scrub
    *  - waiting_for_unreadable_object
@@ -1077,6 +1080,9 @@ protected:
   /// ops waiting on readble
   std::list<OpRequestRef>            waiting_for_readable;
 
+  /// replica reads waiting for pg_committed_to to reach a write
+  std::map<eversion_t, std::list<OpRequestRef>> waiting_for_committed;
+
   // ops waiting on active (require peered as well)
   std::list<OpRequestRef>            waiting_for_active;
   std::list<OpRequestRef>            waiting_for_flush;
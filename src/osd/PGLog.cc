@@ -156,6 +156,8 @@ void PGLog::IndexedLog::trim(
     tail = s;
   lgeneric_subdout(cct, osd, 20) << "IndexedLog::trim after trim"
 				 << " dups.size()=" << dups.size()
+				 << " reqid index bytes="
+				 << get_reqid_index_bytes()
 				 << " tail=" << tail
 				 << " s=" << s << dendl;
 }
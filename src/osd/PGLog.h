@@ -24,6 +24,7 @@
 #include "include/common_fwd.h"
 #include "osd_types.h"
 #include "os/ObjectStore.h"
+#include "PGLogIndex.h"
 
 #include <iosfwd>
 #include <map>
@@ -167,10 +168,14 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable std::unordered_map<hobject_t, pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable std::unordered_map<osd_reqid_t, pg_log_entry_t*> caller_ops;
-    mutable std::unordered_multimap<osd_reqid_t, pg_log_entry_t*> extra_caller_ops;
-    mutable std::unordered_map<osd_reqid_t, pg_log_dup_t*> dup_index;
+    mutable mempool::osd_pglog_index::unordered_map<
+      hobject_t, pg_log_entry_t*> objects;  // ptrs into log.  be careful!
+    mutable pg_log_reqid_index_t<
+      pg_log_entry_t, pg_log_entry_reqid_match_t> caller_ops;
+    mutable pg_log_reqid_index_t<
+      pg_log_entry_t, pg_log_entry_extra_reqid_match_t> extra_caller_ops;
+    mutable pg_log_reqid_index_t<
+      pg_log_dup_t, pg_log_dup_reqid_match_t> dup_index;
 
     // recovery pointers
     std::list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -412,12 +417,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      auto p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
-	*op_returns = p->second->op_returns;
+      if (auto p = caller_ops.find(r); p) {
+	*version = p->version;
+	*user_version = p->user_version;
+	*return_code = p->return_code;
+	*op_returns = p->op_returns;
 	return true;
       }
 
@@ -426,20 +430,19 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
-      if (p != extra_caller_ops.end()) {
+      if (auto p = extra_caller_ops.find(r); p) {
 	uint32_t idx = 0;
-	for (auto i = p->second->extra_reqids.begin();
-	     i != p->second->extra_reqids.end();
+	for (auto i = p->extra_reqids.begin();
+	     i != p->extra_reqids.end();
 	     ++idx, ++i) {
 	  if (i->first == r) {
-	    *version = p->second->version;
+	    *version = p->version;
 	    *user_version = i->second;
-	    *return_code = p->second->return_code;
-	    *op_returns = p->second->op_returns;
+	    *return_code = p->return_code;
+	    *op_returns = p->op_returns;
 	    if (*return_code >= 0) {
-	      auto it = p->second->extra_reqid_return_codes.find(idx);
-	      if (it != p->second->extra_reqid_return_codes.end()) {
+	      auto it = p->extra_reqid_return_codes.find(idx);
+	      if (it != p->extra_reqid_return_codes.end()) {
 		*return_code = it->second;
 	      }
 	    }
@@ -452,12 +455,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_DUPS)) {
         index_dups();
       }
-      auto q = dup_index.find(r);
-      if (q != dup_index.end()) {
-	*version = q->second->version;
-	*user_version = q->second->user_version;
-	*return_code = q->second->return_code;
-	*op_returns = q->second->op_returns;
+      if (auto q = dup_index.find(r); q) {
+	*version = q->version;
+	*user_version = q->user_version;
+	*return_code = q->return_code;
+	*op_returns = q->op_returns;
 	return true;
       }
 
@@ -465,13 +467,19 @@ public:
     }
 
     bool has_write_since(const hobject_t &oid, const eversion_t &bound) const {
+      return get_last_write_since(oid, bound) != eversion_t();
+    }
+
+    /// version of the last write to oid newer than bound, or eversion_t()
+    eversion_t get_last_write_since(const hobject_t &oid,
+				    const eversion_t &bound) const {
       for (auto i = log.rbegin(); i != log.rend(); ++i) {
 	if (i->version <= bound)
-	  return false;
+	  break;
 	if (i->soid.get_head() == oid.get_head())
-	  return true;
+	  return i->version;
       }
-      return false;
+      return eversion_t();
     }
 
     /// get a (bounded) std::list of recent reqids for the given object
@@ -521,8 +529,9 @@ public:
 	extra_caller_ops.clear();
       if (to_index & PGLOG_INDEXED_DUPS) {
 	dup_index.clear();
+	dup_index.reserve(dups.size());
 	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
+	  dup_index.insert_or_assign(i.reqid, const_cast<pg_log_dup_t*>(&i));
 	}
       }
 
@@ -532,6 +541,10 @@ public:
 	PGLOG_INDEXED_EXTRA_CALLER_OPS;
 
       if (to_index & any_log_entry_index) {
+	// size the reqid indexes once rather than growing them entry by entry
+	if (to_index & PGLOG_INDEXED_CALLER_OPS) {
+	  caller_ops.reserve(log.size());
+	}
 	for (auto i = log.begin(); i != log.end(); ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
@@ -541,7 +554,8 @@ public:
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      caller_ops.insert_or_assign(
+		i->reqid, const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -550,7 +564,7 @@ public:
 		 j != i->extra_reqids.end();
 		 ++j) {
 	      extra_caller_ops.insert(
-		std::make_pair(j->first, const_cast<pg_log_entry_t*>(&(*i))));
+		j->first, const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 	}
@@ -575,6 +589,13 @@ public:
       index(PGLOG_INDEXED_DUPS);
     }
 
+    /// memory used by the reqid indexes
+    size_t get_reqid_index_bytes() const {
+      return caller_ops.get_bytes() +
+	extra_caller_ops.get_bytes() +
+	dup_index.get_bytes();
+    }
+
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
         if (objects.count(e.soid) == 0 ||
@@ -584,14 +605,14 @@ public:
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.insert_or_assign(e.reqid, &e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
         for (auto j = e.extra_reqids.begin();
 	     j != e.extra_reqids.end();
 	     ++j) {
-	  extra_caller_ops.insert(std::make_pair(j->first, &e));
+	  extra_caller_ops.insert(j->first, &e);
         }
       }
     }
@@ -613,40 +634,28 @@ public:
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
-	  auto it = caller_ops.find(e.reqid);
 	  // divergent merge_log indexes new before unindexing old
-          if (it != caller_ops.end() && it->second == &e)
-            caller_ops.erase(it);
+          caller_ops.erase(e.reqid, &e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
         for (auto j = e.extra_reqids.begin();
              j != e.extra_reqids.end();
              ++j) {
-          for (auto k = extra_caller_ops.find(j->first);
-               k != extra_caller_ops.end() && k->first == j->first;
-               ++k) {
-            if (k->second == &e) {
-              extra_caller_ops.erase(k);
-              break;
-            }
-          }
+          extra_caller_ops.erase(j->first, &e);
         }
       }
     }
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert_or_assign(e.reqid, &e);
       }
     }
 
     void unindex(const pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	auto i = dup_index.find(e.reqid);
-	if (i != dup_index.end()) {
-	  dup_index.erase(i);
-	}
+	dup_index.erase(e.reqid);
       }
     }
 
@@ -680,7 +689,7 @@ public:
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.insert_or_assign(e.reqid, &(log.back()));
         }
       }
 
@@ -688,7 +697,7 @@ public:
         for (auto j = e.extra_reqids.begin();
 	     j != e.extra_reqids.end();
 	     ++j) {
-	  extra_caller_ops.insert(std::make_pair(j->first, &(log.back())));
+	  extra_caller_ops.insert(j->first, &(log.back()));
         }
       }
 
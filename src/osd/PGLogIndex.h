@@ -0,0 +1,206 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "include/ceph_assert.h"
+#include "include/hash.h"
+#include "include/mempool.h"
+#include "osd_types.h"
+
+/**
+ * pg_log_reqid_index_t
+ *
+ * Index of the PG log entries (or dups) by reqid.  It is an open-addressed
+ * table with linear probing, whose slots only hold the hash of the reqid and
+ * a pointer to the indexed item, the reqid itself is found in the item by
+ * Match.  So each indexed item costs a 16 byte slot in one contiguous array
+ * rather than a heap allocated node per item as with std::unordered_map,
+ * which adds up with osd_pg_log_dups_tracked dups in every PG.
+ *
+ * Items are only dereferenced when the full 64 bit hash of their reqid
+ * matches the one looked up.  Several items may be indexed by the same
+ * reqid if added with insert().
+ */
+template <typename T, typename Match>
+class pg_log_reqid_index_t {
+  struct slot_t {
+    uint64_t hash = 0;
+    T *item = nullptr;  ///< nullptr if the slot is empty
+  };
+  static constexpr size_t MIN_SLOTS = 16;
+
+  mempool::osd_pglog_index::vector<slot_t> slots;
+  size_t num_items = 0;
+
+  static uint64_t hash_reqid(const osd_reqid_t &r) {
+    return rjhash64(r.name.num() ^
+		    rjhash64(r.tid ^ (uint64_t(uint32_t(r.inc)) << 32)));
+  }
+  size_t mask() const {
+    return slots.size() - 1;
+  }
+  size_t home(uint64_t hash) const {
+    return hash & mask();
+  }
+
+  /// resize the table to hold n items at most 3/4 full
+  void rehash(size_t n) {
+    size_t want = MIN_SLOTS;
+    while (want * 3 < n * 4) {
+      want <<= 1;
+    }
+    if (want == slots.size()) {
+      return;
+    }
+    mempool::osd_pglog_index::vector<slot_t> old(want);
+    old.swap(slots);
+    for (auto &s : old) {
+      if (s.item) {
+	place(s);
+      }
+    }
+  }
+  void place(const slot_t &s) {
+    for (size_t i = home(s.hash); ; i = (i + 1) & mask()) {
+      if (!slots[i].item) {
+	slots[i] = s;
+	return;
+      }
+    }
+  }
+  template <typename F>
+  slot_t *find_slot(uint64_t hash, F &&f) {
+    if (slots.empty()) {
+      return nullptr;
+    }
+    for (size_t i = home(hash); ; i = (i + 1) & mask()) {
+      auto &s = slots[i];
+      if (!s.item) {
+	return nullptr;
+      }
+      if (s.hash == hash && f(s)) {
+	return &s;
+      }
+    }
+  }
+  /// remove the slot, shifting back the following ones of the probe run
+  void erase_slot(slot_t *s) {
+    size_t i = s - slots.data();
+    for (size_t j = (i + 1) & mask(); slots[j].item; j = (j + 1) & mask()) {
+      // j may move to the hole if its home isn't in (i, j]
+      if (((j - home(slots[j].hash)) & mask()) >= ((j - i) & mask())) {
+	slots[i] = slots[j];
+	i = j;
+      }
+    }
+    slots[i] = slot_t{};
+    --num_items;
+    if (slots.size() > MIN_SLOTS && num_items * 8 < slots.size()) {
+      rehash(num_items);
+    }
+  }
+
+public:
+  T *find(const osd_reqid_t &r) const {
+    auto s = const_cast<pg_log_reqid_index_t*>(this)->find_slot(
+      hash_reqid(r),
+      [&r](const slot_t &s) { return Match{}(*s.item, r); });
+    return s ? s->item : nullptr;
+  }
+  size_t count(const osd_reqid_t &r) const {
+    return find(r) ? 1 : 0;
+  }
+
+  /// index item by r, along with the items already indexed by r
+  void insert(const osd_reqid_t &r, T *item) {
+    ceph_assert(item);
+    if ((num_items + 1) * 4 > slots.size() * 3) {
+      rehash(num_items + 1);
+    }
+    place(slot_t{hash_reqid(r), item});
+    ++num_items;
+  }
+  /// index item by r, replacing the item already indexed by r if any
+  void insert_or_assign(const osd_reqid_t &r, T *item) {
+    ceph_assert(item);
+    auto hash = hash_reqid(r);
+    auto s = find_slot(
+      hash,
+      [&r](const slot_t &s) { return Match{}(*s.item, r); });
+    if (s) {
+      s->item = item;
+    } else {
+      insert(r, item);
+    }
+  }
+  /// stop indexing item by r
+  bool erase(const osd_reqid_t &r, const T *item) {
+    auto s = find_slot(
+      hash_reqid(r),
+      [item](const slot_t &s) { return s.item == item; });
+    if (!s) {
+      return false;
+    }
+    erase_slot(s);
+    return true;
+  }
+  /// stop indexing the item found by r
+  bool erase(const osd_reqid_t &r) {
+    auto s = find_slot(
+      hash_reqid(r),
+      [&r](const slot_t &s) { return Match{}(*s.item, r); });
+    if (!s) {
+      return false;
+    }
+    erase_slot(s);
+    return true;
+  }
+
+  /// size the table for n items ahead of indexing them
+  void reserve(size_t n) {
+    if (n > num_items) {
+      rehash(n);
+    }
+  }
+  void clear() {
+    mempool::osd_pglog_index::vector<slot_t>().swap(slots);
+    num_items = 0;
+  }
+  size_t size() const {
+    return num_items;
+  }
+  bool empty() const {
+    return num_items == 0;
+  }
+  size_t get_bytes() const {
+    return slots.capacity() * sizeof(slot_t);
+  }
+};
+
+/// matches the log entries by their reqid
+struct pg_log_entry_reqid_match_t {
+  bool operator()(const pg_log_entry_t &e, const osd_reqid_t &r) const {
+    return e.reqid == r;
+  }
+};
+
+/// matches the log entries by their extra_reqids
+struct pg_log_entry_extra_reqid_match_t {
+  bool operator()(const pg_log_entry_t &e, const osd_reqid_t &r) const {
+    return std::any_of(
+      e.extra_reqids.begin(), e.extra_reqids.end(),
+      [&r](const auto &extra) { return extra.first == r; });
+  }
+};
+
+/// matches the dups by their reqid
+struct pg_log_dup_reqid_match_t {
+  bool operator()(const pg_log_dup_t &e, const osd_reqid_t &r) const {
+    return e.reqid == r;
+  }
+};
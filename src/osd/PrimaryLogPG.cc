@@ -942,6 +942,50 @@ void PrimaryLogPG::recheck_readable()
   }
 }
 
+bool PrimaryLogPG::maybe_wait_for_committed(
+  const hobject_t& oid, OpRequestRef& op)
+{
+  ceph_assert(!is_primary());
+  // only wait if the primary is going to advance pg_committed_to without
+  // further writes, and only once so that a stream of writes to the
+  // object cannot starve the read
+  if (op->waited_for_commit ||
+      !pool.info.is_replicated() ||
+      !pool.info.opts.is_set(pool_opts_t::PCT_UPDATE_DELAY) ||
+      !PG_HAVE_FEATURE(get_pg_acting_features(), PCT) ||
+      !cct->_conf.get_val<bool>("osd_replica_read_wait_for_commit")) {
+    return false;
+  }
+  auto v = recovery_state.get_pg_log().get_log().get_last_write_since(
+    oid, recovery_state.get_pg_committed_to());
+  ceph_assert(v != eversion_t());
+  dout(20) << __func__ << " " << oid << " waiting for pg_committed_to "
+	   << recovery_state.get_pg_committed_to() << " to reach " << v
+	   << dendl;
+  op->waited_for_commit = true;
+  waiting_for_committed[v].push_back(op);
+  op->mark_delayed("waiting for committed");
+  osd->logger->inc(l_osd_replica_read_wait_commit);
+  return true;
+}
+
+void PrimaryLogPG::requeue_committed_reads()
+{
+  auto pct = recovery_state.get_pg_committed_to();
+  auto end = waiting_for_committed.upper_bound(pct);
+  if (end == waiting_for_committed.begin()) {
+    return;
+  }
+  dout(20) << __func__ << " pg_committed_to " << pct << dendl;
+  // requeue_ops() puts the ops at the front, start with the newest writes
+  for (auto p = std::make_reverse_iterator(end);
+       p != waiting_for_committed.rend();
+       ++p) {
+    requeue_ops(p->second);
+  }
+  waiting_for_committed.erase(waiting_for_committed.begin(), end);
+}
+
 bool PrimaryLogPG::pgls_filter(const PGLSFilter& filter, const hobject_t& sobj)
 {
   bufferlist bl;
@@ -2353,6 +2397,9 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
 
   if (!is_primary()) {
     if (!recovery_state.can_serve_read(oid)) {
+      if (maybe_wait_for_committed(oid, op)) {
+        return;
+      }
       std::string_view storage_object = "replica";
       if (pool.info.is_erasure()) {
         storage_object = "shard";
@@ -13162,6 +13209,12 @@ void PrimaryLogPG::on_change(ObjectStore::Transaction &t)
   requeue_ops(waiting_for_peered);
   requeue_ops(waiting_for_flush);
   requeue_ops(waiting_for_active);
+  for (auto p = waiting_for_committed.rbegin();
+       p != waiting_for_committed.rend();
+       ++p) {
+    requeue_ops(p->second);
+  }
+  waiting_for_committed.clear();
   requeue_ops(waiting_for_readable);
 
   vector<ceph_tid_t> tids;
@@ -541,6 +541,9 @@ public:
     recovery_state.append_log(
       std::move(logv), trim_to, roll_forward_to, pg_committed_to,
       t, transaction_applied, async);
+    if (!is_primary()) {
+      requeue_committed_reads();
+    }
   }
 
   void clear_repop_obc(
@@ -574,6 +577,7 @@ public:
 
   void update_pct(eversion_t pct) override {
     recovery_state.update_pct(pct);
+    requeue_committed_reads();
   }
 
   void update_stats(
@@ -1912,6 +1916,9 @@ public:
   bool check_laggy(OpRequestRef& op);
   bool check_laggy_requeue(OpRequestRef& op);
   void recheck_readable() override;
+  /// park a replica read until its object's last write is committed
+  bool maybe_wait_for_committed(const hobject_t& oid, OpRequestRef& op);
+  void requeue_committed_reads();
 
   bool is_backfill_target(pg_shard_t osd) const {
     return recovery_state.is_backfill_target(osd);
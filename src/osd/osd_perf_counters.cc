@@ -148,6 +148,10 @@ PerfCounters *build_osd_logger(CephContext *cct) {
     l_osd_replica_read_served,
     "replica_read_served",
     "Count of replica reads served");
+  osd_plb.add_u64_counter(
+    l_osd_replica_read_wait_commit,
+    "replica_read_wait_commit",
+    "Count of replica reads delayed until an unstable write committed");
 
   osd_plb.add_u64_counter(
     l_osd_sop, "subop", "Suboperations");
@@ -228,6 +232,14 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64(l_osd_missed_crc, "missed_crc", 
     "Total number of crc cache misses");
 
+  osd_plb.add_u64(
+    l_osd_pglog_bytes, "pglog_bytes",
+    "Memory used by the PG log entries and dups", NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64(
+    l_osd_pglog_index_bytes, "pglog_index_bytes",
+    "Memory used by the indexes of the PG log entries and dups",
+    NULL, 0, unit_t(UNIT_BYTES));
+
   osd_plb.add_u64(l_osd_pg, "numpg", "Placement groups",
 		  "pgs", PerfCountersBuilder::PRIO_USEFUL);
   osd_plb.add_u64(
@@ -325,6 +337,16 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_object_ctx_cache_total, "object_ctx_cache_total", "Object context cache lookups");
 
+  osd_plb.add_u64_counter(
+    l_osd_ec_cache_reads, "ec_cache_reads",
+    "EC read-modify-write reads sent by the extent cache");
+  osd_plb.add_u64_counter(
+    l_osd_ec_cache_reads_coalesced, "ec_cache_reads_coalesced",
+    "EC writes whose reads were merged into a pending read");
+  osd_plb.add_u64_counter(
+    l_osd_ec_cache_reads_saved, "ec_cache_reads_saved",
+    "EC writes which needed no read as the extent cache held the data");
+
   osd_plb.add_u64_counter(l_osd_op_cache_hit, "op_cache_hit");
   osd_plb.add_time_avg(
     l_osd_tier_flush_lat, "osd_tier_flush_lat", "Object flush latency");
@@ -558,3 +580,56 @@ PerfCounters *build_scrub_labeled_perf(CephContext *cct, std::string label)
 
   return scrub_perf.create_perf_counters();
 }
+
+PerfCounters *build_osd_shard_logger(CephContext *cct, unsigned shard_id)
+{
+  PerfCountersBuilder shard_plb(cct, "osd-shard-" + std::to_string(shard_id),
+                                l_osd_shard_first, l_osd_shard_last);
+
+  // Latency axis configuration, values are in nanoseconds
+  PerfHistogramCommon::axis_config_d queue_hist_x_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2, ///< Latency in logarithmic scale
+    0,                               ///< Start at 0
+    1000,                            ///< Quantization unit is 1usec
+    32,                              ///< Enough to cover over half an hour
+  };
+  PerfHistogramCommon::axis_config_d queue_hist_y_axis_config{
+    "Cost",
+    PerfHistogramCommon::SCALE_LOG2, ///< Cost in logarithmic scale
+    0,                               ///< Start at 0
+    512,                             ///< Quantization unit is 512
+    32,                              ///< Enough to cover any cost
+  };
+
+  shard_plb.add_time_avg(
+    l_osd_shard_queue_lat, "queue_latency",
+    "Latency from queueing an item to the shard to its dequeue");
+  shard_plb.add_u64_counter_histogram(
+    l_osd_shard_queue_lat_cost_hist, "queue_latency_cost_histogram",
+    queue_hist_x_axis_config, queue_hist_y_axis_config,
+    "Histogram of the shard queue latency + item cost");
+  shard_plb.add_u64_counter(
+    l_osd_shard_ingress_batches, "ingress_batches",
+    "Batches moved from the lock-free ingress into the scheduler");
+  shard_plb.add_u64_counter(
+    l_osd_shard_ingress_items, "ingress_items",
+    "Items moved from the lock-free ingress into the scheduler");
+  shard_plb.add_u64_counter(
+    l_osd_shard_spin_hits, "spin_hits",
+    "Idle worker spins which found work before parking");
+  shard_plb.add_u64_counter(
+    l_osd_shard_spin_misses, "spin_misses",
+    "Idle worker spins which timed out and parked");
+  shard_plb.add_time(
+    l_osd_shard_busy, "busy",
+    "Time spent running the shard's items, by any thread");
+  shard_plb.add_u64_counter(
+    l_osd_shard_steals, "steals",
+    "Items of other shards run by this shard's threads");
+  shard_plb.add_u64_counter(
+    l_osd_shard_stolen, "stolen",
+    "Items of this shard run by other shards' threads");
+
+  return shard_plb.create_perf_counters();
+}
@@ -47,6 +47,7 @@ enum osd_counter_idx_t {
   l_osd_replica_read_redirect_missing,
   l_osd_replica_read_redirect_conflict,
   l_osd_replica_read_served,
+  l_osd_replica_read_wait_commit,
 
   l_osd_sop,
   l_osd_sop_inb,
@@ -82,6 +83,9 @@ enum osd_counter_idx_t {
   l_osd_cached_crc_adjusted,
   l_osd_missed_crc,
 
+  l_osd_pglog_bytes,
+  l_osd_pglog_index_bytes,
+
   l_osd_pg,
   l_osd_pg_primary,
   l_osd_pg_replica,
@@ -130,6 +134,10 @@ enum osd_counter_idx_t {
   l_osd_object_ctx_cache_hit,
   l_osd_object_ctx_cache_total,
 
+  l_osd_ec_cache_reads,
+  l_osd_ec_cache_reads_coalesced,
+  l_osd_ec_cache_reads_saved,
+
   l_osd_op_cache_hit,
   l_osd_tier_flush_lat,
   l_osd_tier_promote_lat,
@@ -283,3 +291,31 @@ enum {
 };
 
 PerfCounters *build_scrub_labeled_perf(CephContext *cct, std::string label);
+
+// Per OSDShard op queue counters
+enum {
+  l_osd_shard_first = 20600,
+
+  /// time from queueing an item to the shard to its dequeue
+  l_osd_shard_queue_lat,
+  /// the same, along with the item's cost
+  l_osd_shard_queue_lat_cost_hist,
+  /// batches moved from the lock-free ingress into the scheduler
+  l_osd_shard_ingress_batches,
+  /// items moved from the lock-free ingress into the scheduler
+  l_osd_shard_ingress_items,
+  /// idle worker spins which found work before parking
+  l_osd_shard_spin_hits,
+  /// idle worker spins which timed out
+  l_osd_shard_spin_misses,
+  /// time spent running the shard's items, by any thread
+  l_osd_shard_busy,
+  /// items of other shards run by this shard's threads
+  l_osd_shard_steals,
+  /// items of this shard run by other shards' threads
+  l_osd_shard_stolen,
+
+  l_osd_shard_last,
+};
+
+PerfCounters *build_osd_shard_logger(CephContext *cct, unsigned shard_id);
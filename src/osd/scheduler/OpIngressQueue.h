@@ -0,0 +1,78 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "osd/scheduler/OpSchedulerItem.h"
+
+namespace ceph::osd::scheduler {
+
+/**
+ * OpIngressQueue
+ *
+ * Multi-producer single-consumer hand off of items to an OSD shard.
+ * Producers push onto a lock-free stack, the consumer (serialized by the
+ * shard lock) takes the whole stack at once and gets the items back in
+ * the order they were pushed, so that they can be enqueued into the
+ * OpScheduler in one batch.
+ */
+class OpIngressQueue {
+  struct node_t {
+    OpSchedulerItem item;
+    node_t *next = nullptr;
+  };
+  std::atomic<node_t*> head{nullptr};
+
+public:
+  OpIngressQueue() = default;
+  OpIngressQueue(const OpIngressQueue&) = delete;
+  OpIngressQueue& operator=(const OpIngressQueue&) = delete;
+  ~OpIngressQueue() {
+    drain([](OpSchedulerItem&&) {});
+  }
+
+  /// returns true if the queue was empty
+  bool push(OpSchedulerItem &&item) {
+    auto n = new node_t{std::move(item)};
+    n->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(n->next, n,
+				       std::memory_order_seq_cst,
+				       std::memory_order_relaxed));
+    return n->next == nullptr;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_seq_cst) == nullptr;
+  }
+
+  /// pass the queued items to f in push order, returns their number
+  template <typename F>
+  size_t drain(F &&f) {
+    if (empty()) {
+      return 0;
+    }
+    node_t *n = head.exchange(nullptr, std::memory_order_acquire);
+    node_t *fifo = nullptr;
+    while (n) {
+      auto next = n->next;
+      n->next = fifo;
+      fifo = n;
+      n = next;
+    }
+    size_t count = 0;
+    while (fifo) {
+      auto next = fifo->next;
+      f(std::move(fifo->item));
+      delete fifo;
+      fifo = next;
+      ++count;
+    }
+    return count;
+  }
+};
+
+}
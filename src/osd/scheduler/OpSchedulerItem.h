@@ -85,6 +85,7 @@ private:
   utime_t start_time;
   uint64_t owner;  ///< global id (e.g., client.XXX)
   epoch_t map_epoch;    ///< an epoch we expect the PG to exist in
+  ceph::mono_time enqueue_stamp;  ///< when first queued to its shard
 
   /**
    * qos_cost
@@ -141,6 +142,8 @@ public:
   utime_t get_start_time() const { return start_time; }
   uint64_t get_owner() const { return owner; }
   epoch_t get_map_epoch() const { return map_epoch; }
+  ceph::mono_time get_enqueue_stamp() const { return enqueue_stamp; }
+  void set_enqueue_stamp(ceph::mono_time stamp) { enqueue_stamp = stamp; }
 
   bool is_peering() const {
     return qitem->is_peering();
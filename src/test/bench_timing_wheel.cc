@@ -0,0 +1,159 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+// compares the arm, cancel and fire rates of the timing wheel with the
+// ordered maps EventCenter and SafeTimer used to keep their events in
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "common/timing_wheel.h"
+
+using namespace std;
+using clock_type = std::chrono::steady_clock;
+
+struct Timer : public ceph::common::timing_wheel_hook {
+  uint64_t id = 0;
+};
+
+// the time events as EventCenter kept them, looked up by id
+struct MapTimers {
+  std::multimap<clock_type::time_point, uint64_t> time_events;
+  std::map<uint64_t, decltype(time_events)::iterator> event_map;
+
+  void arm(uint64_t id, clock_type::time_point when) {
+    event_map[id] = time_events.emplace(when, id);
+  }
+  void cancel(uint64_t id) {
+    auto p = event_map.find(id);
+    time_events.erase(p->second);
+    event_map.erase(p);
+  }
+  size_t expire(clock_type::time_point now) {
+    size_t fired = 0;
+    while (!time_events.empty() && time_events.begin()->first <= now) {
+      event_map.erase(time_events.begin()->second);
+      time_events.erase(time_events.begin());
+      ++fired;
+    }
+    return fired;
+  }
+};
+
+struct WheelTimers {
+  std::vector<Timer> timers;
+  ceph::common::timing_wheel<Timer, clock_type> wheel;
+
+  WheelTimers(size_t n, clock_type::time_point start)
+    : timers(n), wheel(std::chrono::microseconds(100), start) {
+    for (size_t i = 0; i < n; ++i) {
+      timers[i].id = i;
+    }
+  }
+  ~WheelTimers() {
+    wheel.clear();
+  }
+  void arm(uint64_t id, clock_type::time_point when) {
+    wheel.arm(timers[id], when);
+  }
+  void cancel(uint64_t id) {
+    wheel.cancel(timers[id]);
+  }
+  size_t expire(clock_type::time_point now) {
+    return wheel.expire(now, [](Timer&) {});
+  }
+};
+
+struct Rates {
+  double arm = 0, cancel = 0, fire = 0;
+};
+
+template <typename Timers>
+Rates run(Timers &timers, const vector<clock_type::duration> &delays,
+          clock_type::time_point start, int rounds)
+{
+  const size_t n = delays.size();
+  auto rate = [n, rounds](clock_type::duration d) {
+    return double(n) * rounds / std::chrono::duration<double>(d).count();
+  };
+  clock_type::duration arming{}, cancelling{}, firing{};
+  // the timers advance a millisecond per step, e.g. for the ticks of the
+  // event loop
+  const auto step = std::chrono::milliseconds(1);
+  for (int r = 0; r < rounds; ++r) {
+    auto t0 = clock_type::now();
+    for (size_t i = 0; i < n; ++i) {
+      timers.arm(i, start + delays[i]);
+    }
+    auto t1 = clock_type::now();
+    for (size_t i = 0; i < n; ++i) {
+      timers.cancel(i);
+    }
+    auto t2 = clock_type::now();
+    arming += t1 - t0;
+    cancelling += t2 - t1;
+
+    for (size_t i = 0; i < n; ++i) {
+      timers.arm(i, start + delays[i]);
+    }
+    auto t3 = clock_type::now();
+    size_t fired = 0;
+    for (auto now = start; fired < n; now += step) {
+      fired += timers.expire(now);
+    }
+    firing += clock_type::now() - t3;
+    start += delays.back() + step;
+  }
+  return {rate(arming), rate(cancelling), rate(firing)};
+}
+
+void usage(const char *name) {
+  cout << name << " [timers] [rounds] [max delay ms]\n"
+       << "\t timers: the number of timers armed at once, 100000 by default\n"
+       << "\t rounds: how many times they are armed, cancelled and fired\n"
+       << "\t max delay ms: their delays are spread up to this, 30000 by default\n"
+       << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && argv[1][0] == '-') {
+    usage(argv[0]);
+    return 1;
+  }
+  size_t n = argc > 1 ? atol(argv[1]) : 100000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 5;
+  long max_delay_ms = argc > 3 ? atol(argv[3]) : 30000;
+  if (!n || rounds <= 0 || max_delay_ms <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // like the keepalive, replay and op timeouts of many connections, the
+  // last delay is the longest
+  std::mt19937_64 rng(0);
+  vector<clock_type::duration> delays(n);
+  for (auto &d : delays) {
+    d = std::chrono::microseconds(rng() % (max_delay_ms * 1000));
+  }
+  delays.back() = std::chrono::milliseconds(max_delay_ms);
+
+  auto start = clock_type::now();
+  MapTimers map_timers;
+  WheelTimers wheel_timers(n, start);
+  cout << " timers " << n << ", rounds " << rounds
+       << ", max delay " << max_delay_ms << "ms" << std::endl;
+  for (auto [name, rates] : {
+      std::pair{"multimap", run(map_timers, delays, start, rounds)},
+      std::pair{"timing_wheel", run(wheel_timers, delays, start, rounds)}}) {
+    cout << " " << name << ": "
+         << uint64_t(rates.arm) << " arms/s, "
+         << uint64_t(rates.cancel) << " cancels/s, "
+         << uint64_t(rates.fire) << " fires/s" << std::endl;
+  }
+  return 0;
+}
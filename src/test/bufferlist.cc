@@ -1989,6 +1989,21 @@ TEST(BufferList, is_contiguous) {
   EXPECT_EQ((unsigned)2, bl.get_num_buffers());
 }
 
+TEST(BufferList, copy_tracker) {
+  ceph::buffer_instrumentation::copy_tracker copied;
+  bufferlist bl;
+  bl.append(buffer::create_page_aligned(CEPH_PAGE_SIZE));
+  bl.append(buffer::create_page_aligned(CEPH_PAGE_SIZE));
+  EXPECT_EQ(0U, copied.get());
+  // already aligned, nothing to copy
+  EXPECT_FALSE(bl.rebuild_aligned(CEPH_PAGE_SIZE));
+  EXPECT_EQ(0U, copied.get());
+  bl.c_str();
+  EXPECT_EQ(2 * CEPH_PAGE_SIZE, copied.get());
+  bl.c_str();
+  EXPECT_EQ(2 * CEPH_PAGE_SIZE, copied.get());
+}
+
 TEST(BufferList, rebuild) {
   {
     bufferlist bl;
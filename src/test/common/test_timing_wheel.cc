@@ -0,0 +1,222 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <map>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "common/timing_wheel.h"
+
+// a clock which only moves when told, in ticks of the wheel
+struct test_clock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<test_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point at(uint64_t tick) {
+    return time_point(duration(tick));
+  }
+  static time_point now() {
+    return at(0);
+  }
+};
+
+struct TestTimer : public ceph::common::timing_wheel_hook {
+  uint64_t expiry = 0;
+  unsigned id = 0;
+};
+
+using wheel_t = ceph::common::timing_wheel<TestTimer, test_clock>;
+
+// expire the wheel one step at a time, recording when each timer fired
+static std::vector<std::pair<unsigned, uint64_t>> run(wheel_t &wheel)
+{
+  std::vector<std::pair<unsigned, uint64_t>> fired;
+  while (auto next = wheel.next_expiry()) {
+    uint64_t now = next->time_since_epoch().count();
+    wheel.expire(*next, [&](TestTimer &t) {
+      fired.emplace_back(t.id, now);
+    });
+  }
+  return fired;
+}
+
+TEST(TimingWheel, fire_at_expiry)
+{
+  wheel_t wheel(std::chrono::nanoseconds(1));
+  const std::vector<uint64_t> delays = {
+    0, 1, 2, 63, 64, 65, 100, 4095, 4096, 4097, 262143, 262144, 300000,
+    20000000, 1ull << 36, 1ull << 40};
+  std::vector<TestTimer> timers(delays.size());
+  for (unsigned i = 0; i < delays.size(); ++i) {
+    timers[i].id = i;
+    wheel.arm(timers[i], test_clock::at(delays[i]));
+  }
+  ASSERT_EQ(delays.size(), wheel.size());
+
+  auto fired = run(wheel);
+  ASSERT_EQ(delays.size(), fired.size());
+  for (unsigned i = 0; i < fired.size(); ++i) {
+    EXPECT_EQ(i, fired[i].first);
+    EXPECT_EQ(delays[i], fired[i].second);
+  }
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_FALSE(wheel.next_expiry());
+}
+
+TEST(TimingWheel, same_tick_in_arming_order)
+{
+  wheel_t wheel(std::chrono::microseconds(1));
+  std::vector<TestTimer> timers(10);
+  for (unsigned i = 0; i < timers.size(); ++i) {
+    timers[i].id = i;
+    // all within the same microsecond
+    wheel.arm(timers[i], test_clock::at(5000000 + 500 + i * 10));
+  }
+  EXPECT_EQ(0u, wheel.expire(test_clock::at(5000999), [](TestTimer&) {
+    FAIL();
+  }));
+  unsigned expected = 0;
+  EXPECT_EQ(timers.size(), wheel.expire(test_clock::at(5001000),
+                                        [&](TestTimer &t) {
+    EXPECT_EQ(expected++, t.id);
+  }));
+}
+
+TEST(TimingWheel, cancel)
+{
+  wheel_t wheel(std::chrono::nanoseconds(1));
+  TestTimer a, b, c;
+  a.id = 1;
+  b.id = 2;
+  c.id = 3;
+  EXPECT_FALSE(wheel.cancel(a));
+  wheel.arm(a, test_clock::at(10));
+  wheel.arm(b, test_clock::at(10));
+  wheel.arm(c, test_clock::at(5000));
+  EXPECT_TRUE(a.is_armed());
+  EXPECT_TRUE(wheel.cancel(a));
+  EXPECT_FALSE(a.is_armed());
+  EXPECT_FALSE(wheel.cancel(a));
+  EXPECT_TRUE(wheel.cancel(c));
+  EXPECT_EQ(1u, wheel.size());
+
+  // moving an armed timer
+  wheel.arm(b, test_clock::at(20));
+  EXPECT_EQ(1u, wheel.size());
+  auto fired = run(wheel);
+  ASSERT_EQ(1u, fired.size());
+  EXPECT_EQ(2u, fired[0].first);
+  EXPECT_EQ(20u, fired[0].second);
+}
+
+TEST(TimingWheel, arm_and_cancel_from_callback)
+{
+  wheel_t wheel(std::chrono::nanoseconds(1));
+  TestTimer periodic, victim, late;
+  periodic.id = 1;
+  victim.id = 2;
+  late.id = 3;
+  wheel.arm(periodic, test_clock::at(10));
+  wheel.arm(victim, test_clock::at(10));
+  unsigned ticks = 0;
+  uint64_t late_at = 0;
+  size_t fired = wheel.expire(test_clock::at(1000), [&](TestTimer &t) {
+    ASSERT_NE(2u, t.id);
+    if (t.id == 3) {
+      late_at = ticks;
+      return;
+    }
+    ++ticks;
+    if (ticks == 1) {
+      EXPECT_TRUE(wheel.cancel(victim));
+      // already due, but after this tick
+      wheel.arm(late, test_clock::at(0));
+    }
+    if (ticks < 5) {
+      wheel.arm(periodic, test_clock::at(10 * (ticks + 1)));
+    }
+  });
+  // the late timer fires at 11, between the first two periods
+  EXPECT_EQ(1u, late_at);
+  EXPECT_EQ(5u + 1u, fired);
+  EXPECT_EQ(5u, ticks);
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheel, before_now)
+{
+  wheel_t wheel(std::chrono::nanoseconds(1), test_clock::at(100000));
+  TestTimer t;
+  wheel.arm(t, test_clock::at(5));
+  auto next = wheel.next_expiry();
+  ASSERT_TRUE(next);
+  EXPECT_EQ(test_clock::at(100000), *next);
+  EXPECT_EQ(1u, wheel.expire(test_clock::at(100000), [](TestTimer&) {}));
+}
+
+TEST(TimingWheel, random)
+{
+  std::mt19937_64 rng(42);
+  wheel_t wheel(std::chrono::nanoseconds(1));
+  std::vector<TestTimer> timers(1000);
+  std::multimap<uint64_t, unsigned> expected;
+  for (unsigned i = 0; i < timers.size(); ++i) {
+    timers[i].id = i;
+  }
+  uint64_t now = 0;
+  auto forget = [&](unsigned id) {
+    auto [first, last] = expected.equal_range(timers[id].expiry);
+    for (auto p = first; p != last; ++p) {
+      if (p->second == id) {
+        expected.erase(p);
+        return;
+      }
+    }
+    FAIL() << "timer " << id << " not expected";
+  };
+  for (unsigned round = 0; round < 20000; ++round) {
+    auto &t = timers[rng() % timers.size()];
+    switch (rng() % 4) {
+    case 0:
+    case 1:
+      if (t.is_armed()) {
+        forget(t.id);
+      }
+      // mostly short delays, some across the levels, and past the tick
+      // expired last
+      t.expiry = now + 1 + (rng() % 2 ? rng() % 200 : rng() % (1 << 24));
+      wheel.arm(t, test_clock::at(t.expiry));
+      expected.emplace(t.expiry, t.id);
+      break;
+    case 2:
+      if (t.is_armed()) {
+        forget(t.id);
+      }
+      wheel.cancel(t);
+      break;
+    case 3:
+      now += rng() % (rng() % 2 ? 100 : 100000);
+      uint64_t last = 0;
+      wheel.expire(test_clock::at(now), [&](TestTimer &fired) {
+        EXPECT_LE(fired.expiry, now);
+        EXPECT_LE(last, fired.expiry);
+        last = fired.expiry;
+        forget(fired.id);
+      });
+      ASSERT_TRUE(expected.empty() || expected.begin()->first > now);
+      break;
+    }
+    ASSERT_EQ(expected.size(), wheel.size());
+    if (auto next = wheel.next_expiry(); next) {
+      ASSERT_LE(uint64_t(next->time_since_epoch().count()),
+                expected.begin()->first);
+    }
+  }
+  for (auto &t : timers) {
+    wheel.cancel(t);
+  }
+  EXPECT_TRUE(wheel.empty());
+}
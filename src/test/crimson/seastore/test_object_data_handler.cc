@@ -23,12 +23,18 @@ namespace {
 
 class TestOnode final : public Onode {
   onode_layout_t layout;
+  onode_layout_ext_t ext;
 
 public:
-  TestOnode(uint32_t ddr, uint32_t dmr) : Onode(ddr, dmr, hobject_t()) {}
+  TestOnode(uint32_t ddr, uint32_t dmr, bool with_ext = true)
+    : Onode(ddr, dmr, hobject_t()),
+      ext(with_ext ? onode_layout_ext_t{} : get_missing_layout_ext()) {}
   const onode_layout_t &get_layout() const final {
     return layout;
   }
+  onode_layout_ext_t get_layout_ext() const final {
+    return ext;
+  }
   template <typename Func>
   void with_mutable_layout(Transaction &t, Func&& f) {
     f(layout);
@@ -37,6 +43,7 @@ public:
     return true;
   }
   void swap_layout(Transaction &t, Onode& other) final {
+    std::swap(ext.blob_order, static_cast<TestOnode&>(other).ext.blob_order);
     static_cast<TestOnode&>(other).with_mutable_layout(
       t,
       [this](auto &o_mlayout) {
@@ -86,6 +93,8 @@ public:
   }
 
   void update_object_data(Transaction &t, object_data_t &odata) final {
+    ceph_assert(ext.version > 0 || odata.get_blob_order() == 0);
+    ext.blob_order = odata.get_blob_order();
     with_mutable_layout(t, [&odata](onode_layout_t &mlayout) {
       mlayout.object_data.update(odata);
     });
@@ -133,6 +142,8 @@ struct object_data_handler_test_t:
   public seastar_test_suite_t,
   TMTestState {
   OnodeRef onode;
+  // disabled unless a test sets the compressor
+  data_compression_t compression;
 
   bufferptr known_contents;
   extent_len_t size = 0;
@@ -143,14 +154,19 @@ struct object_data_handler_test_t:
 
   void write(Transaction &t, objaddr_t offset, extent_len_t len, char fill) {
     ceph_assert(offset + len <= known_contents.length());
-    size = std::max<extent_len_t>(size, offset + len);
-    Option::size_t olen = crimson::common::local_conf().get_val<Option::size_t>(
-      "seastore_data_delta_based_overwrite");
-    ceph_assert(olen == 0 || len <= olen);
     memset(
       known_contents.c_str() + offset,
       fill,
       len);
+    write_known(t, offset, len);
+  }
+  /// write [offset, offset + len) of known_contents as it is
+  void write_known(Transaction &t, objaddr_t offset, extent_len_t len) {
+    ceph_assert(offset + len <= known_contents.length());
+    size = std::max<extent_len_t>(size, offset + len);
+    Option::size_t olen = crimson::common::local_conf().get_val<Option::size_t>(
+      "seastore_data_delta_based_overwrite");
+    ceph_assert(olen == 0 || len <= olen);
     bufferlist bl;
     bl.append(
       bufferptr(
@@ -167,6 +183,8 @@ struct object_data_handler_test_t:
 	      *tm,
 	      t,
 	      *onode,
+	      nullptr,
+	      &compression
 	    },
 	    offset,
 	    bl);
@@ -178,6 +196,16 @@ struct object_data_handler_test_t:
     write(*t, offset, len, fill);
     return submit_transaction(std::move(t));
   }
+  void write_random(objaddr_t offset, extent_len_t len) {
+    ceph_assert(offset + len <= known_contents.length());
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (auto i = offset; i < offset + len; ++i) {
+      known_contents[i] = static_cast<char>(byte(gen));
+    }
+    auto t = create_mutate_transaction();
+    write_known(*t, offset, len);
+    return submit_transaction(std::move(t));
+  }
 
   void truncate(Transaction &t, objaddr_t offset) {
     if (size > offset) {
@@ -193,7 +221,9 @@ struct object_data_handler_test_t:
 	    ObjectDataHandler::context_t{
 	      *tm,
 	      t,
-	      *onode
+	      *onode,
+	      nullptr,
+	      &compression
 	    },
 	    offset);
 	});
@@ -314,6 +344,7 @@ struct object_data_handler_test_t:
 
   seastar::future<> tear_down_fut() final {
     onode.reset();
+    compression = data_compression_t{};
     size = 0;
     return tm_teardown();
   }
@@ -337,6 +368,16 @@ struct object_data_handler_test_t:
       "seastore_max_data_allocation_size", "8192").get();
   }
 
+  void enable_compression(extent_len_t blob_size) {
+    compression.compressor = get_data_compressor(Compressor::COMP_ALG_SNAPPY);
+    ceph_assert(compression.enabled());
+    compression.blob_size = blob_size;
+    compression.required_ratio = 1.0;
+  }
+  void check_blob_size(extent_len_t blob_size) {
+    EXPECT_EQ(onode->get_object_data().get_blob_size(), blob_size);
+  }
+
   objaddr_t get_random_write_offset(size_t block_size, objaddr_t limit) {
     return block_size *
       std::uniform_int_distribution<>(0, (limit / block_size) - 1)(gen);
@@ -917,6 +958,86 @@ TEST_P(object_data_handler_test_t, parallel_partial_read) {
   });
 }
 
+TEST_P(object_data_handler_test_t, compressed_write)
+{
+  run_async([this] {
+    enable_compression(64<<10);
+    write(0, 128<<10, 'a');
+    write(128<<10, 32<<10, 'b');
+    check_blob_size(64<<10);
+    read(0, 192<<10);
+    read_near(60<<10, 8<<10, 512);
+
+    restart();
+    epm->check_usage();
+    read(0, 192<<10);
+  });
+}
+
+TEST_P(object_data_handler_test_t, compressed_overwrite)
+{
+  run_async([this] {
+    enable_compression(64<<10);
+    write(0, 256<<10, 'a');
+    check_blob_size(64<<10);
+
+    // within a blob
+    write((64<<10) + (1<<10), 6<<10, 'b');
+    read_near(64<<10, 8<<10, 512);
+    // across two blobs
+    write(120<<10, 16<<10, 'c');
+    read_near(120<<10, 16<<10, 512);
+    // a whole blob
+    write(192<<10, 64<<10, 'd');
+    read(0, 256<<10);
+
+    restart();
+    epm->check_usage();
+    read(0, 256<<10);
+  });
+}
+
+TEST_P(object_data_handler_test_t, compressed_truncate)
+{
+  run_async([this] {
+    enable_compression(64<<10);
+    write(0, 192<<10, 'a');
+    truncate(100<<10);
+    read(0, 192<<10);
+    write(160<<10, 8<<10, 'b');
+    read(0, 192<<10);
+    truncate(0);
+    read(0, 192<<10);
+  });
+}
+
+TEST_P(object_data_handler_test_t, incompressible_write)
+{
+  run_async([this] {
+    enable_compression(64<<10);
+    write_random(0, 128<<10);
+    check_blob_size(64<<10);
+    read(0, 128<<10);
+    write(32<<10, 4<<10, 'a');
+    read(0, 128<<10);
+  });
+}
+
+TEST_P(object_data_handler_test_t, compressed_write_without_layout_ext)
+{
+  run_async([this] {
+    // onodes written before the layout extension keep their data raw
+    onode = new TestOnode(
+      DEFAULT_OBJECT_DATA_RESERVATION,
+      DEFAULT_OBJECT_METADATA_RESERVATION,
+      false);
+    enable_compression(64<<10);
+    write(0, 128<<10, 'a');
+    check_blob_size(0);
+    read(0, 128<<10);
+  });
+}
+
 INSTANTIATE_TEST_SUITE_P(
   object_data_handler_test,
   object_data_handler_test_t,
@@ -0,0 +1,456 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <cstring>
+#include <random>
+
+#include "gtest/gtest.h"
+#include "crimson/osd/ec_planner.h"
+#include "erasure-code/ErasureCode.h"
+
+using namespace crimson::osd::ec;
+
+// a single parity chunk, the xor of the data chunks
+class ErasureCodeXor : public ceph::ErasureCode {
+  const unsigned k;
+
+  static void xor_into(char *out, const char *in, unsigned len) {
+    for (unsigned i = 0; i < len; ++i) {
+      out[i] ^= in[i];
+    }
+  }
+
+public:
+  explicit ErasureCodeXor(unsigned k) : k(k) {}
+
+  int init(ceph::ErasureCodeProfile&, std::ostream*) override {
+    return 0;
+  }
+  uint64_t get_supported_optimizations() const override {
+    return FLAG_EC_PLUGIN_PARTIAL_READ_OPTIMIZATION |
+      FLAG_EC_PLUGIN_PARTIAL_WRITE_OPTIMIZATION |
+      FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION |
+      FLAG_EC_PLUGIN_OPTIMIZED_SUPPORTED;
+  }
+  unsigned int get_chunk_count() const override { return k + 1; }
+  unsigned int get_data_chunk_count() const override { return k; }
+  unsigned int get_chunk_size(unsigned int stripe_width) const override {
+    return stripe_width / k;
+  }
+  size_t get_minimum_granularity() override { return 1; }
+
+  [[deprecated]]
+  int encode_chunks(const std::set<int>&,
+                    std::map<int, ceph::bufferlist>*) override {
+    ceph_abort_msg("only the new interface is used");
+  }
+  int encode_chunks(const shard_id_map<ceph::bufferptr> &in,
+                    shard_id_map<ceph::bufferptr> &out) override {
+    // data chunks which are not there are zeros
+    for (auto &&[s, parity] : out) {
+      ::memset(parity.c_str(), 0, parity.length());
+      for (auto &&[d, data] : in) {
+        xor_into(parity.c_str(), data.c_str(), parity.length());
+      }
+    }
+    return 0;
+  }
+  [[deprecated]]
+  int decode_chunks(const std::set<int>&,
+                    const std::map<int, ceph::bufferlist>&,
+                    std::map<int, ceph::bufferlist>*) override {
+    ceph_abort_msg("only the new interface is used");
+  }
+  int decode_chunks(const shard_id_set&,
+                    shard_id_map<ceph::bufferptr> &in,
+                    shard_id_map<ceph::bufferptr> &out) override {
+    if (out.size() > 1) {
+      return -EIO;
+    }
+    // the missing chunk is the xor of all the others, parity included
+    return encode_chunks(in, out);
+  }
+  void encode_delta(const ceph::bufferptr &old_data,
+                    const ceph::bufferptr &new_data,
+                    ceph::bufferptr *delta) override {
+    if (delta->c_str() != old_data.c_str()) {
+      ::memcpy(delta->c_str(), old_data.c_str(), old_data.length());
+    }
+    xor_into(delta->c_str(), new_data.c_str(), new_data.length());
+  }
+  void apply_delta(const shard_id_map<ceph::bufferptr> &in,
+                   shard_id_map<ceph::bufferptr> &out) override {
+    for (auto &&[p, parity] : out) {
+      if (auto old = in.find(p);
+          old != in.end() && old->second.c_str() != parity.c_str()) {
+        ::memcpy(parity.c_str(), old->second.c_str(), parity.length());
+      }
+      for (auto &&[s, delta] : in) {
+        if (s < shard_id_t(k)) {
+          xor_into(parity.c_str(), delta.c_str(), parity.length());
+        }
+      }
+    }
+  }
+};
+
+// the parity of whole stripes only
+class ErasureCodeXorFullStripes : public ErasureCodeXor {
+public:
+  using ErasureCodeXor::ErasureCodeXor;
+  uint64_t get_supported_optimizations() const override {
+    return FLAG_EC_PLUGIN_OPTIMIZED_SUPPORTED;
+  }
+};
+
+static uint64_t range_end(const extent_map& emap)
+{
+  extent_set eset;
+  emap.to_interval_set(eset);
+  return eset.range_end();
+}
+
+class ECPlannerTest : public ::testing::Test {
+protected:
+  static constexpr unsigned k = 4;
+  static constexpr uint64_t chunk_size = 4096;
+  static constexpr uint64_t stripe_width = k * chunk_size;
+
+  const ceph::ErasureCodeInterfaceRef ec_impl =
+    std::make_shared<ErasureCodeXor>(k);
+  const ECUtil::stripe_info_t sinfo{ec_impl, nullptr, stripe_width};
+
+  static ceph::bufferlist filled(uint64_t len, char c) {
+    ceph::bufferlist bl;
+    bl.append(std::string(len, c));
+    return bl;
+  }
+  static ceph::bufferlist random_data(uint64_t len) {
+    std::mt19937 rng(42);
+    std::string s(len, 0);
+    for (auto& c : s) {
+      c = static_cast<char>(rng());
+    }
+    ceph::bufferlist bl;
+    bl.append(s);
+    return bl;
+  }
+  // the shards of an object holding data, parity included
+  ECUtil::shard_extent_map_t encoded(const ceph::bufferlist& data) const {
+    ECUtil::shard_extent_map_t sem(&sinfo);
+    ceph::bufferlist bl = data;
+    sinfo.ro_range_to_shard_extent_map(0, bl.length(), bl, sem);
+    sem.insert_parity_buffers();
+    EXPECT_EQ(0, sem.encode(ec_impl, nullptr));
+    return sem;
+  }
+  // what read_shards would get from the shards which did not fail
+  static void read_from(const ECUtil::shard_extent_map_t& shards,
+                        const ECUtil::shard_extent_set_t& want,
+                        const shard_id_set& failed,
+                        ECUtil::shard_extent_map_t& out) {
+    for (auto &&[s, eset] : want) {
+      if (failed.contains(s)) {
+        continue;
+      }
+      for (auto [off, len] : eset) {
+        for (auto& e : shards.get_extent_map(s).intersect(off, len)) {
+          out.insert_in_shard(s, e.get_off(), e.get_val());
+        }
+      }
+    }
+  }
+};
+
+TEST_F(ECPlannerTest, plan_write)
+{
+  object_state_t st;
+  st.size = st.valid_end = stripe_width;
+  write_plan_t plan;
+
+  plan_write(plan, st, 100, 0, {});
+  EXPECT_TRUE(plan.overlay.empty());
+  EXPECT_TRUE(plan.dirty.empty());
+
+  plan_write(plan, st, 100, 10, filled(10, 'a'));
+  EXPECT_FALSE(plan.resized);
+  EXPECT_EQ(stripe_width, st.size);
+
+  plan_write(plan, st, stripe_width - 5, 10, filled(10, 'b'));
+  EXPECT_TRUE(plan.resized);
+  EXPECT_EQ(stripe_width + 5, st.size);
+  // growing does not make the shards current any further
+  EXPECT_EQ(stripe_width, st.valid_end);
+  extent_set dirty;
+  dirty.insert(100, 10);
+  dirty.insert(stripe_width - 5, 10);
+  EXPECT_EQ(dirty, plan.dirty);
+}
+
+TEST_F(ECPlannerTest, plan_truncate)
+{
+  object_state_t st;
+  st.size = st.valid_end = 2 * stripe_width;
+  st.data.insert(stripe_width, 100, filled(100, 'd'));
+  write_plan_t plan;
+  plan_write(plan, st, stripe_width + 50, 100, filled(100, 'a'));
+  ASSERT_FALSE(plan.resized);
+
+  plan_truncate(sinfo, plan, st, stripe_width + 60);
+  EXPECT_TRUE(plan.resized);
+  EXPECT_EQ(stripe_width + 60, st.size);
+  EXPECT_EQ(stripe_width + 60, st.valid_end);
+  ASSERT_TRUE(plan.truncate_to);
+  EXPECT_EQ(stripe_width + 60, *plan.truncate_to);
+  EXPECT_EQ(stripe_width + 60, range_end(plan.overlay));
+  EXPECT_EQ(stripe_width + 60, range_end(st.data));
+  // the rest of the last stripe is zeroed, so its parity is rewritten
+  extent_set dirty;
+  dirty.insert(stripe_width + 50, stripe_width - 50);
+  EXPECT_EQ(dirty, plan.dirty);
+
+  // growing back keeps the lowest truncation point
+  plan_truncate(sinfo, plan, st, 3 * stripe_width);
+  EXPECT_EQ(3 * stripe_width, st.size);
+  EXPECT_EQ(stripe_width + 60, st.valid_end);
+  EXPECT_EQ(stripe_width + 60, *plan.truncate_to);
+
+  // on a stripe boundary nothing is left to re-encode
+  write_plan_t aligned;
+  plan_truncate(sinfo, aligned, st, stripe_width);
+  EXPECT_TRUE(aligned.dirty.empty());
+  ASSERT_TRUE(aligned.truncate_to);
+  EXPECT_EQ(stripe_width, *aligned.truncate_to);
+}
+
+TEST_F(ECPlannerTest, should_write_parity_delta)
+{
+  object_state_t st;
+  st.size = st.valid_end = 4 * stripe_width;
+  st.pending = 1;
+  {
+    // one data shard touched: reads it and the parity instead of 3 shards
+    write_plan_t plan;
+    plan_write(plan, st, 100, 10, filled(10, 'a'));
+    EXPECT_TRUE(should_write_parity_delta(sinfo, plan, st));
+  }
+  {
+    // two data shards touched
+    write_plan_t plan;
+    plan_write(plan, st, chunk_size - 5, 10, filled(10, 'a'));
+    EXPECT_FALSE(should_write_parity_delta(sinfo, plan, st));
+  }
+  {
+    object_state_t growing = st;
+    write_plan_t plan;
+    plan_write(plan, growing, st.size - 5, 10, filled(10, 'a'));
+    EXPECT_FALSE(should_write_parity_delta(sinfo, plan, growing));
+  }
+  {
+    // past what is on disk
+    object_state_t shrunk = st;
+    shrunk.valid_end = 50;
+    write_plan_t plan;
+    plan_write(plan, shrunk, 100, 10, filled(10, 'a'));
+    EXPECT_FALSE(should_write_parity_delta(sinfo, plan, shrunk));
+  }
+  {
+    // other writes in flight
+    object_state_t busy = st;
+    busy.pending = 2;
+    write_plan_t plan;
+    plan_write(plan, busy, 100, 10, filled(10, 'a'));
+    EXPECT_FALSE(should_write_parity_delta(sinfo, plan, busy));
+    busy.pending = 1;
+    busy.data.insert(0, 10, filled(10, 'd'));
+    EXPECT_FALSE(should_write_parity_delta(sinfo, plan, busy));
+  }
+  {
+    write_plan_t plan;
+    plan_write(plan, st, 100, 10, filled(10, 'a'));
+    EXPECT_FALSE(should_write_parity_delta(
+      ECUtil::stripe_info_t{std::make_shared<ErasureCodeXorFullStripes>(k),
+                            nullptr, stripe_width},
+      plan, st));
+    // with k = 2, rewriting the stripe reads less
+    EXPECT_FALSE(should_write_parity_delta(
+      ECUtil::stripe_info_t{std::make_shared<ErasureCodeXor>(2),
+                            nullptr, 2 * chunk_size},
+      plan, st));
+    plan_truncate(sinfo, plan, st, 2 * stripe_width);
+    EXPECT_FALSE(should_write_parity_delta(sinfo, plan, st));
+  }
+}
+
+TEST_F(ECPlannerTest, stripes_to_rewrite)
+{
+  write_plan_t plan;
+  plan.dirty.insert(100, 10);
+  plan.dirty.insert(2 * stripe_width + 10, stripe_width);
+  extent_set expected;
+  expected.insert(0, stripe_width);
+  expected.insert(2 * stripe_width, 2 * stripe_width);
+  EXPECT_EQ(expected, stripes_to_rewrite(sinfo, plan, 10 * stripe_width));
+
+  // nothing past the stripe holding the end of the object
+  expected.erase(3 * stripe_width, stripe_width);
+  EXPECT_EQ(expected, stripes_to_rewrite(sinfo, plan, 2 * stripe_width + 1));
+  expected.erase(2 * stripe_width, stripe_width);
+  EXPECT_EQ(expected, stripes_to_rewrite(sinfo, plan, 2 * stripe_width));
+}
+
+TEST_F(ECPlannerTest, old_data_to_read)
+{
+  object_state_t st;
+  st.size = 2 * stripe_width;
+  write_plan_t plan;
+  plan_write(plan, st, 100, 10, filled(10, 'a'));
+  extent_set stripes;
+  stripes.insert(0, 2 * stripe_width);
+
+  // nothing on disk
+  EXPECT_TRUE(old_data_to_read(plan, st, stripes).empty());
+
+  st.valid_end = stripe_width + 1000;
+  st.data.insert(500, 100, filled(100, 'd'));
+  extent_set expected;
+  expected.insert(0, 100);
+  expected.insert(110, 390);
+  expected.insert(600, stripe_width + 400);
+  EXPECT_EQ(expected, old_data_to_read(plan, st, stripes));
+}
+
+TEST_F(ECPlannerTest, assemble_stripes)
+{
+  object_state_t st;
+  st.data.insert(10, 20, filled(20, 'f'));
+  write_plan_t plan;
+  plan_write(plan, st, 20, 20, filled(20, 'p'));
+  extent_map old_data;
+  old_data.insert(0, 100, filled(100, 'o'));
+  extent_set stripes;
+  stripes.insert(0, stripe_width);
+
+  ceph::bufferlist bl;
+  for (auto& e : assemble_stripes(plan, st, stripes, old_data)) {
+    ASSERT_EQ(bl.length(), e.get_off());
+    bl.append(e.get_val());
+  }
+  const std::string expected = std::string(10, 'o') + std::string(10, 'f') +
+    std::string(20, 'p') + std::string(60, 'o') +
+    std::string(stripe_width - 100, '\0');
+  EXPECT_EQ(expected, bl.to_str());
+}
+
+TEST_F(ECPlannerTest, shards_to_rewrite)
+{
+  write_plan_t plan;
+  plan.dirty.insert(chunk_size + 10, 10);
+  plan.dirty.insert(stripe_width + 3 * chunk_size, 10);
+  shard_id_set expected;
+  expected.insert(shard_id_t(1));
+  expected.insert(shard_id_t(3));
+  expected.insert(shard_id_t(k));
+  EXPECT_EQ(expected, shards_to_rewrite(sinfo, plan));
+
+  // without partial writes every shard is written
+  shard_id_set all;
+  all.insert_range(shard_id_t(0), k + 1);
+  EXPECT_EQ(all, shards_to_rewrite(
+    ECUtil::stripe_info_t{std::make_shared<ErasureCodeXorFullStripes>(k),
+                          nullptr, stripe_width},
+    plan));
+}
+
+TEST_F(ECPlannerTest, extents_to_decode)
+{
+  ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
+  // a chunk and a half, on shards 0 and 1
+  sinfo.ro_range_to_shard_extent_set(0, chunk_size + chunk_size / 2, want);
+  want.align(EC_ALIGN_SIZE);
+  shard_id_set failed;
+  failed.insert(shard_id_t(1));
+
+  auto more = extents_to_decode(sinfo, want, failed);
+  extent_set row;
+  row.insert(0, chunk_size);
+  EXPECT_FALSE(more.contains(shard_id_t(0)));
+  EXPECT_FALSE(more.contains(shard_id_t(1)));
+  for (unsigned s : {2, 3, 4}) {
+    ASSERT_TRUE(more.contains(shard_id_t(s)));
+    EXPECT_EQ(row, more.at(shard_id_t(s)));
+  }
+}
+
+TEST_F(ECPlannerTest, decode_shards)
+{
+  const uint64_t size = 2 * stripe_width + 3 * chunk_size;
+  const auto data = random_data(size);
+  const auto shards = encoded(data);
+
+  ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
+  sinfo.ro_range_to_shard_extent_set(0, size, want);
+  want.align(EC_ALIGN_SIZE);
+  for (unsigned lost = 0; lost < k; ++lost) {
+    SCOPED_TRACE(lost);
+    shard_id_set failed;
+    failed.insert(shard_id_t(lost));
+    ECUtil::shard_extent_map_t out(&sinfo);
+    read_from(shards, want, failed, out);
+    read_from(shards, extents_to_decode(sinfo, want, failed), failed, out);
+    // a shard failing halfway leaves what it returned before
+    out.insert_in_shard(shard_id_t(lost), 0, filled(chunk_size, 'x'));
+
+    ASSERT_EQ(0, decode_shards(sinfo, ec_impl, want, failed, out));
+    EXPECT_TRUE(data.contents_equal(out.get_ro_buffer(0, size)));
+  }
+}
+
+TEST_F(ECPlannerTest, decode_shards_too_many_failed)
+{
+  const uint64_t size = stripe_width;
+  const auto shards = encoded(random_data(size));
+
+  ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
+  sinfo.ro_range_to_shard_extent_set(0, size, want);
+  shard_id_set failed;
+  failed.insert(shard_id_t(0));
+  failed.insert(shard_id_t(k));
+  ECUtil::shard_extent_map_t out(&sinfo);
+  read_from(shards, want, failed, out);
+  read_from(shards, extents_to_decode(sinfo, want, failed), failed, out);
+  failed.insert(shard_id_t(2));
+  EXPECT_EQ(-EIO, decode_shards(sinfo, ec_impl, want, failed, out));
+  EXPECT_FALSE(out.contains_shard(shard_id_t(2)));
+}
+
+TEST(ECPlanner, check_transaction)
+{
+  const coll_t cid;
+  const ghobject_t oid{hobject_t{"foo", "", CEPH_NOSNAP, 0, 1, ""}};
+  const ghobject_t clone_oid{hobject_t{"foo", "", 1, 0, 1, ""}};
+  ceph::bufferlist bl;
+  bl.append("bar");
+  {
+    ceph::os::Transaction t;
+    t.touch(cid, oid);
+    t.write(cid, oid, 0, bl.length(), bl);
+    t.setattr(cid, oid, "_", bl);
+    t.omap_setkeys(cid, oid, std::map<std::string, ceph::bufferlist>{{"k", bl}});
+    t.clone(cid, oid, clone_oid);
+    t.truncate(cid, oid, 1);
+    t.remove(cid, clone_oid);
+    EXPECT_EQ(0, check_transaction(t));
+  }
+  {
+    ceph::os::Transaction t;
+    t.write(cid, oid, 0, bl.length(), bl);
+    t.clone_range(cid, oid, clone_oid, 0, bl.length(), 0);
+    EXPECT_EQ(-EOPNOTSUPP, check_transaction(t));
+  }
+  {
+    ceph::os::Transaction t;
+    t.try_rename(cid, oid, clone_oid);
+    EXPECT_EQ(-EOPNOTSUPP, check_transaction(t));
+  }
+}
@@ -367,6 +367,85 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, encode_decode_batch)
+{
+  ErasureCodeIsaDefault Isa(tcache, "reed_sol_van");
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  Isa.init(profile, &cerr);
+
+  const unsigned k = 4, m = 2, stripes = 3;
+  const unsigned chunk_size = Isa.get_alignment() * 2;
+  vector<bufferptr> shards, parity;
+  for (unsigned i = 0; i < k + m; i++) {
+    shards.push_back(buffer::create_aligned(stripes * chunk_size,
+                                            EC_ISA_ADDRESS_ALIGNMENT));
+    parity.push_back(buffer::create_aligned(chunk_size,
+                                            EC_ISA_ADDRESS_ALIGNMENT));
+    for (unsigned j = 0; j < stripes * chunk_size; j++) {
+      shards[i].c_str()[j] = i < k ? random() : 0;
+    }
+  }
+  auto slice = [&](unsigned s, shard_id_t shard) {
+    return bufferptr(shards[int(shard)], s * chunk_size, chunk_size);
+  };
+
+  // A batch encode gives the parity of encoding each stripe on its own
+  vector<shard_id_map<bufferptr>> in(stripes, shard_id_map<bufferptr>(k + m));
+  vector<shard_id_map<bufferptr>> out(stripes, shard_id_map<bufferptr>(k + m));
+  for (unsigned s = 0; s < stripes; s++) {
+    for (shard_id_t i; i < k + m; ++i) {
+      if (i < k) {
+        in[s].emplace(i, slice(s, i));
+      } else {
+        out[s].emplace(i, slice(s, i));
+      }
+    }
+  }
+  EXPECT_EQ(0, Isa.encode_chunks_batch(in, out));
+  for (unsigned s = 0; s < stripes; s++) {
+    shard_id_map<bufferptr> single_out(k + m);
+    for (shard_id_t i(k); i < k + m; ++i) {
+      single_out.emplace(i, parity[int(i)]);
+    }
+    EXPECT_EQ(0, Isa.encode_chunks(in[s], single_out));
+    for (shard_id_t i(k); i < k + m; ++i) {
+      EXPECT_EQ(0, memcmp(single_out.at(i).c_str(), slice(s, i).c_str(),
+                          chunk_size));
+    }
+  }
+
+  // Decode two stripes losing shards 0 and 4, then one losing 1 and 5,
+  // so that the tables of the first are reused and then replaced.
+  vector<bufferptr> copy;
+  for (unsigned i = 0; i < k + m; i++) {
+    copy.emplace_back(shards[i].c_str(), shards[i].length());
+  }
+  shard_id_set want_to_read;
+  vector<shard_id_map<bufferptr>> dec_in(stripes, shard_id_map<bufferptr>(k + m));
+  vector<shard_id_map<bufferptr>> dec_out(stripes, shard_id_map<bufferptr>(k + m));
+  for (unsigned s = 0; s < stripes; s++) {
+    shard_id_set lost;
+    lost.insert(shard_id_t(s < 2 ? 0 : 1));
+    lost.insert(shard_id_t(s < 2 ? 4 : 5));
+    want_to_read.insert(lost);
+    for (shard_id_t i; i < k + m; ++i) {
+      if (lost.contains(i)) {
+        memset(slice(s, i).c_str(), 0, chunk_size);
+        dec_out[s].emplace(i, slice(s, i));
+      } else {
+        dec_in[s].emplace(i, slice(s, i));
+      }
+    }
+  }
+  EXPECT_EQ(0, Isa.decode_chunks_batch(want_to_read, dec_in, dec_out));
+  for (unsigned i = 0; i < k + m; i++) {
+    EXPECT_EQ(0, memcmp(copy[i].c_str(), shards[i].c_str(),
+                        stripes * chunk_size));
+  }
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache, "reed_sol_van");
@@ -931,6 +931,65 @@ TEST(ErasureCodeLrc, encode_decode_2)
   }
 }
 
+TEST(ErasureCodeLrc, parity_delta)
+{
+  ErasureCodeLrc lrc(g_conf().get_val<std::string>("erasure_code_dir"));
+  ErasureCodeProfile profile;
+  profile["mapping"] =
+    "DD__DD__";
+  const char *description_string =
+    "[ "
+    " [ \"DDc_DDc_\", \"\" ],"
+    " [ \"DDDc____\", \"\" ],"
+    " [ \"____DDDc\", \"\" ],"
+    "]";
+  profile["layers"] = description_string;
+  EXPECT_EQ(0, lrc.init(profile, &cerr));
+  EXPECT_TRUE(lrc.get_supported_optimizations() &
+              ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION);
+  unsigned int chunk_size = 4096;
+  const vector<shard_id_t> &mapping = lrc.get_chunk_mapping();
+  shard_id_set data_shards;
+  for (unsigned int i = 0; i < lrc.get_data_chunk_count(); i++) {
+    data_shards.insert(mapping[i]);
+  }
+
+  // encode the old and the new stripes, which only differ by one data chunk
+  auto encode = [&](char fill, char changed) {
+    shard_id_map<bufferptr> in(lrc.get_chunk_count());
+    shard_id_map<bufferptr> out(lrc.get_chunk_count());
+    for (unsigned int i = 0; i < lrc.get_chunk_count(); i++) {
+      shard_id_t shard(i);
+      bufferptr bp(buffer::create_page_aligned(chunk_size));
+      if (data_shards.contains(shard)) {
+        memset(bp.c_str(), shard == mapping[1] ? changed : fill + i,
+               chunk_size);
+        in[shard] = bp;
+      } else {
+        out[shard] = bp;
+      }
+    }
+    EXPECT_EQ(0, lrc.encode_chunks(in, out));
+    return std::make_pair(in, out);
+  };
+  auto [old_in, old_out] = encode('A', 'x');
+  auto [new_in, new_out] = encode('A', 'y');
+
+  shard_id_t changed = mapping[1];
+  bufferptr delta(buffer::create_page_aligned(chunk_size));
+  lrc.encode_delta(old_in[changed], new_in[changed], &delta);
+  shard_id_map<bufferptr> in(lrc.get_chunk_count());
+  in[changed] = delta;
+  // every parity chunk is patched, including the local parity of the
+  // layer which does not contain the changed chunk but protects a global
+  // parity chunk
+  lrc.apply_delta(in, old_out);
+  for (auto&& [shard, parity] : new_out) {
+    EXPECT_EQ(string(parity.c_str(), chunk_size),
+              string(old_out[shard].c_str(), chunk_size)) << "shard " << shard;
+  }
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
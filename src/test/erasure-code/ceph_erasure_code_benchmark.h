@@ -33,6 +33,7 @@
 
 class ErasureCodeBench {
   int in_size;
+  int stripe_unit;
   int max_iterations;
   int erasures;
   int k;
@@ -58,6 +59,8 @@ public:
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
   int encode();
+  int encode_stripes();
+  int decode_stripes();
 };
 
 #endif
@@ -0,0 +1,292 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <iostream>
+
+using namespace std;
+
+#include "acconfig.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "msg/Messenger.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "auth/DummyAuth.h"
+
+// replies to the ops right from the messenger thread, so that only the
+// messengers are measured
+class ServerDispatcher : public Dispatcher {
+ public:
+  ServerDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OP;
+  }
+  void ms_handle_fast_connect(Connection *con) override {}
+  void ms_handle_fast_accept(Connection *con) override {}
+  bool ms_dispatch(Message *m) override { return true; }
+  void ms_fast_dispatch(Message *m) override {
+    MOSDOp *osd_op = static_cast<MOSDOp*>(m);
+    MOSDOpReply *reply = new MOSDOpReply(osd_op, 0, 0, 0, false);
+    m->get_connection()->send_message(reply);
+    m->put();
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  bool ms_handle_fast_authentication(Connection *con) override {
+    return true;
+  }
+};
+
+class ClientDispatcher : public Dispatcher {
+ public:
+  ceph::mutex lock = ceph::make_mutex("MessengerLoopback::ClientDispatcher::lock");
+  ceph::condition_variable cond;
+  uint64_t inflight = 0;
+
+  ClientDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OPREPLY;
+  }
+  void ms_handle_fast_connect(Connection *con) override {}
+  void ms_handle_fast_accept(Connection *con) override {}
+  bool ms_dispatch(Message *m) override { return true; }
+  void ms_fast_dispatch(Message *m) override {
+    m->put();
+    std::lock_guard l{lock};
+    inflight--;
+    cond.notify_all();
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  bool ms_handle_fast_authentication(Connection *con) override {
+    return true;
+  }
+};
+
+// the dummy auth, but it can negotiate the secure mode with a made up
+// connection secret
+class LoopbackAuth : public DummyAuthClientServer {
+  bool secure;
+  // the key and the two nonces of the secure mode
+  const std::string secret = std::string(16 + 2 * 12, 's');
+
+ public:
+  LoopbackAuth(CephContext *cct, bool secure)
+    : DummyAuthClientServer(cct), secure(secure) {}
+
+  int get_auth_request(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    uint32_t *method,
+    std::vector<uint32_t> *preferred_modes,
+    bufferlist *out) override {
+    *method = CEPH_AUTH_NONE;
+    *preferred_modes = { secure ? CEPH_CON_MODE_SECURE : CEPH_CON_MODE_CRC };
+    return 0;
+  }
+  int handle_auth_done(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    uint64_t global_id,
+    uint32_t con_mode,
+    const bufferlist& bl,
+    CryptoKey *session_key,
+    std::string *connection_secret) override {
+    *connection_secret = secret;
+    return 0;
+  }
+  int handle_auth_request(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    bool more,
+    uint32_t auth_method,
+    const bufferlist& bl,
+    bufferlist *reply) override {
+    auth_meta->connection_secret = secret;
+    return 1;
+  }
+};
+
+class MessengerLoopback {
+  string type;
+  string mode;
+  Messenger *server = nullptr;
+  Messenger *client = nullptr;
+  ServerDispatcher server_dispatcher;
+  ClientDispatcher client_dispatcher;
+  LoopbackAuth auth;
+  ConnectionRef conn;
+
+ public:
+  MessengerLoopback(const string &t, const string &m)
+    : type(t), mode(m), auth(g_ceph_context, m != "crc") {}
+  ~MessengerLoopback() {
+    for (auto msgr : {client, server}) {
+      if (msgr) {
+        msgr->shutdown();
+        msgr->wait();
+        delete msgr;
+      }
+    }
+  }
+
+  int start() {
+    int r = g_ceph_context->_conf.set_val("ms_secure_mode_ktls",
+                                          mode == "ktls" ? "true" : "false");
+    if (r < 0) {
+      return r;
+    }
+    auth.auth_registry.refresh_config();
+    server = Messenger::create(g_ceph_context, type, entity_name_t::OSD(0),
+                               "server", 0);
+    client = Messenger::create(g_ceph_context, type, entity_name_t::CLIENT(0),
+                               "client", getpid());
+    if (!server || !client) {
+      return -EINVAL;
+    }
+    server->set_default_policy(Messenger::Policy::stateless_server(0));
+    server->set_auth_server(&auth);
+    entity_addr_t addr;
+    addr.parse("v2:127.0.0.1:0");
+    r = server->bind(addr);
+    if (r < 0) {
+      return r;
+    }
+    server->add_dispatcher_head(&server_dispatcher);
+    server->start();
+
+    client->set_default_policy(Messenger::Policy::lossless_client(0));
+    client->set_auth_client(&auth);
+    client->add_dispatcher_head(&client_dispatcher);
+    client->start();
+    conn = client->connect_to_osd(server->get_myaddrs());
+    return 0;
+  }
+
+  /// send ios ops of len bytes with at most concurrency of them in flight,
+  /// returns the seconds it took to get all the replies
+  double run(int ios, int concurrency, int len) {
+    bufferptr ptr(len);
+    memset(ptr.c_str(), 0, len);
+    bufferlist data;
+    data.append(ptr);
+    object_t oid("object-name");
+    object_locator_t oloc(1, 1);
+    pg_t pgid;
+    hobject_t hobj(oid, oloc.key, CEPH_NOSNAP, pgid.ps(), pgid.pool(),
+                   oloc.nspace);
+    spg_t spgid(pgid);
+
+    auto start = ceph::mono_clock::now();
+    std::unique_lock l{client_dispatcher.lock};
+    for (int i = 0; i < ios; ++i) {
+      client_dispatcher.cond.wait(l, [&] {
+        return client_dispatcher.inflight < uint64_t(concurrency);
+      });
+      MOSDOp *m = new MOSDOp(0, 0, hobj, spgid, 0, 0, 0);
+      bufferlist msg_data(data);
+      m->write(0, len, msg_data);
+      client_dispatcher.inflight++;
+      conn->send_message(m);
+    }
+    client_dispatcher.cond.wait(l, [&] {
+      return client_dispatcher.inflight == 0;
+    });
+    return std::chrono::duration<double>(ceph::mono_clock::now() - start).count();
+  }
+};
+
+void usage(const string &name) {
+  cout << "Usage: " << name << " [ios] [concurrency] [small msg length] [large msg length] [ms types...]" << std::endl;
+  cout << "       [ios]: how much messages sent for each message length" << std::endl;
+  cout << "       [concurrency]: the max inflight messages(like iodepth in fio)" << std::endl;
+  cout << "       [small msg length]: message data bytes of the message rate run" << std::endl;
+  cout << "       [large msg length]: message data bytes of the throughput run" << std::endl;
+  cout << "       [ms types]: the messengers to compare, async+posix";
+#ifdef HAVE_URING_MESSENGER
+  cout << " and async+uring";
+#endif
+  cout << " by default" << std::endl;
+  cout << "                   a type may be followed by /crc (the default), /secure or /ktls" << std::endl;
+  cout << "                   for the connection mode, e.g. async+posix/ktls" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  if (args.size() < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  int ios = atoi(args[0]);
+  int concurrency = atoi(args[1]);
+  int small_len = atoi(args[2]);
+  int large_len = atoi(args[3]);
+  vector<string> types(args.begin() + 4, args.end());
+  if (types.empty()) {
+    types.push_back("async+posix");
+#ifdef HAVE_URING_MESSENGER
+    types.push_back("async+uring");
+#endif
+  }
+
+  cout << " ios " << ios << std::endl;
+  cout << " concurrency " << concurrency << std::endl;
+  for (auto &spec : types) {
+    string type = spec;
+    string mode = "crc";
+    if (auto slash = spec.find('/'); slash != string::npos) {
+      type = spec.substr(0, slash);
+      mode = spec.substr(slash + 1);
+    }
+    if (mode != "crc" && mode != "secure" && mode != "ktls") {
+      cerr << " unknown connection mode " << mode << std::endl;
+      return 1;
+    }
+    MessengerLoopback loopback(type, mode);
+    int r = loopback.start();
+    if (r < 0) {
+      cerr << " unable to start " << spec << ": " << cpp_strerror(r) << std::endl;
+      return 1;
+    }
+    // the first connection setup isn't part of the measure
+    loopback.run(1, 1, 0);
+    for (int len : {small_len, large_len}) {
+      double secs = loopback.run(ios, concurrency, len);
+      cout << " " << spec << " message data bytes " << len
+           << ": " << uint64_t(ios / secs) << " msgs/s, "
+           << (double(ios) * len / secs / (1 << 20)) << " MiB/s" << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -24,9 +24,11 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <arpa/inet.h>
+#include "acconfig.h"
 #include "include/Context.h"
 #include "common/ceph_mutex.h"
 #include "common/Cond.h"
+#include "common/errno.h"
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
 #include "msg/async/Event.h"
@@ -56,6 +58,11 @@
 #include "msg/async/EventKqueue.h"
 #endif
 #include "msg/async/EventSelect.h"
+#ifdef HAVE_URING_MESSENGER
+#include <netinet/in.h>
+#include <poll.h>
+#include "msg/async/EventUring.h"
+#endif
 
 #include <gtest/gtest.h>
 
@@ -78,7 +85,15 @@ class EventDriverTest : public ::testing::TestWithParam<const char*> {
 #endif
     if (strcmp(GetParam(), "select"))
       driver = new SelectDriver(g_ceph_context);
-    driver->init(NULL, 100);
+#ifdef HAVE_URING_MESSENGER
+    if (!strcmp(GetParam(), "uring")) {
+      delete driver;
+      driver = new UringDriver(g_ceph_context);
+    }
+#endif
+    int r = driver->init(NULL, 100);
+    if (r < 0 && !strcmp(GetParam(), "uring"))
+      GTEST_SKIP() << "io_uring unavailable: " << cpp_strerror(r);
   }
   void TearDown() override {
     delete driver;
@@ -332,6 +347,197 @@ TEST(EventCenterTest, DispatchTest) {
   worker2.join();
 }
 
+#ifdef HAVE_URING_MESSENGER
+class UringDriverTest : public ::testing::Test {
+ public:
+  std::unique_ptr<UringDriver> driver;
+  int fds[2] = {-1, -1};   // a TCP connection over loopback
+  bool attached = false;   // the driver closes fds[0]
+
+  // false if the kernel doesn't offer what the driver needs
+  bool start(uint64_t recv_buffers = 64,
+             uint64_t recv_buffers_per_socket = 32,
+             uint64_t send_queue_bytes = 1 << 20) {
+    auto &conf = g_ceph_context->_conf;
+    conf.set_val_or_die("ms_async_uring_recv_buffers",
+                        std::to_string(recv_buffers));
+    conf.set_val_or_die("ms_async_uring_recv_buffer_size", "4096");
+    conf.set_val_or_die("ms_async_uring_recv_buffers_per_socket",
+                        std::to_string(recv_buffers_per_socket));
+    conf.set_val_or_die("ms_async_uring_send_queue_bytes",
+                        std::to_string(send_queue_bytes));
+    driver = std::make_unique<UringDriver>(g_ceph_context);
+    int r = driver->init(nullptr, 100);
+    if (r < 0) {
+      cerr << "io_uring unavailable: " << cpp_strerror(r) << std::endl;
+      return false;
+    }
+
+    int listen_sd = ::socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_GE(listen_sd, 0);
+    struct sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sa);
+    EXPECT_EQ(0, ::bind(listen_sd, (struct sockaddr*)&sa, len));
+    EXPECT_EQ(0, ::listen(listen_sd, 1));
+    EXPECT_EQ(0, ::getsockname(listen_sd, (struct sockaddr*)&sa, &len));
+    fds[1] = ::socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_EQ(0, ::connect(fds[1], (struct sockaddr*)&sa, len));
+    fds[0] = ::accept(listen_sd, nullptr, nullptr);
+    EXPECT_GE(fds[0], 0);
+    ::close(listen_sd);
+    EXPECT_EQ(0, set_nonblock(fds[0]));
+    EXPECT_EQ(0, set_nonblock(fds[1]));
+    return true;
+  }
+  void TearDown() override {
+    if (!attached && fds[0] >= 0)
+      ::close(fds[0]);
+    if (fds[1] >= 0)
+      ::close(fds[1]);
+    driver.reset();
+    auto &conf = g_ceph_context->_conf;
+    for (auto key : {"ms_async_uring_recv_buffers",
+                     "ms_async_uring_recv_buffer_size",
+                     "ms_async_uring_recv_buffers_per_socket",
+                     "ms_async_uring_send_queue_bytes"}) {
+      conf.rm_val(key);
+    }
+  }
+  UringDriver::Socket *attach() {
+    driver->add_event(fds[0], EVENT_NONE, EVENT_READABLE);
+    attached = true;
+    return driver->attach(fds[0]);
+  }
+  // run the event loop until fds[0] fires mask, up to a few seconds
+  bool wait_for(int mask) {
+    vector<FiredFileEvent> fired_events;
+    for (int i = 0; i < 500; ++i) {
+      struct timeval tv = {0, 10000};
+      fired_events.clear();
+      driver->event_wait(fired_events, &tv);
+      for (auto &e : fired_events) {
+        if (e.fd == fds[0] && (e.mask & mask))
+          return true;
+      }
+    }
+    return false;
+  }
+  // read what the peer received so far
+  size_t drain_peer(string *out = nullptr) {
+    char buf[65536];
+    size_t n = 0;
+    ssize_t r;
+    while ((r = ::read(fds[1], buf, sizeof(buf))) > 0) {
+      if (out)
+        out->append(buf, r);
+      n += r;
+    }
+    return n;
+  }
+};
+
+TEST_F(UringDriverTest, ReceiveAndSend) {
+  if (!start())
+    GTEST_SKIP() << "the io_uring messenger needs Linux 6.0 or later";
+  auto s = attach();
+  char buf[16];
+  ASSERT_EQ(-EAGAIN, driver->read(s, buf, sizeof(buf)));
+
+  ASSERT_EQ(5, ::write(fds[1], "hello", 5));
+  ASSERT_TRUE(wait_for(EVENT_READABLE));
+  ASSERT_EQ(5, driver->read(s, buf, sizeof(buf)));
+  ASSERT_EQ(0, memcmp(buf, "hello", 5));
+  ASSERT_EQ(-EAGAIN, driver->read(s, buf, sizeof(buf)));
+
+  bufferlist bl;
+  bl.append("world");
+  ASSERT_EQ(5, driver->send(s, bl));
+  ASSERT_EQ(0u, bl.length());
+  struct pollfd pfd = {fds[1], POLLIN, 0};
+  ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+  string received;
+  drain_peer(&received);
+  ASSERT_EQ("world", received);
+
+  ::shutdown(fds[1], SHUT_WR);
+  ASSERT_TRUE(wait_for(EVENT_READABLE));
+  ASSERT_EQ(0, driver->read(s, buf, sizeof(buf)));
+  driver->close(s);
+}
+
+TEST_F(UringDriverTest, ReceiveBeyondTheBuffersOfASocket) {
+  // the socket may only hold 2 of the buffers, the rest of what arrives
+  // is read directly from it
+  if (!start(8, 2))
+    GTEST_SKIP() << "the io_uring messenger needs Linux 6.0 or later";
+  auto s = attach();
+  string sent;
+  for (unsigned i = 0; i < 65536; ++i) {
+    sent.push_back('a' + i % 26);
+  }
+  ASSERT_EQ((ssize_t)sent.size(), ::write(fds[1], sent.data(), sent.size()));
+
+  string received;
+  char buf[3000];
+  for (int i = 0; received.size() < sent.size() && i < 1000; ++i) {
+    ssize_t r = driver->read(s, buf, sizeof(buf));
+    if (r == -EAGAIN) {
+      ASSERT_TRUE(wait_for(EVENT_READABLE));
+      continue;
+    }
+    ASSERT_GT(r, 0);
+    received.append(buf, r);
+  }
+  ASSERT_EQ(sent, received);
+  driver->close(s);
+}
+
+TEST_F(UringDriverTest, SendQueueLimit) {
+  if (!start(64, 32, 65536))
+    GTEST_SKIP() << "the io_uring messenger needs Linux 6.0 or later";
+  auto s = attach();
+  const unsigned len = 16 << 20;
+  bufferlist bl;
+  bl.append_zero(len);
+
+  // the peer doesn't read, what the socket doesn't take is queued up to
+  // the limit and the rest left
+  ssize_t sent = driver->send(s, bl);
+  ASSERT_GT(sent, 0);
+  ASSERT_EQ(len - sent, bl.length());
+  ASSERT_GT(bl.length(), 0u);
+  ASSERT_EQ(0, driver->send(s, bl));
+
+  // WRITABLE fires once the queue drained
+  size_t received = 0;
+  bool writable = false;
+  for (int i = 0; !writable && i < 500; ++i) {
+    received += drain_peer();
+    vector<FiredFileEvent> fired_events;
+    struct timeval tv = {0, 10000};
+    driver->event_wait(fired_events, &tv);
+    for (auto &e : fired_events) {
+      writable |= e.fd == fds[0] && (e.mask & EVENT_WRITABLE);
+    }
+  }
+  ASSERT_TRUE(writable);
+
+  for (int i = 0; received < len && i < 5000; ++i) {
+    if (bl.length()) {
+      ASSERT_GE(driver->send(s, bl), 0);
+    }
+    received += drain_peer();
+    vector<FiredFileEvent> fired_events;
+    struct timeval tv = {0, 1000};
+    driver->event_wait(fired_events, &tv);
+  }
+  ASSERT_EQ(len, received);
+  driver->close(s);
+}
+#endif
+
 INSTANTIATE_TEST_SUITE_P(
   AsyncMessenger,
   EventDriverTest,
@@ -341,6 +547,9 @@ INSTANTIATE_TEST_SUITE_P(
 #endif
 #ifdef HAVE_KQUEUE
     "kqueue",
+#endif
+#ifdef HAVE_URING_MESSENGER
+    "uring",
 #endif
     "select"
   )
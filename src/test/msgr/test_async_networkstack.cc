@@ -24,6 +24,9 @@
 #include <set>
 #include <vector>
 #include <gtest/gtest.h>
+#ifdef __linux__
+#include <poll.h>
+#endif
 
 #include "acconfig.h"
 #include "common/config_obs.h"
@@ -62,6 +65,17 @@ class NetworkWorkerTest : public ::testing::TestWithParam<const char*> {
   NetworkWorkerTest() {}
   void SetUp() override {
     cerr << __func__ << " start set up " << GetParam() << std::endl;
+    // "posix/zerocopy" is the posix stack sending everything with
+    // MSG_ZEROCOPY
+    string type = GetParam();
+    bool zerocopy = false;
+    if (auto slash = type.find('/'); slash != string::npos) {
+      zerocopy = type.substr(slash + 1) == "zerocopy";
+      type = type.substr(0, slash);
+    }
+    g_ceph_context->_conf.set_val("ms_tcp_zerocopy",
+                                  zerocopy ? "true" : "false");
+    g_ceph_context->_conf.set_val("ms_tcp_zerocopy_threshold", "1");
     if (strncmp(GetParam(), "dpdk", 4)) {
       g_ceph_context->_conf.set_val("ms_type", "async+posix");
       addr = "127.0.0.1:15000";
@@ -73,11 +87,12 @@ class NetworkWorkerTest : public ::testing::TestWithParam<const char*> {
       addr = ipv4_addr + std::string(":15000");
       port_addr = ipv4_addr + std::string(":15001");
     }
-    stack = NetworkStack::create(g_ceph_context, GetParam());
+    stack = NetworkStack::create(g_ceph_context, type);
     stack->start();
   }
   void TearDown() override {
     stack->stop();
+    g_ceph_context->_conf.set_val("ms_tcp_zerocopy", "false");
   }
   string get_addr() const {
     return addr;
@@ -262,6 +277,115 @@ TEST_P(NetworkWorkerTest, SimpleTest) {
   });
 }
 
+#ifdef __linux__
+TEST_P(NetworkWorkerTest, ZerocopyCompletionTest) {
+  if (strcmp(GetParam(), "posix/zerocopy")) {
+    GTEST_SKIP() << "only the posix stack sends with MSG_ZEROCOPY";
+  }
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+
+  exec_events([bind_addr](Worker *worker) mutable {
+    if (worker->id != 0)
+      return;
+    EventCenter *center = &worker->center;
+    entity_addr_t cli_addr;
+    SocketOptions options;
+    ServerSocket bind_socket;
+    ssize_t r = worker->listen(bind_addr, 0, options, &bind_socket);
+    ASSERT_EQ(0, r);
+
+    ConnectedSocket cli_socket, srv_socket;
+    r = worker->connect(bind_addr, options, &cli_socket);
+    ASSERT_EQ(0, r);
+    {
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+      r = bind_socket.accept(&srv_socket, options, &cli_addr, worker);
+      ASSERT_EQ(0, r);
+    }
+    {
+      C_poll cb(center);
+      center->create_file_event(cli_socket.fd(), EVENT_READABLE, &cb);
+      r = cli_socket.is_connected();
+      if (r == 0) {
+        ASSERT_TRUE(cb.poll(500));
+        r = cli_socket.is_connected();
+      }
+      ASSERT_EQ(1, r);
+      center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+    }
+
+    PerfCounters *logger = worker->get_perf_counter();
+    uint64_t zerocopy_bytes = logger->get(l_msgr_send_zerocopy_bytes);
+    uint64_t zerocopy_copied_bytes =
+      logger->get(l_msgr_send_zerocopy_copied_bytes);
+    uint64_t copied_bytes = logger->get(l_msgr_send_copied_bytes);
+    const unsigned len = 16384;
+    bufferlist bl;
+    bl.append_zero(len);
+    r = cli_socket.send(bl, false);
+    ASSERT_EQ(len, r);
+    ASSERT_EQ(zerocopy_bytes + len, logger->get(l_msgr_send_zerocopy_bytes));
+
+    // nobody reads the socket, the completion shows up as POLLERR once the
+    // peer acked the data
+    struct pollfd pfd = {cli_socket.fd(), 0, 0};
+    auto start = ceph::mono_clock::now();
+    while ((r = ::poll(&pfd, 1, 10)) == 0) {
+      ASSERT_LT(ceph::mono_clock::now() - start, 10s);
+    }
+    ASSERT_EQ(1, r);
+    ASSERT_TRUE(pfd.revents & POLLERR);
+
+    // the way AsyncConnection does it, without reading from the socket
+    struct C_drain : public EventCallback {
+      ConnectedSocket &cs;
+      unsigned calls = 0;
+      explicit C_drain(ConnectedSocket &cs) : cs(cs) {}
+      void do_request(uint64_t fd) override {
+        ++calls;
+        cs.drain_error_queue();
+      }
+    } drain(cli_socket);
+    center->create_file_event(cli_socket.fd(), EVENT_READABLE, &drain);
+    center->process_events(1000);
+    ASSERT_EQ(1u, drain.calls);
+    ASSERT_EQ(0, ::poll(&pfd, 1, 0));
+    // the error is gone, the worker doesn't spin on it
+    center->process_events(1000);
+    ASSERT_EQ(1u, drain.calls);
+    center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+
+    // over loopback the kernel copies the data anyway, after which the
+    // socket stops using MSG_ZEROCOPY
+    bool copied = logger->get(l_msgr_send_zerocopy_copied_bytes) ==
+      zerocopy_copied_bytes + len;
+    if (!copied) {
+      ASSERT_EQ(zerocopy_copied_bytes,
+                logger->get(l_msgr_send_zerocopy_copied_bytes));
+    }
+    bl.append_zero(len);
+    r = cli_socket.send(bl, false);
+    ASSERT_EQ(len, r);
+    if (copied) {
+      ASSERT_EQ(zerocopy_bytes + len, logger->get(l_msgr_send_zerocopy_bytes));
+      ASSERT_EQ(copied_bytes + len, logger->get(l_msgr_send_copied_bytes));
+    } else {
+      ASSERT_EQ(zerocopy_bytes + 2 * len,
+                logger->get(l_msgr_send_zerocopy_bytes));
+      ASSERT_EQ(copied_bytes, logger->get(l_msgr_send_copied_bytes));
+    }
+
+    bind_socket.abort_accept();
+    srv_socket.close();
+    cli_socket.close();
+  });
+}
+#endif
+
 TEST_P(NetworkWorkerTest, ConnectFailedTest) {
   entity_addr_t bind_addr;
   ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
@@ -1049,6 +1173,12 @@ INSTANTIATE_TEST_SUITE_P(
   ::testing::Values(
 #ifdef HAVE_DPDK
     "dpdk",
+#endif
+#ifdef HAVE_URING_MESSENGER
+    "uring",
+#endif
+#ifdef __linux__
+    "posix/zerocopy",
 #endif
     "posix"
   )
@@ -19,9 +19,13 @@
 #include <iostream>
 #include <list>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <gmock/gmock-matchers.h>
 #include <stdlib.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -36,6 +40,7 @@
 
 #include "common/ceph_argparse.h"
 #include "common/ceph_mutex.h"
+#include "common/common_init.h"
 #include "global/global_init.h"
 #include "messages/MCommand.h"
 #include "messages/MPing.h"
@@ -1645,6 +1650,560 @@ TEST_P(MessengerTest, AuthTest) {
   client_msgr->wait();
 }
 
+// the dummy auth, but it negotiates the secure mode with a made up
+// connection secret
+class SecureDummyAuth : public DummyAuthClientServer {
+  // the key and the two nonces of the secure mode
+  const std::string secret = std::string(16 + 2 * 12, 's');
+
+ public:
+  explicit SecureDummyAuth(CephContext *cct) : DummyAuthClientServer(cct) {
+    auth_registry.refresh_config();
+  }
+  int get_auth_request(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    uint32_t *method,
+    std::vector<uint32_t> *preferred_modes,
+    bufferlist *out) override {
+    *method = CEPH_AUTH_NONE;
+    *preferred_modes = { CEPH_CON_MODE_SECURE };
+    return 0;
+  }
+  int handle_auth_done(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    uint64_t global_id,
+    uint32_t con_mode,
+    const bufferlist& bl,
+    CryptoKey *session_key,
+    std::string *connection_secret) override {
+    *connection_secret = secret;
+    return 0;
+  }
+  int handle_auth_request(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    bool more,
+    uint32_t auth_method,
+    const bufferlist& bl,
+    bufferlist *reply) override {
+    auth_meta->connection_secret = secret;
+    return 1;
+  }
+};
+
+// whether the kernel lets us attach the "tls" ULP to a TCP socket
+static bool kernel_has_tls()
+{
+#if defined(__linux__) && defined(TCP_ULP)
+  bool ok = false;
+  int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int cfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sa = {};
+  socklen_t len = sizeof(sa);
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (lfd >= 0 && cfd >= 0 &&
+      ::bind(lfd, (struct sockaddr*)&sa, sizeof(sa)) == 0 &&
+      ::listen(lfd, 1) == 0 &&
+      ::getsockname(lfd, (struct sockaddr*)&sa, &len) == 0 &&
+      ::connect(cfd, (struct sockaddr*)&sa, sizeof(sa)) == 0) {
+    ok = ::setsockopt(cfd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+  }
+  if (cfd >= 0) {
+    ::close(cfd);
+  }
+  if (lfd >= 0) {
+    ::close(lfd);
+  }
+  return ok;
+#else
+  return false;
+#endif
+}
+
+static std::string dump_connections(Messenger *msgr)
+{
+  auto f = Formatter::create_unique("json");
+  std::ostringstream os;
+  msgr->dump(f.get());
+  f->flush(os);
+  return os.str();
+}
+
+// ping the server with some data, which takes several TLS records
+static void ping_with_data(ConnectionRef conn, FakeDispatcher &dispatcher,
+			   unsigned len)
+{
+  MPing *m = new MPing();
+  bufferlist bl;
+  bl.append_zero(len);
+  m->set_data(bl);
+  ASSERT_EQ(conn->send_message(m), 0);
+  std::unique_lock l{dispatcher.lock};
+  dispatcher.cond.wait(l, [&] { return dispatcher.got_new; });
+  dispatcher.got_new = false;
+}
+
+TEST_P(MessengerTest, KtlsTest) {
+  if (string(GetParam()) != "async+posix") {
+    GTEST_SKIP() << "only async+posix supports kernel TLS";
+  }
+  g_ceph_context->_conf.set_val("ms_secure_mode_ktls", "true");
+  SecureDummyAuth secure_auth(g_ceph_context);
+  server_msgr->set_auth_client(&secure_auth);
+  server_msgr->set_auth_server(&secure_auth);
+  client_msgr->set_auth_client(&secure_auth);
+  client_msgr->set_auth_server(&secure_auth);
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  for (unsigned len : {0u, 100u, 1u << 20, 4000u}) {
+    ping_with_data(conn, cli_dispatcher, len);
+  }
+  ASSERT_TRUE(conn->is_connected());
+  ASSERT_EQ(4U, static_cast<Session*>(conn->get_priv().get())->get_count());
+
+  // without the ULP, both ends stay with the secure mode frames
+  const bool ktls = kernel_has_tls();
+  for (auto msgr : {client_msgr, server_msgr}) {
+    auto dump = dump_connections(msgr);
+    ASSERT_THAT(dump, ::testing::HasSubstr("\"con_mode\":\"secure\"")) << dump;
+    if (ktls) {
+      ASSERT_THAT(dump, ::testing::HasSubstr("\"ktls\":true")) << dump;
+      ASSERT_THAT(dump, ::testing::HasSubstr("\"rx\":\"PLAIN\"")) << dump;
+    } else {
+      ASSERT_THAT(dump, ::testing::HasSubstr("\"ktls\":false")) << dump;
+      ASSERT_THAT(dump, ::testing::HasSubstr("\"rx\":\"AES-128-GCM\"")) << dump;
+    }
+  }
+
+  // the session goes on over a new connection after a reset
+  conn->mark_down();
+  conn = client_msgr->connect_to(server_msgr->get_mytype(),
+				 server_msgr->get_myaddrs());
+  ping_with_data(conn, cli_dispatcher, 1u << 16);
+  ASSERT_TRUE(conn->is_connected());
+
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+  g_ceph_context->_conf.set_val("ms_secure_mode_ktls", "false");
+}
+
+TEST_P(MessengerTest, KtlsFallbackTest) {
+  if (string(GetParam()) != "async+posix") {
+    GTEST_SKIP() << "only async+posix supports kernel TLS";
+  }
+  // the client attaches the ULP and offers kernel TLS, the server, with a
+  // context of its own, doesn't: the ULP must pass the secure mode frames
+  // through untouched
+  g_ceph_context->_conf.set_val("ms_secure_mode_ktls", "true");
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_OSD);
+  boost::intrusive_ptr<CephContext> server_cct{
+    common_preinit(iparams, CODE_ENVIRONMENT_UTILITY,
+		   CINIT_FLAG_NO_DEFAULT_CONFIG_FILE),
+    false};
+  server_cct->_conf.set_val("ms_secure_mode_ktls", "false");
+  server_cct->_conf.apply_changes(nullptr);
+  SecureDummyAuth server_auth(server_cct.get());
+  SecureDummyAuth client_auth(g_ceph_context);
+  Messenger *plain_server = Messenger::create(
+    server_cct.get(), string(GetParam()), entity_name_t::OSD(1), "server",
+    getpid());
+  plain_server->set_default_policy(Messenger::Policy::stateless_server(0));
+  plain_server->set_auth_client(&server_auth);
+  plain_server->set_auth_server(&server_auth);
+  plain_server->set_require_authorizer(false);
+  client_msgr->set_auth_client(&client_auth);
+  client_msgr->set_auth_server(&client_auth);
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  plain_server->bind(bind_addr);
+  plain_server->add_dispatcher_head(&srv_dispatcher);
+  plain_server->start();
+
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->connect_to(plain_server->get_mytype(),
+					       plain_server->get_myaddrs());
+  for (unsigned len : {0u, 1u << 20, 100u}) {
+    ping_with_data(conn, cli_dispatcher, len);
+  }
+  ASSERT_TRUE(conn->is_connected());
+  auto dump = dump_connections(client_msgr);
+  ASSERT_THAT(dump, ::testing::HasSubstr("\"ktls\":false")) << dump;
+  ASSERT_THAT(dump, ::testing::HasSubstr("\"rx\":\"AES-128-GCM\"")) << dump;
+
+  plain_server->shutdown();
+  client_msgr->shutdown();
+  plain_server->wait();
+  client_msgr->wait();
+  delete plain_server;
+  g_ceph_context->_conf.set_val("ms_secure_mode_ktls", "false");
+}
+
+// records the tids of the messages it gets, in the order they are
+// dispatched
+class StreamDispatcher : public Dispatcher {
+ public:
+  ceph::mutex lock = ceph::make_mutex("StreamDispatcher::lock");
+  ceph::condition_variable cond;
+  std::vector<uint64_t> tids;
+  bool got_remote_reset = false;
+
+  explicit StreamDispatcher(CephContext *cct) : Dispatcher(cct) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    std::lock_guard l{lock};
+    tids.push_back(m->get_tid());
+    cond.notify_all();
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override {
+    ms_fast_dispatch(m);
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override {
+    return true;
+  }
+  void ms_handle_remote_reset(Connection *con) override {
+    std::lock_guard l{lock};
+    got_remote_reset = true;
+    cond.notify_all();
+  }
+  bool ms_handle_refused(Connection *con) override {
+    return false;
+  }
+  bool ms_handle_fast_authentication(Connection *con) override {
+    return true;
+  }
+};
+
+// Tells the streams of a session from its primary, the first connection
+// it sees or the one which identifies the session, and holds or fails
+// them on their way
+struct StreamInterceptor : public Interceptor {
+  std::set<Connection*> primaries;
+  uint32_t hold_step = 0;  // the streams wait there until released
+  unsigned held = 0;
+  bool fail_stream = false;  // the next message read by a stream
+  bool fail_primary = false;  // the next message read by the primary
+  unsigned failed = 0;
+
+  ACTION intercept(Connection *conn, uint32_t step) override {
+    std::unique_lock l(lock);
+    if (primaries.empty() ||
+        step == STEP::SEND_SERVER_IDENTITY ||
+        step == STEP::SEND_RECONNECT_OK) {
+      primaries.insert(conn);
+    }
+    const bool primary = primaries.count(conn);
+    if (!primary && step == hold_step) {
+      lderr(g_ceph_context) << __func__ << " holding stream " << conn
+                            << " on step=" << step << dendl;
+      ++held;
+      cond_var.notify_all();
+      cond_var.wait(l, [this, step] { return hold_step != step; });
+      return ACTION::CONTINUE;
+    }
+    if (step == STEP::HANDLE_MESSAGE) {
+      bool& fail = primary ? fail_primary : fail_stream;
+      if (fail) {
+        lderr(g_ceph_context) << __func__ << " failing "
+                              << (primary ? "primary " : "stream ")
+                              << conn << dendl;
+        fail = false;
+        ++failed;
+        cond_var.notify_all();
+        return ACTION::FAIL;
+      }
+    }
+    return ACTION::CONTINUE;
+  }
+
+  void hold(uint32_t step) {
+    std::lock_guard l(lock);
+    hold_step = step;
+  }
+  void release() {
+    std::lock_guard l(lock);
+    hold_step = 0;
+    cond_var.notify_all();
+  }
+  void wait_held(unsigned count) {
+    std::unique_lock l(lock);
+    cond_var.wait(l, [&] { return held >= count; });
+  }
+  void wait_failed(unsigned count) {
+    std::unique_lock l(lock);
+    cond_var.wait(l, [&] { return failed >= count; });
+  }
+};
+
+// Two OSDs whose session is striped over three streams.  Each has a
+// context of its own, with a worker per connection, so that a stream held
+// by the interceptor doesn't hold the others.
+class StripedSession {
+ public:
+  boost::intrusive_ptr<CephContext> server_cct, client_cct;
+  DummyAuthClientServer server_auth, client_auth;
+  StreamDispatcher srv_dispatcher, cli_dispatcher;
+  StreamInterceptor srv_interceptor, cli_interceptor;
+  Messenger *server = nullptr;
+  Messenger *client = nullptr;
+  ConnectionRef conn;
+  uint64_t next_tid = 0;
+
+  static boost::intrusive_ptr<CephContext> create_context() {
+    CephInitParameters iparams(CEPH_ENTITY_TYPE_OSD);
+    boost::intrusive_ptr<CephContext> cct{
+      common_preinit(iparams, CODE_ENVIRONMENT_UTILITY,
+                     CINIT_FLAG_NO_DEFAULT_CONFIG_FILE),
+      false};
+    cct->_conf.set_val("ms_osd_peer_streams", "3");
+    cct->_conf.set_val("ms_osd_peer_stream_min_size", "4096");
+    cct->_conf.set_val("ms_async_op_threads", "8");
+    cct->_conf.apply_changes(nullptr);
+    return cct;
+  }
+  Messenger *create_messenger(const std::string &type, CephContext *cct,
+                              DummyAuthClientServer &auth,
+                              StreamDispatcher &dispatcher,
+                              StreamInterceptor &interceptor, int id) {
+    auth.auth_registry.refresh_config();
+    Messenger *msgr = Messenger::create(cct, type, entity_name_t::OSD(id),
+                                        "osd", getpid());
+    msgr->set_policy(entity_name_t::TYPE_OSD,
+                     Messenger::Policy::lossless_peer(0));
+    msgr->set_auth_client(&auth);
+    msgr->set_auth_server(&auth);
+    msgr->set_require_authorizer(false);
+    msgr->interceptor = &interceptor;
+    entity_addr_t bind_addr;
+    bind_addr.parse("v2:127.0.0.1");
+    msgr->bind(bind_addr);
+    msgr->add_dispatcher_head(&dispatcher);
+    msgr->start();
+    return msgr;
+  }
+
+  explicit StripedSession(const std::string &type)
+    : server_cct(create_context()), client_cct(create_context()),
+      server_auth(server_cct.get()), client_auth(client_cct.get()),
+      srv_dispatcher(server_cct.get()), cli_dispatcher(client_cct.get()) {
+    server = create_messenger(type, server_cct.get(), server_auth,
+                              srv_dispatcher, srv_interceptor, 0);
+    client = create_messenger(type, client_cct.get(), client_auth,
+                              cli_dispatcher, cli_interceptor, 1);
+  }
+  ~StripedSession() {
+    srv_interceptor.release();
+    cli_interceptor.release();
+    client->shutdown();
+    server->shutdown();
+    client->wait();
+    server->wait();
+    delete client;
+    delete server;
+  }
+
+  void connect() {
+    conn = client->connect_to(server->get_mytype(), server->get_myaddrs());
+    send(0);
+    wait_for(1);
+  }
+  // messages with len bytes of data or more go over the streams
+  void send(unsigned len) {
+    MPing *m = new MPing();
+    m->set_tid(next_tid++);
+    if (len) {
+      bufferlist bl;
+      bl.append_zero(len);
+      m->set_data(bl);
+    }
+    ASSERT_EQ(conn->send_message(m), 0);
+  }
+  void wait_for(size_t count) {
+    std::unique_lock l{srv_dispatcher.lock};
+    srv_dispatcher.cond.wait(l, [&] {
+      return srv_dispatcher.tids.size() >= count;
+    });
+  }
+  // the sessions only, the streams may be held by the interceptor
+  static std::string dump_sessions(Messenger *msgr) {
+    auto f = Formatter::create_unique("json");
+    std::ostringstream os;
+    msgr->dump(f.get(), [](const std::string &what) {
+      return what == "connections";
+    });
+    f->flush(os);
+    return os.str();
+  }
+  static bool has_in_dump(Messenger *msgr, const std::string &what) {
+    for (int i = 0; i < 10000; ++i) {
+      if (dump_sessions(msgr).find(what) != std::string::npos) {
+        return true;
+      }
+      usleep(1000);
+    }
+    return false;
+  }
+  void wait_streams() {
+    ASSERT_TRUE(has_in_dump(client, "\"streams\":2"))
+      << dump_sessions(client);
+    ASSERT_TRUE(has_in_dump(server, "\"streams\":2"))
+      << dump_sessions(server);
+  }
+  // every message was dispatched once, in the order it was sent, and the
+  // session survived
+  void expect_in_order() {
+    wait_for(next_tid);
+    std::lock_guard l{srv_dispatcher.lock};
+    std::vector<uint64_t> expected(next_tid);
+    std::iota(expected.begin(), expected.end(), 0);
+    EXPECT_EQ(expected, srv_dispatcher.tids);
+    EXPECT_FALSE(srv_dispatcher.got_remote_reset);
+  }
+};
+
+TEST_P(MessengerTest, StreamOrderTest) {
+  StripedSession session(GetParam());
+  session.connect();
+  session.wait_streams();
+
+  // the large messages overtake the small ones, and each other
+  for (unsigned i = 0; i < 300; ++i) {
+    switch (i % 4) {
+    case 0:
+      session.send(1 << 20);
+      break;
+    case 1:
+      session.send(64 << 10);
+      break;
+    case 2:
+      session.send(100);
+      break;
+    default:
+      session.send(0);
+    }
+  }
+  session.expect_in_order();
+  ASSERT_TRUE(session.conn->is_connected());
+}
+
+TEST_P(MessengerTest, StreamFaultTest) {
+  StripedSession session(GetParam());
+  session.connect();
+  session.wait_streams();
+
+  // the server loses a stream while the messages are on their way, the
+  // session is reset along with its streams and resends them
+  {
+    std::lock_guard l(session.srv_interceptor.lock);
+    session.srv_interceptor.fail_stream = true;
+  }
+  for (unsigned i = 0; i < 60; ++i) {
+    session.send(i % 2 ? 256 << 10 : 10);
+  }
+  session.srv_interceptor.wait_failed(1);
+  session.expect_in_order();
+  // it's striped again
+  session.wait_streams();
+  for (unsigned i = 0; i < 20; ++i) {
+    session.send(i % 2 ? 10 : 256 << 10);
+  }
+  session.expect_in_order();
+}
+
+TEST_P(MessengerTest, StreamParkedReconnectTest) {
+  StripedSession session(GetParam());
+  session.connect();
+  session.wait_streams();
+
+  // a stream holds a message which the next one, read by the primary,
+  // waits for
+  session.srv_interceptor.hold(Interceptor::STEP::HANDLE_MESSAGE);
+  session.send(64 << 10);
+  session.srv_interceptor.wait_held(1);
+  session.send(0);
+  ASSERT_TRUE(StripedSession::has_in_dump(session.server,
+                                          "\"streams_parked_messages\":1"))
+    << StripedSession::dump_sessions(session.server);
+
+  // the primary fails meanwhile, it drops the parked message and closes
+  // the streams, the held one included once it goes on
+  {
+    std::lock_guard l(session.srv_interceptor.lock);
+    session.srv_interceptor.fail_primary = true;
+  }
+  session.send(0);
+  session.srv_interceptor.wait_failed(1);
+  session.srv_interceptor.release();
+
+  // the session reconnects and resends them all
+  session.expect_in_order();
+  session.wait_streams();
+  for (unsigned i = 0; i < 10; ++i) {
+    session.send(64 << 10);
+  }
+  session.expect_in_order();
+}
+
+TEST_P(MessengerTest, StreamAttachCookieTest) {
+  StripedSession session(GetParam());
+  // the streams of the first session are held before they attach
+  session.cli_interceptor.hold(Interceptor::STEP::SEND_AUTH_REQUEST);
+  session.connect();
+  session.cli_interceptor.wait_held(2);
+
+  // the server forgets the session, the client is reset and starts
+  // another one, with new cookies, when it sends again
+  session.server->mark_down_addrs(session.client->get_myaddrs());
+  session.send(0);
+  {
+    std::unique_lock l{session.cli_dispatcher.lock};
+    session.cli_dispatcher.cond.wait(l, [&] {
+      return session.cli_dispatcher.got_remote_reset;
+    });
+  }
+  // the message was dropped along with the old session
+  session.send(0);
+  session.wait_for(2);
+  {
+    std::lock_guard l{session.srv_dispatcher.lock};
+    ASSERT_EQ(2u, session.srv_dispatcher.tids.back());
+    session.srv_dispatcher.tids.clear();
+  }
+  session.next_tid = 0;
+
+  // the held streams try to join the new session with the cookies of
+  // the old one, they are turned away and leave the room to the streams
+  // of the new session
+  session.cli_interceptor.release();
+  session.wait_streams();
+  for (unsigned i = 0; i < 20; ++i) {
+    session.send(i % 2 ? 0 : 64 << 10);
+  }
+  session.expect_in_order();
+}
+
 TEST_P(MessengerTest, MessageTest) {
   FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
   entity_addr_t bind_addr;
@@ -2514,6 +3073,9 @@ INSTANTIATE_TEST_SUITE_P(
   Messenger,
   MessengerTest,
   ::testing::Values(
+#ifdef HAVE_URING_MESSENGER
+    "async+uring",
+#endif
     "async+posix"
   )
 );
@@ -15,6 +15,7 @@
 #include "include/stringify.h"
 #include "include/Context.h"
 #include "os/bluestore/Allocator.h"
+#include "os/bluestore/ShardedAllocator.h"
 
 using namespace std;
 
@@ -799,3 +800,86 @@ INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
   ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree", "hybrid_btree2"));
+
+class ShardedAllocTest : public ::testing::TestWithParam<const char*> {
+public:
+  static constexpr uint64_t region = ShardedAllocator::REGION_ALIGNMENT;
+  std::unique_ptr<ShardedAllocator> alloc;
+
+  void init_alloc(int64_t size, uint64_t min_alloc_size, size_t shards) {
+    alloc.reset(ShardedAllocator::create(g_ceph_context, GetParam(), size,
+					 min_alloc_size, shards));
+    ASSERT_TRUE(alloc);
+  }
+};
+
+TEST_P(ShardedAllocTest, test_regions)
+{
+  int64_t block_size = 0x1000;
+  init_alloc(4 * region + region / 2, block_size, 5);
+  ASSERT_EQ(5u, alloc->get_num_shards());
+
+  // a range crossing region boundaries is split between regions
+  alloc->init_add_free(region / 2, 3 * region);
+  ASSERT_EQ(3 * region, alloc->get_free());
+  alloc->init_rm_free(region - block_size, 2 * block_size);
+  ASSERT_EQ(3 * region - 2 * block_size, alloc->get_free());
+
+  uint64_t free = 0;
+  alloc->foreach([&](uint64_t off, uint64_t len) {
+    ASSERT_GE(off, region / 2);
+    ASSERT_LE(off + len, region / 2 + 3 * region);
+    ASSERT_FALSE(off < region && off + len > region - block_size);
+    free += len;
+  });
+  ASSERT_EQ(alloc->get_free(), free);
+}
+
+TEST_P(ShardedAllocTest, test_steal)
+{
+  int64_t block_size = 0x1000;
+  init_alloc(4 * region, block_size, 4);
+  alloc->init_add_free(0, 4 * region);
+
+  // more than a single region can provide
+  PExtentVector extents;
+  uint64_t want = 2 * region + 0x10000;
+  ASSERT_EQ((int64_t)want, alloc->allocate(want, block_size, 0, 0, &extents));
+  ASSERT_EQ(4 * region - want, alloc->get_free());
+  ASSERT_EQ(1u, alloc->get_steal_count());
+  interval_set<uint64_t> allocated;
+  for (auto& e : extents) {
+    ASSERT_LE(e.end(), 4 * region);
+    allocated.union_insert(e.offset, e.length);
+  }
+  ASSERT_EQ(want, allocated.size());
+
+  // hinted allocations stay in the hinted region
+  PExtentVector hinted;
+  auto hint = 3 * region + 0x100000;
+  for (auto& e : extents) {
+    if (e.offset >= 3 * region) {
+      hint = 0; // region is used already, any placement is fine
+    }
+  }
+  ASSERT_EQ(0x10000, alloc->allocate(0x10000, block_size, 0, hint, &hinted));
+  if (hint) {
+    ASSERT_GE(hinted[0].offset, 3 * region);
+  }
+
+  alloc->release(extents);
+  alloc->release(hinted);
+  ASSERT_EQ(4 * region, alloc->get_free());
+
+  // everything is gone
+  extents.clear();
+  ASSERT_EQ((int64_t)(4 * region),
+	    alloc->allocate(4 * region, block_size, 0, 0, &extents));
+  PExtentVector more;
+  ASSERT_EQ(-ENOSPC, alloc->allocate(block_size, block_size, 0, 0, &more));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  Allocator,
+  ShardedAllocTest,
+  ::testing::Values("bitmap", "avl", "hybrid", "btree", "hybrid_btree2"));
@@ -0,0 +1,243 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * BlueStore buffer cache simulator.
+ *
+ * Replays a read trace against each buffer cache policy and reports the
+ * resulting hit ratios, so that replacement policies can be compared on
+ * a given access pattern without running an OSD.
+ */
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "include/types.h"
+#include "include/stringify.h"
+#include "common/ceph_argparse.h"
+#include "common/perf_counters.h"
+#include "common/strtol.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "os/bluestore/BlueStore.h"
+
+using namespace std;
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " <cache_size> <trace_file|synthetic>"
+       << " [<policy> ...]" << std::endl;
+  cerr << "Policies default to lru, 2q and arc." << std::endl;
+  cerr << "The trace file holds one read per line (space separated):"
+       << " object offset length [dontneed]" << std::endl;
+  cerr << "'synthetic' replays a hot working set of half the cache size"
+       << " mixed with a sequential scan over four times the cache size."
+       << std::endl;
+}
+
+struct read_op_t {
+  uint32_t object;
+  uint32_t offset;
+  uint32_t length;
+  bool dontneed;
+};
+
+struct trace_t {
+  vector<string> objects;
+  vector<read_op_t> ops;
+};
+
+int load_trace(const char* fname, trace_t* trace)
+{
+  ifstream in(fname);
+  if (!in) {
+    cerr << "error: unable to open " << fname << std::endl;
+    return -1;
+  }
+  map<string, uint32_t> ids;
+  string line;
+  size_t lineno = 0;
+  while (getline(in, line)) {
+    ++lineno;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    istringstream ss(line);
+    string name, hint;
+    uint64_t offset, length;
+    if (!(ss >> name >> offset >> length) ||
+        offset + length > numeric_limits<uint32_t>::max()) {
+      cerr << "error: bad read at line " << lineno << ": " << line
+           << std::endl;
+      return -1;
+    }
+    ss >> hint;
+    auto [p, inserted] = ids.emplace(name, trace->objects.size());
+    if (inserted) {
+      trace->objects.push_back(name);
+    }
+    trace->ops.push_back(
+      {p->second, (uint32_t)offset, (uint32_t)length, hint == "dontneed"});
+  }
+  return 0;
+}
+
+void make_synthetic(uint64_t cache_size, trace_t* trace)
+{
+  constexpr uint32_t object_size = 4 << 20;
+  constexpr uint32_t scan_chunk = 64 << 10;
+  uint32_t hot_objects = std::max<uint64_t>(1, cache_size / 2 / object_size);
+  uint32_t scan_objects = std::max<uint64_t>(1, cache_size * 4 / object_size);
+  for (uint32_t i = 0; i < hot_objects; ++i) {
+    trace->objects.push_back("hot_" + stringify(i));
+  }
+  for (uint32_t i = 0; i < scan_objects; ++i) {
+    trace->objects.push_back("scan_" + stringify(i));
+  }
+
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<uint32_t> hot_obj(0, hot_objects - 1);
+  std::uniform_int_distribution<uint32_t> hot_block(0, object_size / 4096 - 16);
+  std::uniform_int_distribution<uint32_t> hot_len(1, 16);
+  // warm up the working set, then keep reading it while one scan passes
+  uint64_t warmup_ops = hot_objects * (object_size / 4096) / 4;
+  for (uint64_t i = 0; i < warmup_ops; ++i) {
+    trace->ops.push_back(
+      {hot_obj(rng), hot_block(rng) * 4096, hot_len(rng) * 4096, false});
+  }
+  for (uint32_t o = 0; o < scan_objects; ++o) {
+    for (uint32_t off = 0; off < object_size; off += scan_chunk) {
+      trace->ops.push_back({hot_objects + o, off, scan_chunk, false});
+      for (int i = 0; i < 4; ++i) {
+        trace->ops.push_back(
+          {hot_obj(rng), hot_block(rng) * 4096, hot_len(rng) * 4096, false});
+      }
+    }
+  }
+}
+
+struct result_t {
+  uint64_t hit_ops = 0;
+  uint64_t hit_bytes = 0;
+  uint64_t miss_bytes = 0;
+  double seconds = 0;
+};
+
+result_t replay(const string& policy, uint64_t cache_size, const trace_t& trace)
+{
+  BlueStore store(g_ceph_context, "", 4096);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc{
+    BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL)};
+
+  // BufferSpace::read reports hit/miss bytes through the shard's logger
+  PerfCountersBuilder b(g_ceph_context, "bluestore_cache_sim",
+                        l_bluestore_first, l_bluestore_last);
+  b.add_u64_counter(l_bluestore_buffer_hit_bytes, "buffer_hit_bytes",
+                    "Sum for bytes of read hit in the cache");
+  b.add_u64_counter(l_bluestore_buffer_miss_bytes, "buffer_miss_bytes",
+                    "Sum for bytes of read missed in the cache");
+  std::unique_ptr<PerfCounters> logger{b.create_perf_counters()};
+  std::unique_ptr<BlueStore::BufferCacheShard> bc{
+    BlueStore::BufferCacheShard::create(&store, policy, logger.get())};
+  bc->set_max(cache_size);
+
+  auto coll = ceph::make_ref<BlueStore::Collection>(
+    &store, oc.get(), bc.get(), coll_t());
+  vector<std::unique_ptr<BlueStore::Onode>> onodes;
+  onodes.reserve(trace.objects.size());
+  for (auto& name : trace.objects) {
+    ghobject_t oid(hobject_t(sobject_t(name, CEPH_NOSNAP)));
+    onodes.emplace_back(new BlueStore::Onode(coll.get(), oid, name.c_str()));
+  }
+
+  result_t r;
+  auto start = std::chrono::steady_clock::now();
+  for (auto& op : trace.ops) {
+    auto& o = onodes[op.object];
+    BlueStore::ready_regions_t ready;
+    interval_set<uint32_t> cached;
+    o->bc.read(bc.get(), op.offset, op.length, ready, cached);
+    r.hit_bytes += cached.size();
+    r.miss_bytes += op.length - cached.size();
+    if (cached.size() == op.length) {
+      ++r.hit_ops;
+      continue;
+    }
+    // fill the holes as a buffered read from disk would
+    interval_set<uint32_t> missing;
+    missing.insert(op.offset, op.length);
+    missing.subtract(cached);
+    for (auto p = missing.begin(); p != missing.end(); ++p) {
+      bufferlist data;
+      data.append_zero(p.get_len());
+      o->bc.did_read(bc.get(), p.get_start(), std::move(data),
+                     op.dontneed ? 0 : 1);
+    }
+  }
+  r.seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  onodes.clear();
+  return r;
+}
+
+int main(int argc, char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+                         CODE_ENVIRONMENT_UTILITY,
+                         CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (args.size() < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  string err;
+  uint64_t cache_size = strict_iecstrtoll(args[0], &err);
+  if (!err.empty() || cache_size == 0) {
+    cerr << "error: bad cache size '" << args[0] << "'" << std::endl;
+    return 1;
+  }
+  trace_t trace;
+  if (strcmp(args[1], "synthetic") == 0) {
+    make_synthetic(cache_size, &trace);
+  } else if (load_trace(args[1], &trace) < 0) {
+    return 1;
+  }
+  vector<string> policies(args.begin() + 2, args.end());
+  if (policies.empty()) {
+    policies = {"lru", "2q", "arc"};
+  }
+  for (auto& p : policies) {
+    if (p != "lru" && p != "2q" && p != "arc") {
+      cerr << "error: unknown policy '" << p << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << trace.ops.size() << " reads over " << trace.objects.size()
+            << " objects, cache " << byte_u_t(cache_size) << std::endl;
+  std::cout << std::setw(6) << "policy"
+            << std::setw(12) << "op hit%"
+            << std::setw(12) << "byte hit%"
+            << std::setw(16) << "miss bytes"
+            << std::setw(10) << "secs" << std::endl;
+  for (auto& p : policies) {
+    auto r = replay(p, cache_size, trace);
+    uint64_t total = r.hit_bytes + r.miss_bytes;
+    std::cout << std::setw(6) << p << std::fixed << std::setprecision(2)
+              << std::setw(12)
+              << (trace.ops.empty() ? 0.0 :
+                  100.0 * r.hit_ops / trace.ops.size())
+              << std::setw(12)
+              << (total ? 100.0 * r.hit_bytes / total : 0.0)
+              << std::setw(16) << r.miss_bytes
+              << std::setw(10) << std::setprecision(3) << r.seconds
+              << std::endl;
+  }
+  return 0;
+}
@@ -5686,6 +5686,26 @@ INSTANTIATE_TEST_SUITE_P(
   }))
 );
 
+class SyntheticMatrixKVSyncLanes: public MatrixTest {};
+TEST_P(SyntheticMatrixKVSyncLanes, Test)
+{
+  SyntheticTest();
+};
+
+INSTANTIATE_TEST_SUITE_P(
+  BlueStore,
+  SyntheticMatrixKVSyncLanes,
+  ::testing::ValuesIn(MatrixTest::Expand({
+    { "bluestore_min_alloc_size", "4096" },
+    { "max_write", "65536" },
+    { "max_size", "1048576" },
+    { "alignment", "512" },
+    { "bluestore_kv_sync_lanes", "3", "8" },
+    { "bluestore_prefer_deferred_size", "32768", "0" },
+    { "bluestore_sync_submit_transaction", "true", "false" }
+  }))
+);
+
 TEST_P(StoreTest, AttrSynthetic) {
   MixedGenerator gen(447);
   gen_type rng(TEST_RANDOM_SEED);
@@ -10957,6 +10977,442 @@ TEST_P(StoreTest, SpuriousReadErrorTest) {
   }
 }
 
+TEST_P(StoreTest, SequentialReadPrefetchTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  int r;
+  auto logger = store->get_perf_counters();
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t hoid(hobject_t(sobject_t("foo", CEPH_NOSNAP)));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const uint64_t obj_size = 0x100000;
+  const uint64_t chunk = 0x4000;
+  bufferlist test_data;
+  for (uint64_t i = 0; i < obj_size / chunk; ++i) {
+    bufferptr ap(chunk);
+    memset(ap.c_str(), 'a' + i % 26, chunk);
+    test_data.append(ap);
+  }
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, obj_size, test_data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    // force cache clear
+    ch.reset();
+    EXPECT_EQ(store->umount(), 0);
+    EXPECT_EQ(store->mount(), 0);
+  }
+  ch = store->open_collection(cid);
+
+  SetVal(g_conf(), "bluestore_prefetch_max_bytes", "262144");
+  SetVal(g_conf(), "bluestore_prefetch_min_bytes", "65536");
+  SetVal(g_conf(), "bluestore_prefetch_trigger_requests", "2");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  auto prefetched = logger->get(l_bluestore_prefetch_bytes);
+  auto hits = logger->get(l_bluestore_prefetch_hit_bytes);
+  for (uint64_t off = 0; off < obj_size; off += chunk) {
+    bufferlist in, expected;
+    r = store->read(ch, hoid, off, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+    expected.substr_of(test_data, off, chunk);
+    ASSERT_TRUE(bl_eq(expected, in));
+  }
+  ASSERT_GT(logger->get(l_bluestore_prefetch_bytes), prefetched);
+  ASSERT_GT(logger->get(l_bluestore_prefetch_hit_bytes), hits);
+
+  // non-sequential reads must not trigger prefetch
+  prefetched = logger->get(l_bluestore_prefetch_bytes);
+  for (uint64_t off = obj_size - chunk; off > 0; off -= 2 * chunk) {
+    bufferlist in;
+    r = store->read(ch, hoid, off, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_prefetch_bytes), prefetched);
+
+  SetVal(g_conf(), "bluestore_prefetch_max_bytes", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+TEST_P(StoreTest, TransactionPrefetchTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_txc_prefetch", "true");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  int r;
+  auto logger = store->get_perf_counters();
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const int num_objects = 8;
+  vector<ghobject_t> oids;
+  bufferlist bl;
+  bl.append(std::string(0x1000, 'a'));
+  {
+    ObjectStore::Transaction t;
+    for (int i = 0; i < num_objects; ++i) {
+      oids.emplace_back(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+      t.write(cid, oids.back(), 0, bl.length(), bl);
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    // force cache clear
+    ch.reset();
+    EXPECT_EQ(store->umount(), 0);
+    EXPECT_EQ(store->mount(), 0);
+  }
+  ch = store->open_collection(cid);
+
+  auto onodes = logger->get(l_bluestore_txc_prefetch_onodes);
+  auto collapsed = logger->get(l_bluestore_txc_prefetch_collapsed);
+  {
+    ObjectStore::Transaction t;
+    for (auto& oid : oids) {
+      t.setattr(cid, oid, "attr", bl);
+    }
+    // not there, still gets created
+    t.touch(cid, ghobject_t(hobject_t(sobject_t("new", CEPH_NOSNAP))));
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_txc_prefetch_onodes),
+            onodes + num_objects + 1);
+  ASSERT_EQ(logger->get(l_bluestore_txc_prefetch_collapsed),
+            collapsed + num_objects);
+  for (auto& oid : oids) {
+    bufferptr bp;
+    r = store->getattr(ch, oid, "attr", bp);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(bl.length(), bp.length());
+  }
+  ASSERT_TRUE(store->exists(ch, ghobject_t(hobject_t(sobject_t("new", CEPH_NOSNAP)))));
+
+  SetVal(g_conf(), "bluestore_txc_prefetch", "false");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+TEST_P(StoreTest, OnodePackTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_onode_pack_ratio", "1");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  int r;
+  auto logger = store->get_perf_counters();
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // small objects keep their extent map inline, the big one gets sharded
+  const int num_objects = 64;
+  vector<ghobject_t> oids;
+  for (int i = 0; i < num_objects; ++i) {
+    oids.emplace_back(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(std::string(0x1000, 'a' + i % 26));
+    ObjectStore::Transaction t;
+    t.write(cid, oids.back(), 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ghobject_t big(hobject_t(sobject_t("big", CEPH_NOSNAP)));
+  const int num_extents = 512;
+  for (int i = 0; i < num_extents; i += 64) {
+    ObjectStore::Transaction t;
+    for (int j = i; j < i + 64; ++j) {
+      bufferlist bl;
+      bl.append(std::string(0x1000, 'A' + j % 26));
+      t.write(cid, big, j * 0x2000, bl.length(), bl);
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // adding onodes trims the cache, which packs the idle ones
+  for (int i = 0; i < num_objects; ++i) {
+    ObjectStore::Transaction t;
+    t.touch(cid, ghobject_t(hobject_t(sobject_t("new" + stringify(i),
+                                                CEPH_NOSNAP))));
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_GT(logger->get(l_bluestore_onode_packs), 0u);
+
+  auto unpacks = logger->get(l_bluestore_onode_unpacks);
+  // overwrite half of everything through the packed onodes
+  {
+    ObjectStore::Transaction t;
+    for (int i = 0; i < num_objects; i += 2) {
+      bufferlist bl;
+      bl.append(std::string(0x800, 'z'));
+      t.write(cid, oids[i], 0x800, bl.length(), bl);
+    }
+    for (int j = 0; j < num_extents; j += 2) {
+      bufferlist bl;
+      bl.append(std::string(0x800, 'z'));
+      t.write(cid, big, j * 0x2000 + 0x800, bl.length(), bl);
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_GT(logger->get(l_bluestore_onode_unpacks), unpacks);
+
+  auto verify = [&]() {
+    for (int i = 0; i < num_objects; ++i) {
+      bufferlist expected, in;
+      expected.append(std::string(0x1000, 'a' + i % 26));
+      if (i % 2 == 0) {
+        expected.begin(0x800).copy_in(0x800, std::string(0x800, 'z').c_str());
+      }
+      r = store->read(ch, oids[i], 0, 0x1000, in);
+      ASSERT_EQ(r, 0x1000);
+      ASSERT_TRUE(bl_eq(expected, in));
+    }
+    for (int j = 0; j < num_extents; ++j) {
+      bufferlist expected, in;
+      expected.append(std::string(0x1000, 'A' + j % 26));
+      if (j % 2 == 0) {
+        expected.begin(0x800).copy_in(0x800, std::string(0x800, 'z').c_str());
+      }
+      r = store->read(ch, big, j * 0x2000, 0x1000, in);
+      ASSERT_EQ(r, 0x1000);
+      ASSERT_TRUE(bl_eq(expected, in));
+    }
+  };
+  verify();
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  verify();
+}
+
+TEST_P(StoreTest, OnlineFsckTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_online_fsck_batch", "8");
+  SetVal(g_conf(), "bluestore_online_fsck_sleep", "0");
+  SetVal(g_conf(), "bluestore_online_fsck_threads", "4");
+  SetVal(g_conf(), "bluestore_online_fsck_interval", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  int r;
+  const int num_objects = 100;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // every other object gets a clone, so shared blobs are checked too
+  for (int i = 0; i < num_objects; ++i) {
+    ghobject_t oid(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(std::string(0x3000, 'a' + i % 26));
+    ObjectStore::Transaction t;
+    t.write(cid, oid, 0, bl.length(), bl);
+    if (i % 2 == 0) {
+      t.clone(cid, oid,
+              ghobject_t(hobject_t(sobject_t("obj" + stringify(i), 1))));
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  auto logger = store->get_perf_counters();
+  auto wait_for_pass = [&](uint64_t passes) {
+    return bstore->online_fsck_wait(0, std::chrono::seconds(60)) &&
+      logger->get(l_bluestore_online_fsck_passes) > passes;
+  };
+
+  auto passes = logger->get(l_bluestore_online_fsck_passes);
+  ASSERT_EQ(bstore->online_fsck_start(true), 0);
+  ASSERT_TRUE(wait_for_pass(passes));
+  EXPECT_GE(logger->get(l_bluestore_online_fsck_objects),
+            (uint64_t)num_objects * 3 / 2);
+  EXPECT_EQ(logger->get(l_bluestore_online_fsck_errors), 0u);
+
+  // a pass interrupted by umount resumes from its checkpoint
+  SetVal(g_conf(), "bluestore_online_fsck_sleep", "0.05");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  ASSERT_EQ(bstore->online_fsck_start(false), 0);
+  // a couple of batches in
+  ASSERT_TRUE(bstore->online_fsck_wait(16, std::chrono::seconds(60)));
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  SetVal(g_conf(), "bluestore_online_fsck_sleep", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  passes = logger->get(l_bluestore_online_fsck_passes);
+  auto objects = logger->get(l_bluestore_online_fsck_objects);
+  ASSERT_EQ(bstore->online_fsck_start(false), 0);
+  ASSERT_TRUE(wait_for_pass(passes));
+  EXPECT_LT(logger->get(l_bluestore_online_fsck_objects) - objects,
+            (uint64_t)num_objects * 3 / 2);
+  EXPECT_EQ(logger->get(l_bluestore_online_fsck_errors), 0u);
+  {
+    JSONFormatter f;
+    f.open_object_section("online_fsck");
+    bstore->online_fsck_dump(&f);
+    f.close_section();
+    std::stringstream ss;
+    f.flush(ss);
+    EXPECT_NE(ss.str().find("\"last_pass_errors\":0"), std::string::npos);
+  }
+}
+
+TEST_P(StoreTest, OnlineFsckCorruptionTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_online_fsck_sleep", "0");
+  SetVal(g_conf(), "bluestore_online_fsck_interval", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t hoid(hobject_t(sobject_t("obj", CEPH_NOSNAP)));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    bufferlist bl;
+    bl.append(std::string(0x3000, 'a'));
+    t.write(cid, hoid, 0, bl.length(), bl);
+    // the first shared blob of the store, sbid 1
+    t.clone(cid, hoid, ghobject_t(hobject_t(sobject_t("obj", 1))));
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  auto logger = store->get_perf_counters();
+  auto run_pass = [&] {
+    auto passes = logger->get(l_bluestore_online_fsck_passes);
+    ASSERT_EQ(bstore->online_fsck_start(false), 0);
+    ASSERT_TRUE(bstore->online_fsck_wait(0, std::chrono::seconds(60)))
+      << "online fsck pass did not complete";
+    bstore->online_fsck_stop();
+    EXPECT_GT(logger->get(l_bluestore_online_fsck_passes), passes);
+  };
+
+  // drop the references of the shared blob to the clones' data
+  string key;
+  _key_encode_u64(1, &key);
+  bufferlist orig;
+  ASSERT_EQ(bstore->get_shared_blob(key, orig), 0);
+  {
+    bufferlist bl;
+    bluestore_shared_blob_t sb(1);
+    encode(sb, bl);
+    bstore->inject_broken_shared_blob_key(key, bl);
+  }
+  auto errors = logger->get(l_bluestore_online_fsck_errors);
+  run_pass();
+  EXPECT_GT(logger->get(l_bluestore_online_fsck_errors), errors);
+
+  // and once repaired the next pass is clean
+  bstore->inject_broken_shared_blob_key(key, orig);
+  errors = logger->get(l_bluestore_online_fsck_errors);
+  run_pass();
+  EXPECT_EQ(logger->get(l_bluestore_online_fsck_errors), errors);
+}
+
+TEST_P(StoreTest, OnlineFsckDeferredTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_online_fsck_sleep", "0");
+  SetVal(g_conf(), "bluestore_online_fsck_interval", "0");
+  SetVal(g_conf(), "bluestore_csum_type", "crc32c");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  int r;
+  const int num_objects = 16;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto oid = [](int i) {
+    return ghobject_t(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+  };
+  for (int i = 0; i < num_objects; ++i) {
+    bufferlist bl;
+    bl.append(std::string(0x10000, 'a'));
+    ObjectStore::Transaction t;
+    t.write(cid, oid(i), 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  // overwrite the data in place through deferred writes, and keep them
+  // pending so that the device still has the old data
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", "1048576");
+  SetVal(g_conf(), "bluestore_deferred_batch_ops", "10000");
+  SetVal(g_conf(), "bluestore_max_defer_interval", "1000");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  auto logger = store->get_perf_counters();
+  auto submitted = logger->get(l_bluestore_submitted_deferred_writes);
+  for (int i = 0; i < num_objects; ++i) {
+    bufferlist bl;
+    bl.append(std::string(0x4000, 'b'));
+    ObjectStore::Transaction t;
+    t.write(cid, oid(i), 0x4000, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_submitted_deferred_writes), submitted);
+
+  // a deep pass must not mistake them for bad checksums
+  auto errors = logger->get(l_bluestore_online_fsck_errors);
+  ASSERT_EQ(bstore->online_fsck_start(true), 0);
+  ASSERT_TRUE(bstore->online_fsck_wait(0, std::chrono::seconds(60)));
+  bstore->online_fsck_stop();
+  EXPECT_EQ(logger->get(l_bluestore_online_fsck_errors), errors);
+  EXPECT_GT(logger->get(l_bluestore_submitted_deferred_writes), submitted);
+
+  for (int i = 0; i < num_objects; ++i) {
+    bufferlist bl, expected;
+    expected.append(std::string(0x4000, 'a'));
+    expected.append(std::string(0x4000, 'b'));
+    expected.append(std::string(0x8000, 'a'));
+    r = store->read(ch, oid(i), 0, 0x10000, bl);
+    ASSERT_EQ(r, 0x10000);
+    EXPECT_TRUE(bl_eq(expected, bl));
+  }
+}
+
 TEST_P(StoreTest, mergeRegionTest) {
   if (string(GetParam()) != "bluestore")
     return;
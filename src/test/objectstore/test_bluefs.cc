@@ -1690,6 +1690,63 @@ TEST(BlueFS, truncate_fsync) {
   }
 }
 
+TEST(BlueFS, group_commit_fsync) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_group_commit", "true");
+  conf.ApplyChanges();
+
+  constexpr int num_threads = 8;
+  constexpr int num_syncs = 100;
+  const std::string content(4096, 'g');
+  uuid_d fsid;
+  {
+    BlueFS fs(g_ceph_context);
+    ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+    ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+    ASSERT_EQ(0, fs.mount());
+    ASSERT_EQ(0, fs.maybe_verify_layout({ BlueFS::BDEV_DB, false, false }));
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&fs, &content, t] {
+        BlueFS::FileWriter *h;
+        ceph_assert(0 == fs.open_for_write("dir", "file" + stringify(t), &h,
+                                           false));
+        for (int i = 0; i < num_syncs; i++) {
+          // every append grows the file, so each fsync needs the log synced
+          h->append(content.c_str(), content.length());
+          ceph_assert(0 == fs.fsync(h));
+        }
+        fs.close_writer(h);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    auto *logger = fs.get_perf_counters();
+    // an fsync is counted in at most one group
+    ASSERT_LE(logger->get(l_bluefs_log_sync_group_size),
+              uint64_t(num_threads * num_syncs));
+    ASSERT_GT(logger->get(l_bluefs_log_sync_group_size) +
+              logger->get(l_bluefs_log_sync_coalesced), 0u);
+    fs.umount();
+  }
+  {
+    BlueFS fs(g_ceph_context);
+    ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+    ASSERT_EQ(0, fs.mount());
+    for (int t = 0; t < num_threads; t++) {
+      uint64_t file_size;
+      utime_t mtime;
+      ASSERT_EQ(0, fs.stat("dir", "file" + stringify(t), &file_size, &mtime));
+      ASSERT_EQ(uint64_t(num_syncs * content.length()), file_size);
+    }
+    fs.umount();
+  }
+}
+
 TEST(BlueFS, test_shared_alloc) {
   uint64_t size = 1048576 * 128;
   TempBdev bdev_slow{size};
@@ -4106,6 +4106,151 @@ TEST(bluestore_blob_use_tracker_t, mempool_stats_test) {
   }
 }
 
+TEST(CacheGhost, basic) {
+  BlueStore::CacheGhost g;
+  ASSERT_FALSE(g.enabled());
+  g.set_capacity(100);
+  ASSERT_TRUE(g.enabled());
+
+  for (uint64_t k = 0; k < 10; ++k) {
+    g.add(k, 10);
+  }
+  ASSERT_EQ(100u, g.size);
+
+  // oldest entry falls off once over capacity
+  g.add(10, 10);
+  ASSERT_EQ(100u, g.size);
+  uint64_t depth = std::numeric_limits<uint64_t>::max();
+  ASSERT_FALSE(g.take(0, &depth));
+
+  // the most recently evicted key is right behind the cache edge
+  ASSERT_TRUE(g.take(10, &depth));
+  ASSERT_EQ(0u, depth);
+  g.note_hit(depth);
+  ASSERT_EQ(90u, g.size);
+  ASSERT_EQ(1u, g.hits);
+  ASSERT_EQ(1u, g.bucket_hits[0]);
+  ASSERT_FALSE(g.take(10, &depth));
+
+  // an older one lands further out on the curve
+  depth = std::numeric_limits<uint64_t>::max();
+  ASSERT_TRUE(g.take(1, &depth));
+  ASSERT_EQ(90u, depth);
+  g.note_hit(depth);
+  ASSERT_EQ(1u, g.bucket_hits[BlueStore::CacheGhost::BUCKETS - 1]);
+
+  // re-adding a key moves it to the front without growing
+  g.add(5, 10);
+  ASSERT_EQ(80u, g.size);
+
+  g.set_capacity(0);
+  ASSERT_FALSE(g.enabled());
+  ASSERT_EQ(0u, g.size);
+  ASSERT_TRUE(g.lru.empty());
+  ASSERT_TRUE(g.index.empty());
+}
+
+TEST(BufferCacheShard, arc_scan_resistance) {
+  BlueStore store(g_ceph_context, "", 4096);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc{
+      BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL)};
+  std::unique_ptr<BlueStore::BufferCacheShard> bc{
+      BlueStore::BufferCacheShard::create(&store, "arc", NULL)};
+  bc->set_max(16 * 4096);
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t());
+
+  BlueStore::Onode hot(coll.get(), ghobject_t(hobject_t(sobject_t("hot", CEPH_NOSNAP))), "hot");
+  BlueStore::Onode scan(coll.get(), ghobject_t(hobject_t(sobject_t("scan", CEPH_NOSNAP))), "scan");
+  auto read = [&](BlueStore::Onode& o, uint32_t off, int level) {
+    bufferlist bl;
+    bl.append_zero(4096);
+    o.bc.did_read(bc.get(), off, std::move(bl), level);
+  };
+
+  // read twice, hence frequently used
+  for (int pass = 0; pass < 2; ++pass) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      read(hot, i * 4096, 1);
+    }
+  }
+  // a scan much larger than the cache only displaces itself
+  for (uint32_t i = 0; i < 64; ++i) {
+    read(scan, i * 4096, 1);
+  }
+  ASSERT_EQ(4u, hot.bc.buffer_map.size());
+  for (auto& b : hot.bc.buffer_map) {
+    ASSERT_TRUE(b.is_clean());
+  }
+  uint64_t scan_bytes = 0;
+  for (auto& b : scan.bc.buffer_map) {
+    if (b.is_clean()) {
+      scan_bytes += b.length;
+    }
+  }
+  ASSERT_EQ(12u * 4096, scan_bytes);
+
+  // data read with a cold hint goes first
+  read(scan, 1 << 20, 0);
+  read(scan, 2 << 20, 1);
+  auto p = scan.bc.buffer_map.find(1 << 20);
+  ASSERT_TRUE(p != scan.bc.buffer_map.end());
+  ASSERT_TRUE(p->is_empty());
+  p = scan.bc.buffer_map.find(2 << 20);
+  ASSERT_TRUE(p != scan.bc.buffer_map.end());
+  ASSERT_TRUE(p->is_clean());
+}
+
+TEST(BufferCacheShard, twoq_cold_reads) {
+  BlueStore store(g_ceph_context, "", 4096);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc{
+      BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL)};
+  std::unique_ptr<BlueStore::BufferCacheShard> bc{
+      BlueStore::BufferCacheShard::create(&store, "2q", NULL)};
+  bc->set_max(16 * 4096);
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t());
+
+  BlueStore::Onode o(coll.get(), ghobject_t(hobject_t(sobject_t("obj", CEPH_NOSNAP))), "obj");
+  auto read = [&](uint32_t off, int level) {
+    bufferlist bl;
+    bl.append_zero(4096);
+    o.bc.did_read(bc.get(), off, std::move(bl), level);
+  };
+  auto is_cached = [&](uint32_t off) {
+    auto p = o.bc.buffer_map.find(off);
+    return p != o.bc.buffer_map.end() && p->is_clean();
+  };
+  const uint32_t cold = 0, warm = 4096;
+  const uint32_t scan = 1 << 20;
+
+  // both fall out of warm_in, into warm_out
+  read(cold, 1);
+  read(warm, 1);
+  for (uint32_t i = 0; i < 16; ++i) {
+    read(scan + i * 4096, 1);
+  }
+  ASSERT_FALSE(is_cached(cold));
+  ASSERT_FALSE(is_cached(warm));
+
+  // read again: only the warm read promotes to hot, the cold one goes to
+  // the back of warm_in, and is the first to go
+  read(cold, 0);
+  read(warm, 1);
+  ASSERT_TRUE(is_cached(warm));
+  for (uint32_t i = 0; i < 16; ++i) {
+    read(2 * scan + i * 4096, 1);
+  }
+  ASSERT_FALSE(is_cached(cold));
+  ASSERT_TRUE(is_cached(warm));
+
+  // a cold read of a buffer in warm_in leaves it first to go
+  read(3 * scan, 1);
+  read(3 * scan + 4096, 1);
+  read(3 * scan, 0);
+  read(4 * scan, 1);
+  ASSERT_FALSE(is_cached(3 * scan));
+  ASSERT_TRUE(is_cached(3 * scan + 4096));
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   auto cct =
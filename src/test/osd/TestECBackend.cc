@@ -220,6 +220,11 @@ public:
     return 0;
   }
 
+  int encode_chunks_batch(const std::vector<shard_id_map<bufferptr>> &in,
+                          std::vector<shard_id_map<bufferptr>> &out) override {
+    return 0;
+  }
+
   int decode(const shard_id_set &want_to_read, const shard_id_map<bufferlist> &chunks, shard_id_map<bufferlist> *decoded,
 	     int chunk_size) override {
     return 0;
@@ -272,6 +277,16 @@ public:
     return 0;
   }
 
+  int decode_chunks_batch(const shard_id_set &want_to_read,
+                          std::vector<shard_id_map<bufferptr>> &in,
+                          std::vector<shard_id_map<bufferptr>> &out) override
+  {
+    for (size_t i = 0; i < in.size(); ++i) {
+      decode_chunks(want_to_read, in[i], out[i]);
+    }
+    return 0;
+  }
+
   const vector<shard_id_t> &get_chunk_mapping() const override {
     return chunk_mapping;
   }
@@ -302,6 +302,30 @@ public:
     cout << "first: " << *first << std::endl;;
     cout << "primary: " << *primary << std::endl;;
   }
+  // apply inc to osdmap and the mapping, and check the latter against
+  // a mapping computed from scratch
+  void apply_to_mapping(OSDMap::Incremental& inc, ParallelPGMapper& mapper) {
+    osdmap.apply_incremental(inc);
+    mapping.note_incremental(inc);
+    auto job = mapping.start_update(osdmap, mapper, 8);
+    job->wait();
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+    OSDMapMapping full;
+    full.update(osdmap);
+    for (auto& [poolid, pool] : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < pool.get_pg_num(); ++ps) {
+	pg_t pgid(ps, poolid);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	full.get(pgid, &up, &up_primary, &acting, &acting_primary);
+	mapping.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+  }
   void clean_pg_upmaps(CephContext *cct,
                        const OSDMap& om,
                        OSDMap::Incremental& pending_inc) {
@@ -545,6 +569,65 @@ TEST_F(OSDMapTest, MapFunctionsMatch) {
   EXPECT_EQ(acting_osds, acting_osds_two);
 }
 
+TEST_F(OSDMapTest, IncrementalMapping) {
+  set_up_map();
+  ThreadPool tp(g_ceph_context, "IncrementalMapping", "mapping_tp", 2);
+  ParallelPGMapper mapper(g_ceph_context, &tp);
+  tp.start();
+
+  {
+    // nothing noted yet, everything is mapped
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    apply_to_mapping(inc, mapper);
+  }
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  vector<int> up;
+  osdmap.pg_to_up_acting_osds(pgid, &up, nullptr, nullptr, nullptr);
+  ASSERT_EQ(3u, up.size());
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[up[0]] = CEPH_OSD_UP;
+    apply_to_mapping(inc, mapper);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pgid] = {up[2], up[1]};
+    inc.new_primary_affinity[up[1]] = 0;
+    apply_to_mapping(inc, mapper);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_up_client[up[0]] = osdmap.get_addrs(up[1]);
+    inc.new_pg_upmap_items[pgid] = {{up[2], up[0]}};
+    apply_to_mapping(inc, mapper);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[up[2]] = CEPH_OSD_OUT;
+    inc.new_pg_temp[pgid] = {};
+    apply_to_mapping(inc, mapper);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    pg_pool_t pool = *osdmap.get_pg_pool(my_ec_pool);
+    pool.set_pg_num(pool.get_pg_num() * 2);
+    pool.set_pgp_num(pool.get_pgp_num() * 2);
+    pool.last_change = inc.epoch;
+    inc.new_pools[my_ec_pool] = pool;
+    inc.old_pg_upmap_items.insert(pgid);
+    apply_to_mapping(inc, mapper);
+  }
+  {
+    // a gap in the noted incrementals remaps everything
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[up[1]] = CEPH_OSD_UP;
+    osdmap.apply_incremental(inc);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    apply_to_mapping(inc2, mapper);
+  }
+  tp.stop();
+}
+
 /** This test must be removed or modified appropriately when we allow
  * other ways to specify a primary. */
 TEST_F(OSDMapTest, PrimaryIsFirst) {
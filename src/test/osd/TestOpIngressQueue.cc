@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/common_init.h"
+
+#include "osd/scheduler/OpIngressQueue.h"
+
+using namespace ceph::osd::scheduler;
+
+int main(int argc, char **argv) {
+  std::vector<const char*> args(argv, argv+argc);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+struct MockItem : public PGOpQueueable {
+  MockItem() : PGOpQueueable(spg_t()) {}
+
+  ostream &print(ostream &rhs) const final { return rhs; }
+
+  std::string print() const final {
+    return std::string();
+  }
+
+  std::optional<OpRequestRef> maybe_get_op() const final {
+    return std::nullopt;
+  }
+
+  SchedulerClass get_scheduler_class() const final {
+    return SchedulerClass::client;
+  }
+
+  void run(OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final {}
+};
+
+// the producer goes in the owner, its sequence number in the epoch
+OpSchedulerItem create_item(uint64_t producer, epoch_t seq)
+{
+  return OpSchedulerItem(
+    std::make_unique<MockItem>(), 1, 1, utime_t(), producer, seq);
+}
+
+TEST(OpIngressQueue, fifo)
+{
+  OpIngressQueue q;
+  ASSERT_TRUE(q.empty());
+  EXPECT_EQ(0u, q.drain([](OpSchedulerItem&&) { FAIL(); }));
+
+  EXPECT_TRUE(q.push(create_item(0, 1)));
+  EXPECT_FALSE(q.push(create_item(0, 2)));
+  EXPECT_FALSE(q.push(create_item(0, 3)));
+  ASSERT_FALSE(q.empty());
+
+  epoch_t expected = 1;
+  EXPECT_EQ(3u, q.drain([&](OpSchedulerItem&& item) {
+    EXPECT_EQ(expected++, item.get_map_epoch());
+  }));
+  ASSERT_TRUE(q.empty());
+
+  EXPECT_TRUE(q.push(create_item(0, 4)));
+  EXPECT_EQ(1u, q.drain([](OpSchedulerItem&& item) {
+    EXPECT_EQ(4u, item.get_map_epoch());
+  }));
+}
+
+TEST(OpIngressQueue, destroy_non_empty)
+{
+  OpIngressQueue q;
+  q.push(create_item(0, 1));
+  q.push(create_item(0, 2));
+}
+
+TEST(OpIngressQueue, concurrent_producers)
+{
+  constexpr unsigned producers = 4;
+  constexpr epoch_t per_producer = 20000;
+  OpIngressQueue q;
+
+  std::vector<std::thread> threads;
+  for (unsigned p = 0; p < producers; ++p) {
+    threads.emplace_back([&q, p] {
+      for (epoch_t i = 1; i <= per_producer; ++i) {
+	q.push(create_item(p, i));
+      }
+    });
+  }
+
+  // every producer's items come out in the order it pushed them
+  std::vector<epoch_t> last(producers, 0);
+  size_t total = 0;
+  auto check = [&](OpSchedulerItem&& item) {
+    auto p = item.get_owner();
+    ASSERT_LT(p, producers);
+    EXPECT_EQ(last[p] + 1, item.get_map_epoch());
+    last[p] = item.get_map_epoch();
+  };
+  while (total < producers * per_producer) {
+    total += q.drain(check);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_TRUE(q.empty());
+  for (unsigned p = 0; p < producers; ++p) {
+    EXPECT_EQ(per_producer, last[p]);
+  }
+}
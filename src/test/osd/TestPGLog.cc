@@ -2226,6 +2226,44 @@ TEST_F(PGLogTest, get_request) {
   }
 }
 
+TEST_F(PGLogTest, get_last_write_since) {
+  clear();
+
+  hobject_t oid(object_t("objname"), "key", CEPH_NOSNAP, 456, 0, "");
+  hobject_t clone(object_t("objname"), "key", 1, 456, 0, "");
+  hobject_t other(object_t("other"), "key", CEPH_NOSNAP, 457, 0, "");
+  hobject_t unwritten(object_t("unwritten"), "key", CEPH_NOSNAP, 458, 0, "");
+  log.add(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(6,2), eversion_t(3,4),
+		   1, osd_reqid_t(entity_name_t::CLIENT(777), 8, 1),
+		   utime_t(0,1), 0));
+  log.add(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, other, eversion_t(6,3), eversion_t(),
+		   2, osd_reqid_t(entity_name_t::CLIENT(777), 8, 2),
+		   utime_t(1,2), 0));
+  // a write to a clone counts for its head
+  log.add(
+    pg_log_entry_t(pg_log_entry_t::CLONE, clone, eversion_t(6,4), eversion_t(6,2),
+		   3, osd_reqid_t(entity_name_t::CLIENT(777), 8, 3),
+		   utime_t(2,1), 0));
+  log.add(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, other, eversion_t(6,5), eversion_t(6,3),
+		   4, osd_reqid_t(entity_name_t::CLIENT(777), 8, 4),
+		   utime_t(3,1), 0));
+
+  EXPECT_EQ(eversion_t(6,4), log.get_last_write_since(oid, eversion_t()));
+  EXPECT_EQ(eversion_t(6,4), log.get_last_write_since(oid, eversion_t(6,3)));
+  EXPECT_EQ(eversion_t(), log.get_last_write_since(oid, eversion_t(6,4)));
+  EXPECT_EQ(eversion_t(6,4), log.get_last_write_since(clone, eversion_t(6,2)));
+  EXPECT_EQ(eversion_t(6,5), log.get_last_write_since(other, eversion_t(6,4)));
+  EXPECT_EQ(eversion_t(), log.get_last_write_since(other, eversion_t(6,5)));
+  EXPECT_EQ(eversion_t(), log.get_last_write_since(unwritten, eversion_t()));
+
+  EXPECT_TRUE(log.has_write_since(oid, eversion_t(6,3)));
+  EXPECT_FALSE(log.has_write_since(oid, eversion_t(6,4)));
+  EXPECT_FALSE(log.has_write_since(unwritten, eversion_t()));
+}
+
 TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   clear();
 
@@ -2996,6 +3034,73 @@ TEST(pg_log_dup_t, get_key_name) {
 }
 
 
+TEST(pg_log_reqid_index_t, insert_find_erase) {
+  std::list<pg_log_dup_t> dups;
+  pg_log_reqid_index_t<pg_log_dup_t, pg_log_dup_reqid_match_t> index;
+  auto client = entity_name_t::CLIENT(777);
+  for (unsigned i = 0; i < 1000; ++i) {
+    dups.emplace_back(eversion_t(1, i + 1), i + 1,
+		      osd_reqid_t(client, 8, i), 0);
+    index.insert_or_assign(dups.back().reqid, &dups.back());
+  }
+  EXPECT_EQ(1000u, index.size());
+  for (auto& d : dups) {
+    EXPECT_EQ(&d, index.find(d.reqid));
+  }
+  EXPECT_EQ(nullptr, index.find(osd_reqid_t(client, 8, 1000)));
+
+  // a later dup with the same reqid replaces the earlier one
+  dups.emplace_back(eversion_t(2, 1), 1001, osd_reqid_t(client, 8, 0), 0);
+  index.insert_or_assign(dups.back().reqid, &dups.back());
+  EXPECT_EQ(1000u, index.size());
+  EXPECT_EQ(&dups.back(), index.find(osd_reqid_t(client, 8, 0)));
+
+  // trim from the front, the remaining ones have to be found still
+  unsigned trimmed = 0;
+  while (dups.size() > 10) {
+    index.erase(dups.front().reqid);
+    dups.pop_front();
+    ++trimmed;
+  }
+  EXPECT_EQ(9u, index.size());
+  for (auto& d : dups) {
+    if (d.reqid.tid != 0) {
+      EXPECT_EQ(&d, index.find(d.reqid));
+    }
+  }
+  EXPECT_LT(index.get_bytes(), 1000u * 16);
+  index.clear();
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(nullptr, index.find(dups.back().reqid));
+}
+
+TEST(pg_log_reqid_index_t, extra_reqids) {
+  pg_log_reqid_index_t<pg_log_entry_t, pg_log_entry_extra_reqid_match_t> index;
+  auto client = entity_name_t::CLIENT(777);
+  osd_reqid_t shared(client, 8, 1);
+  pg_log_entry_t a, b;
+  a.extra_reqids.emplace_back(shared, 1);
+  a.extra_reqids.emplace_back(osd_reqid_t(client, 8, 2), 2);
+  b.extra_reqids.emplace_back(shared, 3);
+  for (auto e : {&a, &b}) {
+    for (auto& extra : e->extra_reqids) {
+      index.insert(extra.first, e);
+    }
+  }
+  EXPECT_EQ(3u, index.size());
+  EXPECT_EQ(&a, index.find(osd_reqid_t(client, 8, 2)));
+  auto found = index.find(shared);
+  EXPECT_TRUE(found == &a || found == &b);
+
+  // unindexing one entry keeps the other one found by the shared reqid
+  EXPECT_TRUE(index.erase(shared, &a));
+  EXPECT_FALSE(index.erase(shared, &a));
+  EXPECT_EQ(&b, index.find(shared));
+  EXPECT_TRUE(index.erase(osd_reqid_t(client, 8, 2), &a));
+  EXPECT_EQ(nullptr, index.find(osd_reqid_t(client, 8, 2)));
+  EXPECT_EQ(1u, index.size());
+}
+
 // This tests trim() to make copies of
 // 2 log entries (107, 106) and 3 additional for a total
 // of 5 dups.  Nothing from the original dups is copied.
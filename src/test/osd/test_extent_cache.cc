@@ -66,6 +66,8 @@ struct Client : public ECExtentCache::BackendReadListener
   ECExtentCache cache;
   optional<shard_extent_set_t> active_reads;
   list<shard_extent_map_t> results;
+  bool hold_reads = false;   // take the reads held back by the window
+  bool read_flush_scheduled = false;
 
   Client(uint64_t chunk_size, int k, int m, uint64_t cache_size) :
     sinfo(k, m, k*chunk_size, vector<shard_id_t>(0)),
@@ -77,6 +79,26 @@ struct Client : public ECExtentCache::BackendReadListener
     active_reads = request;
   }
 
+  bool schedule_read_flush(ceph::timespan delay) override {
+    if (!hold_reads) {
+      return false;
+    }
+    ceph_assert(!read_flush_scheduled);
+    read_flush_scheduled = true;
+    return true;
+  }
+
+  void cancel_read_flush() override {
+    read_flush_scheduled = false;
+  }
+
+  void flush_reads()
+  {
+    ceph_assert(read_flush_scheduled);
+    read_flush_scheduled = false;
+    cache.flush_reads();
+  }
+
   void cache_ready(const hobject_t& _oid, const shard_extent_map_t& _result)
   {
     ceph_assert(oid == _oid);
@@ -314,6 +336,68 @@ TEST(ECExtentCache, multiple_writes)
   op4.reset();
 }
 
+TEST(ECExtentCache, coalesce_window)
+{
+  g_ceph_context->_conf.set_val_or_die("ec_extent_cache_read_coalesce_us", "100");
+  Client cl(32, 2, 1, 64);
+  g_ceph_context->_conf.rm_val("ec_extent_cache_read_coalesce_us");
+  cl.hold_reads = true;
+
+  // The first read is held back until the window closes.
+  auto to_read1 = iset_from_vector( {{{0, 2}}}, cl.get_stripe_info());
+  auto to_write1 = iset_from_vector({{{0, 10}}}, cl.get_stripe_info());
+  optional op1 = cl.cache.prepare(cl.oid, to_read1, to_write1, 64, 64, false,
+   [&cl](ECExtentCache::OpRef &op)
+   {
+      cl.cache_ready(op->get_hoid(), op->get_result());
+   });
+  cl.cache_execute(*op1);
+  ASSERT_TRUE(cl.read_flush_scheduled);
+  ASSERT_FALSE(cl.active_reads);
+  ASSERT_TRUE(cl.results.empty());
+
+  // The second write to the object adds its read to the held back one.
+  auto to_read2 = iset_from_vector( {{{32, 6}}}, cl.get_stripe_info());
+  auto to_write2 = iset_from_vector({{{32, 10}}}, cl.get_stripe_info());
+  optional op2 = cl.cache.prepare(cl.oid, to_read2, to_write2, 64, 64, false,
+   [&cl](ECExtentCache::OpRef &op)
+   {
+      cl.cache_ready(op->get_hoid(), op->get_result());
+   });
+  cl.cache_execute(*op2);
+  ASSERT_FALSE(cl.active_reads);
+
+  // Both writes are served by a single backend read.
+  cl.flush_reads();
+  auto expected_read = iset_from_vector({{{0, 2}, {32, 6}}}, cl.get_stripe_info());
+  ASSERT_EQ(expected_read, cl.active_reads);
+  cl.complete_read();
+  ASSERT_FALSE(cl.active_reads);
+  ASSERT_FALSE(cl.read_flush_scheduled);
+  ASSERT_EQ(2, cl.results.size());
+  ASSERT_EQ(to_read1, cl.results.front().get_extent_set());
+  ASSERT_EQ(to_read2, cl.results.back().get_extent_set());
+  cl.complete_write(*op1);
+  cl.complete_write(*op2);
+  op1.reset();
+  op2.reset();
+
+  // on_change drops the held back read.
+  auto to_read3 = iset_from_vector( {{{64, 2}}}, cl.get_stripe_info());
+  auto to_write3 = iset_from_vector({{{64, 10}}}, cl.get_stripe_info());
+  optional op3 = cl.cache.prepare(cl.oid, to_read3, to_write3, 128, 128, false,
+   [&cl](ECExtentCache::OpRef &op)
+   {
+      cl.cache_ready(op->get_hoid(), op->get_result());
+   });
+  cl.cache_execute(*op3);
+  ASSERT_TRUE(cl.read_flush_scheduled);
+  cl.cache.on_change();
+  ASSERT_FALSE(cl.read_flush_scheduled);
+  op3.reset();
+  cl.cache.on_change2();
+}
+
 int dummies;
 struct Dummy
 {
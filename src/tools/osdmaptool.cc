@@ -14,6 +14,7 @@
  */
 
 #include <string>
+#include <thread>
 #include <sys/stat.h>
 
 #include "common/ceph_argparse.h"
@@ -30,6 +31,7 @@
 
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 using namespace std;
 
@@ -70,6 +72,8 @@ void usage()
   cout << "   --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported" << std::endl;
   cout << "   --tree                  displays a tree of the map" << std::endl;
   cout << "   --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds" << std::endl;
+  cout << "   --bench-mapping <epochs> measure how fast the pg mapping catches up with" << std::endl;
+  cout << "                           <epochs> osds going down and up, fully and incrementally" << std::endl;
   cout << "   --adjust-crush-weight <osdid:weight>[,<osdid:weight>,<...>] change <osdid> CRUSH <weight> (but do not persist)" << std::endl;
   cout << "   --save                  write modified osdmap with upmap or crush-adjust changes" << std::endl;
   cout << "   --read <file>           calculate pg upmap entries to balance pg primaries" << std::endl;
@@ -185,6 +189,7 @@ int main(int argc, const char **argv)
 
   int64_t pg_num = -1;
   bool test_map_pgs_dump_all = false;
+  int bench_mapping = 0;
   bool save = false;
   bool vstart = false;
   bool osd_size_aware = false;
@@ -277,6 +282,7 @@ int main(int argc, const char **argv)
       test_map_pg = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--test_map_object", (char*)NULL)) {
       test_map_object = val;
+    } else if (ceph_argparse_witharg(args, i, &bench_mapping, err, "--bench-mapping", (char*)NULL)) {
     } else if (ceph_argparse_flag(args, i, "--test_crush", (char*)NULL)) {
       test_crush = true;
     } else if (ceph_argparse_witharg(args, i, &val, err, "--pg_num", (char*)NULL)) {
@@ -887,6 +893,62 @@ skip_upmap:
         cout << "size " << i << "\t" << size[i] << std::endl;
     }
   }
+  if (bench_mapping > 0) {
+    if (osdmap.get_pools().empty()) {
+      cerr << me << ": no pools to map" << std::endl;
+      exit(1);
+    }
+    // mark the up osds down one per epoch and then back up, like a rack
+    // going away and coming back
+    vector<int> osds;
+    for (int o = 0;
+	 o < osdmap.get_max_osd() && (int)osds.size() * 2 < bench_mapping;
+	 ++o) {
+      if (osdmap.is_up(o)) {
+	osds.push_back(o);
+      }
+    }
+    if (osds.empty()) {
+      cerr << me << ": no osd is up, try --mark-up-in" << std::endl;
+      exit(1);
+    }
+    vector<OSDMap::Incremental> incs;
+    for (int i = 0; i < bench_mapping; ++i) {
+      auto& inc = incs.emplace_back(osdmap.get_epoch() + i + 1);
+      inc.fsid = osdmap.get_fsid();
+      inc.new_state[osds[i % osds.size()]] = CEPH_OSD_UP;
+    }
+
+    ThreadPool tp(g_ceph_context, "osdmaptool::mapping", "tp_mapping",
+		  std::max(1u, std::thread::hardware_concurrency()));
+    ParallelPGMapper mapper(g_ceph_context, &tp);
+    tp.start();
+    unsigned pgs_per_chunk = g_conf()->mon_osd_mapping_pgs_per_chunk;
+    for (bool incremental : {false, true}) {
+      OSDMap m;
+      m.deepish_copy_from(osdmap);
+      OSDMapMapping mapping;
+      mapping.start_update(m, mapper, pgs_per_chunk)->wait();
+      auto start = ceph::mono_clock::now();
+      for (auto& inc : incs) {
+	int r = m.apply_incremental(inc);
+	ceph_assert(r == 0);
+	if (incremental) {
+	  mapping.note_incremental(inc);
+	} else {
+	  mapping.note_full_map();
+	}
+	mapping.start_update(m, mapper, pgs_per_chunk)->wait();
+      }
+      double secs = std::chrono::duration<double>(
+	ceph::mono_clock::now() - start).count();
+      cout << (incremental ? "incremental" : "full") << " mapping of "
+	   << mapping.get_num_pgs() << " pgs: " << incs.size()
+	   << " epochs in " << secs << " s, " << (incs.size() / secs)
+	   << " epochs/s" << std::endl;
+    }
+    tp.stop();
+  }
   if (test_crush) {
     int pass = 0;
     while (1) {
@@ -922,7 +984,8 @@ skip_upmap:
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
       !test_map_pgs && !test_map_pgs_dump && !test_map_pgs_dump_all &&
-      adjust_crush_weight.empty() && !upmap && !upmap_cleanup && !read) {
+      adjust_crush_weight.empty() && !upmap && !upmap_cleanup && !read &&
+      !bench_mapping) {
     cerr << me << ": no action specified?" << std::endl;
     usage();
   }